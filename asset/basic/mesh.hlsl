@@ -12,6 +12,14 @@ cbuffer PSParams : register(b1)
     int LightCount;
 };
 
+// range of this object in ObjectLightIndices.
+// a negative count means every light
+cbuffer ObjectLights : register(b2)
+{
+    int ObjectLightOffset;
+    int ObjectLightCount;
+};
+
 struct VSInput
 {
     float3 position : POSITION;
@@ -31,7 +39,8 @@ Texture2D<float3> Albedo    : register(t0);
 Texture2D<float>  Metallic  : register(t1);
 Texture2D<float>  Roughness : register(t2);
 
-StructuredBuffer<PBSLight> Lights : register(t3);
+StructuredBuffer<PBSLight> Lights             : register(t3);
+StructuredBuffer<int>      ObjectLightIndices : register(t4);
 
 SamplerState LinearSampler : register(s0);
 
@@ -53,12 +62,16 @@ float4 PSMain(VSOutput input) : SV_TARGET
     float  metallic  = Metallic.Sample(LinearSampler, input.texCoord);
     float  roughness = Roughness.Sample(LinearSampler, input.texCoord);
 
+    bool useObjectLights = ObjectLightCount >= 0;
+    int  lightCount      = useObjectLights ? ObjectLightCount : LightCount;
+
     float3 result = float3(0, 0, 0);
-    for(int i = 0; i < LightCount; ++i)
+    for(int i = 0; i < lightCount; ++i)
     {
+        int lightIndex = useObjectLights ? ObjectLightIndices[ObjectLightOffset + i] : i;
         result += PBSWithSingleLight(
             wo, input.worldPosition, normalize(input.worldNormal),
-            albedo, metallic, roughness, Lights[i]);
+            albedo, metallic, roughness, Lights[lightIndex]);
     }
 
     return float4(pow(saturate(result), 1 / 2.2), 1);
@@ -4,6 +4,17 @@
 #define THREAD_GROUP_SIZE_Y 8
 #define LIGHT_BATCH_SIZE    (THREAD_GROUP_SIZE_X * THREAD_GROUP_SIZE_Y)
 
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+// statistics buffer layout. must be consistent with src/clustering/statistics.h
+
+#define STAT_ASSIGNMENT_COUNT    0
+#define STAT_STORED_COUNT        1
+#define STAT_MAX_LIGHTS          2
+#define STAT_OVERFLOWED_CLUSTERS 3
+#define STAT_HISTOGRAM           4
+#define STAT_HISTOGRAM_BIN_COUNT 256
+
 struct CSParams
 {
     float4x4 view;
@@ -14,7 +25,27 @@ struct CSParams
     int lightCount;
 
     int lightIndexCount;
-    float pad0[3];
+    int enableStatistics;
+    int depthWidth;
+    int depthHeight;
+
+    // viewZ2i constants of forward.hlsl
+    float A;
+    float B;
+
+    // view z = depthBias / (depth - depthScale)
+    float depthScale;
+    float depthBias;
+
+    int   slicingMode;
+    float nearSliceZ;
+    float projX;
+    float projY;
+
+    int clusterTest;
+    int enableGlobalLights;
+    int clusterLayout;
+    int pad0;
 };
 
 ConstantBuffer<CSParams> Params : register(b0);
@@ -22,13 +53,200 @@ ConstantBuffer<CSParams> Params : register(b0);
 StructuredBuffer<PBSLight> LightBuffer       : register(t0);
 StructuredBuffer<AABB>     ClusterAABBBuffer : register(t1);
 
+#ifdef COMPACT_CLUSTERS
+RWStructuredBuffer<uint> ClusterRangeBuffer : register(u0);
+RWStructuredBuffer<uint> LightIndexBuffer   : register(u1);
+#else
 RWStructuredBuffer<ClusterRange> ClusterRangeBuffer : register(u0);
 RWStructuredBuffer<int>          LightIndexBuffer   : register(u1);
+#endif
 
 RWStructuredBuffer<int> LightIndexCounterBuffer : register(u2);
 
+RWStructuredBuffer<uint> StatisticsBuffer : register(u3);
+
+// active clusters: [0] is the count, followed by the compacted list of
+// cluster indices and then one flag per cluster
+RWStructuredBuffer<uint> ActiveClusterBuffer : register(u4);
+
+// D3D12_DISPATCH_ARGUMENTS of CSMainActive
+RWStructuredBuffer<uint> ActiveDispatchArgsBuffer : register(u5);
+
+Texture2D<float> DepthBuffer : register(t2);
+
+// one bit per light set by GlobalLightList. those lights are shaded by
+// every pixel and stay out of the cluster lists
+StructuredBuffer<uint> GlobalLightMaskBuffer : register(t3);
+
+#define ACTIVE_COUNT 0
+#define ACTIVE_LIST  1
+#define ACTIVE_FLAGS (1 + Params.clusterXCount * Params.clusterYCount * Params.clusterZCount)
+
 groupshared PBSLight sharedLightGroup[LIGHT_BATCH_SIZE];
 
+// lightCount may exceed MAX_LIGHTS_PER_CLUSTER when statistics are enabled.
+// only the first MAX_LIGHTS_PER_CLUSTER lights are stored
+
+void addClusterToStatistics(int lightCount)
+{
+    uint count = uint(lightCount);
+    uint bin   = min(count, STAT_HISTOGRAM_BIN_COUNT - 1);
+
+    InterlockedAdd(StatisticsBuffer[STAT_ASSIGNMENT_COUNT], count);
+    InterlockedAdd(
+        StatisticsBuffer[STAT_STORED_COUNT], min(count, MAX_LIGHTS_PER_CLUSTER));
+    InterlockedMax(StatisticsBuffer[STAT_MAX_LIGHTS], count);
+
+    if(lightCount > MAX_LIGHTS_PER_CLUSTER)
+        InterlockedAdd(StatisticsBuffer[STAT_OVERFLOWED_CLUSTERS], 1);
+
+    InterlockedAdd(StatisticsBuffer[STAT_HISTOGRAM + bin], 1);
+}
+
+// ranges are stored in the layout of Params.clusterLayout, the other
+// buffers use clusterIndex directly
+
+int getClusterRangeSlot(int clusterIndex)
+{
+    int zi = clusterIndex % Params.clusterZCount;
+    int yi = clusterIndex / Params.clusterZCount % Params.clusterYCount;
+    int xi = clusterIndex / Params.clusterZCount / Params.clusterYCount;
+    return getClusterSlot(
+        Params.clusterLayout, xi, yi, zi,
+        Params.clusterXCount, Params.clusterYCount, Params.clusterZCount);
+}
+
+void writeClusterLights(
+    int clusterIndex,
+    int lightCount,
+    int localLightIndices[MAX_LIGHTS_PER_CLUSTER])
+{
+    if(Params.enableStatistics)
+        addClusterToStatistics(lightCount);
+
+    int localLightCount = min(lightCount, MAX_LIGHTS_PER_CLUSTER);
+
+#ifdef COMPACT_CLUSTERS
+
+    // even allocations keep ranges word aligned, so no two clusters write
+    // halves of the same word
+
+    int beg = 0;
+    InterlockedAdd(
+        LightIndexCounterBuffer[0], (localLightCount + 1) & ~1, beg);
+
+    beg = min(beg, Params.lightIndexCount);
+    int count = min(localLightCount, Params.lightIndexCount - beg);
+    ClusterRangeBuffer[getClusterRangeSlot(clusterIndex)] =
+        packCompactRange(beg, count);
+
+    for(int j = 0; j < count; j += 2)
+    {
+        uint lo = uint(localLightIndices[j]);
+        uint hi = j + 1 < count ? uint(localLightIndices[j + 1]) : 0;
+        LightIndexBuffer[(beg + j) / 2] = lo | (hi << 16);
+    }
+
+#else
+
+    int beg = 0;
+    InterlockedAdd(LightIndexCounterBuffer[0], localLightCount, beg);
+
+    ClusterRange range;
+    range.rangeBeg = beg;
+    range.rangeEnd = min(Params.lightIndexCount, beg + localLightCount);
+    ClusterRangeBuffer[getClusterRangeSlot(clusterIndex)] = range;
+
+    for(int i = beg, j = 0; i < range.rangeEnd; ++i, ++j)
+        LightIndexBuffer[i] = localLightIndices[j];
+
+#endif
+}
+
+// global lights get a zero radius, which fails every cluster test
+
+PBSLight loadViewLight(int lightIndex)
+{
+    PBSLight light = LightBuffer[lightIndex];
+    light.position = mul(float4(light.position, 1), Params.view).xyz;
+
+    uint globalBit = 1u << uint(lightIndex % 32);
+    if(Params.enableGlobalLights != 0 &&
+       (GlobalLightMaskBuffer[lightIndex / 32] & globalBit) != 0)
+        light.maxDistance = 0;
+
+    return light;
+}
+
+TilePlanes getClusterTilePlanes(int xi, int yi)
+{
+    return getTilePlanes(
+        xi, yi, int2(Params.clusterXCount, Params.clusterYCount),
+        Params.projX, Params.projY);
+}
+
+bool isLightInCluster(PBSLight light, AABB aabb, TilePlanes planes)
+{
+    if(!isLightInAABB(light, aabb))
+        return false;
+    return Params.clusterTest != CLUSTER_TEST_FRUSTUM ||
+           isLightInTilePlanes(light, planes);
+}
+
+// every thread of the group must call this, since light batches are
+// loaded into group shared memory by all threads together
+
+void assignLights(bool validCluster, int clusterIndex, int posInGroup)
+{
+    int lightCount = 0;
+
+    AABB clusterAABB = ClusterAABBBuffer[validCluster ? clusterIndex : 0];
+
+    int tileIndex = clusterIndex / Params.clusterZCount;
+    TilePlanes tilePlanes = getClusterTilePlanes(
+        tileIndex / Params.clusterYCount, tileIndex % Params.clusterYCount);
+
+    int localLightIndices[MAX_LIGHTS_PER_CLUSTER];
+
+    for(int i = 0; i < Params.lightCount; i += LIGHT_BATCH_SIZE)
+    {
+        // load lights into group shared buffer
+
+        int posEnd = min(LIGHT_BATCH_SIZE, Params.lightCount - i);
+        if(posInGroup < posEnd)
+            sharedLightGroup[posInGroup] = loadViewLight(i + posInGroup);
+
+        GroupMemoryBarrierWithGroupSync();
+
+        // fill localLightIndices
+        
+        if(validCluster)
+        {
+            for(int j = 0; j < posEnd; ++j)
+            {
+                if(lightCount >= MAX_LIGHTS_PER_CLUSTER &&
+                   !Params.enableStatistics)
+                    break;
+
+                PBSLight light = sharedLightGroup[j];
+                if(isLightInCluster(light, clusterAABB, tilePlanes))
+                {
+                    if(lightCount < MAX_LIGHTS_PER_CLUSTER)
+                        localLightIndices[lightCount] = i + j;
+                    ++lightCount;
+                }
+            }
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    // fill ClusterIndexBuffer
+
+    if(validCluster)
+        writeClusterLights(clusterIndex, lightCount, localLightIndices);
+}
+
 [numthreads(THREAD_GROUP_SIZE_X, THREAD_GROUP_SIZE_Y, 1)]
 void CSMain(
     int3 threadIdx        : SV_DispatchThreadID,
@@ -47,41 +265,192 @@ void CSMain(
         threadIdx.y * Params.clusterZCount +
         threadIdx.z;
 
-    int localLightCount = 0;
+    assignLights(validCluster, clusterIndex, posInGroup);
+}
 
-    AABB clusterAABB = ClusterAABBBuffer[validCluster ? clusterIndex : 0];
+// active cluster pre-stage. CSMarkActiveClusters flags the cluster of every
+// depth sample, CSCompactActiveClusters compacts the flags and clears the
+// ranges of inactive clusters, CSWriteActiveDispatchArgs sizes the indirect
+// dispatch and CSMainActive assigns lights to the list
 
-#define MAX_LIGHTS_PER_CLUSTER 128
+[numthreads(8, 8, 1)]
+void CSMarkActiveClusters(int3 pixel : SV_DispatchThreadID)
+{
+    if(pixel.x >= Params.depthWidth || pixel.y >= Params.depthHeight)
+        return;
+
+    float depth = DepthBuffer[pixel.xy];
+    if(depth >= 1)
+        return;
+
+    float viewZ = Params.depthBias / (depth - Params.depthScale);
+
+    float2 scrPos = float2(
+        (pixel.x + 0.5) / Params.depthWidth,
+        1 - (pixel.y + 0.5) / Params.depthHeight);
+
+    int xi = int(floor(scrPos.x * Params.clusterXCount));
+    int yi = int(floor(scrPos.y * Params.clusterYCount));
+    int zi = viewZ2i(
+        Params.slicingMode, Params.A, Params.B, Params.nearSliceZ, viewZ);
+
+    if(0 <= zi && zi < Params.clusterZCount &&
+       0 <= xi && xi < Params.clusterXCount &&
+       0 <= yi && yi < Params.clusterYCount)
+    {
+        int clusterIndex =
+            xi * Params.clusterYCount * Params.clusterZCount +
+            yi * Params.clusterZCount +
+            zi;
+        ActiveClusterBuffer[ACTIVE_FLAGS + clusterIndex] = 1;
+    }
+}
+
+[numthreads(LIGHT_BATCH_SIZE, 1, 1)]
+void CSCompactActiveClusters(int3 threadIdx : SV_DispatchThreadID)
+{
+    int clusterCount =
+        Params.clusterXCount * Params.clusterYCount * Params.clusterZCount;
+
+    int clusterIndex = threadIdx.x;
+    if(clusterIndex >= clusterCount)
+        return;
+
+    if(ActiveClusterBuffer[ACTIVE_FLAGS + clusterIndex])
+    {
+        uint slot = 0;
+        InterlockedAdd(ActiveClusterBuffer[ACTIVE_COUNT], 1, slot);
+        ActiveClusterBuffer[ACTIVE_LIST + slot] = clusterIndex;
+    }
+    else
+    {
+#ifdef COMPACT_CLUSTERS
+        ClusterRangeBuffer[getClusterRangeSlot(clusterIndex)] =
+            packCompactRange(0, 0);
+#else
+        ClusterRange range;
+        range.rangeBeg = 0;
+        range.rangeEnd = 0;
+        ClusterRangeBuffer[getClusterRangeSlot(clusterIndex)] = range;
+#endif
+
+        if(Params.enableStatistics)
+            addClusterToStatistics(0);
+    }
+}
+
+[numthreads(1, 1, 1)]
+void CSWriteActiveDispatchArgs()
+{
+    uint activeCount = ActiveClusterBuffer[ACTIVE_COUNT];
+    ActiveDispatchArgsBuffer[0] =
+        (activeCount + LIGHT_BATCH_SIZE - 1) / LIGHT_BATCH_SIZE;
+    ActiveDispatchArgsBuffer[1] = 1;
+    ActiveDispatchArgsBuffer[2] = 1;
+}
+
+[numthreads(LIGHT_BATCH_SIZE, 1, 1)]
+void CSMainActive(
+    int3 groupIdx   : SV_GroupID,
+    int  posInGroup : SV_GroupIndex)
+{
+    int activeCount = ActiveClusterBuffer[ACTIVE_COUNT];
+
+    int activeIndex = groupIdx.x * LIGHT_BATCH_SIZE + posInGroup;
+    bool validCluster = activeIndex < activeCount;
+
+    int clusterIndex =
+        validCluster ? ActiveClusterBuffer[ACTIVE_LIST + activeIndex] : 0;
+
+    assignLights(validCluster, clusterIndex, posInGroup);
+}
+
+// hierarchical assignment: one thread group per screen tile and one thread
+// per z-slice. each light batch is first culled against the full-depth tile
+// aabb, then every slice only tests the survivors.
+// survivors are appended with atomics, so their order inside a batch (and
+// which lights are dropped by MAX_LIGHTS_PER_CLUSTER) is not deterministic
+
+#define TILE_THREAD_COUNT LIGHT_BATCH_SIZE
+
+groupshared AABB sharedTileAABB;
+groupshared int  sharedSurvivorCount;
+groupshared int  sharedSurvivorIndices[LIGHT_BATCH_SIZE];
+
+[numthreads(TILE_THREAD_COUNT, 1, 1)]
+void CSMainHierarchical(
+    int3 groupIdx   : SV_GroupID,
+    int  posInGroup : SV_GroupIndex)
+{
+    bool validCluster = posInGroup < Params.clusterZCount;
+
+    int tileBeg =
+        groupIdx.x * Params.clusterYCount * Params.clusterZCount +
+        groupIdx.y * Params.clusterZCount;
+
+    int clusterIndex = tileBeg + posInGroup;
+
+    AABB clusterAABB = ClusterAABBBuffer[validCluster ? clusterIndex : tileBeg];
+
+    // all clusters of the group share the tile planes, so the coarse test
+    // uses them too
+
+    TilePlanes tilePlanes = getClusterTilePlanes(groupIdx.x, groupIdx.y);
+
+    if(posInGroup == 0)
+    {
+        AABB tileAABB = clusterAABB;
+        for(int z = 1; z < Params.clusterZCount; ++z)
+        {
+            AABB aabb = ClusterAABBBuffer[tileBeg + z];
+            tileAABB.lower = min(tileAABB.lower, aabb.lower);
+            tileAABB.upper = max(tileAABB.upper, aabb.upper);
+        }
+        sharedTileAABB = tileAABB;
+    }
+
+    int lightCount = 0;
     int localLightIndices[MAX_LIGHTS_PER_CLUSTER];
 
     for(int i = 0; i < Params.lightCount; i += LIGHT_BATCH_SIZE)
     {
-        // load lights into group shared buffer
+        if(posInGroup == 0)
+            sharedSurvivorCount = 0;
 
-        int posEnd = min(LIGHT_BATCH_SIZE, Params.lightCount - i);
-        if(posInGroup < posEnd)
+        GroupMemoryBarrierWithGroupSync();
+
+        // coarse: cull the batch against the tile
+
+        int lightIndex = i + posInGroup;
+        if(lightIndex < Params.lightCount)
         {
-            PBSLight light = LightBuffer[i + posInGroup];
-            light.position = mul(float4(light.position, 1), Params.view).xyz;
-            sharedLightGroup[posInGroup] = light;
+            PBSLight light = loadViewLight(lightIndex);
+            if(isLightInCluster(light, sharedTileAABB, tilePlanes))
+            {
+                int slot = 0;
+                InterlockedAdd(sharedSurvivorCount, 1, slot);
+                sharedLightGroup[slot]      = light;
+                sharedSurvivorIndices[slot] = lightIndex;
+            }
         }
 
         GroupMemoryBarrierWithGroupSync();
 
-        // fill localLightIndices
-        
+        // fine: survivors against this thread's z-slice
+
         if(validCluster)
         {
-            for(int j = 0; j < posEnd; ++j)
+            for(int j = 0; j < sharedSurvivorCount; ++j)
             {
-                if(localLightCount >= MAX_LIGHTS_PER_CLUSTER)
+                if(lightCount >= MAX_LIGHTS_PER_CLUSTER &&
+                   !Params.enableStatistics)
                     break;
 
-                PBSLight light = sharedLightGroup[j];
-                if(isLightInAABB(light, clusterAABB))
+                if(isLightInCluster(sharedLightGroup[j], clusterAABB, tilePlanes))
                 {
-                    localLightIndices[localLightCount] = i + j;
-                    ++localLightCount;
+                    if(lightCount < MAX_LIGHTS_PER_CLUSTER)
+                        localLightIndices[lightCount] = sharedSurvivorIndices[j];
+                    ++lightCount;
                 }
             }
         }
@@ -89,19 +458,6 @@ void CSMain(
         GroupMemoryBarrierWithGroupSync();
     }
 
-    // fill ClusterIndexBuffer
-
     if(validCluster)
-    {
-        int beg = 0;
-        InterlockedAdd(LightIndexCounterBuffer[0], localLightCount, beg);
-
-        ClusterRange range;
-        range.rangeBeg = beg;
-        range.rangeEnd = min(Params.lightIndexCount, beg + localLightCount);
-        ClusterRangeBuffer[clusterIndex] = range;
-
-        for(int i = beg, j = 0; i < range.rangeEnd; ++i, ++j)
-            LightIndexBuffer[i] = localLightIndices[j];
-    }
+        writeClusterLights(clusterIndex, lightCount, localLightIndices);
 }
@@ -0,0 +1,83 @@
+#ifndef CLUSTER_LAYOUT_HLSL
+#define CLUSTER_LAYOUT_HLSL
+
+// where the range of cluster (xi, yi, zi) is stored in the cluster range
+// buffer. this file is included by common.hlsl and by
+// src/clustering/cluster_layout.h, so it only uses what hlsl and c++ both
+// accept: int arithmetic, #define and functions without references
+
+// x * countY * countZ + y * countZ + z, the order of getClusterIndex.
+// neighbouring screen tiles are countZ or countY * countZ ranges apart
+#define CLUSTER_LAYOUT_LINEAR      0
+// z outermost, then screen rows, so neighbouring tiles of a slice are
+// neighbouring ranges
+#define CLUSTER_LAYOUT_SLICE_MAJOR 1
+// bits of x, y and z interleaved, which keeps small 3d blocks of clusters
+// together. each axis is rounded up to a power of 2, so the buffer has
+// unused ranges
+#define CLUSTER_LAYOUT_MORTON      2
+
+// bits needed for indices in [0, count)
+inline int getClusterLayoutBits(int count)
+{
+    int bits = 0;
+    while((1 << bits) < count)
+        ++bits;
+    return bits;
+}
+
+// bit i of each axis goes to the next free slot bit, x first. an axis
+// stops taking part once its bits are used up
+inline int getMortonClusterSlot(
+    int xi, int yi, int zi, int countX, int countY, int countZ)
+{
+    int bitsX = getClusterLayoutBits(countX);
+    int bitsY = getClusterLayoutBits(countY);
+    int bitsZ = getClusterLayoutBits(countZ);
+
+    int slot  = 0;
+    int shift = 0;
+    for(int i = 0; i < bitsX || i < bitsY || i < bitsZ; ++i)
+    {
+        if(i < bitsX)
+        {
+            slot |= ((xi >> i) & 1) << shift;
+            ++shift;
+        }
+        if(i < bitsY)
+        {
+            slot |= ((yi >> i) & 1) << shift;
+            ++shift;
+        }
+        if(i < bitsZ)
+        {
+            slot |= ((zi >> i) & 1) << shift;
+            ++shift;
+        }
+    }
+    return slot;
+}
+
+inline int getClusterSlot(
+    int layout, int xi, int yi, int zi, int countX, int countY, int countZ)
+{
+    if(layout == CLUSTER_LAYOUT_SLICE_MAJOR)
+        return (zi * countY + yi) * countX + xi;
+    if(layout == CLUSTER_LAYOUT_MORTON)
+        return getMortonClusterSlot(xi, yi, zi, countX, countY, countZ);
+    return (xi * countY + yi) * countZ + zi;
+}
+
+// ranges the cluster range buffer needs
+inline int getClusterSlotCount(int layout, int countX, int countY, int countZ)
+{
+    if(layout == CLUSTER_LAYOUT_MORTON)
+    {
+        return 1 << (getClusterLayoutBits(countX) +
+                     getClusterLayoutBits(countY) +
+                     getClusterLayoutBits(countZ));
+    }
+    return countX * countY * countZ;
+}
+
+#endif // #ifndef CLUSTER_LAYOUT_HLSL
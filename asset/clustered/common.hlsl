@@ -2,6 +2,7 @@
 #define COMMON_HLSL
 
 #include "../common/pbs.hlsl"
+#include "./cluster_layout.hlsl"
 
 struct AABB
 {
@@ -15,6 +16,50 @@ struct ClusterRange
     int rangeEnd;
 };
 
+// with COMPACT_CLUSTERS defined, a cluster range is one uint (offset in the
+// low bits, count in the high bits) and light indices are uint16 packed two
+// per uint, lower index first. see clustering::packCompactRange
+
+#define COMPACT_RANGE_OFFSET_BITS 24
+#define COMPACT_RANGE_OFFSET_MASK ((1u << COMPACT_RANGE_OFFSET_BITS) - 1)
+
+uint packCompactRange(int offset, int count)
+{
+    return uint(offset) | (uint(count) << COMPACT_RANGE_OFFSET_BITS);
+}
+
+int getCompactRangeOffset(uint range)
+{
+    return int(range & COMPACT_RANGE_OFFSET_MASK);
+}
+
+int getCompactRangeCount(uint range)
+{
+    return int(range >> COMPACT_RANGE_OFFSET_BITS);
+}
+
+// depth slicing, see clustering::SlicingMode
+
+#define SLICING_LOGARITHMIC 0
+#define SLICING_LINEAR      1
+#define SLICING_HYBRID      2
+
+// see clustering::viewZ2i
+int viewZ2i(int slicingMode, float A, float B, float nearSliceZ, float z)
+{
+    if(slicingMode == SLICING_LINEAR)
+        return int(floor(z * A - B));
+    if(slicingMode == SLICING_HYBRID && z < nearSliceZ)
+        return 0;
+    int offset = slicingMode == SLICING_HYBRID ? 1 : 0;
+    return offset + int(floor(log(z) * A - B));
+}
+
+// light tests, see clustering::ClusterTest
+
+#define CLUSTER_TEST_AABB    0
+#define CLUSTER_TEST_FRUSTUM 1
+
 float square(float x)
 {
     return x * x;
@@ -28,4 +73,68 @@ bool isLightInAABB(PBSLight light, AABB aabb)
     return dist2 < square(light.maxDistance);
 }
 
+// see clustering::ClusterTilePlanes. assumes a projection with
+// clip = (projX * x, projY * y, ..., z), like the camera of the samples
+
+struct TilePlanes
+{
+    float3 normals[4];
+    float3 edges[4];
+    float  cosAngles[4];
+};
+
+TilePlanes getTilePlanes(int xi, int yi, int2 tileCount, float projX, float projY)
+{
+    float2 lower = float2(xi, yi) / tileCount * 2 - 1;
+    float2 upper = float2(xi + 1, yi + 1) / tileCount * 2 - 1;
+
+    TilePlanes planes;
+    planes.normals[0] = normalize(float3(projX, 0, -lower.x));
+    planes.normals[1] = normalize(float3(0, projY, -lower.y));
+    planes.normals[2] = -normalize(float3(projX, 0, -upper.x));
+    planes.normals[3] = -normalize(float3(0, projY, -upper.y));
+
+    for(int i = 0; i < 4; ++i)
+    {
+        float3 a = planes.normals[i];
+        float3 b = planes.normals[(i + 1) % 4];
+        planes.edges[i]     = normalize(cross(a, b));
+        planes.cosAngles[i] = dot(a, b);
+    }
+
+    return planes;
+}
+
+// see clustering::isLightInTilePlanes
+bool isLightInTilePlanes(PBSLight light, TilePlanes planes)
+{
+    float3 p = light.position;
+    float  r = light.maxDistance;
+
+    float d[4];
+    for(int i = 0; i < 4; ++i)
+    {
+        d[i] = dot(planes.normals[i], p);
+        if(d[i] <= -r)
+            return false;
+    }
+
+    for(int j = 0; j < 4; ++j)
+    {
+        int k = (j + 1) % 4;
+        if(d[j] >= 0 || d[k] >= 0)
+            continue;
+
+        float c = planes.cosAngles[j];
+        if(d[k] - d[j] * c >= 0 || d[j] - d[k] * c >= 0)
+            continue;
+
+        float t = dot(planes.edges[j], p);
+        if(dot(p, p) - t * t >= square(r))
+            return false;
+    }
+
+    return true;
+}
+
 #endif // #ifndef COMMON_HLSL
@@ -0,0 +1,30 @@
+struct VSTransform
+{
+    float4x4 world;
+    float4x4 worldView;
+    float4x4 worldViewProj;
+};
+
+ConstantBuffer<VSTransform> vsTransform : register(b0);
+
+struct VSInput
+{
+    float3 position : POSITION;
+};
+
+struct VSOutput
+{
+    float4 position : SV_POSITION;
+};
+
+VSOutput VSMain(VSInput input)
+{
+    VSOutput output;
+    output.position = mul(float4(input.position, 1), vsTransform.worldViewProj);
+    return output;
+}
+
+void PSMain(VSOutput input)
+{
+    // do nothing
+}
@@ -20,7 +20,23 @@ struct PSParams
 
     float B;
     int   enableCulling;
-    float pad0[3];
+    int   enableZBinning;
+    int   zBinMaskWordCount;
+
+    int   zBinTileCountX;
+    int   zBinTileCountY;
+    int   zBinCount;
+    float zBinNearZ;
+
+    float zBinScale;
+    int   slicingMode;
+    float nearSliceZ;
+    int   globalLightCount;
+
+    int clusterLayout;
+    int enableTiles;
+    int tileCountX;
+    int tileCountY;
 };
 
 ConstantBuffer<VSTransform> vsTransform : register(b0);
@@ -32,8 +48,21 @@ Texture2D<float3> Albedo    : register(t1);
 Texture2D<float>  Metallic  : register(t2);
 Texture2D<float>  Roughness : register(t3);
 
+#ifdef COMPACT_CLUSTERS
+StructuredBuffer<uint> ClusterRangeBuffer : register(t4);
+StructuredBuffer<uint> LightIndexBuffer   : register(t5);
+#else
 StructuredBuffer<ClusterRange> ClusterRangeBuffer : register(t4);
 StructuredBuffer<int>          LightIndexBuffer   : register(t5);
+#endif
+
+// z-binning, see clustering/zbin.h
+StructuredBuffer<uint> ZBinBuffer             : register(t6);
+StructuredBuffer<uint> TileMaskBuffer         : register(t7);
+StructuredBuffer<int>  SortedLightIndexBuffer : register(t8);
+
+// lights left out of the cluster lists, see GlobalLightList
+StructuredBuffer<int> GlobalLightIndexBuffer : register(t9);
 
 SamplerState LinearSampler : register(s0);
 
@@ -70,18 +99,16 @@ VSOutput VSMain(VSInput input)
     return output;
 }
 
-int viewZ2i(float A, float B, float z)
-{
-    return int(floor(log(z) * A - B));
-}
-
-int getClusterIndex(float3 viewPosition, float2 ndcPositionXY)
+// slot of the pixel's cluster in ClusterRangeBuffer, see cluster_layout.hlsl
+int getPixelClusterSlot(float3 viewPosition, float2 ndcPositionXY)
 {
     float2 scrPos = 0.5 * ndcPositionXY + 0.5;
 
     int xi = int(floor(scrPos.x * psParams.clusterCountX));
     int yi = int(floor(scrPos.y * psParams.clusterCountY));
-    int zi = viewZ2i(psParams.A, psParams.B, viewPosition.z);
+    int zi = viewZ2i(
+        psParams.slicingMode, psParams.A, psParams.B,
+        psParams.nearSliceZ, viewPosition.z);
 
     int result = -1;
 
@@ -89,9 +116,74 @@ int getClusterIndex(float3 viewPosition, float2 ndcPositionXY)
        0 <= xi && xi < psParams.clusterCountX &&
        0 <= yi && yi < psParams.clusterCountY)
     {
-        result = xi * psParams.clusterCountY * psParams.clusterCountZ +
-                 yi * psParams.clusterCountZ +
-                 zi;
+        result = getClusterSlot(
+            psParams.clusterLayout, xi, yi, zi,
+            psParams.clusterCountX, psParams.clusterCountY, psParams.clusterCountZ);
+    }
+
+    return result;
+}
+
+// slot of the pixel's tile in ClusterRangeBuffer when it holds the lists
+// of asset/clustered/tile.hlsl
+int getPixelTileIndex(float2 ndcPositionXY)
+{
+    float2 scrPos = 0.5 * ndcPositionXY + 0.5;
+
+    int xi = int(floor(scrPos.x * psParams.tileCountX));
+    int yi = int(floor(scrPos.y * psParams.tileCountY));
+
+    int result = -1;
+
+    if(0 <= xi && xi < psParams.tileCountX &&
+       0 <= yi && yi < psParams.tileCountY)
+        result = xi * psParams.tileCountY + yi;
+
+    return result;
+}
+
+void getClusterLightRange(int clusterSlot, out int rangeBeg, out int rangeEnd)
+{
+#ifdef COMPACT_CLUSTERS
+    uint range = ClusterRangeBuffer[clusterSlot];
+    rangeBeg = getCompactRangeOffset(range);
+    rangeEnd = rangeBeg + getCompactRangeCount(range);
+#else
+    ClusterRange range = ClusterRangeBuffer[clusterSlot];
+    rangeBeg = range.rangeBeg;
+    rangeEnd = range.rangeEnd;
+#endif
+}
+
+int getClusterLightIndex(int i)
+{
+#ifdef COMPACT_CLUSTERS
+    return int((LightIndexBuffer[i >> 1] >> ((i & 1) * 16)) & 0xffff);
+#else
+    return LightIndexBuffer[i];
+#endif
+}
+
+int getZBinIndex(float z)
+{
+    int bi = int(floor((z - psParams.zBinNearZ) * psParams.zBinScale));
+    return 0 <= bi && bi < psParams.zBinCount ? bi : -1;
+}
+
+int getZBinTileMaskBase(float2 ndcPositionXY)
+{
+    float2 scrPos = 0.5 * ndcPositionXY + 0.5;
+
+    int xi = int(floor(scrPos.x * psParams.zBinTileCountX));
+    int yi = int(floor(scrPos.y * psParams.zBinTileCountY));
+
+    int result = -1;
+
+    if(0 <= xi && xi < psParams.zBinTileCountX &&
+       0 <= yi && yi < psParams.zBinTileCountY)
+    {
+        result = (xi * psParams.zBinTileCountY + yi) *
+                 psParams.zBinMaskWordCount;
     }
 
     return result;
@@ -116,18 +208,63 @@ float4 PSMain(VSOutput input) : SV_TARGET
                 albedo, metallic, roughness, Lights[i]);
         }
     }
+    else if(psParams.enableZBinning != 0)
+    {
+        int binIndex = getZBinIndex(input.viewPosition.z);
+        int maskBase = getZBinTileMaskBase(
+            input.screenPos.xy / input.screenPos.w);
+        if(binIndex < 0 || maskBase < 0)
+            return float4(0, 0, 0, 1);
+
+        // empty bins have minIndex > maxIndex and skip the loop
+
+        uint bin = ZBinBuffer[binIndex];
+        int minIndex = int(bin & 0xffff);
+        int maxIndex = int(bin >> 16);
+
+        for(int w = minIndex / 32; w <= maxIndex / 32; ++w)
+        {
+            uint bits = TileMaskBuffer[maskBase + w];
+            if(w == minIndex / 32)
+                bits &= 0xffffffff << uint(minIndex % 32);
+            if(w == maxIndex / 32)
+                bits &= 0xffffffff >> uint(31 - maxIndex % 32);
+
+            while(bits != 0)
+            {
+                int bit = int(firstbitlow(bits));
+                bits &= bits - 1;
+
+                int lightIndex = SortedLightIndexBuffer[w * 32 + bit];
+                result += PBSWithSingleLight(
+                    wo, input.worldPosition, normalize(input.worldNormal),
+                    albedo, metallic, roughness, Lights[lightIndex]);
+            }
+        }
+    }
     else
     {
-        int clusterIndex = getClusterIndex(
-            input.viewPosition, input.screenPos.xy / input.screenPos.w);
-        if(clusterIndex < 0)
+        float2 ndcPositionXY = input.screenPos.xy / input.screenPos.w;
+
+        int clusterSlot = psParams.enableTiles != 0 ?
+            getPixelTileIndex(ndcPositionXY) :
+            getPixelClusterSlot(input.viewPosition, ndcPositionXY);
+        if(clusterSlot < 0)
             return float4(0, 0, 0, 1);
 
-        ClusterRange clusterRange = ClusterRangeBuffer[clusterIndex];
+        for(int g = 0; g < psParams.globalLightCount; ++g)
+        {
+            result += PBSWithSingleLight(
+                wo, input.worldPosition, normalize(input.worldNormal),
+                albedo, metallic, roughness, Lights[GlobalLightIndexBuffer[g]]);
+        }
+
+        int rangeBeg, rangeEnd;
+        getClusterLightRange(clusterSlot, rangeBeg, rangeEnd);
 
-        for(int i = clusterRange.rangeBeg; i < clusterRange.rangeEnd; ++i)
+        for(int i = rangeBeg; i < rangeEnd; ++i)
         {
-            int lightIndex = LightIndexBuffer[i];
+            int lightIndex = getClusterLightIndex(i);
             result += PBSWithSingleLight(
                 wo, input.worldPosition, normalize(input.worldNormal),
                 albedo, metallic, roughness, Lights[lightIndex]);
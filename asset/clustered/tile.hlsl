@@ -0,0 +1,168 @@
+#include "./common.hlsl"
+
+#define TILE_THREAD_COUNT_X 16
+#define TILE_THREAD_COUNT_Y 16
+#define TILE_THREAD_COUNT   (TILE_THREAD_COUNT_X * TILE_THREAD_COUNT_Y)
+
+// must be consistent with clustering::MAX_LIGHTS_PER_TILE
+#define MAX_LIGHTS_PER_TILE 256
+
+struct CSParams
+{
+    float4x4 view;
+
+    int tileCountX;
+    int tileCountY;
+    int lightCount;
+    int depthWidth;
+
+    int depthHeight;
+
+    // view z = depthBias / (depth - depthScale)
+    float depthScale;
+    float depthBias;
+
+    float projX;
+    float projY;
+
+    int pad0;
+    int pad1;
+    int pad2;
+};
+
+ConstantBuffer<CSParams> Params : register(b0);
+
+StructuredBuffer<PBSLight> LightBuffer : register(t0);
+
+// tile i owns the indices [i * MAX_LIGHTS_PER_TILE, (i + 1) * MAX_LIGHTS_PER_TILE)
+RWStructuredBuffer<ClusterRange> TileRangeBuffer : register(u0);
+RWStructuredBuffer<int>          LightIndexBuffer : register(u1);
+
+Texture2D<float> DepthBuffer : register(t1);
+
+// view z is positive, so the float bits order like the values
+groupshared uint sharedMinZ;
+groupshared uint sharedMaxZ;
+
+groupshared int sharedLightCount;
+groupshared int sharedLightIndices[MAX_LIGHTS_PER_TILE];
+
+// pixel range [beg, end) of tile ti along an axis of size pixelCount, a
+// superset of the pixels with floor((p + 0.5) / pixelCount * tileCount) == ti
+int2 getTilePixelRange(int ti, int tileCount, int pixelCount)
+{
+    int beg = int(floor(float(ti) * pixelCount / tileCount));
+    int end = int(ceil(float(ti + 1) * pixelCount / tileCount)) + 1;
+    return int2(max(beg - 1, 0), min(end, pixelCount));
+}
+
+// one thread group per tile, see clustering::CPULightTiles.
+// lights are appended with atomics, so which ones are dropped by
+// MAX_LIGHTS_PER_TILE is not deterministic
+
+[numthreads(TILE_THREAD_COUNT_X, TILE_THREAD_COUNT_Y, 1)]
+void CSMain(
+    int3 groupIdx         : SV_GroupID,
+    int3 threadIdxInGroup : SV_GroupThreadID,
+    int  posInGroup       : SV_GroupIndex)
+{
+    int xi = groupIdx.x;
+    int yi = groupIdx.y;
+
+    if(posInGroup == 0)
+    {
+        sharedMinZ       = asuint(3.402823466e+38f);
+        sharedMaxZ       = 0;
+        sharedLightCount = 0;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // depth bounds. yi = 0 is the bottom of the screen, row 0 the top
+
+    int2 pxRange = getTilePixelRange(xi, Params.tileCountX, Params.depthWidth);
+    int2 pyRange = getTilePixelRange(
+        Params.tileCountY - 1 - yi, Params.tileCountY, Params.depthHeight);
+
+    float localMinZ = 3.402823466e+38f;
+    float localMaxZ = 0;
+
+    for(int py = pyRange.x + threadIdxInGroup.y; py < pyRange.y;
+        py += TILE_THREAD_COUNT_Y)
+    {
+        float scrY = 1 - (py + 0.5) / Params.depthHeight;
+        if(int(floor(scrY * Params.tileCountY)) != yi)
+            continue;
+
+        for(int px = pxRange.x + threadIdxInGroup.x; px < pxRange.y;
+            px += TILE_THREAD_COUNT_X)
+        {
+            float scrX = (px + 0.5) / Params.depthWidth;
+            if(int(floor(scrX * Params.tileCountX)) != xi)
+                continue;
+
+            float depth = DepthBuffer[int2(px, py)];
+            if(depth >= 1)
+                continue;
+
+            float viewZ = Params.depthBias / (depth - Params.depthScale);
+            localMinZ = min(localMinZ, viewZ);
+            localMaxZ = max(localMaxZ, viewZ);
+        }
+    }
+
+    if(localMinZ <= localMaxZ)
+    {
+        InterlockedMin(sharedMinZ, asuint(localMinZ));
+        InterlockedMax(sharedMaxZ, asuint(localMaxZ));
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // lights. tiles without geometry keep an empty list
+
+    float minZ = asfloat(sharedMinZ);
+    float maxZ = asfloat(sharedMaxZ);
+
+    if(minZ <= maxZ)
+    {
+        TilePlanes planes = getTilePlanes(
+            xi, yi, int2(Params.tileCountX, Params.tileCountY),
+            Params.projX, Params.projY);
+
+        for(int li = posInGroup; li < Params.lightCount; li += TILE_THREAD_COUNT)
+        {
+            PBSLight light = LightBuffer[li];
+            light.position = mul(float4(light.position, 1), Params.view).xyz;
+
+            // see clustering::isLightInTile
+
+            if(light.position.z + light.maxDistance <= minZ ||
+               light.position.z - light.maxDistance >= maxZ ||
+               !isLightInTilePlanes(light, planes))
+                continue;
+
+            int slot = 0;
+            InterlockedAdd(sharedLightCount, 1, slot);
+            if(slot < MAX_LIGHTS_PER_TILE)
+                sharedLightIndices[slot] = li;
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    int tileIndex = xi * Params.tileCountY + yi;
+    int beg       = tileIndex * MAX_LIGHTS_PER_TILE;
+    int count     = min(sharedLightCount, MAX_LIGHTS_PER_TILE);
+
+    for(int i = posInGroup; i < count; i += TILE_THREAD_COUNT)
+        LightIndexBuffer[beg + i] = sharedLightIndices[i];
+
+    if(posInGroup == 0)
+    {
+        ClusterRange range;
+        range.rangeBeg = beg;
+        range.rangeEnd = beg + count;
+        TileRangeBuffer[tileIndex] = range;
+    }
+}
@@ -4,6 +4,7 @@
 #include <agz-utils/time.h>
 
 #include "../common/camera.h"
+#include "../common/clustering.h"
 #include "../common/sky.h"
 
 #include "./mesh.h"
@@ -210,6 +211,22 @@ void run()
     meshRenderer.setLights(
         lights.data(), lights.size(), d3d12.getResourceManager(), uploader);
 
+    // per-object light lists
+
+    const auto objectLightData =
+        common::toClusteringLights(lights.data(), lights.size());
+
+    clustering::ThreadPool      threadPool;
+    clustering::CPUObjectLights objectLights(threadPool);
+    objectLights.setIncrementalEnabled(true);
+    objectLights.setLights(objectLightData.data(), objectLightData.size());
+
+    // world bounds of the meshes in render queue order
+    std::vector<clustering::AABB> meshBounds(1);
+    objectLights.setObjects(meshBounds.data(), meshBounds.size());
+
+    bool enableObjectLights = true;
+
     agz::time::fps_counter_t fpsCounter;
     
     // mainloop
@@ -232,6 +249,13 @@ void run()
             ImGui::Text("fps: %d", fpsCounter.fps());
             ImGui::Text(
                 "camera position: %s", camera.getPosition().to_string().c_str());
+            ImGui::Checkbox("per-object light lists", &enableObjectLights);
+            if(enableObjectLights)
+            {
+                ImGui::Text(
+                    "object lights: %lld",
+                    static_cast<long long>(objectLights.getAssignmentCount()));
+            }
         }
         ImGui::End();
 
@@ -255,6 +279,15 @@ void run()
             d3d12.getFramebufferIndex(),
             { world, world * camera.getViewProj() });
 
+        if(enableObjectLights)
+        {
+            meshBounds[0] = common::getWorldBounds(mesh, world);
+            objectLights.run();
+            meshRenderer.setObjectLights(d3d12.getFramebufferIndex(), &objectLights);
+        }
+        else
+            meshRenderer.setObjectLights(d3d12.getFramebufferIndex(), nullptr);
+
         graph.run(d3d12.getFramebufferIndex());
         
         d3d12.swapFramebuffers();
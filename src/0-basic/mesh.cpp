@@ -14,6 +14,7 @@ MeshRenderer::MeshRenderer(D3D12Context &d3d12)
 {
     initRootSignature();
     initConstantBuffer();
+    initObjectLightBuffers();
 }
 
 rg::Pass *MeshRenderer::addToRenderGraph(
@@ -69,9 +70,18 @@ rg::Pass *MeshRenderer::addToRenderGraph(
 
         ctx->SetGraphicsRootShaderResourceView(
             3, lightBuffer_.getGPUVirtualAddress());
+        ctx->SetGraphicsRootShaderResourceView(
+            5, objectLightIndices_[frame].getGPUVirtualAddress());
 
-        for(auto mesh : meshes_)
+        for(size_t i = 0; i < meshes_.size(); ++i)
         {
+            auto mesh = meshes_[i];
+
+            const ObjectLightRange objectLightRange =
+                i < objectLightRanges_.size() ? objectLightRanges_[i]
+                                              : ObjectLightRange{};
+            ctx->SetGraphicsRoot32BitConstants(4, 2, &objectLightRange, 0);
+
             ctx->SetGraphicsRootConstantBufferView(
                 0, mesh->vsTransform.getGPUVirtualAddress(frame));
             ctx->SetGraphicsRootDescriptorTable(
@@ -111,6 +121,32 @@ void MeshRenderer::setLights(
     uploader.submitAndSync();
 }
 
+void MeshRenderer::setObjectLights(
+    int                                frameIndex,
+    const clustering::CPUObjectLights *objectLights)
+{
+    objectLightRanges_.clear();
+    if(!objectLights)
+        return;
+
+    auto &indices = objectLights->getLightIndices();
+    const size_t byteSize = (std::max)(indices.size(), size_t(1)) * sizeof(int32_t);
+
+    Buffer &buffer = objectLightIndices_[frameIndex];
+    if(buffer.getByteSize() < byteSize)
+        buffer.initializeUpload(rscMgr_, byteSize);
+    if(!indices.empty())
+        buffer.updateData(0, indices.size() * sizeof(int32_t), indices.data());
+
+    for(auto &range : objectLights->getObjectRanges())
+    {
+        objectLightRanges_.push_back({
+            .offset = range.rangeBeg,
+            .count  = range.rangeEnd - range.rangeBeg
+        });
+    }
+}
+
 void MeshRenderer::initRootSignature()
 {
     CD3DX12_DESCRIPTOR_RANGE psTableRange;
@@ -119,11 +155,16 @@ void MeshRenderer::initRootSignature()
     CD3DX12_ROOT_DESCRIPTOR_TABLE psTable;
     psTable.Init(1, &psTableRange);
 
+    CD3DX12_ROOT_PARAMETER objectLightRange;
+    objectLightRange.InitAsConstants(2, 2, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+
     RootSignatureBuilder builder;
     builder.addParameterCBV(b0,   D3D12_SHADER_VISIBILITY_VERTEX);
     builder.addParameter(psTable, D3D12_SHADER_VISIBILITY_PIXEL);
     builder.addParameterCBV(b1,   D3D12_SHADER_VISIBILITY_PIXEL);
     builder.addParameterSRV(t3,   D3D12_SHADER_VISIBILITY_PIXEL);
+    builder.addParameter(objectLightRange);
+    builder.addParameterSRV(t4,   D3D12_SHADER_VISIBILITY_PIXEL);
     builder.addStaticSampler(
         s0,
         D3D12_SHADER_VISIBILITY_PIXEL,
@@ -193,3 +234,12 @@ void MeshRenderer::initConstantBuffer()
 {
     psParams_.initializeUpload(rscMgr_, frameCount_);
 }
+
+void MeshRenderer::initObjectLightBuffers()
+{
+    // root srvs must point to valid memory even without light lists
+
+    objectLightIndices_.resize(frameCount_);
+    for(auto &buffer : objectLightIndices_)
+        buffer.initializeUpload(rscMgr_, sizeof(int32_t));
+}
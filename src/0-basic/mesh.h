@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../clustering/object_lights.h"
 #include "../common/light.h"
 #include "../common/mesh.h"
 
@@ -27,6 +28,12 @@ public:
         ResourceManager  &manager,
         ResourceUploader &uploader);
 
+    // light lists of the meshes in render queue order, copied into the
+    // buffer of the given frame. nullptr shades every mesh with all lights
+    void setObjectLights(
+        int                                frameIndex,
+        const clustering::CPUObjectLights *objectLights);
+
 private:
 
     void initRootSignature();
@@ -35,12 +42,21 @@ private:
 
     void initConstantBuffer();
 
+    void initObjectLightBuffers();
+
     struct PSParams
     {
         Float3  eye;
         int32_t lightCount = 0;
     };
 
+    // root constants of one mesh. count < 0 means all lights
+    struct ObjectLightRange
+    {
+        int32_t offset = 0;
+        int32_t count  = -1;
+    };
+
     ID3D12Device    *device_;
     ResourceManager &rscMgr_;
     int              frameCount_;
@@ -52,6 +68,8 @@ private:
     //      2: roughness
     // 2: psParams
     // 3: lightBuffer
+    // 4: objectLightRange
+    // 5: objectLightIndices
     ComPtr<ID3D12RootSignature> rootSignature_;
     ComPtr<ID3D12PipelineState> pipeline_;
 
@@ -64,4 +82,7 @@ private:
     ConstantBuffer<PSParams> psParams_;
 
     Buffer lightBuffer_;
+
+    std::vector<ObjectLightRange> objectLightRanges_;
+    std::vector<Buffer>           objectLightIndices_;
 };
@@ -13,6 +13,7 @@ ForwardRenderer::ForwardRenderer(D3D12Context &d3d12)
 {
     initRootSignature();
     initConstantBuffer();
+    initObjectLightBuffers();
 }
 
 rg::Pass *ForwardRenderer::addToRenderGraph(
@@ -76,16 +77,44 @@ void ForwardRenderer::setLights(
     uploader.submitAndSync();
 }
 
+void ForwardRenderer::setObjectLights(
+    int                                frameIndex,
+    const clustering::CPUObjectLights *objectLights)
+{
+    objectLightRanges_.clear();
+    if(!objectLights)
+        return;
+
+    auto &indices = objectLights->getLightIndices();
+    const size_t byteSize = (std::max)(indices.size(), size_t(1)) * sizeof(int32_t);
+
+    Buffer &buffer = objectLightIndices_[frameIndex];
+    if(buffer.getByteSize() < byteSize)
+        buffer.initializeUpload(d3d12_.getResourceManager(), byteSize);
+    if(!indices.empty())
+        buffer.updateData(0, indices.size() * sizeof(int32_t), indices.data());
+
+    for(auto &range : objectLights->getObjectRanges())
+    {
+        objectLightRanges_.push_back({
+            .offset = range.rangeBeg,
+            .count  = range.rangeEnd - range.rangeBeg
+        });
+    }
+}
+
 void ForwardRenderer::initRootSignature()
 {
     CD3DX12_DESCRIPTOR_RANGE psTableRange;
     psTableRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0);
 
-    CD3DX12_ROOT_PARAMETER params[4];
+    CD3DX12_ROOT_PARAMETER params[6];
     params[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
     params[1].InitAsDescriptorTable(1, &psTableRange, D3D12_SHADER_VISIBILITY_PIXEL);
     params[2].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     params[3].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[4].InitAsConstants(2, 2, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[5].InitAsShaderResourceView(4, 0, D3D12_SHADER_VISIBILITY_PIXEL);
 
     RootSignatureBuilder builder;
     for(auto &p : params)
@@ -163,6 +192,15 @@ void ForwardRenderer::initConstantBuffer()
         d3d12_.getResourceManager(), d3d12_.getFramebufferCount());
 }
 
+void ForwardRenderer::initObjectLightBuffers()
+{
+    // root srvs must point to valid memory even without light lists
+
+    objectLightIndices_.resize(d3d12_.getFramebufferCount());
+    for(auto &buffer : objectLightIndices_)
+        buffer.initializeUpload(d3d12_.getResourceManager(), sizeof(int32_t));
+}
+
 void ForwardRenderer::doForwardPass(rg::PassContext &ctx)
 {
     auto rawRTV = ctx.getDescriptor(renderTarget_).getCPUHandle();
@@ -178,13 +216,21 @@ void ForwardRenderer::doForwardPass(rg::PassContext &ctx)
     ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
     ctx->SetGraphicsRootShaderResourceView(3, lights_.getGPUVirtualAddress());
+    ctx->SetGraphicsRootShaderResourceView(
+        5, objectLightIndices_[ctx.getFrameIndex()].getGPUVirtualAddress());
 
     psParams_.updateData(ctx.getFrameIndex(), psParamsData_);
     ctx->SetGraphicsRootConstantBufferView(
         2, psParams_.getGPUVirtualAddress(ctx.getFrameIndex()));
 
-    for(auto mesh : meshes_)
+    for(size_t i = 0; i < meshes_.size(); ++i)
     {
+        auto mesh = meshes_[i];
+
+        const ObjectLightRange objectLightRange =
+            i < objectLightRanges_.size() ? objectLightRanges_[i] : ObjectLightRange{};
+        ctx->SetGraphicsRoot32BitConstants(4, 2, &objectLightRange, 0);
+
         ctx->SetGraphicsRootConstantBufferView(
             0, mesh->vsTransform.getGPUVirtualAddress(ctx.getFrameIndex()));
         ctx->SetGraphicsRootDescriptorTable(1, mesh->descTable[0]);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../clustering/object_lights.h"
 #include "../common/light.h"
 #include "./mesh.h"
 
@@ -26,6 +27,12 @@ public:
         ResourceManager  &manager,
         ResourceUploader &uploader);
 
+    // light lists of the meshes in addMesh() order, copied into the buffer of
+    // the given frame. nullptr shades every mesh with all lights
+    void setObjectLights(
+        int                                frameIndex,
+        const clustering::CPUObjectLights *objectLights);
+
 private:
 
     void initRootSignature();
@@ -36,6 +43,8 @@ private:
 
     void initConstantBuffer();
 
+    void initObjectLightBuffers();
+
     void doForwardPass(rg::PassContext &ctx);
 
     struct PSParams
@@ -44,6 +53,13 @@ private:
         int32_t lightCount = 0;
     };
 
+    // root constants of one mesh. count < 0 means all lights
+    struct ObjectLightRange
+    {
+        int32_t offset = 0;
+        int32_t count  = -1;
+    };
+
     D3D12Context &d3d12_;
 
     // 0: vsTransform   (b0)
@@ -53,6 +69,8 @@ private:
     //      2: roughness(t2)
     // 2: psParams      (b1)
     // 3: lightBuffer   (t3)
+    // 4: objectLightRange   (b2)
+    // 5: objectLightIndices (t4)
     // linearSampler    (s0)
     ComPtr<ID3D12RootSignature> rootSignature_;
     ComPtr<ID3D12PipelineState> pipeline_;
@@ -69,4 +87,7 @@ private:
     ConstantBuffer<PSParams> psParams_;
 
     Buffer lights_;
+
+    std::vector<ObjectLightRange> objectLightRanges_;
+    std::vector<Buffer>           objectLightIndices_;
 };
@@ -3,6 +3,7 @@
 #include <agz-utils/time.h>
 
 #include "../common/camera.h"
+#include "../common/clustering.h"
 #include "../common/sky.h"
 #include "./depth.h"
 #include "./forward.h"
@@ -97,6 +98,22 @@ void run()
     forwardRenderer.setLights(
         lights.data(), lights.size(), d3d12.getResourceManager(), uploader);
 
+    // per-object light lists
+
+    const auto objectLightData =
+        common::toClusteringLights(lights.data(), lights.size());
+
+    clustering::ThreadPool      threadPool;
+    clustering::CPUObjectLights objectLights(threadPool);
+    objectLights.setIncrementalEnabled(true);
+    objectLights.setLights(objectLightData.data(), objectLightData.size());
+
+    // world bounds of the meshes in addMesh() order
+    std::vector<clustering::AABB> meshBounds(1);
+    objectLights.setObjects(meshBounds.data(), meshBounds.size());
+
+    bool enableObjectLights = true;
+
     depthRenderer.addMesh(&mesh);
     forwardRenderer.addMesh(&mesh);
 
@@ -195,6 +212,13 @@ void run()
             ImGui::Text("fps: %d", fpsCounter.fps());
             ImGui::Text(
                 "camera position: %s", camera.getPosition().to_string().c_str());
+            ImGui::Checkbox("per-object light lists", &enableObjectLights);
+            if(enableObjectLights)
+            {
+                ImGui::Text(
+                    "object lights: %lld",
+                    static_cast<long long>(objectLights.getAssignmentCount()));
+            }
         }
         ImGui::End();
         
@@ -218,6 +242,15 @@ void run()
             d3d12.getFramebufferIndex(),
             { world, world * camera.getViewProj() });
 
+        if(enableObjectLights)
+        {
+            meshBounds[0] = common::getWorldBounds(mesh, world);
+            objectLights.run();
+            forwardRenderer.setObjectLights(d3d12.getFramebufferIndex(), &objectLights);
+        }
+        else
+            forwardRenderer.setObjectLights(d3d12.getFramebufferIndex(), nullptr);
+
         graph.run(d3d12.getFramebufferIndex());
         
         d3d12.swapFramebuffers();
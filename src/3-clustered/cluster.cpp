@@ -1,69 +1,110 @@
+#include <cstring>
+
 #include <agz-utils/file.h>
 
 #include "./cluster.h"
 
-namespace
-{
-
-    Float3 getFrustumDirection(
-        const Float3 &A,
-        const Float3 &B,
-        const Float3 &C,
-        const Float3 &D,
-        const Float2 &scrCoord)
-    {
-        const Float3 AB = lerp(A, B, scrCoord.x);
-        const Float3 CD = lerp(C, D, scrCoord.x);
-        return lerp(CD, AB, scrCoord.y).normalize();
-    }
-
-    float clusterI2Z(int i, int N, float nearZ, float farZ)
-    {
-        return nearZ * std::pow(
-            farZ / nearZ, static_cast<float>(i) / static_cast<float>(N));
-    }
-
-    std::pair<Float3, Float3> getAABB(std::initializer_list<Float3> points)
-    {
-        Float3 lower((std::numeric_limits<float>::max)());
-        Float3 upper(std::numeric_limits<float>::lowest());
-        for(auto &p : points)
-        {
-            for(int i = 0; i < 3; ++i)
-            {
-                lower[i] = (std::min)(lower[i], p[i]);
-                upper[i] = (std::max)(upper[i], p[i]);
-            }
-        }
-        return { lower, upper };
-    }
-
-} // namespace anonymous
-
 LightCluster::LightCluster(D3D12Context &d3d)
     : d3d_(d3d),
+      assignMode_(AssignMode::Flat),
+      clusterTest_(clustering::ClusterTest::AABB), globalLights_(nullptr),
+      tileWidth_(0), tileHeight_(0),
+      enableCompactEncoding_(false), compactEncoding_(false),
+      nextClusterLayout_(clustering::ClusterLayout::Linear),
+      clusterLayout_(clustering::ClusterLayout::Linear),
       clusterRange_(nullptr), lightIndex_(nullptr), uavTable_(nullptr),
+      depthBuffer_(nullptr), depthTable_(nullptr),
+      depthWidth_(0), depthHeight_(0),
+      activeClusters_(nullptr), activeDispatchArgs_(nullptr),
       nearZ_(0), farZ_(0),
       lightBuffer_(nullptr), lightCount_(0),
-      lightIndexCounter_(nullptr)
+      lightIndexCounter_(nullptr),
+      enableStatistics_(false), statistics_(nullptr),
+      enableOccupancyReadback_(false), rangeReadbackSize_(0),
+      enableTemporalReuse_(false), dirty_(true), reuseLists_(false),
+      frameCount_(0), reusedFrameCount_(0),
+      clusterAABBBuilder_(threadPool_), clusterAABBBuffer_(nullptr)
 {
     initRootSignature();
-    initPipeline();
+    initPipeline(false);
+    initCommandSignature();
     initConstantBuffer();
     initZeroLightIndexCounter();
+    initStatistics();
 }
 
 void LightCluster::setClusterCount(const Int3 &count)
 {
     clusterCount_ = count;
+    tileWidth_    = 0;
+    tileHeight_   = 0;
+    dirty_        = true;
+}
+
+void LightCluster::setClusterTileSize(int tileWidth, int tileHeight, int zCount)
+{
+    tileWidth_      = tileWidth;
+    tileHeight_     = tileHeight;
+    clusterCount_.z = zCount;
+    dirty_          = true;
+}
+
+const Int3 &LightCluster::getClusterCount() const
+{
+    return clusterCount_;
+}
+
+void LightCluster::setCompactEncodingEnabled(bool enabled)
+{
+    enableCompactEncoding_ = enabled;
 }
 
-rg::Vertex *LightCluster::addToRenderGraph(rg::Graph &graph, int thread, int queue)
+bool LightCluster::isCompactEncoding() const
 {
-    const int clusterCount              = clusterCount_.product();
-    const int lightIndexCount           = clusterCount * AVG_LIGHTS_PER_CLUSTER;
-    const size_t clusterRangeBufferSize = clusterCount * sizeof(ClusterRange);
-    const size_t lightIndexBufferSize   = lightIndexCount * sizeof(int32_t);
+    return compactEncoding_;
+}
+
+void LightCluster::setClusterLayout(clustering::ClusterLayout layout)
+{
+    nextClusterLayout_ = layout;
+}
+
+clustering::ClusterLayout LightCluster::getClusterLayout() const
+{
+    return clusterLayout_;
+}
+
+rg::Vertex *LightCluster::addToRenderGraph(
+    rg::Graph &graph, int thread, int queue, rg::Resource *depthBuffer)
+{
+    const int clusterCount    = clusterCount_.product();
+    const int lightIndexCount = clusterCount * AVG_LIGHTS_PER_CLUSTER;
+
+    const bool compact = enableCompactEncoding_ &&
+        clustering::canUseCompactClusters(lightCount_, lightIndexCount);
+    if(compact != compactEncoding_)
+    {
+        initPipeline(compact);
+        compactEncoding_ = compact;
+    }
+
+    clusterLayout_ = nextClusterLayout_;
+
+    // compact index words hold two uint16 indices. the capacity is even
+
+    const int lightIndexElements = compact ? lightIndexCount / 2 : lightIndexCount;
+
+    const size_t clusterRangeBufferSize =
+        getClusterRangeCount() * getClusterRangeStride();
+    const size_t lightIndexBufferSize   = lightIndexElements * sizeof(int32_t);
+    const size_t statisticsBufferSize   =
+        clustering::stat::COUNTER_COUNT * sizeof(uint32_t);
+    const size_t activeClusterBufferSize =
+        (1 + 2 * clusterCount) * sizeof(uint32_t);
+
+    depthBuffer_ = depthBuffer;
+    depthTable_  = nullptr;
+    dirty_       = true;
 
     // create internal resources
 
@@ -83,16 +124,74 @@ rg::Vertex *LightCluster::addToRenderGraph(rg::Graph &graph, int thread, int que
     lightIndexCounter_->setDescription(CD3DX12_RESOURCE_DESC::Buffer(
         4, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
 
-    // light index counter pass
+    statistics_ = graph.addInternalResource("cluster statistics");
+    statistics_->setDescription(CD3DX12_RESOURCE_DESC::Buffer(
+        statisticsBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    activeClusters_ = graph.addInternalResource("active cluster buffer");
+    activeClusters_->setInitialState(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    activeClusters_->setDescription(CD3DX12_RESOURCE_DESC::Buffer(
+        activeClusterBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    activeDispatchArgs_ = graph.addInternalResource("active dispatch arguments");
+    activeDispatchArgs_->setInitialState(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    activeDispatchArgs_->setDescription(CD3DX12_RESOURCE_DESC::Buffer(
+        sizeof(D3D12_DISPATCH_ARGUMENTS),
+        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    if(depthBuffer_)
+    {
+        const std::vector<uint32_t> data(1 + 2 * clusterCount, 0);
+        zeroActiveClusters_.initializeUpload(
+            d3d_.getResourceManager(), activeClusterBufferSize);
+        zeroActiveClusters_.updateData(0, activeClusterBufferSize, data.data());
+
+        depthWidth_  = static_cast<int>(depthBuffer_->getDescription().Width);
+        depthHeight_ = static_cast<int>(depthBuffer_->getDescription().Height);
+    }
 
-    auto clearLightIndexCounterPass = graph.addPass(
-        "clear light index counter", thread, queue);
+    // the graph is only rebuilt while the gpu is idle, so old readback
+    // buffers can be released here
 
-    clearLightIndexCounterPass->addResourceState(
+    if(rangeReadbackSize_ < clusterRangeBufferSize)
+    {
+        const D3D12_HEAP_PROPERTIES heapProperties =
+            CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+        const D3D12_RESOURCE_DESC desc =
+            CD3DX12_RESOURCE_DESC::Buffer(clusterRangeBufferSize);
+
+        rangeReadback_.resize(d3d_.getFramebufferCount());
+        for(auto &readback : rangeReadback_)
+        {
+            AGZ_D3D12_CHECK_HR(
+                d3d_.getDevice()->CreateCommittedResource(
+                    &heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+                    D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                    IID_PPV_ARGS(readback.ReleaseAndGetAddressOf())));
+        }
+
+        rangeReadbackSize_ = clusterRangeBufferSize;
+    }
+
+    rangesWritten_.assign(d3d_.getFramebufferCount(), false);
+
+    // clear counter pass
+
+    auto clearCounterPass = graph.addPass(
+        "clear light cluster counters", thread, queue);
+
+    clearCounterPass->addResourceState(
         lightIndexCounter_, D3D12_RESOURCE_STATE_COPY_DEST);
+    clearCounterPass->addResourceState(
+        statistics_, D3D12_RESOURCE_STATE_COPY_DEST);
 
-    clearLightIndexCounterPass->setCallback(
-        this, &LightCluster::doClearLightIndexCounterPass);
+    if(depthBuffer_)
+    {
+        clearCounterPass->addResourceState(
+            activeClusters_, D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+
+    clearCounterPass->setCallback(this, &LightCluster::doClearCounterPass);
 
     // clustering pass
 
@@ -105,8 +204,8 @@ rg::Vertex *LightCluster::addToRenderGraph(rg::Graph &graph, int thread, int que
         .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
         .Buffer        = D3D12_BUFFER_UAV{
             .FirstElement         = 0,
-            .NumElements          = static_cast<UINT>(clusterCount),
-            .StructureByteStride  = sizeof(ClusterRange),
+            .NumElements          = static_cast<UINT>(getClusterRangeCount()),
+            .StructureByteStride  = static_cast<UINT>(getClusterRangeStride()),
             .CounterOffsetInBytes = 0,
             .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
         }
@@ -117,7 +216,7 @@ rg::Vertex *LightCluster::addToRenderGraph(rg::Graph &graph, int thread, int que
         .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
         .Buffer        = D3D12_BUFFER_UAV{
             .FirstElement         = 0,
-            .NumElements          = static_cast<UINT>(lightIndexCount),
+            .NumElements          = static_cast<UINT>(lightIndexElements),
             .StructureByteStride  = sizeof(int32_t),
             .CounterOffsetInBytes = 0,
             .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
@@ -136,12 +235,80 @@ rg::Vertex *LightCluster::addToRenderGraph(rg::Graph &graph, int thread, int que
         }
     });
 
+    uavTable_->addUAV(statistics_, nullptr, D3D12_UNORDERED_ACCESS_VIEW_DESC{
+        .Format        = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+        .Buffer        = D3D12_BUFFER_UAV{
+            .FirstElement         = 0,
+            .NumElements          = clustering::stat::COUNTER_COUNT,
+            .StructureByteStride  = sizeof(uint32_t),
+            .CounterOffsetInBytes = 0,
+            .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
+        }
+    });
+
+    uavTable_->addUAV(activeClusters_, nullptr, D3D12_UNORDERED_ACCESS_VIEW_DESC{
+        .Format        = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+        .Buffer        = D3D12_BUFFER_UAV{
+            .FirstElement         = 0,
+            .NumElements          = static_cast<UINT>(1 + 2 * clusterCount),
+            .StructureByteStride  = sizeof(uint32_t),
+            .CounterOffsetInBytes = 0,
+            .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
+        }
+    });
+
+    uavTable_->addUAV(activeDispatchArgs_, nullptr, D3D12_UNORDERED_ACCESS_VIEW_DESC{
+        .Format        = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+        .Buffer        = D3D12_BUFFER_UAV{
+            .FirstElement         = 0,
+            .NumElements          = 3,
+            .StructureByteStride  = sizeof(uint32_t),
+            .CounterOffsetInBytes = 0,
+            .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
+        }
+    });
+
+    if(depthBuffer_)
+    {
+        depthTable_ = clusterPass->addDescriptorTable(false, true);
+        depthTable_->addSRV(
+            depthBuffer_,
+            rg::ShaderResourceType::NonPixelOnly,
+            D3D12_SHADER_RESOURCE_VIEW_DESC{
+                .Format                  = DXGI_FORMAT_R32_FLOAT,
+                .ViewDimension           = D3D12_SRV_DIMENSION_TEXTURE2D,
+                .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+                .Texture2D               = D3D12_TEX2D_SRV{
+                    .MostDetailedMip     = 0,
+                    .MipLevels           = 1,
+                    .PlaneSlice          = 0,
+                    .ResourceMinLODClamp = 0
+                }
+            });
+    }
+
     clusterPass->setCallback(this, &LightCluster::doClusterPass);
 
-    graph.addDependency(clearLightIndexCounterPass, clusterPass);
+    // statistics and occupancy readback pass
+
+    auto readbackPass = graph.addPass(
+        "read back cluster statistics", thread, queue);
+
+    readbackPass->addResourceState(
+        statistics_, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    readbackPass->addResourceState(
+        clusterRange_, D3D12_RESOURCE_STATE_COPY_SOURCE);
+
+    readbackPass->setCallback(this, &LightCluster::doReadbackPass);
+
+    graph.addDependency(clearCounterPass, clusterPass);
+    graph.addDependency(clusterPass, readbackPass);
 
     return graph.addAggregate(
-        "light cluster aggregate", clearLightIndexCounterPass, clusterPass);
+        "light cluster aggregate", clearCounterPass, readbackPass);
 }
 
 rg::Resource *LightCluster::getClusterRangeBuffer() const
@@ -162,8 +329,8 @@ D3D12_SHADER_RESOURCE_VIEW_DESC LightCluster::getClusterRangeSRV() const
         .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
         .Buffer                  = D3D12_BUFFER_SRV{
             .FirstElement        = 0,
-            .NumElements         = static_cast<UINT>(clusterCount_.product()),
-            .StructureByteStride = sizeof(ClusterRange),
+            .NumElements         = static_cast<UINT>(getClusterRangeCount()),
+            .StructureByteStride = static_cast<UINT>(getClusterRangeStride()),
             .Flags               = D3D12_BUFFER_SRV_FLAG_NONE
         }
     };
@@ -178,7 +345,8 @@ D3D12_SHADER_RESOURCE_VIEW_DESC LightCluster::getLightIndexSRV() const
         .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
         .Buffer                  = D3D12_BUFFER_SRV{
             .FirstElement        = 0,
-            .NumElements         = static_cast<UINT>(indexCount),
+            .NumElements         = static_cast<UINT>(
+                compactEncoding_ ? indexCount / 2 : indexCount),
             .StructureByteStride = sizeof(int32_t),
             .Flags               = D3D12_BUFFER_SRV_FLAG_NONE
         }
@@ -188,37 +356,194 @@ D3D12_SHADER_RESOURCE_VIEW_DESC LightCluster::getLightIndexSRV() const
 void LightCluster::setProj(float nearZ, float farZ, const Mat4 &proj)
 {
     nearZ_ = nearZ;
-    farZ_ = farZ;
-    proj_ = proj;
+    farZ_  = farZ;
+    proj_  = proj;
+    dirty_ = true;
+}
+
+void LightCluster::setSlicingPolicy(const clustering::SlicingPolicy &policy)
+{
+    slicingPolicy_ = policy;
+    dirty_         = true;
 }
 
 void LightCluster::setView(const Float3 &eye, const Mat4 &view)
 {
+    // the camera is set every frame, so only an actual change counts
+
+    if(toClusteringMat4(view) != toClusteringMat4(view_))
+        dirty_ = true;
+
     eye_  = eye;
     view_ = view;
 }
 
 void LightCluster::updateClusterAABBs(ResourceUploader &uploader)
 {
+    if(tileWidth_ > 0)
+    {
+        const clustering::Int3 count = clustering::getTiledClusterCount(
+            d3d_.getClientWidth(), d3d_.getClientHeight(),
+            tileWidth_, tileHeight_, clusterCount_.z);
+        clusterCount_ = Int3{ count.x, count.y, count.z };
+    }
+
     initClusterAABBBuffer(uploader);
+    dirty_ = true;
 }
 
 void LightCluster::setLights(const Buffer &lightBuffer, size_t lightCount)
 {
+    if(lightCount != lightCount_)
+        dirty_ = true;
+
     lightBuffer_ = &lightBuffer;
     lightCount_  = lightCount;
 }
 
+void LightCluster::setAssignMode(AssignMode mode)
+{
+    assignMode_ = mode;
+    dirty_      = true;
+}
+
+void LightCluster::setClusterTest(clustering::ClusterTest test)
+{
+    clusterTest_ = test;
+    dirty_       = true;
+}
+
+void LightCluster::setGlobalLights(const GlobalLightList *globalLights)
+{
+    if(globalLights != globalLights_)
+        dirty_ = true;
+    globalLights_ = globalLights;
+}
+
+void LightCluster::setStatisticsEnabled(bool enabled)
+{
+    enableStatistics_ = enabled;
+    dirty_            = true;
+}
+
+bool LightCluster::isStatisticsEnabled() const
+{
+    return enableStatistics_;
+}
+
+bool LightCluster::getStatistics(clustering::ClusterStatistics &statistics) const
+{
+    const int frameIndex = d3d_.getFramebufferIndex();
+    if(!statisticsWritten_[frameIndex])
+        return false;
+
+    ID3D12Resource *readback = statisticsReadback_[frameIndex].Get();
+    const size_t byteSize = clustering::stat::COUNTER_COUNT * sizeof(uint32_t);
+
+    const D3D12_RANGE readRange = { 0, byteSize };
+    void *mappedData = nullptr;
+    AGZ_D3D12_CHECK_HR(readback->Map(0, &readRange, &mappedData));
+
+    std::vector<uint32_t> counters(clustering::stat::COUNTER_COUNT);
+    std::memcpy(counters.data(), mappedData, byteSize);
+
+    const D3D12_RANGE writeRange = { 0, 0 };
+    readback->Unmap(0, &writeRange);
+
+    const int clusterCount = clusterCount_.product();
+    statistics = clustering::resolveClusterStatistics(
+        counters.data(), clusterCount, AVG_LIGHTS_PER_CLUSTER * clusterCount);
+
+    return true;
+}
+
+void LightCluster::setOccupancyReadbackEnabled(bool enabled)
+{
+    enableOccupancyReadback_ = enabled;
+}
+
+bool LightCluster::getClusterOccupancy(
+    clustering::ClusterOccupancy &occupancy) const
+{
+    const int frameIndex = d3d_.getFramebufferIndex();
+    if(!rangesWritten_[frameIndex])
+        return false;
+
+    ID3D12Resource *readback = rangeReadback_[frameIndex].Get();
+    const size_t byteSize = getClusterRangeCount() * getClusterRangeStride();
+
+    const D3D12_RANGE readRange = { 0, byteSize };
+    void *mappedData = nullptr;
+    AGZ_D3D12_CHECK_HR(readback->Map(0, &readRange, &mappedData));
+
+    const clustering::Int3 count = {
+        clusterCount_.x, clusterCount_.y, clusterCount_.z
+    };
+
+    if(compactEncoding_)
+    {
+        occupancy = clustering::computeCompactClusterOccupancy(
+            count, static_cast<const uint32_t *>(mappedData), clusterLayout_);
+    }
+    else
+    {
+        occupancy = clustering::computeClusterOccupancy(
+            count, static_cast<const clustering::ClusterRange *>(mappedData),
+            clusterLayout_);
+    }
+
+    const D3D12_RANGE writeRange = { 0, 0 };
+    readback->Unmap(0, &writeRange);
+
+    return true;
+}
+
+void LightCluster::setTemporalReuseEnabled(bool enabled)
+{
+    enableTemporalReuse_ = enabled;
+}
+
+bool LightCluster::isTemporalReuseEnabled() const
+{
+    return enableTemporalReuse_;
+}
+
+void LightCluster::markLightsDirty()
+{
+    dirty_ = true;
+}
+
+int64_t LightCluster::getFrameCount() const
+{
+    return frameCount_;
+}
+
+int64_t LightCluster::getReusedFrameCount() const
+{
+    return reusedFrameCount_;
+}
+
+void LightCluster::resetTemporalReuseCounters()
+{
+    frameCount_       = 0;
+    reusedFrameCount_ = 0;
+}
+
 void LightCluster::initRootSignature()
 {
     CD3DX12_DESCRIPTOR_RANGE uavRange;
-    uavRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 0, 0);
+    uavRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 6, 0, 0);
 
-    CD3DX12_ROOT_PARAMETER params[4];
+    CD3DX12_DESCRIPTOR_RANGE depthRange;
+    depthRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2, 0);
+
+    CD3DX12_ROOT_PARAMETER params[6];
     params[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
     params[1].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
     params[2].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_ALL);
     params[3].InitAsDescriptorTable(1, &uavRange, D3D12_SHADER_VISIBILITY_ALL);
+    params[4].InitAsDescriptorTable(1, &depthRange, D3D12_SHADER_VISIBILITY_ALL);
+    params[5].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_ALL);
 
     RootSignatureBuilder builder;
     for(auto &p : params)
@@ -227,20 +552,65 @@ void LightCluster::initRootSignature()
     rootSignature_ = builder.build(d3d_.getDevice());
 }
 
-void LightCluster::initPipeline()
+void LightCluster::initPipeline(bool compact)
+{
+    const char       *shaderFilename = "./asset/clustered/cluster.hlsl";
+    const std::string shaderSource   = agz::file::read_txt_file(shaderFilename);
+
+    flatPipeline_ = createPipeline(
+        shaderFilename, shaderSource, "CSMain", compact);
+    hierarchicalPipeline_ = createPipeline(
+        shaderFilename, shaderSource, "CSMainHierarchical", compact);
+
+    markActivePipeline_ = createPipeline(
+        shaderFilename, shaderSource, "CSMarkActiveClusters", compact);
+    compactActivePipeline_ = createPipeline(
+        shaderFilename, shaderSource, "CSCompactActiveClusters", compact);
+    writeActiveDispatchArgsPipeline_ = createPipeline(
+        shaderFilename, shaderSource, "CSWriteActiveDispatchArgs", compact);
+    activePipeline_ = createPipeline(
+        shaderFilename, shaderSource, "CSMainActive", compact);
+}
+
+void LightCluster::initCommandSignature()
+{
+    D3D12_INDIRECT_ARGUMENT_DESC arg = {};
+    arg.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+
+    D3D12_COMMAND_SIGNATURE_DESC desc;
+    desc.ByteStride       = sizeof(D3D12_DISPATCH_ARGUMENTS);
+    desc.NumArgumentDescs = 1;
+    desc.pArgumentDescs   = &arg;
+    desc.NodeMask         = 0;
+
+    AGZ_D3D12_CHECK_HR(
+        d3d_.getDevice()->CreateCommandSignature(
+            &desc, nullptr,
+            IID_PPV_ARGS(activeDispatchSignature_.GetAddressOf())));
+}
+
+ComPtr<ID3D12PipelineState> LightCluster::createPipeline(
+    const char        *shaderFilename,
+    const std::string &shaderSource,
+    const char        *entry,
+    bool               compact)
 {
     FXC compiler;
     compiler.setWarnings(true);
 
-    const char       *shaderFilename = "./asset/clustered/cluster.hlsl";
-    const std::string shaderSource   = agz::file::read_txt_file(shaderFilename);
+    D3D_SHADER_MACRO macros[2] = {
+        { "COMPACT_CLUSTERS", "1" },
+        { nullptr, nullptr }
+    };
+
+    FXC::Options options = {
+        .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        .sourceName = shaderFilename,
+        .entry      = entry
+    };
+    options.macros = compact ? macros : nullptr;
 
-    auto cs = compiler.compile(
-        shaderSource, "cs_5_1", FXC::Options{
-            .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
-            .sourceName = shaderFilename,
-            .entry      = "CSMain"
-        });
+    auto cs = compiler.compile(shaderSource, "cs_5_1", options);
 
     D3D12_SHADER_BYTECODE csByteCode = {
         .pShaderBytecode = cs->GetBufferPointer(),
@@ -254,9 +624,12 @@ void LightCluster::initPipeline()
     desc.CachedPSO      = {};
     desc.Flags          = D3D12_PIPELINE_STATE_FLAG_NONE;
 
+    ComPtr<ID3D12PipelineState> pipeline;
     AGZ_D3D12_CHECK_HR(
         d3d_.getDevice()->CreateComputePipelineState(
-            &desc, IID_PPV_ARGS(pipeline_.GetAddressOf())));
+            &desc, IID_PPV_ARGS(pipeline.GetAddressOf())));
+
+    return pipeline;
 }
 
 void LightCluster::initConstantBuffer()
@@ -272,101 +645,121 @@ void LightCluster::initZeroLightIndexCounter()
     zeroLightIndexCounter_.updateData(0, 4, &data);
 }
 
-void LightCluster::initClusterAABBBuffer(ResourceUploader &uploader)
+void LightCluster::initStatistics()
 {
-    std::vector<ClusterAABB> clusterAABBBufferData;
-    clusterAABBBufferData.reserve(clusterCount_.product());
+    const size_t byteSize = clustering::stat::COUNTER_COUNT * sizeof(uint32_t);
 
-    const Mat4 invProj = proj_.inv();
+    const std::vector<uint32_t> data(clustering::stat::COUNTER_COUNT, 0);
+    zeroStatistics_.initializeUpload(d3d_.getResourceManager(), byteSize);
+    zeroStatistics_.updateData(0, byteSize, data.data());
 
-    const Float3 frustumA =
-        (Float4(-1, +1, 0.5f, 1) * invProj).homogenize().normalize();
-    const Float3 frustumB =
-        (Float4(+1, +1, 0.5f, 1) * invProj).homogenize().normalize();
-    const Float3 frustumC =
-        (Float4(-1, -1, 0.5f, 1) * invProj).homogenize().normalize();
-    const Float3 frustumD =
-        (Float4(+1, -1, 0.5f, 1) * invProj).homogenize().normalize();
+    const D3D12_HEAP_PROPERTIES heapProperties =
+        CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+    const D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
 
-    for(int xi = 0; xi < clusterCount_.x; ++xi)
+    statisticsReadback_.resize(d3d_.getFramebufferCount());
+    for(auto &readback : statisticsReadback_)
     {
-        const float lowerScrX = static_cast<float>(xi    ) / clusterCount_.x;
-        const float upperScrX = static_cast<float>(xi + 1) / clusterCount_.x;
+        AGZ_D3D12_CHECK_HR(
+            d3d_.getDevice()->CreateCommittedResource(
+                &heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+                D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                IID_PPV_ARGS(readback.GetAddressOf())));
+    }
 
-        for(int yi = 0; yi < clusterCount_.y; ++yi)
+    statisticsWritten_.resize(d3d_.getFramebufferCount(), false);
+}
+
+void LightCluster::initClusterAABBBuffer(ResourceUploader &uploader)
+{
+    const clustering::ClusterAABBKey key = {
+        .clusterCount = { clusterCount_.x, clusterCount_.y, clusterCount_.z },
+        .nearZ        = nearZ_,
+        .farZ         = farZ_,
+        .proj         = toClusteringMat4(proj_),
+        .slicing      = slicingPolicy_
+    };
+
+    for(auto it = clusterAABBBufferCache_.begin();
+        it != clusterAABBBufferCache_.end(); ++it)
+    {
+        if(it->key == key)
         {
-            const float lowerScrY = static_cast<float>(yi    ) / clusterCount_.y;
-            const float upperScrY = static_cast<float>(yi + 1) / clusterCount_.y;
-
-            const Float3 A = getFrustumDirection(
-                frustumA, frustumB, frustumC, frustumD, { lowerScrX, upperScrY });
-            const Float3 B = getFrustumDirection(
-                frustumA, frustumB, frustumC, frustumD, { upperScrX, upperScrY });
-            const Float3 C = getFrustumDirection(
-                frustumA, frustumB, frustumC, frustumD, { lowerScrX, lowerScrY });
-            const Float3 D = getFrustumDirection(
-                frustumA, frustumB, frustumC, frustumD, { upperScrX, lowerScrY });
-
-            for(int zi = 0; zi < clusterCount_.z; ++zi)
-            {
-                const float lowerZ = clusterI2Z(
-                    zi, clusterCount_.z, nearZ_, farZ_);
-                const float upperZ = clusterI2Z(
-                    zi + 1, clusterCount_.z, nearZ_, farZ_);
-
-                static auto getClusterVertex = [](const Float3 &dir, float z)
-                {
-                    return dir * z / dir.z;
-                };
-
-                const Float3 Alz = getClusterVertex(A, lowerZ);
-                const Float3 Blz = getClusterVertex(B, lowerZ);
-                const Float3 Clz = getClusterVertex(C, lowerZ);
-                const Float3 Dlz = getClusterVertex(D, lowerZ);
-
-                const Float3 Auz = getClusterVertex(A, upperZ);
-                const Float3 Buz = getClusterVertex(B, upperZ);
-                const Float3 Cuz = getClusterVertex(C, upperZ);
-                const Float3 Duz = getClusterVertex(D, upperZ);
-
-                const auto [lower, upper] = getAABB(
-                    { Alz, Blz, Clz, Dlz, Auz, Buz, Cuz, Duz });
-
-                clusterAABBBufferData.push_back(ClusterAABB{
-                    .lower = lower,
-                    .upper = upper
-                });
-            }
+            clusterAABBBufferCache_.splice(
+                clusterAABBBufferCache_.begin(), clusterAABBBufferCache_, it);
+            clusterAABBBuffer_ = &clusterAABBBufferCache_.front().buffer;
+            return;
         }
     }
 
-    clusterAABBBuffer_ = d3d_.createDefaultBuffer(
-        sizeof(ClusterAABB) * clusterAABBBufferData.size(),
+    const std::vector<clustering::AABB> &clusterAABBs =
+        clusterAABBBuilder_.build(key);
+
+    constexpr size_t CACHE_SIZE = clustering::ClusterAABBBuilder::CACHE_SIZE;
+    if(clusterAABBBufferCache_.size() >= CACHE_SIZE)
+        clusterAABBBufferCache_.pop_back();
+
+    clusterAABBBufferCache_.emplace_front();
+    clusterAABBBufferCache_.front().key = key;
+    Buffer &buffer = clusterAABBBufferCache_.front().buffer;
+
+    buffer = d3d_.createDefaultBuffer(
+        sizeof(clustering::AABB) * clusterAABBs.size(),
         D3D12_RESOURCE_STATE_COMMON);
 
-    uploader.upload(
-        clusterAABBBuffer_,
-        clusterAABBBufferData.data(),
-        clusterAABBBuffer_.getByteSize());
+    uploader.upload(buffer, clusterAABBs.data(), buffer.getByteSize());
     uploader.submitAndSync();
+
+    clusterAABBBuffer_ = &buffer;
+}
+
+int LightCluster::getClusterRangeCount() const
+{
+    return clustering::getClusterSlotCount(
+        clusterLayout_, { clusterCount_.x, clusterCount_.y, clusterCount_.z });
+}
+
+size_t LightCluster::getClusterRangeStride() const
+{
+    return compactEncoding_ ? sizeof(uint32_t) : sizeof(ClusterRange);
 }
 
 void LightCluster::updateCSParams()
 {
+    const clustering::ClusterSlicing slicing = clustering::getClusterSlicing(
+        clusterCount_.z, nearZ_, farZ_, slicingPolicy_);
+
     csParams_.updateData(d3d_.getFramebufferIndex(), CSParams{
         .view               = view_,
         .clusterXCount      = clusterCount_.x,
         .clusterYCount      = clusterCount_.y,
         .clusterZCount      = clusterCount_.z,
         .lightCount         = static_cast<int>(lightCount_),
-        .lightIndexCount    = AVG_LIGHTS_PER_CLUSTER * clusterCount_.product()
+        .lightIndexCount    = AVG_LIGHTS_PER_CLUSTER * clusterCount_.product(),
+        .enableStatistics   = enableStatistics_ ? 1 : 0,
+        .depthWidth         = depthWidth_,
+        .depthHeight        = depthHeight_,
+        .A                  = slicing.A,
+        .B                  = slicing.B,
+        .depthScale         = proj_(2, 2),
+        .depthBias          = proj_(3, 2),
+        .slicingMode        = static_cast<int32_t>(slicing.policy.mode),
+        .nearSliceZ         = slicing.policy.nearSliceZ,
+        .projX              = proj_(0, 0),
+        .projY              = proj_(1, 1),
+        .clusterTest        = static_cast<int32_t>(clusterTest_),
+        .enableGlobalLights = globalLights_ ? 1 : 0,
+        .clusterLayout      = static_cast<int32_t>(clusterLayout_)
     });
 }
 
 void LightCluster::doClusterPass(rg::PassContext &ctx)
 {
+    if(reuseLists_)
+        return;
+    dirty_ = false;
+
     ctx->SetComputeRootSignature(rootSignature_.Get());
-    ctx->SetPipelineState(pipeline_.Get());
 
     updateCSParams();
     ctx->SetComputeRootConstantBufferView(
@@ -376,11 +769,39 @@ void LightCluster::doClusterPass(rg::PassContext &ctx)
         1, lightBuffer_->getGPUVirtualAddress());
 
     ctx->SetComputeRootShaderResourceView(
-        2, clusterAABBBuffer_.getGPUVirtualAddress());
+        2, clusterAABBBuffer_->getGPUVirtualAddress());
+
+    // without global lights the light buffer keeps the slot valid
+
+    ctx->SetComputeRootShaderResourceView(
+        5, globalLights_ ?
+            globalLights_->getBufferAddress(ctx.getFrameIndex(), 0) :
+            lightBuffer_->getGPUVirtualAddress());
 
     auto uavTable = ctx.getDescriptorRange(uavTable_);
     ctx->SetComputeRootDescriptorTable(3, uavTable[0]);
 
+    if(depthBuffer_)
+    {
+        doActiveClusterDispatches(ctx);
+        return;
+    }
+
+    const bool hierarchical =
+        assignMode_ == AssignMode::Hierarchical &&
+        clusterCount_.z <= HIERARCHICAL_MAX_Z_COUNT;
+
+    ctx->SetPipelineState(
+        hierarchical ? hierarchicalPipeline_.Get() : flatPipeline_.Get());
+
+    if(hierarchical)
+    {
+        // one thread group per tile, one thread per z-slice
+
+        ctx->Dispatch(clusterCount_.x, clusterCount_.y, 1);
+        return;
+    }
+
     const UINT dispatchCountX = agz::upalign_to(clusterCount_.x, 8) / 8;
     const UINT dispatchCountY = agz::upalign_to(clusterCount_.y, 8) / 8;
     const UINT dispatchCountZ = agz::upalign_to(clusterCount_.z, 1) / 1;
@@ -388,9 +809,112 @@ void LightCluster::doClusterPass(rg::PassContext &ctx)
     ctx->Dispatch(dispatchCountX, dispatchCountY, dispatchCountZ);
 }
 
-void LightCluster::doClearLightIndexCounterPass(rg::PassContext &ctx)
+void LightCluster::doActiveClusterDispatches(rg::PassContext &ctx)
+{
+    ctx->SetComputeRootDescriptorTable(
+        4, ctx.getDescriptorRange(depthTable_)[0]);
+
+    ID3D12Resource *activeClusters = ctx.getRawResource(activeClusters_);
+    ID3D12Resource *dispatchArgs   = ctx.getRawResource(activeDispatchArgs_);
+
+    const D3D12_RESOURCE_BARRIER activeClustersBarrier =
+        CD3DX12_RESOURCE_BARRIER::UAV(activeClusters);
+
+    // flag clusters containing depth samples
+
+    ctx->SetPipelineState(markActivePipeline_.Get());
+    ctx->Dispatch(
+        agz::upalign_to(depthWidth_, 8) / 8,
+        agz::upalign_to(depthHeight_, 8) / 8, 1);
+
+    ctx->ResourceBarrier(1, &activeClustersBarrier);
+
+    // compact flags into the active list
+
+    ctx->SetPipelineState(compactActivePipeline_.Get());
+    ctx->Dispatch(agz::upalign_to(clusterCount_.product(), 64) / 64, 1, 1);
+
+    ctx->ResourceBarrier(1, &activeClustersBarrier);
+
+    ctx->SetPipelineState(writeActiveDispatchArgsPipeline_.Get());
+    ctx->Dispatch(1, 1, 1);
+
+    // assign lights to active clusters. the graph tracks the arguments as an
+    // uav, so the state is restored afterwards
+
+    const D3D12_RESOURCE_BARRIER toIndirectArgument =
+        CD3DX12_RESOURCE_BARRIER::Transition(
+            dispatchArgs,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+            D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    ctx->ResourceBarrier(1, &toIndirectArgument);
+
+    ctx->SetPipelineState(activePipeline_.Get());
+    ctx->ExecuteIndirect(
+        activeDispatchSignature_.Get(), 1, dispatchArgs, 0, nullptr, 0);
+
+    const D3D12_RESOURCE_BARRIER toUnorderedAccess =
+        CD3DX12_RESOURCE_BARRIER::Transition(
+            dispatchArgs,
+            D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    ctx->ResourceBarrier(1, &toUnorderedAccess);
+}
+
+void LightCluster::doClearCounterPass(rg::PassContext &ctx)
 {
+    // statistics are collected per frame, so they need a new assignment too
+
+    reuseLists_ = enableTemporalReuse_ && !dirty_ &&
+                  !depthBuffer_ && !enableStatistics_;
+
+    ++frameCount_;
+    if(reuseLists_)
+    {
+        ++reusedFrameCount_;
+        return;
+    }
+
     ctx->CopyResource(
         ctx.getRawResource(lightIndexCounter_),
         zeroLightIndexCounter_.getResource());
+
+    ctx->CopyBufferRegion(
+        ctx.getRawResource(statistics_), 0,
+        zeroStatistics_.getResource(), 0,
+        clustering::stat::COUNTER_COUNT * sizeof(uint32_t));
+
+    if(depthBuffer_)
+    {
+        ctx->CopyBufferRegion(
+            ctx.getRawResource(activeClusters_), 0,
+            zeroActiveClusters_.getResource(), 0,
+            (1 + 2 * clusterCount_.product()) * sizeof(uint32_t));
+    }
+}
+
+void LightCluster::doReadbackPass(rg::PassContext &ctx)
+{
+    const int frameIndex = ctx.getFrameIndex();
+
+    statisticsWritten_[frameIndex] = enableStatistics_;
+    if(enableStatistics_)
+    {
+        ctx->CopyBufferRegion(
+            statisticsReadback_[frameIndex].Get(), 0,
+            ctx.getRawResource(statistics_), 0,
+            clustering::stat::COUNTER_COUNT * sizeof(uint32_t));
+    }
+
+    // reused lists are still the ones of the current view, so they are
+    // read back as well
+
+    rangesWritten_[frameIndex] = enableOccupancyReadback_;
+    if(enableOccupancyReadback_)
+    {
+        ctx->CopyBufferRegion(
+            rangeReadback_[frameIndex].Get(), 0,
+            ctx.getRawResource(clusterRange_), 0,
+            getClusterRangeCount() * getClusterRangeStride());
+    }
 }
@@ -1,17 +1,68 @@
 #pragma once
 
+#include "../clustering/cluster_aabb.h"
+#include "../clustering/cluster_frustum.h"
+#include "../clustering/cluster_layout.h"
+#include "../clustering/occupancy.h"
+#include "../clustering/statistics.h"
 #include "./common.h"
+#include "./global_lights.h"
 
 class LightCluster : public agz::misc::uncopyable_t
 {
 public:
 
+    enum class AssignMode
+    {
+        // every cluster tests every light (CSMain)
+        Flat,
+        // lights are culled per screen tile before the per-slice test
+        // (CSMainHierarchical). falls back to Flat when the z count exceeds
+        // HIERARCHICAL_MAX_Z_COUNT
+        Hierarchical
+    };
+
+    static constexpr int HIERARCHICAL_MAX_Z_COUNT = 64;
+
     explicit LightCluster(D3D12Context &d3d);
 
     void setClusterCount(const Int3 &count);
 
+    // derive the x and y counts from the framebuffer size instead, so that
+    // a cluster covers at most tileWidth x tileHeight pixels at any
+    // resolution (see clustering::getTiledClusterCount). counts are updated
+    // by updateClusterAABBs(), which must be called after each resize.
+    // setClusterCount() goes back to a fixed grid
+    void setClusterTileSize(int tileWidth, int tileHeight, int zCount);
+
+    // counts of the last updateClusterAABBs()
+    const Int3 &getClusterCount() const;
+
+    // store ranges as one packed word and light indices as uint16 (see
+    // clustering::packCompactRange). takes effect at the next
+    // addToRenderGraph(), and only if the lights and index capacity fit.
+    // shaders reading the buffers must be compiled with COMPACT_CLUSTERS
+    // when isCompactEncoding() is true
+    void setCompactEncodingEnabled(bool enabled);
+
+    bool isCompactEncoding() const;
+
+    // order of the ranges in the cluster range buffer. takes effect at the
+    // next addToRenderGraph(). ForwardRenderer must use getClusterLayout()
+    void setClusterLayout(clustering::ClusterLayout layout);
+
+    clustering::ClusterLayout getClusterLayout() const;
+
+    // when depthBuffer (R32_TYPELESS, filled before this vertex) is given,
+    // clusters containing a depth sample are flagged and compacted first,
+    // and lights are only assigned to them. the assign mode is ignored then.
+    // compute queues can not transition a depth buffer out of DEPTH_WRITE,
+    // so use a graphics queue in that case
     rg::Vertex *addToRenderGraph(
-        rg::Graph &graph, int thread = 0, int queue = 0);
+        rg::Graph    &graph,
+        int           thread      = 0,
+        int           queue       = 0,
+        rg::Resource *depthBuffer = nullptr);
 
     rg::Resource *getClusterRangeBuffer() const;
 
@@ -23,12 +74,76 @@ public:
 
     void setProj(float nearZ, float farZ, const Mat4 &proj);
 
+    // takes effect at the next updateClusterAABBs().
+    // must match ForwardRenderer::setCluster
+    void setSlicingPolicy(const clustering::SlicingPolicy &policy);
+
     void setView(const Float3 &eye, const Mat4 &view);
 
+    // aabbs are built on the cpu with clustering::ClusterAABBBuilder. the
+    // uploaded buffers of the last few projections are kept, so resizing
+    // back to a previous aspect ratio needs no rebuild or upload.
+    // buffers may be released here, so the gpu must be idle
     void updateClusterAABBs(ResourceUploader &uploader);
 
+    // may be called every frame, e.g. with the buffer of
+    // DynamicLightBuffer. a new buffer is assumed to hold the same lights
+    // unless the count changed or markLightsDirty() is called
     void setLights(const Buffer &lightBuffer, size_t lightCount);
 
+    void setAssignMode(AssignMode mode);
+
+    // Frustum also tests the tile pyramid of each cluster (see
+    // clustering::isLightInClusterFrustum), which drops some of the lights
+    // reaching only the corners of cluster aabbs
+    void setClusterTest(clustering::ClusterTest test);
+
+    // leave the lights of globalLights out of the cluster lists. they must
+    // then be shaded from its index buffer, see ForwardRenderer. nullptr
+    // puts all lights in the lists again
+    void setGlobalLights(const GlobalLightList *globalLights);
+
+    // count lights per cluster past MAX_LIGHTS_PER_CLUSTER and accumulate
+    // clustering::ClusterStatistics. costs a full light loop per cluster
+    void setStatisticsEnabled(bool enabled);
+
+    bool isStatisticsEnabled() const;
+
+    // statistics read back from the last frame that used the current
+    // framebuffer index. call after D3D12Context::startFrame().
+    // returns false if that frame did not collect statistics
+    bool getStatistics(clustering::ClusterStatistics &statistics) const;
+
+    // copy the cluster ranges of every frame to a readback buffer, for
+    // getClusterOccupancy()
+    void setOccupancyReadbackEnabled(bool enabled);
+
+    // light counts of the last frame that used the current framebuffer
+    // index. call after D3D12Context::startFrame().
+    // returns false if that frame did not read back its ranges
+    bool getClusterOccupancy(clustering::ClusterOccupancy &occupancy) const;
+
+    // skip the clustering passes while nothing they read has changed since
+    // the last assignment, keeping the lists of that frame. lists are built
+    // by atomic appends, so unlike clustering::CPULightCluster they can not
+    // be patched per moved light; any change rebuilds all of them.
+    // the active cluster path depends on the depth of each frame and never
+    // reuses. relies on the graph keeping internal resources between runs
+    void setTemporalReuseEnabled(bool enabled);
+
+    bool isTemporalReuseEnabled() const;
+
+    // call when the contents of the light buffer have changed
+    void markLightsDirty();
+
+    // frames run since the counters were reset, and how many of them
+    // reused the lists of a previous frame
+    int64_t getFrameCount() const;
+
+    int64_t getReusedFrameCount() const;
+
+    void resetTemporalReuseCounters();
+
 private:
 
     static constexpr int AVG_LIGHTS_PER_CLUSTER = 128;
@@ -42,8 +157,25 @@ private:
         int32_t clusterZCount      = 0;
         int32_t lightCount         = 0;
 
-        int32_t lightIndexCount = 0;
-        float pad0[3] = {};
+        int32_t lightIndexCount  = 0;
+        int32_t enableStatistics = 0;
+        int32_t depthWidth       = 0;
+        int32_t depthHeight      = 0;
+
+        float A          = 0;
+        float B          = 0;
+        float depthScale = 0;
+        float depthBias  = 0;
+
+        int32_t slicingMode = 0;
+        float   nearSliceZ  = 0;
+        float   projX       = 0;
+        float   projY       = 0;
+
+        int32_t clusterTest        = 0;
+        int32_t enableGlobalLights = 0;
+        int32_t clusterLayout      = 0;
+        int32_t pad0               = 0;
     };
 
     struct ClusterRange
@@ -52,28 +184,46 @@ private:
         int32_t rangeEnd;
     };
 
-    struct ClusterAABB
+    struct CachedClusterAABBBuffer
     {
-        Float3 lower;
-        Float3 upper;
+        clustering::ClusterAABBKey key;
+        Buffer                     buffer;
     };
 
     void initRootSignature();
 
-    void initPipeline();
+    void initPipeline(bool compact);
+
+    void initCommandSignature();
+
+    ComPtr<ID3D12PipelineState> createPipeline(
+        const char        *shaderFilename,
+        const std::string &shaderSource,
+        const char        *entry,
+        bool               compact);
 
     void initConstantBuffer();
 
     void initZeroLightIndexCounter();
 
+    void initStatistics();
+
     void initClusterAABBBuffer(ResourceUploader &uploader);
 
+    int getClusterRangeCount() const;
+
+    size_t getClusterRangeStride() const;
+
     void updateCSParams();
 
-    void doClearLightIndexCounterPass(rg::PassContext &ctx);
+    void doClearCounterPass(rg::PassContext &ctx);
 
     void doClusterPass(rg::PassContext &ctx);
 
+    void doActiveClusterDispatches(rg::PassContext &ctx);
+
+    void doReadbackPass(rg::PassContext &ctx);
+
     D3D12Context &d3d_;
 
     // pipeline
@@ -85,24 +235,68 @@ private:
     //      0: clusterRange     (u0)
     //      1: lightIndex       (u1)
     //      2: lightIndexCounter(u2)
+    //      3: statistics       (u3)
+    //      4: activeClusters   (u4)
+    //      5: activeDispatch   (u5)
+    // 4. depthTable:
+    //      0: depthBuffer      (t2)
+    // 5. globalLightMask  (t3)
     ComPtr<ID3D12RootSignature> rootSignature_;
-    ComPtr<ID3D12PipelineState> pipeline_;
+    ComPtr<ID3D12PipelineState> flatPipeline_;
+    ComPtr<ID3D12PipelineState> hierarchicalPipeline_;
+
+    ComPtr<ID3D12PipelineState>    markActivePipeline_;
+    ComPtr<ID3D12PipelineState>    compactActivePipeline_;
+    ComPtr<ID3D12PipelineState>    writeActiveDispatchArgsPipeline_;
+    ComPtr<ID3D12PipelineState>    activePipeline_;
+    ComPtr<ID3D12CommandSignature> activeDispatchSignature_;
+
+    AssignMode assignMode_;
+
+    clustering::ClusterTest clusterTest_;
+
+    const GlobalLightList *globalLights_;
 
     // cluster
 
     Int3 clusterCount_;
 
+    // 0 for a fixed grid
+    int tileWidth_;
+    int tileHeight_;
+
+    // compactEncoding_ and clusterLayout_ are what the current graph and
+    // pipelines use
+    bool enableCompactEncoding_;
+    bool compactEncoding_;
+
+    clustering::ClusterLayout nextClusterLayout_;
+    clustering::ClusterLayout clusterLayout_;
+
     rg::InternalResource *clusterRange_;
     rg::InternalResource *lightIndex_;
 
     rg::DescriptorTable *uavTable_;
 
+    // active clusters
+
+    rg::Resource        *depthBuffer_;
+    rg::DescriptorTable *depthTable_;
+    int                  depthWidth_;
+    int                  depthHeight_;
+
+    Buffer zeroActiveClusters_;
+    rg::InternalResource *activeClusters_;
+    rg::InternalResource *activeDispatchArgs_;
+
     // proj
 
     float  nearZ_;
     float  farZ_;
     Mat4   proj_;
 
+    clustering::SlicingPolicy slicingPolicy_;
+
     // view
 
     Float3 eye_;
@@ -118,9 +312,44 @@ private:
     Buffer zeroLightIndexCounter_;
     rg::InternalResource *lightIndexCounter_;
 
+    // statistics, cleared with an upload buffer and copied to a per-frame
+    // readback buffer after the cluster pass
+
+    bool enableStatistics_;
+
+    Buffer zeroStatistics_;
+    rg::InternalResource *statistics_;
+
+    std::vector<ComPtr<ID3D12Resource>> statisticsReadback_;
+    std::vector<bool>                   statisticsWritten_;
+
+    // occupancy, the cluster range buffer copied to a per-frame readback
+    // buffer by the same pass as the statistics
+
+    bool enableOccupancyReadback_;
+
+    size_t                              rangeReadbackSize_;
+    std::vector<ComPtr<ID3D12Resource>> rangeReadback_;
+    std::vector<bool>                   rangesWritten_;
+
     // cluster aabb
 
-    Buffer clusterAABBBuffer_;
+    // temporal reuse. reuseLists_ is decided once per frame by the clear
+    // pass and read by the cluster pass
+
+    bool enableTemporalReuse_;
+    bool dirty_;
+    bool reuseLists_;
+
+    int64_t frameCount_;
+    int64_t reusedFrameCount_;
+
+    clustering::ThreadPool         threadPool_;
+    clustering::ClusterAABBBuilder clusterAABBBuilder_;
+
+    // most recently used first
+    std::list<CachedClusterAABBBuffer> clusterAABBBufferCache_;
+    const Buffer                      *clusterAABBBuffer_;
 
     // constant buffer
 
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "../clustering/math.h"
+#include "../common/clustering.h"
 #include "../common/light.h"
 #include "../common/mesh.h"
 
 using Light = common::PBSLight;
 using Mesh  = common::MeshWithViewTransform;
+
+using common::toClusteringMat4;
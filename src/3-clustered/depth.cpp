@@ -0,0 +1,115 @@
+#include <agz-utils/file.h>
+
+#include "./depth.h"
+
+PreDepthRenderer::PreDepthRenderer(D3D12Context &d3d)
+    : d3d_(d3d), depthBuffer_(nullptr), viewport_(), scissor_()
+{
+    initRootSignature();
+    initPipeline();
+}
+
+rg::Pass *PreDepthRenderer::addToRenderGraph(
+    rg::Graph &graph, rg::Resource *depthBuffer)
+{
+    depthBuffer_ = depthBuffer;
+
+    viewport_ = depthBuffer_->getDefaultViewport();
+    scissor_  = depthBuffer_->getDefaultScissor();
+
+    auto pass = graph.addPass("predepth");
+    pass->addDSV(
+        depthBuffer_,
+        rg::DepthStencilType::ReadAndWrite,
+        D3D12_DEPTH_STENCIL_VIEW_DESC{
+            .Format        = DXGI_FORMAT_D32_FLOAT,
+            .ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D,
+            .Flags         = D3D12_DSV_FLAG_NONE,
+            .Texture2D     = { 0 }
+        });
+    pass->setCallback(this, &PreDepthRenderer::doPreDepthPass);
+
+    return pass;
+}
+
+void PreDepthRenderer::addMesh(const Mesh *mesh)
+{
+    meshes_.push_back(mesh);
+}
+
+void PreDepthRenderer::initRootSignature()
+{
+    RootSignatureBuilder builder;
+    builder.addParameterCBV(b0, D3D12_SHADER_VISIBILITY_VERTEX);
+    builder.addFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    rootSignature_ = builder.build(d3d_.getDevice());
+}
+
+void PreDepthRenderer::initPipeline()
+{
+    const char       *shaderFilename = "./asset/clustered/depth.hlsl";
+    const std::string shaderSource   = agz::file::read_txt_file(shaderFilename);
+
+    FXC compiler;
+    compiler.setWarnings(true);
+
+    auto vs = compiler.compile(
+        shaderSource, "vs_5_1", FXC::Options{
+            .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
+            .sourceName = shaderFilename,
+            .entry      = "VSMain"
+        });
+
+    auto ps = compiler.compile(
+        shaderSource, "ps_5_1", FXC::Options{
+            .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
+            .sourceName = shaderFilename,
+            .entry      = "PSMain"
+        });
+
+    PipelineBuilder builder;
+    builder.addInputElement({
+        "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,
+        0, offsetof(Mesh::Vertex, position),
+        D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0
+        });
+
+    builder.setRenderTargetCount(0);
+    builder.setDepthStencilFormat(DXGI_FORMAT_D32_FLOAT);
+
+    builder.setDepthTest(true, true);
+    builder.setPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
+    builder.setCullMode(D3D12_CULL_MODE_BACK);
+    builder.setRootSignature(rootSignature_);
+
+    builder.setVertexShader(vs);
+    builder.setPixelShader(ps);
+
+    pipeline_ = builder.build(d3d_.getDevice());
+}
+
+void PreDepthRenderer::doPreDepthPass(rg::PassContext &ctx)
+{
+    auto rawDSV = ctx.getDescriptor(depthBuffer_).getCPUHandle();
+    ctx->ClearDepthStencilView(rawDSV, D3D12_CLEAR_FLAG_DEPTH, 1, 0, 1, &scissor_);
+    ctx->OMSetRenderTargets(0, nullptr, false, &rawDSV);
+
+    ctx->RSSetViewports(1, &viewport_);
+    ctx->RSSetScissorRects(1, &scissor_);
+
+    ctx->SetGraphicsRootSignature(rootSignature_.Get());
+    ctx->SetPipelineState(pipeline_.Get());
+
+    ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    for(auto mesh : meshes_)
+    {
+        ctx->SetGraphicsRootConstantBufferView(
+            0, mesh->vsTransform.getGPUVirtualAddress(ctx.getFrameIndex()));
+
+        auto vtxBufView = mesh->vertexBuffer.getView();
+        ctx->IASetVertexBuffers(0, 1, &vtxBufView);
+
+        ctx->DrawInstanced(mesh->vertexBuffer.getVertexCount(), 1, 0, 0);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "./common.h"
+
+// fills the depth buffer before light clustering, so that LightCluster can
+// skip clusters without visible geometry
+class PreDepthRenderer : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit PreDepthRenderer(D3D12Context &d3d);
+
+    rg::Pass *addToRenderGraph(rg::Graph &graph, rg::Resource *depthBuffer);
+
+    void addMesh(const Mesh *mesh);
+
+private:
+
+    void initRootSignature();
+
+    void initPipeline();
+
+    void doPreDepthPass(rg::PassContext &ctx);
+
+    D3D12Context &d3d_;
+
+    rg::Resource *depthBuffer_;
+
+    // 0: vsTransform (b0)
+    ComPtr<ID3D12RootSignature> rootSignature_;
+    ComPtr<ID3D12PipelineState> pipeline_;
+
+    D3D12_VIEWPORT viewport_;
+    D3D12_RECT     scissor_;
+
+    std::vector<const Mesh *> meshes_;
+};
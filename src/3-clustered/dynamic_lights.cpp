@@ -0,0 +1,80 @@
+#include "./dynamic_lights.h"
+
+DynamicLightBuffer::DynamicLightBuffer(D3D12Context &d3d)
+    : d3d_(d3d), store_(1 + d3d.getFramebufferCount()),
+      updated_(false), uploadedByteCount_(0)
+{
+    static_assert(sizeof(Light) == sizeof(clustering::Light));
+}
+
+void DynamicLightBuffer::setLights(const Light *lights, size_t lightCount)
+{
+    store_.resize(lightCount);
+    for(size_t i = 0; i < lightCount; ++i)
+        store_.setLight(i, reinterpret_cast<const clustering::Light &>(lights[i]));
+
+    mirror_.resize(lightCount);
+
+    // root srvs must point to valid memory even without lights
+
+    const size_t byteSize = (std::max)(lightCount, size_t(1)) * sizeof(Light);
+
+    frameBuffers_.resize(d3d_.getFramebufferCount());
+    for(auto &buffer : frameBuffers_)
+    {
+        if(!buffer.getResource() || buffer.getByteSize() < byteSize)
+            buffer.initializeUpload(d3d_.getResourceManager(), byteSize);
+    }
+}
+
+clustering::LightStore &DynamicLightBuffer::getStore()
+{
+    return store_;
+}
+
+void DynamicLightBuffer::update()
+{
+    store_.takeDirtyRanges(MIRROR_CONSUMER, ranges_);
+    updated_ = !ranges_.empty();
+
+    store_.writeLights(
+        threadPool_, ranges_,
+        reinterpret_cast<clustering::Light *>(mirror_.data()));
+
+    const int frameIndex = d3d_.getFramebufferIndex();
+    store_.takeDirtyRanges(1 + frameIndex, ranges_);
+
+    uploadedByteCount_ = 0;
+    for(auto &range : ranges_)
+    {
+        const size_t offset = range.beg * sizeof(Light);
+        const size_t size   = (range.end - range.beg) * sizeof(Light);
+        frameBuffers_[frameIndex].updateData(offset, size, &mirror_[range.beg]);
+        uploadedByteCount_ += size;
+    }
+}
+
+const Buffer &DynamicLightBuffer::getBuffer() const
+{
+    return frameBuffers_[d3d_.getFramebufferIndex()];
+}
+
+const Light *DynamicLightBuffer::getLights() const
+{
+    return mirror_.data();
+}
+
+size_t DynamicLightBuffer::getLightCount() const
+{
+    return mirror_.size();
+}
+
+bool DynamicLightBuffer::isUpdated() const
+{
+    return updated_;
+}
+
+size_t DynamicLightBuffer::getUploadedByteCount() const
+{
+    return uploadedByteCount_;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../clustering/light_store.h"
+#include "./common.h"
+
+// lights animated on the cpu. they are kept in a clustering::LightStore,
+// and each frame in flight has its own upload buffer holding a full copy.
+// update() converts the lights changed since the last frame into a cpu
+// mirror, and copies into the current frame's buffer only the ranges
+// changed since that buffer was last written. the gpu reads the upload
+// buffers directly, so nothing waits for a copy queue
+class DynamicLightBuffer : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit DynamicLightBuffer(D3D12Context &d3d);
+
+    // reallocates the per-frame buffers, so the gpu must be idle
+    void setLights(const Light *lights, size_t lightCount);
+
+    // modify lights here, marking what changed as dirty
+    clustering::LightStore &getStore();
+
+    // call once per frame after D3D12Context::startFrame()
+    void update();
+
+    // buffer of the current frame
+    const Buffer &getBuffer() const;
+
+    // cpu copy of the lights, up to date after update(). the pointer stays
+    // valid until the next setLights()
+    const Light *getLights() const;
+
+    size_t getLightCount() const;
+
+    // whether the last update() found changed lights
+    bool isUpdated() const;
+
+    // bytes copied into the upload buffer by the last update()
+    size_t getUploadedByteCount() const;
+
+private:
+
+    // consumer 0 of the store is the mirror, 1 + i the buffer of frame i
+    static constexpr int MIRROR_CONSUMER = 0;
+
+    D3D12Context &d3d_;
+
+    clustering::ThreadPool threadPool_;
+    clustering::LightStore store_;
+
+    std::vector<Light>  mirror_;
+    std::vector<Buffer> frameBuffers_;
+
+    std::vector<clustering::LightRange> ranges_;
+
+    bool   updated_;
+    size_t uploadedByteCount_;
+};
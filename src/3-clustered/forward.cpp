@@ -3,7 +3,8 @@
 #include "./forward.h"
 
 ForwardRenderer::ForwardRenderer(D3D12Context &d3d)
-    : d3d_(d3d), viewport_(), scissor_(), psClusterTable_(nullptr)
+    : d3d_(d3d), viewport_(), scissor_(), psClusterTable_(nullptr),
+      lightBuffer_(nullptr), zBinning_(nullptr), globalLights_(nullptr)
 {
     initRootSignature();
     initConstantBuffer();
@@ -13,6 +14,11 @@ rg::Pass *ForwardRenderer::addToRenderGraph(const RenderGraphInput &graphInput)
 {
     graphInput_ = graphInput;
 
+    psParamsData_.clusterLayout = static_cast<int32_t>(graphInput_.clusterLayout);
+    psParamsData_.enableTiles   = graphInput_.tileCountX > 0;
+    psParamsData_.tileCountX    = graphInput_.tileCountX;
+    psParamsData_.tileCountY    = graphInput_.tileCountY;
+
     initViewportAndScissor();
     initPipeline();
 
@@ -27,9 +33,11 @@ rg::Pass *ForwardRenderer::addToRenderGraph(const RenderGraphInput &graphInput)
 
     pass->addDSV(
         graphInput_.depthBuffer,
-        rg::DepthStencilType::ReadAndWrite,
+        graphInput_.depthPrepass ?
+            rg::DepthStencilType::ReadOnly :
+            rg::DepthStencilType::ReadAndWrite,
         D3D12_DEPTH_STENCIL_VIEW_DESC{
-            .Format        = DXGI_FORMAT_UNKNOWN,
+            .Format        = DXGI_FORMAT_D32_FLOAT,
             .ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D,
             .Flags         = D3D12_DSV_FLAG_NONE,
             .Texture2D     = { 0 }
@@ -61,14 +69,36 @@ void ForwardRenderer::setCamera(const Float3 &eye)
 }
 
 void ForwardRenderer::setCluster(
-    float nearZ, float farZ, const Int3 &clusterCount)
+    float                            nearZ,
+    float                            farZ,
+    const Int3                      &clusterCount,
+    const clustering::SlicingPolicy &slicing)
 {
     psParamsData_.clusterCountX = clusterCount.x;
     psParamsData_.clusterCountY = clusterCount.y;
     psParamsData_.clusterCountZ = clusterCount.z;
 
-    psParamsData_.A = clusterCount.z / std::log(farZ / nearZ);
-    psParamsData_.B = clusterCount.z * std::log(nearZ) / std::log(farZ / nearZ);
+    const clustering::ClusterSlicing clusterSlicing =
+        clustering::getClusterSlicing(clusterCount.z, nearZ, farZ, slicing);
+
+    psParamsData_.A           = clusterSlicing.A;
+    psParamsData_.B           = clusterSlicing.B;
+    psParamsData_.slicingMode = static_cast<int32_t>(clusterSlicing.policy.mode);
+    psParamsData_.nearSliceZ  = clusterSlicing.policy.nearSliceZ;
+}
+
+void ForwardRenderer::setCluster(
+    float                            nearZ,
+    float                            farZ,
+    int                              tileWidth,
+    int                              tileHeight,
+    int                              zCount,
+    const clustering::SlicingPolicy &slicing)
+{
+    const clustering::Int3 count = clustering::getTiledClusterCount(
+        d3d_.getClientWidth(), d3d_.getClientHeight(),
+        tileWidth, tileHeight, zCount);
+    setCluster(nearZ, farZ, Int3{ count.x, count.y, count.z }, slicing);
 }
 
 void ForwardRenderer::setLights(const Buffer *lightBuffer, size_t lightCount)
@@ -82,6 +112,16 @@ void ForwardRenderer::setCulling(bool enabled)
     psParamsData_.enableCulling = enabled;
 }
 
+void ForwardRenderer::setZBinning(const LightZBinning *zBinning)
+{
+    zBinning_ = zBinning;
+}
+
+void ForwardRenderer::setGlobalLights(const GlobalLightList *globalLights)
+{
+    globalLights_ = globalLights;
+}
+
 void ForwardRenderer::initRootSignature()
 {
     CD3DX12_DESCRIPTOR_RANGE psMeshTable;
@@ -90,12 +130,16 @@ void ForwardRenderer::initRootSignature()
     CD3DX12_DESCRIPTOR_RANGE psClusterTable;
     psClusterTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 4);
 
-    CD3DX12_ROOT_PARAMETER params[5];
+    CD3DX12_ROOT_PARAMETER params[9];
     params[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
     params[1].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     params[2].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     params[3].InitAsDescriptorTable(1, &psMeshTable, D3D12_SHADER_VISIBILITY_PIXEL);
     params[4].InitAsDescriptorTable(1, &psClusterTable, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[5].InitAsShaderResourceView(6, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[6].InitAsShaderResourceView(7, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[7].InitAsShaderResourceView(8, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    params[8].InitAsShaderResourceView(9, 0, D3D12_SHADER_VISIBILITY_PIXEL);
 
     RootSignatureBuilder builder;
     builder.addParameters(params);
@@ -130,19 +174,23 @@ void ForwardRenderer::initPipeline()
     FXC compiler;
     compiler.setWarnings(true);
 
-    auto vs = compiler.compile(
-        shaderSource, "vs_5_1", FXC::Options{
-            .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
-            .sourceName = shaderFilename,
-            .entry      = "VSMain"
-        });
+    D3D_SHADER_MACRO macros[2] = {
+        { "COMPACT_CLUSTERS", "1" },
+        { nullptr, nullptr }
+    };
 
-    auto ps = compiler.compile(
-        shaderSource, "ps_5_1", FXC::Options{
-            .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
-            .sourceName = shaderFilename,
-            .entry      = "PSMain"
-        });
+    FXC::Options vsOptions = {
+        .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        .sourceName = shaderFilename,
+        .entry      = "VSMain"
+    };
+    vsOptions.macros = graphInput_.compactClusters ? macros : nullptr;
+
+    FXC::Options psOptions = vsOptions;
+    psOptions.entry = "PSMain";
+
+    auto vs = compiler.compile(shaderSource, "vs_5_1", vsOptions);
+    auto ps = compiler.compile(shaderSource, "ps_5_1", psOptions);
 
     PipelineBuilder builder;
 
@@ -165,10 +213,15 @@ void ForwardRenderer::initPipeline()
     builder.setRenderTargetCount(1);
     builder.setRenderTargetFormat(
         0, graphInput_.renderTarget->getDescription().Format);
-    builder.setDepthStencilFormat(
-        graphInput_.depthBuffer->getDescription().Format);
+    builder.setDepthStencilFormat(DXGI_FORMAT_D32_FLOAT);
 
-    builder.setDepthTest(true, true);
+    if(graphInput_.depthPrepass)
+    {
+        builder.setDepthFunc(D3D12_COMPARISON_FUNC_LESS_EQUAL);
+        builder.setDepthTest(true, false);
+    }
+    else
+        builder.setDepthTest(true, true);
     builder.setPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
     builder.setCullMode(D3D12_CULL_MODE_BACK);
     builder.setRootSignature(rootSignature_);
@@ -183,7 +236,8 @@ void ForwardRenderer::doForwardPass(rg::PassContext &ctx)
 {
     auto rawRTV = ctx.getDescriptor(graphInput_.renderTarget).getCPUHandle();
     auto rawDSV = ctx.getDescriptor(graphInput_.depthBuffer).getCPUHandle();
-    ctx->ClearDepthStencilView(rawDSV, D3D12_CLEAR_FLAG_DEPTH, 1, 0, 1, &scissor_);
+    if(!graphInput_.depthPrepass)
+        ctx->ClearDepthStencilView(rawDSV, D3D12_CLEAR_FLAG_DEPTH, 1, 0, 1, &scissor_);
     ctx->OMSetRenderTargets(1, &rawRTV, false, &rawDSV);
 
     ctx->RSSetViewports(1, &viewport_);
@@ -194,6 +248,24 @@ void ForwardRenderer::doForwardPass(rg::PassContext &ctx)
 
     ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+    psParamsData_.enableZBinning = zBinning_ != nullptr;
+    if(zBinning_)
+    {
+        const Int3 &binCount = zBinning_->getBinCount();
+        const clustering::ZBinSlicing slicing = clustering::getZBinSlicing(
+            binCount.z, zBinning_->getNearZ(), zBinning_->getFarZ());
+
+        psParamsData_.zBinMaskWordCount = zBinning_->getMaskWordCount();
+        psParamsData_.zBinTileCountX    = binCount.x;
+        psParamsData_.zBinTileCountY    = binCount.y;
+        psParamsData_.zBinCount         = binCount.z;
+        psParamsData_.zBinNearZ         = slicing.nearZ;
+        psParamsData_.zBinScale         = slicing.scale;
+    }
+
+    psParamsData_.globalLightCount = globalLights_ && !psParamsData_.enableTiles ?
+        static_cast<int32_t>(globalLights_->getGlobalLights().size()) : 0;
+
     psParams_.updateData(ctx.getFrameIndex(), psParamsData_);
     ctx->SetGraphicsRootConstantBufferView(
         1, psParams_.getGPUVirtualAddress(ctx.getFrameIndex()));
@@ -201,6 +273,21 @@ void ForwardRenderer::doForwardPass(rg::PassContext &ctx)
     ctx->SetGraphicsRootShaderResourceView(
         2, lightBuffer_->getGPUVirtualAddress());
 
+    // without z-binning the light buffer keeps the unused slots valid
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ctx->SetGraphicsRootShaderResourceView(
+            5 + i, zBinning_ ?
+                zBinning_->getBufferAddress(ctx.getFrameIndex(), i) :
+                lightBuffer_->getGPUVirtualAddress());
+    }
+
+    ctx->SetGraphicsRootShaderResourceView(
+        8, globalLights_ ?
+            globalLights_->getBufferAddress(ctx.getFrameIndex(), 1) :
+            lightBuffer_->getGPUVirtualAddress());
+
     ctx->SetGraphicsRootDescriptorTable(
         4, ctx.getDescriptorRange(psClusterTable_)[0]);
 
@@ -1,6 +1,7 @@
 #pragma once
 
-#include "./common.h"
+#include "./global_lights.h"
+#include "./zbin.h"
 
 class ForwardRenderer : public agz::misc::uncopyable_t
 {
@@ -18,6 +19,23 @@ public:
 
         rg::Resource                   *lightIndexBuffer = nullptr;
         D3D12_SHADER_RESOURCE_VIEW_DESC lightIndexSRV = {};
+
+        // the buffers use the compact encoding, see
+        // LightCluster::isCompactEncoding
+        bool compactClusters = false;
+
+        // see LightCluster::getClusterLayout
+        clustering::ClusterLayout clusterLayout = clustering::ClusterLayout::Linear;
+
+        // when nonzero, the buffers hold the per-tile lists of LightTiles
+        // with these counts instead of cluster lists. global lights are
+        // then ignored, since the tile lists hold all lights
+        int tileCountX = 0;
+        int tileCountY = 0;
+
+        // depth buffer is already filled by PreDepthRenderer. it is then
+        // tested with LESS_EQUAL and neither cleared nor written
+        bool depthPrepass = false;
     };
 
     explicit ForwardRenderer(D3D12Context &d3d);
@@ -28,12 +46,35 @@ public:
 
     void setCamera(const Float3 &eye);
 
-    void setCluster(float nearZ, float farZ, const Int3 &clusterCount);
+    void setCluster(
+        float                            nearZ,
+        float                            farZ,
+        const Int3                      &clusterCount,
+        const clustering::SlicingPolicy &slicing = {});
+
+    // grid of LightCluster::setClusterTileSize at the current framebuffer
+    // size. call again after each resize
+    void setCluster(
+        float                            nearZ,
+        float                            farZ,
+        int                              tileWidth,
+        int                              tileHeight,
+        int                              zCount,
+        const clustering::SlicingPolicy &slicing = {});
 
     void setLights(const Buffer *lightBuffer, size_t lightCount);
 
     void setCulling(bool enabled);
 
+    // look lights up in zBinning instead of the light cluster buffers.
+    // nullptr switches back to clusters
+    void setZBinning(const LightZBinning *zBinning);
+
+    // shade the lights of globalLights before the cluster list of each
+    // pixel. must be the list given to LightCluster::setGlobalLights.
+    // z-binning ignores it, since its lists hold all lights
+    void setGlobalLights(const GlobalLightList *globalLights);
+
 private:
 
     void initRootSignature();
@@ -56,10 +97,25 @@ private:
         int32_t clusterCountZ = 0;
         float   A             = 0;
 
-        float B               = 0;
-        int32_t enableCulling = 1;
-
-        float pad0[2] = {};
+        float   B                 = 0;
+        int32_t enableCulling     = 1;
+        int32_t enableZBinning    = 0;
+        int32_t zBinMaskWordCount = 0;
+
+        int32_t zBinTileCountX = 0;
+        int32_t zBinTileCountY = 0;
+        int32_t zBinCount      = 0;
+        float   zBinNearZ      = 0;
+
+        float   zBinScale        = 0;
+        int32_t slicingMode      = 0;
+        float   nearSliceZ       = 0;
+        int32_t globalLightCount = 0;
+
+        int32_t clusterLayout = 0;
+        int32_t enableTiles   = 0;
+        int32_t tileCountX    = 0;
+        int32_t tileCountY    = 0;
     };
 
     D3D12Context &d3d_;
@@ -74,6 +130,10 @@ private:
     // 4: psClusterTable
     //      1: clusterRange(t4)
     //      2: lightIndex  (t5)
+    // 5: zBins            (t6)
+    // 6: tileMasks        (t7)
+    // 7: sortedLights     (t8)
+    // 8: globalLights     (t9)
     // linearSampler       (s0)
     ComPtr<ID3D12RootSignature> rootSignature_;
     ComPtr<ID3D12PipelineState> pipeline_;
@@ -91,4 +151,8 @@ private:
     rg::DescriptorTable *psClusterTable_;
 
     const Buffer *lightBuffer_;
+
+    const LightZBinning *zBinning_;
+
+    const GlobalLightList *globalLights_;
 };
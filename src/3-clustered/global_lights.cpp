@@ -0,0 +1,110 @@
+#include "./global_lights.h"
+
+GlobalLightList::GlobalLightList(D3D12Context &d3d)
+    : d3d_(d3d), maxCoverage_(1), nearZ_(0), farZ_(0),
+      view_(clustering::Mat4::identity()), lights_(nullptr), lightCount_(0)
+{
+    initFrameBuffers();
+}
+
+void GlobalLightList::setMaxCoverage(float maxCoverage)
+{
+    maxCoverage_ = maxCoverage;
+}
+
+float GlobalLightList::getMaxCoverage() const
+{
+    return maxCoverage_;
+}
+
+void GlobalLightList::setClusterCount(const Int3 &count)
+{
+    clusterCount_ = count;
+}
+
+void GlobalLightList::setProj(float nearZ, float farZ, const Mat4 &proj)
+{
+    nearZ_ = nearZ;
+    farZ_  = farZ;
+    proj_  = toClusteringMat4(proj);
+}
+
+void GlobalLightList::setSlicingPolicy(const clustering::SlicingPolicy &policy)
+{
+    slicingPolicy_ = policy;
+}
+
+void GlobalLightList::setView(const Mat4 &view)
+{
+    view_ = toClusteringMat4(view);
+}
+
+void GlobalLightList::setLights(const Light *lights, size_t lightCount)
+{
+    static_assert(sizeof(Light) == sizeof(clustering::Light));
+
+    lights_     = lights;
+    lightCount_ = lightCount;
+    initFrameBuffers();
+}
+
+void GlobalLightList::update()
+{
+    const clustering::ClusterSlicing slicing = clustering::getClusterSlicing(
+        clusterCount_.z, nearZ_, farZ_, slicingPolicy_);
+
+    clustering::findGlobalLights(
+        reinterpret_cast<const clustering::Light *>(lights_), lightCount_,
+        view_, proj_, { clusterCount_.x, clusterCount_.y, clusterCount_.z },
+        slicing, maxCoverage_, globalLights_);
+
+    mask_.assign(getMaskWordCount(), 0);
+    for(int li : globalLights_)
+        mask_[li / 32] |= 1u << (li % 32);
+
+    auto &buffers = frameBuffers_[d3d_.getFramebufferIndex()];
+
+    buffers[0].updateData(0, mask_.size() * sizeof(uint32_t), mask_.data());
+
+    if(!globalLights_.empty())
+    {
+        buffers[1].updateData(
+            0, globalLights_.size() * sizeof(int32_t), globalLights_.data());
+    }
+}
+
+const std::vector<int32_t> &GlobalLightList::getGlobalLights() const
+{
+    return globalLights_;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GlobalLightList::getBufferAddress(
+    int frameIndex, int buffer) const
+{
+    return frameBuffers_[frameIndex][buffer].getGPUVirtualAddress();
+}
+
+int GlobalLightList::getMaskWordCount() const
+{
+    return static_cast<int>((lightCount_ + 31) / 32);
+}
+
+void GlobalLightList::initFrameBuffers()
+{
+    // root srvs must point to valid memory even without lights
+
+    const size_t byteSizes[2] = {
+        (std::max)(getMaskWordCount(), 1) * sizeof(uint32_t),
+        (std::max)(lightCount_, size_t(1)) * sizeof(int32_t)
+    };
+
+    frameBuffers_.resize(d3d_.getFramebufferCount());
+    for(auto &buffers : frameBuffers_)
+    {
+        for(int i = 0; i < 2; ++i)
+        {
+            if(!buffers[i].getResource() || buffers[i].getByteSize() < byteSizes[i])
+                buffers[i].initializeUpload(d3d_.getResourceManager(), byteSizes[i]);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+
+#include "../clustering/global_lights.h"
+#include "./common.h"
+
+// lights reaching most clusters, like the fill light of the sample, are
+// classified on the cpu with clustering::isGlobalLight every frame.
+// LightCluster skips the lights set in the mask buffer, and ForwardRenderer
+// shades the index buffer before the cluster list of each pixel. both are
+// per-frame upload buffers read directly by the gpu
+class GlobalLightList : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit GlobalLightList(D3D12Context &d3d);
+
+    // lights estimated to reach more than this fraction of the clusters are
+    // global. 1 by default, which keeps all lights in the cluster lists
+    void setMaxCoverage(float maxCoverage);
+
+    float getMaxCoverage() const;
+
+    // grid, projection and slicing must match LightCluster
+
+    void setClusterCount(const Int3 &count);
+
+    void setProj(float nearZ, float farZ, const Mat4 &proj);
+
+    void setSlicingPolicy(const clustering::SlicingPolicy &policy);
+
+    void setView(const Mat4 &view);
+
+    // lights are read on the cpu by update(), e.g. from
+    // DynamicLightBuffer::getLights(). reallocates the per-frame buffers
+    // when the light count grows, so the gpu must be idle then
+    void setLights(const Light *lights, size_t lightCount);
+
+    // classify the lights and fill the buffers of the current frame.
+    // call after D3D12Context::startFrame()
+    void update();
+
+    // lights found by the last update(), in ascending order
+    const std::vector<int32_t> &getGlobalLights() const;
+
+    // 0: light mask (one bit per light), 1: global light indices
+    D3D12_GPU_VIRTUAL_ADDRESS getBufferAddress(int frameIndex, int buffer) const;
+
+private:
+
+    int getMaskWordCount() const;
+
+    void initFrameBuffers();
+
+    D3D12Context &d3d_;
+
+    float maxCoverage_;
+
+    Int3  clusterCount_;
+    float nearZ_;
+    float farZ_;
+
+    clustering::Mat4          proj_;
+    clustering::Mat4          view_;
+    clustering::SlicingPolicy slicingPolicy_;
+
+    const Light *lights_;
+    size_t       lightCount_;
+
+    std::vector<int32_t>  globalLights_;
+    std::vector<uint32_t> mask_;
+
+    // frameBuffers_[frameIndex][buffer]
+    std::vector<std::array<Buffer, 2>> frameBuffers_;
+};
@@ -1,12 +1,21 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <random>
 
 #include <agz-utils/time.h>
 
+#include "../clustering/grid_tuner.h"
+#include "../clustering/light_sort.h"
 #include "../common/camera.h"
 #include "../common/sky.h"
 #include "./cluster.h"
+#include "./depth.h"
+#include "./dynamic_lights.h"
 #include "./forward.h"
+#include "./global_lights.h"
+#include "./tile.h"
+#include "./zbin.h"
 
 void run()
 {
@@ -67,28 +76,114 @@ void run()
         lightData.push_back(light);
     }
 
-    Buffer lightBuffer = d3d12.createDefaultBuffer(
-        sizeof(Light) * lightData.size(), D3D12_RESOURCE_STATE_COMMON);
+    // neighbouring clusters then reference nearby light indices. the fill
+    // light created first is found again through the old -> new remap
+    size_t fillLightIndex;
+    {
+        static_assert(sizeof(Light) == sizeof(clustering::Light));
+
+        clustering::ThreadPool threadPool;
+        const auto remap = clustering::sortLightsByMorton(
+            threadPool,
+            reinterpret_cast<clustering::Light *>(lightData.data()),
+            lightData.size());
+        fillLightIndex = static_cast<size_t>(remap[0]);
+    }
+
+    // small lights can be animated, only their changed ranges are uploaded
 
-    uploader.upload(lightBuffer, lightData.data(), lightBuffer.getByteSize());
-    uploader.submitAndSync();
+    DynamicLightBuffer dynamicLights(d3d12);
+    dynamicLights.setLights(lightData.data(), lightData.size());
+
+    std::vector<float> lightBaseY(lightData.size());
+    for(size_t i = 0; i < lightData.size(); ++i)
+        lightBaseY[i] = lightData[i].lightPosition.y;
 
     // cluster
 
-    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    // clusters are tiles of at most clusterTileSize pixels, so the work per
+    // cluster stays the same when the window is resized. "ClusteringBench
+    // --save-grid ./asset/clustered/cluster_grid.txt tune" saves the grid it
+    // recommends for this scene at 800x600, which gives the initial tile size
+
+    clustering::Int3 tunedClusterCount = { 20, 15, 32 };
+    clustering::loadClusterGrid(
+        "./asset/clustered/cluster_grid.txt", tunedClusterCount);
+
+    int clusterTileSize[2] = {
+        agz::upalign_to(windowDesc.clientSize.x, tunedClusterCount.x) /
+            tunedClusterCount.x,
+        agz::upalign_to(windowDesc.clientSize.y, tunedClusterCount.y) /
+            tunedClusterCount.y
+    };
+    const int CLUSTER_Z_COUNT = tunedClusterCount.z;
 
     LightCluster lightCluster(d3d12);
-    lightCluster.setClusterCount(CLUSTER_COUNT);
+    lightCluster.setClusterTileSize(
+        clusterTileSize[0], clusterTileSize[1], CLUSTER_Z_COUNT);
     lightCluster.setProj(camera.getNearZ(), camera.getFarZ(), camera.getProj());
     lightCluster.updateClusterAABBs(uploader);
-    lightCluster.setLights(lightBuffer, lightData.size());
+    lightCluster.setLights(dynamicLights.getBuffer(), lightData.size());
+
+    // halves cluster buffer reads in the forward pass. falls back to 32-bit
+    // ranges and indices when the lights do not fit in uint16
+    bool compactClusters = true;
+    lightCluster.setCompactEncodingEnabled(compactClusters);
+
+    // slice major ranges keep neighbouring tiles of a slice together. that
+    // fetched 3-6x fewer range cache lines than linear in the layout bench,
+    // without the unused ranges of morton
+
+    const char *CLUSTER_LAYOUT_NAMES[] = { "linear", "slice major", "morton" };
+
+    int clusterLayout = static_cast<int>(clustering::ClusterLayout::SliceMajor);
+    lightCluster.setClusterLayout(
+        static_cast<clustering::ClusterLayout>(clusterLayout));
+
+    // z-binning, an alternative to the light cluster with 16x16 pixel tiles
+
+    const int Z_BIN_COUNT = 256;
+
+    auto getZBinCount = [&]
+    {
+        return Int3{
+            agz::upalign_to(d3d12.getClientWidth(), 16) / 16,
+            agz::upalign_to(d3d12.getClientHeight(), 16) / 16,
+            Z_BIN_COUNT
+        };
+    };
+
+    LightZBinning zBinning(d3d12);
+    zBinning.setBinCount(getZBinCount());
+    zBinning.setProj(camera.getNearZ(), camera.getFarZ(), camera.getProj());
+
+    // with too many lights z-binning would drop some, clusters are kept then
+    const bool canUseZBinning =
+        zBinning.setLights(dynamicLights.getLights(), lightData.size());
+
+    // tiled forward+, another alternative with 16x16 pixel tiles cut to the
+    // depth range of their prepass samples
+
+    LightTiles lightTiles(d3d12);
+    lightTiles.setTileSize(16, 16);
+    lightTiles.setProj(camera.getProj());
+    lightTiles.setLights(dynamicLights.getBuffer(), lightData.size());
+
+    // lights reaching most clusters, like the fill light, can be shaded from one
+    // global list instead of being stored in every cluster they reach
+
+    GlobalLightList globalLights(d3d12);
+    globalLights.setClusterCount(lightCluster.getClusterCount());
+    globalLights.setProj(camera.getNearZ(), camera.getFarZ(), camera.getProj());
+    globalLights.setLights(dynamicLights.getLights(), lightData.size());
 
     // forward renderer
 
     ForwardRenderer forwardRenderer(d3d12);
-    forwardRenderer.setLights(&lightBuffer, lightData.size());
+    forwardRenderer.setLights(&dynamicLights.getBuffer(), lightData.size());
     forwardRenderer.setCluster(
-        camera.getNearZ(), camera.getFarZ(), CLUSTER_COUNT);
+        camera.getNearZ(), camera.getFarZ(),
+        clusterTileSize[0], clusterTileSize[1], CLUSTER_Z_COUNT);
 
     // sky
 
@@ -114,6 +209,15 @@ void run()
 
     forwardRenderer.addMesh(&mesh);
 
+    // depth prepass, only used by active clusters and tiled forward+
+
+    PreDepthRenderer preDepthRenderer(d3d12);
+    preDepthRenderer.addMesh(&mesh);
+
+    bool activeClusters = false;
+
+    bool tiledLights = false;
+
     // render graph
 
     rg::Graph graph;
@@ -143,7 +247,7 @@ void run()
             });
         depthBuffer->setHeapType(D3D12_HEAP_TYPE_DEFAULT);
         depthBuffer->setDescription(CD3DX12_RESOURCE_DESC::Tex2D(
-            DXGI_FORMAT_D32_FLOAT,
+            DXGI_FORMAT_R32_TYPELESS,
             framebuffer->getDescription().Width,
             framebuffer->getDescription().Height,
             1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
@@ -152,18 +256,52 @@ void run()
 
         auto skyPass = skyRenderer.addToRenderGraph(graph, framebuffer);
 
-        auto lightClusterPass = lightCluster.addToRenderGraph(graph, 1, 1);
-
-        auto forwardPass = forwardRenderer.addToRenderGraph(
-            ForwardRenderer::RenderGraphInput{
-                .graph              = &graph,
-                .renderTarget       = framebuffer,
-                .depthBuffer        = depthBuffer,
-                .clusterRangeBuffer = lightCluster.getClusterRangeBuffer(),
-                .clusterRangeSRV    = lightCluster.getClusterRangeSRV(),
-                .lightIndexBuffer   = lightCluster.getLightIndexBuffer(),
-                .lightIndexSRV      = lightCluster.getLightIndexSRV()
-            });
+        // the cluster and tile passes read the prepass depth buffer, which
+        // can only leave DEPTH_WRITE on the graphics queue
+
+        rg::Pass   *preDepthPass     = nullptr;
+        rg::Vertex *lightClusterPass = nullptr;
+        if(tiledLights)
+        {
+            preDepthPass = preDepthRenderer.addToRenderGraph(graph, depthBuffer);
+            lightClusterPass = lightTiles.addToRenderGraph(
+                graph, 1, 0, depthBuffer);
+        }
+        else if(activeClusters)
+        {
+            preDepthPass = preDepthRenderer.addToRenderGraph(graph, depthBuffer);
+            lightClusterPass = lightCluster.addToRenderGraph(
+                graph, 1, 0, depthBuffer);
+        }
+        else
+            lightClusterPass = lightCluster.addToRenderGraph(graph, 1, 1);
+
+        ForwardRenderer::RenderGraphInput forwardInput = {
+            .graph              = &graph,
+            .renderTarget       = framebuffer,
+            .depthBuffer        = depthBuffer,
+            .clusterRangeBuffer = lightCluster.getClusterRangeBuffer(),
+            .clusterRangeSRV    = lightCluster.getClusterRangeSRV(),
+            .lightIndexBuffer   = lightCluster.getLightIndexBuffer(),
+            .lightIndexSRV      = lightCluster.getLightIndexSRV(),
+            .compactClusters    = lightCluster.isCompactEncoding(),
+            .clusterLayout      = lightCluster.getClusterLayout(),
+            .depthPrepass       = activeClusters
+        };
+
+        if(tiledLights)
+        {
+            forwardInput.clusterRangeBuffer = lightTiles.getTileRangeBuffer();
+            forwardInput.clusterRangeSRV    = lightTiles.getTileRangeSRV();
+            forwardInput.lightIndexBuffer   = lightTiles.getLightIndexBuffer();
+            forwardInput.lightIndexSRV      = lightTiles.getLightIndexSRV();
+            forwardInput.compactClusters    = false;
+            forwardInput.tileCountX         = lightTiles.getTileCountX();
+            forwardInput.tileCountY         = lightTiles.getTileCountY();
+            forwardInput.depthPrepass       = true;
+        }
+
+        auto forwardPass = forwardRenderer.addToRenderGraph(forwardInput);
 
         auto imguiPass = d3d12.addImGuiToRenderGraph(graph, framebuffer);
 
@@ -173,6 +311,12 @@ void run()
         graph.addDependency(lightClusterPass, forwardPass);
         graph.addDependency(forwardPass, imguiPass);
 
+        if(preDepthPass)
+        {
+            graph.addDependency(preDepthPass, lightClusterPass);
+            graph.addDependency(preDepthPass, forwardPass);
+        }
+
         graph.addCrossFrameDependency(forwardPass, lightClusterPass);
 
         graph.compile(
@@ -190,6 +334,36 @@ void run()
 
     initGraph();
 
+    // z slicing of clusters. the hybrid near slice ends 1 unit from the
+    // camera, which balanced per-pixel light lists best in the slicing bench
+
+    const char *SLICING_NAMES[] = { "logarithmic", "linear", "hybrid" };
+    constexpr float HYBRID_NEAR_SLICE_Z = 1;
+
+    int slicingMode = static_cast<int>(clustering::SlicingMode::Logarithmic);
+
+    // recomputes the grid for the current framebuffer size. cached aabb
+    // buffers may be released, so the gpu must be idle
+    auto updateClusterGrid = [&]
+    {
+        const clustering::SlicingPolicy slicing = {
+            .mode       = static_cast<clustering::SlicingMode>(slicingMode),
+            .nearSliceZ = HYBRID_NEAR_SLICE_Z
+        };
+
+        lightCluster.setClusterTileSize(
+            clusterTileSize[0], clusterTileSize[1], CLUSTER_Z_COUNT);
+        lightCluster.setSlicingPolicy(slicing);
+        lightCluster.updateClusterAABBs(uploader);
+
+        globalLights.setClusterCount(lightCluster.getClusterCount());
+        globalLights.setSlicingPolicy(slicing);
+
+        forwardRenderer.setCluster(
+            camera.getNearZ(), camera.getFarZ(),
+            clusterTileSize[0], clusterTileSize[1], CLUSTER_Z_COUNT, slicing);
+    };
+
     d3d12.attach(std::make_shared<SwapChainPostResizeHandler>(
         [&]
     {
@@ -197,7 +371,13 @@ void run()
 
         camera.setWOverH(d3d12.getFramebufferWOverH());
         lightCluster.setProj(camera.getNearZ(), camera.getFarZ(), camera.getProj());
-        lightCluster.updateClusterAABBs(uploader);
+        globalLights.setProj(camera.getNearZ(), camera.getFarZ(), camera.getProj());
+        updateClusterGrid();
+
+        zBinning.setBinCount(getZBinCount());
+        zBinning.setProj(camera.getNearZ(), camera.getFarZ(), camera.getProj());
+
+        lightTiles.setProj(camera.getProj());
 
         input->setCursorLock(
             input->isCursorLocked(),
@@ -216,6 +396,30 @@ void run()
     bool enableCulling = true;
     forwardRenderer.setCulling(enableCulling);
 
+    // tiles colored by the most lights of any of their clusters
+    bool occupancyOverlay = false;
+
+    bool hierarchicalAssignment = false;
+
+    bool tilePyramidTest = false;
+
+    // 0.75 only takes the fill light, lower values start taking small
+    // lights near the camera, which then cost every pixel
+    bool  enableGlobalLights  = false;
+    float globalLightCoverage = 0.75f;
+    globalLights.setMaxCoverage(globalLightCoverage);
+
+    bool enableStatistics = false;
+
+    bool rebuildGraph = false;
+
+    bool enableZBinning = false;
+
+    bool reuseClusterLists = false;
+
+    bool animateLights = false;
+    float lightTime = 0;
+
     while(!d3d12.getCloseFlag())
     {
         d3d12.startFrame();
@@ -236,6 +440,182 @@ void run()
                 "camera position: %s", camera.getPosition().to_string().c_str());
             if(ImGui::Checkbox("enable light culling", &enableCulling))
                 forwardRenderer.setCulling(enableCulling);
+            if(ImGui::Checkbox("light occupancy overlay", &occupancyOverlay))
+                lightCluster.setOccupancyReadbackEnabled(occupancyOverlay);
+
+            clustering::ClusterOccupancy occupancy;
+            if(occupancyOverlay && lightCluster.getClusterOccupancy(occupancy))
+            {
+                const auto &count = occupancy.clusterCount;
+                const ImVec2 size = ImGui::GetIO().DisplaySize;
+
+                ImDrawList *drawList = ImGui::GetBackgroundDrawList();
+                for(int xi = 0; xi < count.x; ++xi)
+                {
+                    for(int yi = 0; yi < count.y; ++yi)
+                    {
+                        const clustering::Float3 color = clustering::getHeatmapColor(
+                            occupancy.tileMaxLights[xi * count.y + yi],
+                            occupancy.maxLights);
+
+                        // yi = 0 is the bottom of the screen
+
+                        drawList->AddRectFilled(
+                            ImVec2(
+                                size.x * xi / count.x,
+                                size.y * (count.y - 1 - yi) / count.y),
+                            ImVec2(
+                                size.x * (xi + 1) / count.x,
+                                size.y * (count.y - yi) / count.y),
+                            ImGui::ColorConvertFloat4ToU32(
+                                ImVec4(color.x, color.y, color.z, 0.4f)));
+                    }
+                }
+
+                const auto busiestSlice = std::max_element(
+                    occupancy.sliceMaxLights.begin(),
+                    occupancy.sliceMaxLights.end());
+                const int zi = static_cast<int>(
+                    busiestSlice - occupancy.sliceMaxLights.begin());
+
+                ImGui::Text(
+                    "busiest slice: %d (max %d, mean %.1f lights)",
+                    zi, occupancy.sliceMaxLights[zi], occupancy.sliceMeanLights[zi]);
+
+                if(ImGui::Button("export occupancy"))
+                {
+                    clustering::saveOccupancyHeatmap(
+                        "./cluster_occupancy.ppm", occupancy);
+                    clustering::saveClusterOccupancyCSV(
+                        "./cluster_occupancy.csv", occupancy);
+                    clustering::saveTileOccupancyCSV(
+                        "./tile_occupancy.csv", occupancy);
+                }
+            }
+            if(ImGui::Checkbox(
+                "hierarchical light assignment", &hierarchicalAssignment))
+            {
+                lightCluster.setAssignMode(
+                    hierarchicalAssignment ?
+                    LightCluster::AssignMode::Hierarchical :
+                    LightCluster::AssignMode::Flat);
+            }
+            if(ImGui::Checkbox("test lights against tile pyramids", &tilePyramidTest))
+            {
+                lightCluster.setClusterTest(
+                    tilePyramidTest ?
+                    clustering::ClusterTest::Frustum :
+                    clustering::ClusterTest::AABB);
+            }
+            if(ImGui::Checkbox("global list for large lights", &enableGlobalLights))
+            {
+                const GlobalLightList *list =
+                    enableGlobalLights ? &globalLights : nullptr;
+                lightCluster.setGlobalLights(list);
+                forwardRenderer.setGlobalLights(list);
+            }
+            if(enableGlobalLights)
+            {
+                if(ImGui::SliderFloat(
+                    "global light coverage", &globalLightCoverage, 0.05f, 1))
+                {
+                    globalLights.setMaxCoverage(globalLightCoverage);
+                    lightCluster.markLightsDirty();
+                }
+                ImGui::Text(
+                    "global lights: %d",
+                    static_cast<int>(globalLights.getGlobalLights().size()));
+            }
+            if(ImGui::Checkbox("light cluster statistics", &enableStatistics))
+                lightCluster.setStatisticsEnabled(enableStatistics);
+            if(ImGui::Checkbox("active clusters from depth", &activeClusters))
+                rebuildGraph = true;
+            if(ImGui::Checkbox("compact cluster encoding", &compactClusters))
+            {
+                lightCluster.setCompactEncodingEnabled(compactClusters);
+                rebuildGraph = true;
+            }
+            if(ImGui::Combo(
+                "cluster layout", &clusterLayout, CLUSTER_LAYOUT_NAMES,
+                static_cast<int>(std::size(CLUSTER_LAYOUT_NAMES))))
+            {
+                lightCluster.setClusterLayout(
+                    static_cast<clustering::ClusterLayout>(clusterLayout));
+                rebuildGraph = true;
+            }
+            if(!canUseZBinning)
+            {
+                ImGui::Text(
+                    "z-binning: more than %d lights", clustering::MAX_ZBIN_LIGHTS);
+            }
+            else if(ImGui::Checkbox("z-binning instead of clusters", &enableZBinning))
+                forwardRenderer.setZBinning(enableZBinning ? &zBinning : nullptr);
+            if(ImGui::Checkbox("tiled forward+ instead of clusters", &tiledLights))
+                rebuildGraph = true;
+            if(tiledLights)
+            {
+                ImGui::Text(
+                    "light tiles: %dx%d",
+                    lightTiles.getTileCountX(), lightTiles.getTileCountY());
+            }
+            if(ImGui::Checkbox("reuse cluster lists when static", &reuseClusterLists))
+            {
+                lightCluster.setTemporalReuseEnabled(reuseClusterLists);
+                lightCluster.resetTemporalReuseCounters();
+            }
+            if(reuseClusterLists)
+            {
+                ImGui::Text(
+                    "reused cluster lists: %lld / %lld frames",
+                    lightCluster.getReusedFrameCount(),
+                    lightCluster.getFrameCount());
+            }
+            if(ImGui::Checkbox("animate lights", &animateLights) && !animateLights)
+            {
+                // put the lights back to where they started
+                auto &store = dynamicLights.getStore();
+                for(size_t i = 0; i < lightBaseY.size(); ++i)
+                    store.getPositionY()[i] = lightBaseY[i];
+                store.markDirty(0, lightBaseY.size());
+            }
+            ImGui::Text(
+                "light upload: %.1f KB / frame",
+                dynamicLights.getUploadedByteCount() / 1024.0);
+            if(ImGui::Combo(
+                "z slicing", &slicingMode,
+                SLICING_NAMES, static_cast<int>(std::size(SLICING_NAMES))))
+            {
+                d3d12.waitForIdle();
+                updateClusterGrid();
+            }
+            if(ImGui::SliderInt2("cluster tile size", clusterTileSize, 16, 128))
+            {
+                // the cluster buffers are resized with the graph
+                d3d12.waitForIdle();
+                updateClusterGrid();
+                rebuildGraph = true;
+            }
+            {
+                const Int3 &count = lightCluster.getClusterCount();
+                ImGui::Text("cluster grid: %dx%dx%d", count.x, count.y, count.z);
+            }
+
+            clustering::ClusterStatistics stats;
+            if(enableStatistics && lightCluster.getStatistics(stats))
+            {
+                ImGui::Text("assignments: %lld", stats.assignmentCount);
+                ImGui::Text(
+                    "lights per cluster: max %d, mean %.2f, p99 %s%d",
+                    stats.maxLightsPerCluster,
+                    stats.meanLightsPerCluster,
+                    stats.p99Saturated ? ">=" : "",
+                    stats.p99LightsPerCluster);
+                ImGui::Text(
+                    "overflowed clusters: %d (%lld lights dropped)",
+                    stats.overflowedClusterCount,
+                    stats.clusterOverflowCount);
+                ImGui::Text("index overflow: %lld", stats.indexOverflowCount);
+            }
         }
         ImGui::End();
 
@@ -253,15 +633,64 @@ void run()
                 });
         }
 
+        if(animateLights)
+        {
+            // the fill light is the dim light covering the whole scene, it
+            // stays put
+
+            lightTime += 0.02f;
+
+            auto &store = dynamicLights.getStore();
+            for(size_t i = 0; i < lightBaseY.size(); ++i)
+            {
+                if(i == fillLightIndex)
+                    continue;
+                store.getPositionY()[i] =
+                    lightBaseY[i] + 0.5f * std::sin(lightTime + static_cast<float>(i));
+            }
+            store.markDirty(0, lightBaseY.size());
+        }
+
+        dynamicLights.update();
+        if(dynamicLights.isUpdated())
+            lightCluster.markLightsDirty();
+
+        lightCluster.setLights(dynamicLights.getBuffer(), dynamicLights.getLightCount());
+        lightTiles.setLights(dynamicLights.getBuffer(), dynamicLights.getLightCount());
+        forwardRenderer.setLights(
+            &dynamicLights.getBuffer(), dynamicLights.getLightCount());
+
         skyRenderer.setCamera(camera.getPosition(), camera.getViewProj());
         lightCluster.setView(camera.getPosition(), camera.getView());
+        lightTiles.setView(camera.getView());
         forwardRenderer.setCamera(camera.getPosition());
 
+        if(enableZBinning)
+        {
+            zBinning.setView(camera.getView());
+            zBinning.update();
+        }
+
+        if(enableGlobalLights)
+        {
+            globalLights.setView(camera.getView());
+            globalLights.setLights(
+                dynamicLights.getLights(), dynamicLights.getLightCount());
+            globalLights.update();
+        }
+
         const Mat4 world = Mat4::right_transform::scale(Float3(0.3f));
         mesh.vsTransform.updateData(
             d3d12.getFramebufferIndex(),
             { world, world * camera.getView(), world * camera.getViewProj() });
 
+        if(rebuildGraph)
+        {
+            d3d12.waitForIdle();
+            initGraph();
+            rebuildGraph = false;
+        }
+
         graph.run(d3d12.getFramebufferIndex());
 
         d3d12.swapFramebuffers();
@@ -0,0 +1,265 @@
+#include <agz-utils/file.h>
+
+#include "./tile.h"
+
+LightTiles::LightTiles(D3D12Context &d3d)
+    : d3d_(d3d), tileWidth_(16), tileHeight_(16), tileCountX_(0), tileCountY_(0),
+      tileRange_(nullptr), lightIndex_(nullptr),
+      uavTable_(nullptr), depthTable_(nullptr), depthWidth_(0), depthHeight_(0),
+      lightBuffer_(nullptr), lightCount_(0)
+{
+    initRootSignature();
+    initPipeline();
+    initConstantBuffer();
+}
+
+void LightTiles::setTileSize(int tileWidth, int tileHeight)
+{
+    tileWidth_  = tileWidth;
+    tileHeight_ = tileHeight;
+}
+
+int LightTiles::getTileCountX() const
+{
+    return tileCountX_;
+}
+
+int LightTiles::getTileCountY() const
+{
+    return tileCountY_;
+}
+
+rg::Pass *LightTiles::addToRenderGraph(
+    rg::Graph &graph, int thread, int queue, rg::Resource *depthBuffer)
+{
+    depthWidth_  = static_cast<int>(depthBuffer->getDescription().Width);
+    depthHeight_ = static_cast<int>(depthBuffer->getDescription().Height);
+
+    const clustering::Int3 count = clustering::getTiledClusterCount(
+        depthWidth_, depthHeight_, tileWidth_, tileHeight_, 1);
+    tileCountX_ = count.x;
+    tileCountY_ = count.y;
+
+    // every tile owns MAX_LIGHTS_PER_TILE index slots, so no counter is
+    // needed and the lists never overflow the buffer
+
+    const size_t tileRangeBufferSize  = getTileCount() * sizeof(clustering::ClusterRange);
+    const size_t lightIndexBufferSize =
+        getTileCount() * MAX_LIGHTS_PER_TILE * sizeof(int32_t);
+
+    tileRange_ = graph.addInternalResource("tile range buffer");
+    tileRange_->setInitialState(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    tileRange_->setDescription(CD3DX12_RESOURCE_DESC::Buffer(
+        tileRangeBufferSize,
+        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    lightIndex_ = graph.addInternalResource("tile light index buffer");
+    lightIndex_->setInitialState(D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    lightIndex_->setDescription(CD3DX12_RESOURCE_DESC::Buffer(
+        lightIndexBufferSize,
+        D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    auto tilePass = graph.addPass("tile lights", thread, queue);
+
+    uavTable_ = tilePass->addDescriptorTable(false, true);
+
+    uavTable_->addUAV(tileRange_, nullptr, D3D12_UNORDERED_ACCESS_VIEW_DESC{
+        .Format        = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+        .Buffer        = D3D12_BUFFER_UAV{
+            .FirstElement         = 0,
+            .NumElements          = static_cast<UINT>(getTileCount()),
+            .StructureByteStride  = sizeof(clustering::ClusterRange),
+            .CounterOffsetInBytes = 0,
+            .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
+        }
+    });
+
+    uavTable_->addUAV(lightIndex_, nullptr, D3D12_UNORDERED_ACCESS_VIEW_DESC{
+        .Format        = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+        .Buffer        = D3D12_BUFFER_UAV{
+            .FirstElement         = 0,
+            .NumElements          = static_cast<UINT>(
+                getTileCount() * MAX_LIGHTS_PER_TILE),
+            .StructureByteStride  = sizeof(int32_t),
+            .CounterOffsetInBytes = 0,
+            .Flags                = D3D12_BUFFER_UAV_FLAG_NONE
+        }
+    });
+
+    depthTable_ = tilePass->addDescriptorTable(false, true);
+    depthTable_->addSRV(
+        depthBuffer,
+        rg::ShaderResourceType::NonPixelOnly,
+        D3D12_SHADER_RESOURCE_VIEW_DESC{
+            .Format                  = DXGI_FORMAT_R32_FLOAT,
+            .ViewDimension           = D3D12_SRV_DIMENSION_TEXTURE2D,
+            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+            .Texture2D               = D3D12_TEX2D_SRV{
+                .MostDetailedMip     = 0,
+                .MipLevels           = 1,
+                .PlaneSlice          = 0,
+                .ResourceMinLODClamp = 0
+            }
+        });
+
+    tilePass->setCallback(this, &LightTiles::doTilePass);
+
+    return tilePass;
+}
+
+rg::Resource *LightTiles::getTileRangeBuffer() const
+{
+    return tileRange_;
+}
+
+rg::Resource *LightTiles::getLightIndexBuffer() const
+{
+    return lightIndex_;
+}
+
+D3D12_SHADER_RESOURCE_VIEW_DESC LightTiles::getTileRangeSRV() const
+{
+    return D3D12_SHADER_RESOURCE_VIEW_DESC{
+        .Format                  = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension           = D3D12_SRV_DIMENSION_BUFFER,
+        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+        .Buffer                  = D3D12_BUFFER_SRV{
+            .FirstElement        = 0,
+            .NumElements         = static_cast<UINT>(getTileCount()),
+            .StructureByteStride = sizeof(clustering::ClusterRange),
+            .Flags               = D3D12_BUFFER_SRV_FLAG_NONE
+        }
+    };
+}
+
+D3D12_SHADER_RESOURCE_VIEW_DESC LightTiles::getLightIndexSRV() const
+{
+    return D3D12_SHADER_RESOURCE_VIEW_DESC{
+        .Format                  = DXGI_FORMAT_UNKNOWN,
+        .ViewDimension           = D3D12_SRV_DIMENSION_BUFFER,
+        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+        .Buffer                  = D3D12_BUFFER_SRV{
+            .FirstElement        = 0,
+            .NumElements         = static_cast<UINT>(
+                getTileCount() * MAX_LIGHTS_PER_TILE),
+            .StructureByteStride = sizeof(int32_t),
+            .Flags               = D3D12_BUFFER_SRV_FLAG_NONE
+        }
+    };
+}
+
+void LightTiles::setProj(const Mat4 &proj)
+{
+    proj_ = proj;
+}
+
+void LightTiles::setView(const Mat4 &view)
+{
+    view_ = view;
+}
+
+void LightTiles::setLights(const Buffer &lightBuffer, size_t lightCount)
+{
+    lightBuffer_ = &lightBuffer;
+    lightCount_  = lightCount;
+}
+
+void LightTiles::initRootSignature()
+{
+    CD3DX12_DESCRIPTOR_RANGE uavRange;
+    uavRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0, 0);
+
+    CD3DX12_DESCRIPTOR_RANGE depthRange;
+    depthRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1, 0);
+
+    CD3DX12_ROOT_PARAMETER params[4];
+    params[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
+    params[1].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_ALL);
+    params[2].InitAsDescriptorTable(1, &uavRange, D3D12_SHADER_VISIBILITY_ALL);
+    params[3].InitAsDescriptorTable(1, &depthRange, D3D12_SHADER_VISIBILITY_ALL);
+
+    RootSignatureBuilder builder;
+    for(auto &p : params)
+        builder.addParameter(p);
+
+    rootSignature_ = builder.build(d3d_.getDevice());
+}
+
+void LightTiles::initPipeline()
+{
+    const char       *shaderFilename = "./asset/clustered/tile.hlsl";
+    const std::string shaderSource   = agz::file::read_txt_file(shaderFilename);
+
+    FXC compiler;
+    compiler.setWarnings(true);
+
+    FXC::Options options = {
+        .includes   = D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        .sourceName = shaderFilename,
+        .entry      = "CSMain"
+    };
+
+    auto cs = compiler.compile(shaderSource, "cs_5_1", options);
+
+    D3D12_SHADER_BYTECODE csByteCode = {
+        .pShaderBytecode = cs->GetBufferPointer(),
+        .BytecodeLength  = cs->GetBufferSize()
+    };
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC desc;
+    desc.pRootSignature = rootSignature_.Get();
+    desc.CS             = csByteCode;
+    desc.NodeMask       = 0;
+    desc.CachedPSO      = {};
+    desc.Flags          = D3D12_PIPELINE_STATE_FLAG_NONE;
+
+    AGZ_D3D12_CHECK_HR(
+        d3d_.getDevice()->CreateComputePipelineState(
+            &desc, IID_PPV_ARGS(pipeline_.GetAddressOf())));
+}
+
+void LightTiles::initConstantBuffer()
+{
+    csParams_.initializeUpload(
+        d3d_.getResourceManager(), d3d_.getFramebufferCount());
+}
+
+int LightTiles::getTileCount() const
+{
+    return tileCountX_ * tileCountY_;
+}
+
+void LightTiles::doTilePass(rg::PassContext &ctx)
+{
+    ctx->SetComputeRootSignature(rootSignature_.Get());
+    ctx->SetPipelineState(pipeline_.Get());
+
+    csParams_.updateData(ctx.getFrameIndex(), CSParams{
+        .view        = view_,
+        .tileCountX  = tileCountX_,
+        .tileCountY  = tileCountY_,
+        .lightCount  = static_cast<int>(lightCount_),
+        .depthWidth  = depthWidth_,
+        .depthHeight = depthHeight_,
+        .depthScale  = proj_(2, 2),
+        .depthBias   = proj_(3, 2),
+        .projX       = proj_(0, 0),
+        .projY       = proj_(1, 1)
+    });
+    ctx->SetComputeRootConstantBufferView(
+        0, csParams_.getGPUVirtualAddress(ctx.getFrameIndex()));
+
+    ctx->SetComputeRootShaderResourceView(
+        1, lightBuffer_->getGPUVirtualAddress());
+
+    ctx->SetComputeRootDescriptorTable(
+        2, ctx.getDescriptorRange(uavTable_)[0]);
+    ctx->SetComputeRootDescriptorTable(
+        3, ctx.getDescriptorRange(depthTable_)[0]);
+
+    // one thread group per tile
+
+    ctx->Dispatch(tileCountX_, tileCountY_, 1);
+}
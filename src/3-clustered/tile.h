@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../clustering/light_tiles.h"
+#include "./common.h"
+
+// tiled forward (forward+) alternative to LightCluster. one thread group
+// per screen tile reduces the prepass depth of its pixels to a view z range
+// and culls every light against the tile pyramid cut to that range.
+// the lists use the ClusterRange layout of LightCluster with one range per
+// tile, indexed by xi * tileCountY + yi. clustering::CPULightTiles is the
+// cpu reference
+class LightTiles : public agz::misc::uncopyable_t
+{
+public:
+
+    static constexpr int MAX_LIGHTS_PER_TILE = clustering::MAX_LIGHTS_PER_TILE;
+
+    explicit LightTiles(D3D12Context &d3d);
+
+    // maximal tile size in pixels. the counts are derived from the depth
+    // buffer size by addToRenderGraph()
+    void setTileSize(int tileWidth, int tileHeight);
+
+    // counts of the last addToRenderGraph()
+    int getTileCountX() const;
+
+    int getTileCountY() const;
+
+    // depthBuffer (R32_TYPELESS) must be filled before this pass.
+    // compute queues can not transition a depth buffer out of DEPTH_WRITE,
+    // so use a graphics queue
+    rg::Pass *addToRenderGraph(
+        rg::Graph    &graph,
+        int           thread,
+        int           queue,
+        rg::Resource *depthBuffer);
+
+    rg::Resource *getTileRangeBuffer() const;
+
+    rg::Resource *getLightIndexBuffer() const;
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC getTileRangeSRV() const;
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC getLightIndexSRV() const;
+
+    void setProj(const Mat4 &proj);
+
+    void setView(const Mat4 &view);
+
+    void setLights(const Buffer &lightBuffer, size_t lightCount);
+
+private:
+
+    struct CSParams
+    {
+        Mat4 view;
+
+        int32_t tileCountX  = 0;
+        int32_t tileCountY  = 0;
+        int32_t lightCount  = 0;
+        int32_t depthWidth  = 0;
+
+        int32_t depthHeight = 0;
+        float   depthScale  = 0;
+        float   depthBias   = 0;
+        float   projX       = 0;
+
+        float   projY = 0;
+        int32_t pad0[3] = {};
+    };
+
+    void initRootSignature();
+
+    void initPipeline();
+
+    void initConstantBuffer();
+
+    int getTileCount() const;
+
+    void doTilePass(rg::PassContext &ctx);
+
+    D3D12Context &d3d_;
+
+    // 0. csParams        (b0)
+    // 1. lightBuffer     (t0)
+    // 2. uavTable:
+    //      0: tileRange  (u0)
+    //      1: lightIndex (u1)
+    // 3. depthTable:
+    //      0: depthBuffer(t1)
+    ComPtr<ID3D12RootSignature> rootSignature_;
+    ComPtr<ID3D12PipelineState> pipeline_;
+
+    int tileWidth_;
+    int tileHeight_;
+    int tileCountX_;
+    int tileCountY_;
+
+    rg::InternalResource *tileRange_;
+    rg::InternalResource *lightIndex_;
+
+    rg::DescriptorTable *uavTable_;
+    rg::DescriptorTable *depthTable_;
+
+    int depthWidth_;
+    int depthHeight_;
+
+    Mat4 proj_;
+    Mat4 view_;
+
+    const Buffer *lightBuffer_;
+    size_t        lightCount_;
+
+    ConstantBuffer<CSParams> csParams_;
+};
@@ -0,0 +1,105 @@
+#include "./zbin.h"
+
+LightZBinning::LightZBinning(D3D12Context &d3d)
+    : d3d_(d3d), zBinning_(threadPool_), nearZ_(0), farZ_(0), lightCount_(0)
+{
+    initFrameBuffers();
+}
+
+void LightZBinning::setBinCount(const Int3 &count)
+{
+    binCount_ = count;
+    zBinning_.setBinCount({ count.x, count.y, count.z });
+    initFrameBuffers();
+}
+
+void LightZBinning::setProj(float nearZ, float farZ, const Mat4 &proj)
+{
+    nearZ_ = nearZ;
+    farZ_  = farZ;
+    zBinning_.setProj(nearZ, farZ, toClusteringMat4(proj));
+}
+
+void LightZBinning::setView(const Mat4 &view)
+{
+    zBinning_.setView(toClusteringMat4(view));
+}
+
+bool LightZBinning::setLights(const Light *lights, size_t lightCount)
+{
+    static_assert(sizeof(Light) == sizeof(clustering::Light));
+
+    lightCount_ = (std::min)(
+        lightCount, static_cast<size_t>(clustering::MAX_ZBIN_LIGHTS));
+    const bool allBinned = zBinning_.setLights(
+        reinterpret_cast<const clustering::Light *>(lights), lightCount);
+    initFrameBuffers();
+    return allBinned;
+}
+
+void LightZBinning::update()
+{
+    zBinning_.run();
+
+    auto &buffers = frameBuffers_[d3d_.getFramebufferIndex()];
+
+    auto &zBins = zBinning_.getZBins();
+    buffers[0].updateData(0, zBins.size() * sizeof(uint32_t), zBins.data());
+
+    auto &tileMasks = zBinning_.getTileMasks();
+    buffers[1].updateData(
+        0, tileMasks.size() * sizeof(uint32_t), tileMasks.data());
+
+    auto &sortedLightIndices = zBinning_.getSortedLightIndices();
+    buffers[2].updateData(
+        0, sortedLightIndices.size() * sizeof(int32_t),
+        sortedLightIndices.data());
+}
+
+const Int3 &LightZBinning::getBinCount() const
+{
+    return binCount_;
+}
+
+int LightZBinning::getMaskWordCount() const
+{
+    return static_cast<int>((lightCount_ + 31) / 32);
+}
+
+float LightZBinning::getNearZ() const
+{
+    return nearZ_;
+}
+
+float LightZBinning::getFarZ() const
+{
+    return farZ_;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS LightZBinning::getBufferAddress(
+    int frameIndex, int buffer) const
+{
+    return frameBuffers_[frameIndex][buffer].getGPUVirtualAddress();
+}
+
+void LightZBinning::initFrameBuffers()
+{
+    // root srvs must point to valid memory even without lights
+
+    const size_t byteSizes[3] = {
+        (std::max)(binCount_.z, 1) * sizeof(uint32_t),
+        (std::max)(binCount_.x * binCount_.y * getMaskWordCount(), 1) *
+            sizeof(uint32_t),
+        (std::max)(lightCount_, size_t(1)) * sizeof(int32_t)
+    };
+
+    frameBuffers_.resize(d3d_.getFramebufferCount());
+    for(auto &buffers : frameBuffers_)
+    {
+        for(int i = 0; i < 3; ++i)
+        {
+            if(!buffers[i].getResource() || buffers[i].getByteSize() < byteSizes[i])
+                buffers[i].initializeUpload(d3d_.getResourceManager(), byteSizes[i]);
+        }
+    }
+}
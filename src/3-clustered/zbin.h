@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+
+#include "../clustering/zbin.h"
+#include "./common.h"
+
+// z-binning alternative to LightCluster. lights are sorted by view depth,
+// and bins of sorted light ranges plus per-tile light bitmasks are built on
+// the cpu with clustering::CPUZBinning every frame. the results are written
+// to per-frame upload buffers that ForwardRenderer reads directly
+class LightZBinning : public agz::misc::uncopyable_t
+{
+public:
+
+    explicit LightZBinning(D3D12Context &d3d);
+
+    // x, y: screen tiles, z: linear depth bins.
+    // reallocates the per-frame buffers, so the gpu must be idle
+    void setBinCount(const Int3 &count);
+
+    void setProj(float nearZ, float farZ, const Mat4 &proj);
+
+    void setView(const Mat4 &view);
+
+    // lights are read on the cpu and must outlive this object.
+    // reallocates the per-frame buffers, so the gpu must be idle.
+    // returns false if there are too many lights to bin them all
+    bool setLights(const Light *lights, size_t lightCount);
+
+    // build bins and tile masks of the current frame.
+    // call after D3D12Context::startFrame()
+    void update();
+
+    const Int3 &getBinCount() const;
+
+    int getMaskWordCount() const;
+
+    float getNearZ() const;
+
+    float getFarZ() const;
+
+    // 0: zBins, 1: tileMasks, 2: sortedLightIndices
+    D3D12_GPU_VIRTUAL_ADDRESS getBufferAddress(int frameIndex, int buffer) const;
+
+private:
+
+    void initFrameBuffers();
+
+    D3D12Context &d3d_;
+
+    clustering::ThreadPool  threadPool_;
+    clustering::CPUZBinning zBinning_;
+
+    Int3  binCount_;
+    float nearZ_;
+    float farZ_;
+
+    size_t lightCount_;
+
+    // frameBuffers_[frameIndex][buffer]
+    std::vector<std::array<Buffer, 3>> frameBuffers_;
+};
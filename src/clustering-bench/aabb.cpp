@@ -0,0 +1,102 @@
+#include "../clustering/cluster_aabb.h"
+#include "./bench.h"
+
+void benchAABB(ThreadPool &threadPool)
+{
+    const Int3 GRIDS[] = {
+        { 20, 15, 32 },
+        { 32, 18, 48 },
+        { 64, 36, 64 },
+    };
+
+    // the default slicing of the clustered sample
+    const SlicingPolicy SLICING = {
+        .mode       = SlicingMode::Logarithmic,
+        .nearSliceZ = 0
+    };
+
+    SceneCamera camera;
+
+    std::printf(
+        "%12s %10s %12s %12s %8s %12s %8s\n",
+        "grid", "clusters", "scalar ms", "builder ms", "speedup",
+        "cached ms", "matches");
+
+    for(auto &grid : GRIDS)
+    {
+        const ClusterAABBKey key = {
+            .clusterCount = grid,
+            .nearZ        = camera.nearZ,
+            .farZ         = camera.farZ,
+            .proj         = camera.getProj(),
+            .slicing      = SLICING
+        };
+
+        ClusterAABBBuilder builder(threadPool);
+
+        const double scalarMS = measureMS([&]
+        {
+            buildClusterAABBs(grid, key.nearZ, key.farZ, key.proj, key.slicing);
+        });
+
+        const double builderMS = measureMS([&]
+        {
+            builder.clearCache();
+            builder.build(key);
+        });
+
+        const double cachedMS = measureMS([&] { builder.build(key); });
+
+        const std::vector<AABB> reference =
+            buildClusterAABBs(grid, key.nearZ, key.farZ, key.proj, key.slicing);
+        const std::vector<AABB> &result = builder.build(key);
+
+        const bool matches = std::equal(
+            reference.begin(), reference.end(), result.begin(), result.end(),
+            [](const AABB &a, const AABB &b)
+        {
+            return a.lower.x == b.lower.x && a.lower.y == b.lower.y &&
+                   a.lower.z == b.lower.z && a.upper.x == b.upper.x &&
+                   a.upper.y == b.upper.y && a.upper.z == b.upper.z;
+        });
+
+        char gridName[32];
+        std::snprintf(
+            gridName, sizeof(gridName), "%dx%dx%d", grid.x, grid.y, grid.z);
+
+        std::printf(
+            "%12s %10d %12.3f %12.3f %8.2f %12.5f %8s\n",
+            gridName, grid.product(), scalarMS, builderMS,
+            scalarMS / builderMS, cachedMS, matches ? "yes" : "NO");
+    }
+
+    // window resized back and forth between two aspect ratios
+
+    const Int3 grid = { 64, 36, 64 };
+    const float ASPECTS[] = { 16.0f / 9, 4.0f / 3, 16.0f / 9, 4.0f / 3 };
+
+    ClusterAABBBuilder builder(threadPool);
+
+    std::printf("\n%8s %12s %8s\n", "aspect", "ms", "cached");
+    for(float aspect : ASPECTS)
+    {
+        camera.wOverH = aspect;
+        const ClusterAABBKey key = {
+            .clusterCount = grid,
+            .nearZ        = camera.nearZ,
+            .farZ         = camera.farZ,
+            .proj         = camera.getProj(),
+            .slicing      = SLICING
+        };
+
+        const int64_t hits = builder.getCacheHitCount();
+
+        Timer timer;
+        builder.build(key);
+        const double ms = timer.ms();
+
+        std::printf(
+            "%8.3f %12.3f %8s\n", aspect, ms,
+            builder.getCacheHitCount() > hits ? "yes" : "no");
+    }
+}
@@ -0,0 +1,97 @@
+#include "../clustering/active_cluster.h"
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchActive(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 8;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096 };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    // speedup is for the light assignment only. on the gpu the flagging
+    // pass is one depth read per pixel, the cpu reference pays a log per
+    // pixel and is reported separately
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    std::printf(
+        "%8s %14s %8s %8s %10s %10s %10s %10s %8s\n",
+        "lights", "mode", "active", "ratio", "find ms",
+        "all ms", "active ms", "speedup", "matches");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        for(AssignMode mode : { AssignMode::Flat, AssignMode::Hierarchical })
+        {
+            double findMS = 0, allMS = 0, activeMS = 0;
+            size_t activeCount = 0;
+            bool matches = true;
+
+            CPULightCluster all(threadPool);
+            CPULightCluster active(threadPool);
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const SceneCamera &camera = cameras[frame];
+                const float *depth = depthImages[frame].data();
+
+                std::vector<int32_t> activeClusters;
+                findMS += measureMS([&]
+                {
+                    activeClusters = findActiveClusters(
+                        threadPool, depth, WIDTH, HEIGHT, CLUSTER_COUNT,
+                        camera.nearZ, camera.farZ, camera.getProj());
+                }, 20);
+                activeCount += activeClusters.size();
+
+                for(CPULightCluster *cluster : { &all, &active })
+                {
+                    cluster->setClusterCount(CLUSTER_COUNT);
+                    cluster->setProj(
+                        camera.nearZ, camera.farZ, camera.getProj());
+                    cluster->updateClusterAABBs();
+                    cluster->setView(camera.getView());
+                    cluster->setLights(lights.data(), lights.size());
+                    cluster->setAssignMode(mode);
+                }
+                active.setActiveClusters(&activeClusters);
+
+                allMS    += measureMS([&] { all.run(); }, 20);
+                activeMS += measureMS([&] { active.run(); }, 20);
+
+                // active clusters get the full lists, others stay empty
+
+                std::vector<ClusterRange> expectedRanges(
+                    CLUSTER_COUNT.product());
+                for(int ci : activeClusters)
+                    expectedRanges[ci] = all.getClusterRanges()[ci];
+
+                matches &= findClusterMismatch(
+                    CLUSTER_COUNT.product(),
+                    expectedRanges, all.getLightIndices(),
+                    active.getClusterRanges(), active.getLightIndices()) < 0;
+            }
+
+            const double avgActive =
+                static_cast<double>(activeCount) / FRAME_COUNT;
+
+            std::printf(
+                "%8zu %14s %8.0f %8.3f %10.3f %10.3f %10.3f %10.2f %8s\n",
+                lightCount,
+                mode == AssignMode::Flat ? "flat" : "hierarchical",
+                avgActive, avgActive / CLUSTER_COUNT.product(),
+                findMS / FRAME_COUNT, allMS / FRAME_COUNT,
+                activeMS / FRAME_COUNT, allMS / activeMS,
+                matches ? "yes" : "NO");
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchAssign(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    SceneCamera camera;
+
+    ThreadPool singleThread(1);
+
+    std::printf(
+        "%8s %8s %12s %12s %14s %12s\n",
+        "lights", "threads", "ms/frame", "Mtests/s", "assignments", "speedup");
+
+    for(size_t lightCount : { 1024, 4096, 16384, 65536 })
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        std::vector<ThreadPool *> pools = { &singleThread };
+        if(threadPool.getThreadCount() > 1)
+            pools.push_back(&threadPool);
+
+        double singleMS = 0;
+        for(ThreadPool *pool : pools)
+        {
+            CPULightCluster cluster(*pool);
+            cluster.setClusterCount(CLUSTER_COUNT);
+            cluster.setProj(camera.nearZ, camera.farZ, camera.getProj());
+            cluster.updateClusterAABBs();
+            cluster.setView(camera.getView());
+            cluster.setLights(lights.data(), lights.size());
+
+            const double ms = measureMS([&] { cluster.run(); });
+            if(pool == &singleThread)
+                singleMS = ms;
+
+            const double tests =
+                static_cast<double>(CLUSTER_COUNT.product()) * lightCount;
+
+            std::printf(
+                "%8zu %8d %12.3f %12.1f %14zu %12.2f\n",
+                lightCount, pool->getThreadCount(), ms,
+                tests / ms / 1e3, cluster.getLightIndices().size(),
+                singleMS / ms);
+        }
+    }
+}
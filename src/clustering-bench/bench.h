@@ -0,0 +1,140 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "../clustering/common.h"
+#include "../clustering/thread_pool.h"
+
+using namespace clustering;
+
+// scene of the clustered sample: eglise mesh scaled by 0.3, camera at
+// (0, -4, 0) and random point lights inside the church
+
+struct SceneCamera
+{
+    float nearZ  = 0.1f;
+    float farZ   = 100.0f;
+    float fovDeg = 60;
+    float wOverH = 800.0f / 600.0f;
+
+    Float3 position = { 0, -4, 0 };
+    float  horiRad  = 0;
+    float  vertRad  = 0;
+
+    Mat4 getView() const;
+
+    Mat4 getProj() const;
+};
+
+// the first light is the big fill light of the sample, others have
+// maxLightDistance = radius
+std::vector<Light> generateSceneLights(
+    size_t count, uint32_t seed = 1, float radius = 2.5f);
+
+// camera flying around the church, one pose per frame
+std::vector<SceneCamera> generateCameraPath(int frameCount);
+
+// depth buffer of a stand-in for the eglise mesh (nave walls, floor and
+// ceiling with two rows of pillars, pews and an altar), ray cast at pixel
+// centers.
+// row 0 is the top of the screen, 1 means nothing was hit
+std::vector<float> renderSceneDepth(
+    const SceneCamera &camera, int width, int height);
+
+class Timer
+{
+public:
+
+    Timer()
+        : start_(std::chrono::steady_clock::now())
+    {
+
+    }
+
+    double ms() const
+    {
+        const auto d = std::chrono::steady_clock::now() - start_;
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+
+private:
+
+    std::chrono::steady_clock::time_point start_;
+};
+
+// run func repeatedly for at least minMS and at least minIterations,
+// returns average milliseconds per call
+template<typename F>
+double measureMS(F &&func, double minMS = 200, int minIterations = 3)
+{
+    func();
+
+    int iterations = 0;
+    Timer timer;
+    while(iterations < minIterations || timer.ms() < minMS)
+    {
+        func();
+        ++iterations;
+    }
+    return timer.ms() / iterations;
+}
+
+// benchmarks
+
+void benchAssign(ThreadPool &threadPool);
+
+void benchSIMD(ThreadPool &threadPool);
+
+void benchHierarchical(ThreadPool &threadPool);
+
+void benchBVH(ThreadPool &threadPool);
+
+void benchCompact(ThreadPool &threadPool);
+
+void benchStats(ThreadPool &threadPool);
+
+void benchAABB(ThreadPool &threadPool);
+
+void benchActive(ThreadPool &threadPool);
+
+void benchZBin(ThreadPool &threadPool);
+
+void benchSlicing(ThreadPool &threadPool);
+
+void benchTemporal(ThreadPool &threadPool);
+
+void benchMorton(ThreadPool &threadPool);
+
+void benchEncoding(ThreadPool &threadPool);
+
+void benchTune(ThreadPool &threadPool);
+
+// file benchTune saves the recommended grid to, set by --save-grid.
+// nothing is saved by default
+void setTunedGridFilename(const char *filename);
+
+void benchDynamic(ThreadPool &threadPool);
+
+void benchFrustum(ThreadPool &threadPool);
+
+void benchOccupancy(ThreadPool &threadPool);
+
+// prepended to the files benchOccupancy saves, set by --save-occupancy.
+// nothing is saved by default
+void setOccupancyFilePrefix(const char *prefix);
+
+void benchGlobal(ThreadPool &threadPool);
+
+void benchLayout(ThreadPool &threadPool);
+
+void benchItems(ThreadPool &threadPool);
+
+void benchTiled(ThreadPool &threadPool);
+
+void benchScatter(ThreadPool &threadPool);
+
+void benchStatic(ThreadPool &threadPool);
+
+void benchObjects(ThreadPool &threadPool);
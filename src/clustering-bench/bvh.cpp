@@ -0,0 +1,71 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchBVH(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    SceneCamera camera;
+
+    std::printf(
+        "%8s %8s %10s %10s %10s %10s %10s %10s\n",
+        "lights", "radius", "build ms", "refit ms",
+        "flat ms", "bvh ms", "speedup", "matches");
+
+    for(size_t lightCount : { 1000, 10000, 100000 })
+    {
+        // keep the average number of lights per cluster roughly constant
+
+        const float radius =
+            2.5f * std::cbrt(1024.0f / static_cast<float>(lightCount));
+        auto lights = generateSceneLights(lightCount, 1, radius);
+
+        LightBVH bvh;
+        const double buildMS = measureMS(
+            [&] { bvh.build(lights.data(), lights.size()); });
+        const double refitMS = measureMS(
+            [&] { bvh.refit(lights.data(), lights.size()); });
+
+        CPULightCluster flat(threadPool);
+        CPULightCluster tree(threadPool);
+        tree.setAssignMode(AssignMode::BVH);
+
+        for(CPULightCluster *cluster : { &flat, &tree })
+        {
+            cluster->setClusterCount(CLUSTER_COUNT);
+            cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+            cluster->updateClusterAABBs();
+            cluster->setView(camera.getView());
+            cluster->setLights(lights.data(), lights.size());
+        }
+
+        const double flatMS = measureMS([&] { flat.run(); });
+        const double treeMS = measureMS([&] { tree.run(); });
+
+        // move the lights and check that the refitted tree is still exact
+
+        std::default_random_engine rng(2);
+        std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+        for(auto &light : lights)
+        {
+            light.lightPosition += Float3(
+                offset(rng), offset(rng), offset(rng));
+        }
+
+        bool matches =
+            flat.getClusterRanges() == tree.getClusterRanges() &&
+            flat.getLightIndices()  == tree.getLightIndices();
+
+        flat.run();
+        tree.run();
+
+        matches &=
+            flat.getClusterRanges() == tree.getClusterRanges() &&
+            flat.getLightIndices()  == tree.getLightIndices();
+
+        std::printf(
+            "%8zu %8.3f %10.3f %10.3f %10.3f %10.3f %10.2f %10s\n",
+            lightCount, radius, buildMS, refitMS, flatMS, treeMS,
+            flatMS / treeMS, matches ? "yes" : "NO");
+    }
+}
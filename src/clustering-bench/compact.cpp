@@ -0,0 +1,77 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchCompact(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    SceneCamera camera;
+
+    struct Case
+    {
+        const char *name;
+        size_t      lightCount;
+        float       radius;
+    };
+
+    const Case CASES[] = {
+        { "sparse", 256,   1.0f },
+        { "sample", 1024,  2.5f },
+        { "dense",  16384, 2.5f },
+    };
+
+    std::printf(
+        "%8s %8s %12s %12s %12s %8s %10s %10s %10s %10s\n",
+        "scene", "lights", "pairs", "fixed KB", "exact KB", "ratio",
+        "clipped", "fixed ms", "exact ms", "prefixes");
+
+    for(auto &c : CASES)
+    {
+        const auto lights = generateSceneLights(c.lightCount, 1, c.radius);
+
+        CPULightCluster fixed(threadPool);
+        CPULightCluster exact(threadPool);
+        exact.setIndexCapacity(IndexCapacity::Exact);
+
+        for(CPULightCluster *cluster : { &fixed, &exact })
+        {
+            cluster->setClusterCount(CLUSTER_COUNT);
+            cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+            cluster->updateClusterAABBs();
+            cluster->setView(camera.getView());
+            cluster->setLights(lights.data(), lights.size());
+        }
+
+        const double fixedMS = measureMS([&] { fixed.run(); });
+        const double exactMS = measureMS([&] { exact.run(); });
+
+        // each fixed list must be a prefix of the exact one
+
+        bool prefixes = true;
+        for(int ci = 0; ci < CLUSTER_COUNT.product(); ++ci)
+        {
+            const ClusterRange &f = fixed.getClusterRanges()[ci];
+            const ClusterRange &e = exact.getClusterRanges()[ci];
+            for(int i = 0; i < f.rangeEnd - f.rangeBeg; ++i)
+            {
+                prefixes &= i < e.rangeEnd - e.rangeBeg &&
+                    fixed.getLightIndices()[f.rangeBeg + i] ==
+                    exact.getLightIndices()[e.rangeBeg + i];
+            }
+        }
+
+        const double fixedKB = fixed.getLightIndexCount() * sizeof(int32_t) / 1024.0;
+        const double exactKB = exact.getLightIndexCount() * sizeof(int32_t) / 1024.0;
+        const int64_t clipped =
+            exact.getAssignmentCount() -
+            static_cast<int64_t>(fixed.getLightIndices().size());
+
+        std::printf(
+            "%8s %8zu %12lld %12.1f %12.1f %8.3f %10lld %10.3f %10.3f %10s\n",
+            c.name, c.lightCount,
+            static_cast<long long>(exact.getAssignmentCount()),
+            fixedKB, exactKB, exactKB / fixedKB,
+            static_cast<long long>(clipped), fixedMS, exactMS,
+            prefixes ? "yes" : "NO");
+    }
+}
@@ -0,0 +1,129 @@
+#include <cstring>
+
+#include "../clustering/light_store.h"
+#include "./bench.h"
+
+void benchDynamic(ThreadPool &threadPool)
+{
+    // the clustered sample has two frames in flight
+    const int FRAMES_IN_FLIGHT = 2;
+    const int FRAME_COUNT      = 64;
+
+    const size_t LIGHT_COUNTS[] = { 4096, 65536 };
+
+    // animated lights are either stored together at the front of the
+    // array, or scattered over it, which dirties every block
+
+    struct Scenario
+    {
+        const char *name;
+        int         movingLightDivisor;
+        bool        scattered;
+    };
+
+    const Scenario SCENARIOS[] = {
+        { "static",         0,  false },
+        { "1/16 grouped",   16, false },
+        { "1/4 grouped",    4,  false },
+        { "1/64 scattered", 64, true  },
+        { "all moving",     1,  false },
+    };
+
+    // full is converting and copying every light to the staging copy of
+    // the frame each frame. dirty converts the changed blocks into a cpu
+    // mirror and copies those ranges into the staging copy
+
+    std::printf(
+        "%8s %14s %10s %10s %8s %10s %10s %8s\n",
+        "lights", "scenario", "full ms", "dirty ms", "speedup",
+        "full KB", "dirty KB", "matches");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto initialLights = generateSceneLights(lightCount);
+
+        for(auto &s : SCENARIOS)
+        {
+            // consumer 0 is the mirror, 1 + i the staging copy of frame i
+            LightStore store(1 + FRAMES_IN_FLIGHT);
+            store.resize(lightCount);
+            for(size_t i = 0; i < lightCount; ++i)
+                store.setLight(i, initialLights[i]);
+
+            std::vector<Light> mirror(lightCount);
+            std::vector<std::vector<Light>> fullStaging(
+                FRAMES_IN_FLIGHT, std::vector<Light>(lightCount));
+            std::vector<std::vector<Light>> dirtyStaging(
+                FRAMES_IN_FLIGHT, std::vector<Light>(lightCount));
+
+            std::vector<LightRange> ranges;
+            std::vector<LightRange> allLights = {
+                { 0, static_cast<int32_t>(lightCount) }
+            };
+
+            double fullMS = 0, dirtyMS = 0;
+            size_t fullBytes = 0, dirtyBytes = 0;
+            bool matches = true;
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const int slot = frame % FRAMES_IN_FLIGHT;
+
+                if(s.movingLightDivisor)
+                {
+                    const size_t movingCount = lightCount / s.movingLightDivisor;
+                    const size_t stride = s.scattered ? s.movingLightDivisor : 1;
+
+                    float *y = store.getPositionY();
+                    for(size_t k = 0; k < movingCount; ++k)
+                    {
+                        const size_t i = k * stride;
+                        y[i] = initialLights[i].lightPosition.y +
+                               std::sin(0.1f * frame + static_cast<float>(i));
+                    }
+
+                    if(s.scattered)
+                    {
+                        for(size_t k = 0; k < movingCount; ++k)
+                            store.markDirty(k * stride, k * stride + 1);
+                    }
+                    else
+                        store.markDirty(0, movingCount);
+                }
+
+                Timer fullTimer;
+                store.writeLights(threadPool, allLights, fullStaging[slot].data());
+                fullMS    += fullTimer.ms();
+                fullBytes += lightCount * sizeof(Light);
+
+                Timer dirtyTimer;
+                store.takeDirtyRanges(0, ranges);
+                store.writeLights(threadPool, ranges, mirror.data());
+
+                store.takeDirtyRanges(1 + slot, ranges);
+                for(auto &range : ranges)
+                {
+                    const size_t bytes = (range.end - range.beg) * sizeof(Light);
+                    std::memcpy(
+                        dirtyStaging[slot].data() + range.beg,
+                        mirror.data() + range.beg, bytes);
+                    dirtyBytes += bytes;
+                }
+                dirtyMS += dirtyTimer.ms();
+
+                matches &= std::memcmp(
+                    fullStaging[slot].data(), dirtyStaging[slot].data(),
+                    lightCount * sizeof(Light)) == 0;
+            }
+
+            std::printf(
+                "%8zu %14s %10.4f %10.4f %8.2f %10.1f %10.1f %8s\n",
+                lightCount, s.name,
+                fullMS / FRAME_COUNT, dirtyMS / FRAME_COUNT,
+                fullMS / dirtyMS,
+                fullBytes / 1024.0 / FRAME_COUNT,
+                dirtyBytes / 1024.0 / FRAME_COUNT,
+                matches ? "yes" : "NO");
+        }
+    }
+}
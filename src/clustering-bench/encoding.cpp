@@ -0,0 +1,162 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchEncoding(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 4;
+
+    // the last count does not fit in uint16 and falls back to 32-bit
+    const size_t LIGHT_COUNTS[] = { 1024, 4096, 16384, 70000 };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // KB is the size of both buffers, B/px the cluster buffer bytes read by
+    // an average pixel and ms the gather loop over all pixels, which sums
+    // light indices instead of shading
+
+    std::printf(
+        "%8s %8s %10s %10s %8s %8s %10s %10s %8s\n",
+        "lights", "compact", "32-bit KB", "packed KB", "32 B/px",
+        "16 B/px", "32-bit ms", "packed ms", "matches");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const float radius = 2.5f * std::cbrt(1024.0f / lightCount);
+        const auto lights = generateSceneLights(lightCount, 1, radius);
+
+        CPULightCluster cluster(threadPool);
+        cluster.setClusterCount(CLUSTER_COUNT);
+        cluster.setCompactEncodingEnabled(true);
+
+        double fullKB = 0, compactKB = 0, fullMS = 0, compactMS = 0;
+        int64_t fullBytes = 0, compactBytes = 0, pixelCount = 0;
+        bool compact = true, matches = true;
+
+        for(int frame = 0; frame < FRAME_COUNT; ++frame)
+        {
+            const SceneCamera &camera = cameras[frame];
+            const Mat4 proj = camera.getProj();
+
+            cluster.setProj(camera.nearZ, camera.farZ, proj);
+            cluster.updateClusterAABBs();
+            cluster.setView(camera.getView());
+            cluster.setLights(lights.data(), lights.size());
+            cluster.run();
+
+            const auto &ranges  = cluster.getClusterRanges();
+            const auto &indices = cluster.getLightIndices();
+
+            const auto &compactRanges  = cluster.getCompactClusterRanges();
+            const auto &compactIndices = cluster.getCompactLightIndices();
+
+            fullKB += (ranges.size() * sizeof(ClusterRange) +
+                       indices.size() * sizeof(int32_t)) / 1024.0;
+
+            compact &= cluster.isCompactEncoded();
+            if(!cluster.isCompactEncoded())
+                continue;
+
+            compactKB += (compactRanges.size() * sizeof(uint32_t) +
+                          compactIndices.size() * sizeof(uint16_t)) / 1024.0;
+
+            for(size_t ci = 0; ci < ranges.size(); ++ci)
+            {
+                const int offset = getCompactRangeOffset(compactRanges[ci]);
+                const int count  = getCompactRangeCount(compactRanges[ci]);
+
+                matches &= count == ranges[ci].rangeEnd - ranges[ci].rangeBeg;
+                for(int i = 0; matches && i < count; ++i)
+                {
+                    matches &= compactIndices[offset + i] ==
+                               indices[ranges[ci].rangeBeg + i];
+                }
+            }
+
+            // cluster index of each pixel, -1 for none
+
+            const ClusterSlicing slicing = getClusterSlicing(
+                CLUSTER_COUNT.z, camera.nearZ, camera.farZ);
+
+            std::vector<int32_t> pixelClusters;
+            const float *depth = depthImages[frame].data();
+            for(int py = 0; py < HEIGHT; ++py)
+            {
+                const int yi = static_cast<int>(
+                    (1 - (py + 0.5f) / HEIGHT) * CLUSTER_COUNT.y);
+                for(int px = 0; px < WIDTH; ++px)
+                {
+                    const float d = depth[static_cast<size_t>(py) * WIDTH + px];
+                    if(d >= 1)
+                        continue;
+
+                    const int xi = static_cast<int>((px + 0.5f) / WIDTH * CLUSTER_COUNT.x);
+                    const int zi = viewZ2i(slicing, proj.m[3][2] / (d - proj.m[2][2]));
+                    if(0 <= zi && zi < CLUSTER_COUNT.z)
+                        pixelClusters.push_back(getClusterIndex(CLUSTER_COUNT, xi, yi, zi));
+                }
+            }
+
+            int64_t fullSum = 0, compactSum = 0;
+
+            fullMS += measureMS([&]
+            {
+                int64_t sum = 0;
+                for(int32_t ci : pixelClusters)
+                {
+                    const ClusterRange range = ranges[ci];
+                    for(int i = range.rangeBeg; i < range.rangeEnd; ++i)
+                        sum += indices[i];
+                }
+                fullSum = sum;
+            }, 100);
+
+            compactMS += measureMS([&]
+            {
+                int64_t sum = 0;
+                for(int32_t ci : pixelClusters)
+                {
+                    const uint32_t range  = compactRanges[ci];
+                    const int      offset = getCompactRangeOffset(range);
+                    const int      end    = offset + getCompactRangeCount(range);
+                    for(int i = offset; i < end; ++i)
+                        sum += compactIndices[i];
+                }
+                compactSum = sum;
+            }, 100);
+
+            matches &= fullSum == compactSum;
+
+            for(int32_t ci : pixelClusters)
+            {
+                const int count = ranges[ci].rangeEnd - ranges[ci].rangeBeg;
+                fullBytes    += sizeof(ClusterRange) + count * sizeof(int32_t);
+                compactBytes += sizeof(uint32_t) + count * sizeof(uint16_t);
+            }
+            pixelCount += pixelClusters.size();
+        }
+
+        if(!compact)
+        {
+            std::printf(
+                "%8zu %8s %10.1f %10s %8s %8s %10s %10s %8s\n",
+                lightCount, "no", fullKB / FRAME_COUNT,
+                "-", "-", "-", "-", "-", "-");
+            continue;
+        }
+
+        std::printf(
+            "%8zu %8s %10.1f %10.1f %8.1f %8.1f %10.3f %10.3f %8s\n",
+            lightCount, "yes", fullKB / FRAME_COUNT, compactKB / FRAME_COUNT,
+            static_cast<double>(fullBytes) / pixelCount,
+            static_cast<double>(compactBytes) / pixelCount,
+            fullMS / FRAME_COUNT, compactMS / FRAME_COUNT,
+            matches ? "yes" : "NO");
+    }
+}
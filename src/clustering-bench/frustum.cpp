@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchFrustum(ThreadPool &threadPool)
+{
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 4;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096 };
+
+    // the default grid of the sample and the one recommended by the tuner
+    const Int3 CLUSTER_COUNTS[] = { { 20, 15, 32 }, { 10, 8, 24 } };
+
+    struct Test
+    {
+        const char *name;
+        ClusterTest test;
+    };
+
+    const Test TESTS[] = {
+        { "aabb",    ClusterTest::AABB    },
+        { "frustum", ClusterTest::Frustum },
+    };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // pairs are light-cluster assignments per frame. false positives are
+    // the pairs whose sphere does not touch the exact cluster frustum.
+    // px lights is the mean list length seen by visible pixels, i.e. the
+    // lights the shading loop evaluates. the exact row is the lower bound
+    // of both. conservative checks that no exact pair was rejected
+
+    std::printf(
+        "%8s %10s %8s %10s %10s %8s %10s %8s %8s\n",
+        "lights", "grid", "test", "ms", "pairs", "false +", "px lights",
+        "saved", "conserv");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        for(const Int3 &CLUSTER_COUNT : CLUSTER_COUNTS)
+        {
+            double  ms[2]            = {};
+            int64_t pairs[2]         = {};
+            int64_t pixelLights[2]   = {};
+            int64_t exactPairs       = 0;
+            int64_t exactPixelLights = 0;
+            int64_t pixelCount       = 0;
+            bool    conservative     = true;
+
+            CPULightCluster clusters[2] = {
+                CPULightCluster(threadPool), CPULightCluster(threadPool)
+            };
+
+            std::vector<uint8_t> inFrustum(lightCount);
+            std::vector<int32_t> exactCounts(CLUSTER_COUNT.product());
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const SceneCamera &camera = cameras[frame];
+                const Mat4 view = camera.getView();
+                const Mat4 proj = camera.getProj();
+
+                for(int t = 0; t < 2; ++t)
+                {
+                    CPULightCluster &cluster = clusters[t];
+                    cluster.setIndexCapacity(IndexCapacity::Exact);
+                    cluster.setClusterTest(TESTS[t].test);
+                    cluster.setClusterCount(CLUSTER_COUNT);
+                    cluster.setProj(camera.nearZ, camera.farZ, proj);
+                    cluster.updateClusterAABBs();
+                    cluster.setView(view);
+                    cluster.setLights(lights.data(), lights.size());
+
+                    ms[t]    += measureMS([&] { cluster.run(); }, 100);
+                    pairs[t] += cluster.getLightIndices().size();
+                }
+
+                // exact pairs are a subset of the aabb pairs, so only those
+                // are tested against the reference
+
+                const CPULightCluster &aabb    = clusters[0];
+                const CPULightCluster &frustum = clusters[1];
+
+                const ClusterSlicing slicing = getClusterSlicing(
+                    CLUSTER_COUNT.z, camera.nearZ, camera.farZ);
+
+                std::vector<Float3> viewLights(lights.size());
+                for(size_t i = 0; i < lights.size(); ++i)
+                    viewLights[i] = view.transformPoint(lights[i].lightPosition);
+
+                for(int ci = 0; ci < CLUSTER_COUNT.product(); ++ci)
+                {
+                    const int zi = ci % CLUSTER_COUNT.z;
+                    const ClusterTilePlanes &planes =
+                        frustum.getClusterTilePlanes()[ci / CLUSTER_COUNT.z];
+
+                    const ClusterRange &fr = frustum.getClusterRanges()[ci];
+                    for(int i = fr.rangeBeg; i < fr.rangeEnd; ++i)
+                        inFrustum[frustum.getLightIndices()[i]] = 1;
+
+                    int exactCount = 0;
+                    const ClusterRange &ar = aabb.getClusterRanges()[ci];
+                    for(int i = ar.rangeBeg; i < ar.rangeEnd; ++i)
+                    {
+                        const int li = aabb.getLightIndices()[i];
+                        if(isLightInClusterExact(
+                            viewLights[li], lights[li].maxLightDistance, planes,
+                            clusterI2Z(slicing, zi), clusterI2Z(slicing, zi + 1)))
+                        {
+                            conservative &= inFrustum[li] != 0;
+                            ++exactCount;
+                        }
+                    }
+
+                    for(int i = fr.rangeBeg; i < fr.rangeEnd; ++i)
+                        inFrustum[frustum.getLightIndices()[i]] = 0;
+
+                    exactCounts[ci] = exactCount;
+                    exactPairs += exactCount;
+                }
+
+                const float *depth = depthImages[frame].data();
+                for(int py = 0; py < HEIGHT; ++py)
+                {
+                    const float scrY = 1 - (py + 0.5f) / HEIGHT;
+                    const int yi = static_cast<int>(scrY * CLUSTER_COUNT.y);
+
+                    for(int px = 0; px < WIDTH; ++px)
+                    {
+                        const float d = depth[static_cast<size_t>(py) * WIDTH + px];
+                        if(d >= 1)
+                            continue;
+
+                        const float scrX = (px + 0.5f) / WIDTH;
+                        const int xi = static_cast<int>(scrX * CLUSTER_COUNT.x);
+                        const int zi = viewZ2i(
+                            slicing, proj.m[3][2] / (d - proj.m[2][2]));
+                        if(zi < 0 || zi >= CLUSTER_COUNT.z)
+                            continue;
+
+                        const int ci = getClusterIndex(CLUSTER_COUNT, xi, yi, zi);
+                        for(int t = 0; t < 2; ++t)
+                        {
+                            const ClusterRange &range =
+                                clusters[t].getClusterRanges()[ci];
+                            pixelLights[t] += range.rangeEnd - range.rangeBeg;
+                        }
+                        exactPixelLights += exactCounts[ci];
+                        ++pixelCount;
+                    }
+                }
+            }
+
+            char grid[32];
+            std::snprintf(
+                grid, sizeof(grid), "%dx%dx%d",
+                CLUSTER_COUNT.x, CLUSTER_COUNT.y, CLUSTER_COUNT.z);
+
+            auto saved = [&](int64_t lights)
+            {
+                return 100.0 * (1 - static_cast<double>(lights) / pixelLights[0]);
+            };
+
+            for(int t = 0; t < 2; ++t)
+            {
+                std::printf(
+                    "%8zu %10s %8s %10.3f %10.0f %7.1f%% %10.2f %7.1f%% %8s\n",
+                    lightCount, grid, TESTS[t].name,
+                    ms[t] / FRAME_COUNT,
+                    static_cast<double>(pairs[t]) / FRAME_COUNT,
+                    100.0 * (pairs[t] - exactPairs) / (std::max)(pairs[t], int64_t(1)),
+                    static_cast<double>(pixelLights[t]) / pixelCount,
+                    saved(pixelLights[t]),
+                    t == 0 ? "-" : (conservative ? "yes" : "NO"));
+            }
+
+            std::printf(
+                "%8zu %10s %8s %10s %10.0f %7.1f%% %10.2f %7.1f%% %8s\n",
+                lightCount, grid, "exact", "-",
+                static_cast<double>(exactPairs) / FRAME_COUNT, 0.0,
+                static_cast<double>(exactPixelLights) / pixelCount,
+                saved(exactPixelLights), "-");
+        }
+    }
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchGlobal(ThreadPool &threadPool)
+{
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 4;
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    const size_t LIGHT_COUNTS[] = { 256, 1024, 4096 };
+
+    // the fill light of the sample alone, and with three more large lights
+    // standing in for sun-like or fill lights of other scenes
+    auto makeLight = [](const Float3 &position, float maxLightDistance)
+    {
+        return Light{
+            .lightPosition    = position,
+            .maxLightDistance = maxLightDistance,
+            .lightIntensity   = { 1, 1, 1 },
+            .pad0             = 0,
+            .lightAmbient     = { 0, 0, 0 },
+            .pad1             = 0
+        };
+    };
+    const Light EXTRA_LIGHTS[] = {
+        makeLight({ -12, -2,  4 }, 25),
+        makeLight({   6, -6, -3 }, 20),
+        makeLight({  -4,  2,  0 }, 30),
+    };
+    const int EXTRA_COUNTS[] = { 0, 3 };
+
+    // 1 disables the global list
+    const float COVERAGES[] = { 1, 0.75f, 0.5f, 0.25f };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // global is the mean size of the global list, index KB the mean size
+    // of the exact light index buffer. px lights is the mean number of
+    // lights a visible pixel evaluates: its cluster list plus the global
+    // list. real cov is the mean fraction of clusters a global light is
+    // assigned to without the list. union checks that the cluster lists
+    // plus the global list hold the lights of the full assignment
+
+    std::printf(
+        "%8s %6s %6s %10s %7s %10s %10s %10s %9s %6s\n",
+        "lights", "large", "cov", "ms", "global", "pairs", "index KB",
+        "px lights", "real cov", "union");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        for(int extraCount : EXTRA_COUNTS)
+        {
+            auto lights = generateSceneLights(lightCount);
+            for(int i = 0; i < extraCount; ++i)
+                lights[1 + i] = EXTRA_LIGHTS[i];
+
+            CPULightCluster full(threadPool);
+            std::vector<uint8_t> isGlobal(lights.size());
+            std::vector<int32_t> fullLightClusters(lights.size());
+
+            for(float coverage : COVERAGES)
+            {
+                double  ms           = 0;
+                int64_t globalCount  = 0;
+                int64_t pairs        = 0;
+                int64_t pixelLights  = 0;
+                int64_t pixelCount   = 0;
+                double  realCoverage = 0;
+                bool    unionMatches = true;
+
+                CPULightCluster cluster(threadPool);
+                cluster.setIndexCapacity(IndexCapacity::Exact);
+                cluster.setClusterCount(CLUSTER_COUNT);
+                cluster.setGlobalLightCoverage(coverage);
+
+                full.setIndexCapacity(IndexCapacity::Exact);
+                full.setClusterCount(CLUSTER_COUNT);
+
+                for(int frame = 0; frame < FRAME_COUNT; ++frame)
+                {
+                    const SceneCamera &camera = cameras[frame];
+                    const Mat4 view = camera.getView();
+                    const Mat4 proj = camera.getProj();
+
+                    for(CPULightCluster *c : { &cluster, &full })
+                    {
+                        c->setProj(camera.nearZ, camera.farZ, proj);
+                        c->updateClusterAABBs();
+                        c->setView(view);
+                        c->setLights(lights.data(), lights.size());
+                    }
+
+                    ms += measureMS([&] { cluster.run(); }, 100);
+                    full.run();
+
+                    const std::vector<int32_t> &globalLights = cluster.getGlobalLights();
+                    globalCount += globalLights.size();
+                    pairs       += cluster.getLightIndices().size();
+
+                    // every pair of the full assignment is either in the
+                    // same cluster list or has a global light, and the
+                    // cluster lists hold no other pair
+
+                    std::fill(isGlobal.begin(), isGlobal.end(), 0);
+                    for(int li : globalLights)
+                        isGlobal[li] = 1;
+
+                    std::fill(fullLightClusters.begin(), fullLightClusters.end(), 0);
+                    std::vector<int32_t> expected;
+
+                    for(int ci = 0; ci < CLUSTER_COUNT.product(); ++ci)
+                    {
+                        const ClusterRange &fr = full.getClusterRanges()[ci];
+                        const ClusterRange &cr = cluster.getClusterRanges()[ci];
+
+                        expected.clear();
+                        for(int i = fr.rangeBeg; i < fr.rangeEnd; ++i)
+                        {
+                            const int li = full.getLightIndices()[i];
+                            ++fullLightClusters[li];
+                            if(!isGlobal[li])
+                                expected.push_back(li);
+                        }
+
+                        unionMatches &= std::equal(
+                            expected.begin(), expected.end(),
+                            cluster.getLightIndices().begin() + cr.rangeBeg,
+                            cluster.getLightIndices().begin() + cr.rangeEnd);
+                    }
+
+                    for(int li : globalLights)
+                    {
+                        realCoverage += static_cast<double>(fullLightClusters[li]) /
+                                        CLUSTER_COUNT.product();
+                    }
+
+                    const ClusterSlicing slicing = getClusterSlicing(
+                        CLUSTER_COUNT.z, camera.nearZ, camera.farZ);
+
+                    const float *depth = depthImages[frame].data();
+                    for(int py = 0; py < HEIGHT; ++py)
+                    {
+                        const float scrY = 1 - (py + 0.5f) / HEIGHT;
+                        const int yi = static_cast<int>(scrY * CLUSTER_COUNT.y);
+
+                        for(int px = 0; px < WIDTH; ++px)
+                        {
+                            const float d = depth[static_cast<size_t>(py) * WIDTH + px];
+                            if(d >= 1)
+                                continue;
+
+                            const float scrX = (px + 0.5f) / WIDTH;
+                            const int xi = static_cast<int>(scrX * CLUSTER_COUNT.x);
+                            const int zi = viewZ2i(
+                                slicing, proj.m[3][2] / (d - proj.m[2][2]));
+                            if(zi < 0 || zi >= CLUSTER_COUNT.z)
+                                continue;
+
+                            const ClusterRange &range = cluster.getClusterRanges()[
+                                getClusterIndex(CLUSTER_COUNT, xi, yi, zi)];
+                            pixelLights += range.rangeEnd - range.rangeBeg;
+                            pixelLights += globalLights.size();
+                            ++pixelCount;
+                        }
+                    }
+                }
+
+                char coverageName[16] = "off";
+                if(coverage < 1)
+                    std::snprintf(coverageName, sizeof(coverageName), "%.2f", coverage);
+
+                char realCoverageName[16] = "-";
+                if(globalCount)
+                {
+                    std::snprintf(
+                        realCoverageName, sizeof(realCoverageName), "%.1f%%",
+                        100.0 * realCoverage / globalCount);
+                }
+
+                std::printf(
+                    "%8zu %6d %6s %10.3f %7.1f %10.0f %10.1f %10.2f %9s %6s\n",
+                    lightCount, 1 + extraCount, coverageName,
+                    ms / FRAME_COUNT,
+                    static_cast<double>(globalCount) / FRAME_COUNT,
+                    static_cast<double>(pairs) / FRAME_COUNT,
+                    pairs * sizeof(int32_t) / 1024.0 / FRAME_COUNT,
+                    static_cast<double>(pixelLights) / pixelCount,
+                    realCoverageName,
+                    unionMatches ? "yes" : "NO");
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchHierarchical(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    SceneCamera camera;
+
+    std::printf(
+        "%8s %12s %12s %10s %10s\n",
+        "lights", "flat ms", "hier ms", "speedup", "matches");
+
+    for(size_t lightCount : { 256, 1024, 4096, 16384, 65536, 262144 })
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        CPULightCluster flat(threadPool);
+        CPULightCluster hier(threadPool);
+        hier.setAssignMode(AssignMode::Hierarchical);
+
+        for(CPULightCluster *cluster : { &flat, &hier })
+        {
+            cluster->setClusterCount(CLUSTER_COUNT);
+            cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+            cluster->updateClusterAABBs();
+            cluster->setView(camera.getView());
+            cluster->setLights(lights.data(), lights.size());
+        }
+
+        const double flatMS = measureMS([&] { flat.run(); });
+        const double hierMS = measureMS([&] { hier.run(); });
+
+        const bool matches =
+            flat.getClusterRanges() == hier.getClusterRanges() &&
+            flat.getLightIndices()  == hier.getLightIndices();
+
+        std::printf(
+            "%8zu %12.3f %12.3f %10.2f %10s\n",
+            lightCount, flatMS, hierMS, flatMS / hierMS,
+            matches ? "yes" : "NO");
+    }
+}
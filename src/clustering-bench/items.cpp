@@ -0,0 +1,212 @@
+#include <algorithm>
+
+#include "../clustering/item_cluster.h"
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+namespace
+{
+
+    // reflection probes, decals on the walls and floor, and rotated fog
+    // volumes in the bounds of the light positions of generateSceneLights
+    struct SceneItems
+    {
+        std::vector<BoundingSphere> lights;
+        std::vector<BoundingSphere> probes;
+        std::vector<AABB>           decals;
+        std::vector<OBB>            volumes;
+    };
+
+    SceneItems generateSceneItems(
+        size_t lightCount, size_t probeCount, size_t decalCount, size_t volumeCount)
+    {
+        SceneItems result;
+
+        for(auto &light : generateSceneLights(lightCount))
+            result.lights.push_back({ light.lightPosition, light.maxLightDistance });
+
+        std::default_random_engine rng(3);
+        auto ufloat = [&](float low, float high)
+            { return std::uniform_real_distribution<float>(low, high)(rng); };
+        auto position = [&]
+        {
+            return Float3(ufloat(-16, 8), ufloat(-9, 2), ufloat(-6, 6));
+        };
+
+        for(size_t i = 0; i < probeCount; ++i)
+            result.probes.push_back({ position(), ufloat(3, 6) });
+
+        for(size_t i = 0; i < decalCount; ++i)
+        {
+            const Float3 center = position();
+            const Float3 extent = { ufloat(0.2f, 1), ufloat(0.2f, 1), ufloat(0.05f, 0.2f) };
+            result.decals.push_back({ center - extent, center + extent });
+        }
+
+        for(size_t i = 0; i < volumeCount; ++i)
+        {
+            const float  angle = ufloat(0, 3.14159265f);
+            const float  c     = std::cos(angle);
+            const float  s     = std::sin(angle);
+
+            OBB volume;
+            volume.center      = position();
+            volume.axes[0]     = { c, 0, s };
+            volume.axes[1]     = { 0, 1, 0 };
+            volume.axes[2]     = { -s, 0, c };
+            volume.halfExtents = { ufloat(1, 4), ufloat(0.5f, 2), ufloat(1, 4) };
+            result.volumes.push_back(volume);
+        }
+
+        return result;
+    }
+
+    template<typename Cluster>
+    void setupCluster(
+        Cluster &cluster, const Int3 &clusterCount, const SceneCamera &camera)
+    {
+        cluster.setClusterCount(clusterCount);
+        cluster.setProj(camera.nearZ, camera.farZ, camera.getProj());
+        cluster.updateClusterAABBs();
+        cluster.setView(camera.getView());
+    }
+
+    // whether type t of the combined lists equals the single type lists
+    template<typename Combined, typename Single>
+    bool isTypeEqual(
+        const Combined &combined, int type, const Single &single, int clusterCount)
+    {
+        for(int ci = 0; ci < clusterCount; ++ci)
+        {
+            const ClusterRange a = combined.getItemRange(ci, type);
+            const ClusterRange b = single.getItemRange(ci, 0);
+            if(!std::equal(
+                combined.getItemIndices().begin() + a.rangeBeg,
+                combined.getItemIndices().begin() + a.rangeEnd,
+                single.getItemIndices().begin() + b.rangeBeg,
+                single.getItemIndices().begin() + b.rangeEnd))
+                return false;
+        }
+        return true;
+    }
+
+} // namespace anonymous
+
+void benchItems(ThreadPool &threadPool)
+{
+    const int  FRAME_COUNT   = 4;
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    struct ItemCounts
+    {
+        size_t lights;
+        size_t probes;
+        size_t decals;
+        size_t volumes;
+    };
+
+    const ItemCounts ITEM_COUNTS[] = {
+        { 256,  16,  128, 8  },
+        { 1024, 64,  512, 32 },
+        { 4096, 256, 2048, 128 },
+    };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    // one: lights, probes, decals and volumes in one CPUItemCluster pass.
+    // separate: one pass per type. both do the same tests, so the one pass
+    // saves little assignment time. what it saves is at shading: a pixel
+    // reads the 5 consecutive offsets of its cluster, usually one cache
+    // line, instead of a range from each of 4 buffers.
+    // pairs are item-cluster pairs of all types, ranges KB the offsets of
+    // the one pass (the separate passes need about as much). match checks
+    // each type against its separate pass, and the lights against
+    // CPULightCluster
+
+    std::printf(
+        "%8s %7s %7s %8s %10s %10s %8s %10s %10s %6s\n",
+        "lights", "probes", "decals", "volumes", "one ms", "sep ms", "speedup",
+        "pairs", "ranges KB", "match");
+
+    for(const ItemCounts &counts : ITEM_COUNTS)
+    {
+        const SceneItems items = generateSceneItems(
+            counts.lights, counts.probes, counts.decals, counts.volumes);
+        const auto lights = generateSceneLights(counts.lights);
+
+        CPUItemCluster<BoundingSphere, BoundingSphere, AABB, OBB> combined(threadPool);
+        CPUItemCluster<BoundingSphere> lightPass(threadPool);
+        CPUItemCluster<BoundingSphere> probePass(threadPool);
+        CPUItemCluster<AABB>           decalPass(threadPool);
+        CPUItemCluster<OBB>            volumePass(threadPool);
+
+        CPULightCluster lightCluster(threadPool);
+        lightCluster.setIndexCapacity(IndexCapacity::Exact);
+
+        combined.setItems<0>(items.lights.data(), items.lights.size());
+        combined.setItems<1>(items.probes.data(), items.probes.size());
+        combined.setItems<2>(items.decals.data(), items.decals.size());
+        combined.setItems<3>(items.volumes.data(), items.volumes.size());
+
+        lightPass.setItems<0>(items.lights.data(), items.lights.size());
+        probePass.setItems<0>(items.probes.data(), items.probes.size());
+        decalPass.setItems<0>(items.decals.data(), items.decals.size());
+        volumePass.setItems<0>(items.volumes.data(), items.volumes.size());
+
+        lightCluster.setLights(lights.data(), lights.size());
+
+        double  oneMS    = 0;
+        double  sepMS    = 0;
+        int64_t pairs    = 0;
+        bool    matches  = true;
+
+        for(int frame = 0; frame < FRAME_COUNT; ++frame)
+        {
+            const SceneCamera &camera = cameras[frame];
+
+            setupCluster(combined, CLUSTER_COUNT, camera);
+            setupCluster(lightPass, CLUSTER_COUNT, camera);
+            setupCluster(probePass, CLUSTER_COUNT, camera);
+            setupCluster(decalPass, CLUSTER_COUNT, camera);
+            setupCluster(volumePass, CLUSTER_COUNT, camera);
+            setupCluster(lightCluster, CLUSTER_COUNT, camera);
+
+            oneMS += measureMS([&] { combined.run(); }, 100);
+            sepMS += measureMS([&]
+            {
+                lightPass.run();
+                probePass.run();
+                decalPass.run();
+                volumePass.run();
+            }, 100);
+
+            lightCluster.run();
+
+            pairs += combined.getAssignmentCount();
+
+            const int clusterCount = CLUSTER_COUNT.product();
+            matches &= isTypeEqual(combined, 0, lightPass,  clusterCount);
+            matches &= isTypeEqual(combined, 1, probePass,  clusterCount);
+            matches &= isTypeEqual(combined, 2, decalPass,  clusterCount);
+            matches &= isTypeEqual(combined, 3, volumePass, clusterCount);
+
+            std::vector<ClusterRange> lightRanges(clusterCount);
+            for(int ci = 0; ci < clusterCount; ++ci)
+                lightRanges[ci] = combined.getItemRange(ci, 0);
+
+            matches &= findClusterMismatch(
+                clusterCount, lightRanges, combined.getItemIndices(),
+                lightCluster.getClusterRanges(), lightCluster.getLightIndices()) < 0;
+        }
+
+        const double rangeKB =
+            combined.getRangeOffsets().size() * sizeof(int32_t) / 1024.0;
+
+        std::printf(
+            "%8zu %7zu %7zu %8zu %10.3f %10.3f %7.2fx %10.0f %10.1f %6s\n",
+            counts.lights, counts.probes, counts.decals, counts.volumes,
+            oneMS / FRAME_COUNT, sepMS / FRAME_COUNT, sepMS / oneMS,
+            static_cast<double>(pairs) / FRAME_COUNT, rangeKB,
+            matches ? "yes" : "NO");
+    }
+}
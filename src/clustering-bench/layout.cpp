@@ -0,0 +1,82 @@
+#include "../clustering/cluster_layout.h"
+#include "./bench.h"
+
+void benchLayout(ThreadPool &)
+{
+    const int WIDTH       = 1280;
+    const int HEIGHT      = 720;
+    const int FRAME_COUNT = 8;
+
+    // the default grid of the sample, and tiles of 32 and 16 pixels
+    const Int3 CLUSTER_COUNTS[] = { { 20, 15, 32 }, { 40, 23, 32 }, { 80, 45, 32 } };
+
+    struct Layout
+    {
+        const char   *name;
+        ClusterLayout layout;
+    };
+
+    const Layout LAYOUTS[] = {
+        { "linear", ClusterLayout::Linear     },
+        { "slice",  ClusterLayout::SliceMajor },
+        { "morton", ClusterLayout::Morton     },
+    };
+
+    // 8 bytes per ClusterRange, 4 with the compact encoding
+    const int RANGE_STRIDES[] = { 8, 4 };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+    {
+        SceneCamera c = camera;
+        c.wOverH = static_cast<float>(WIDTH) / HEIGHT;
+        depthImages.push_back(renderSceneDepth(c, WIDTH, HEIGHT));
+    }
+
+    // lines / warp: distinct 128 byte lines read by an 8x8 pixel warp.
+    // misses: lines fetched per frame through a 16 KB lru cache, with
+    // warps visited row by row
+
+    std::printf(
+        "%10s %8s %7s %10s %12s %12s\n",
+        "grid", "layout", "stride", "range KB", "lines/warp", "misses");
+
+    for(const Int3 &CLUSTER_COUNT : CLUSTER_COUNTS)
+    {
+        char grid[32];
+        std::snprintf(
+            grid, sizeof(grid), "%dx%dx%d",
+            CLUSTER_COUNT.x, CLUSTER_COUNT.y, CLUSTER_COUNT.z);
+
+        for(int stride : RANGE_STRIDES)
+        {
+            for(auto &layout : LAYOUTS)
+            {
+                ClusterLookupStatistics total;
+                for(int frame = 0; frame < FRAME_COUNT; ++frame)
+                {
+                    SceneCamera camera = cameras[frame];
+                    camera.wOverH = static_cast<float>(WIDTH) / HEIGHT;
+
+                    const ClusterLookupStatistics stats = simulateClusterLookups(
+                        depthImages[frame].data(), WIDTH, HEIGHT, CLUSTER_COUNT,
+                        camera.nearZ, camera.farZ, camera.getProj(), {},
+                        layout.layout, stride);
+
+                    total.warpCount   += stats.warpCount;
+                    total.lineTouches += stats.lineTouches;
+                    total.cacheMisses += stats.cacheMisses;
+                }
+
+                std::printf(
+                    "%10s %8s %7d %10.1f %12.3f %12.1f\n",
+                    grid, layout.name, stride,
+                    getClusterSlotCount(layout.layout, CLUSTER_COUNT) * stride / 1024.0,
+                    static_cast<double>(total.lineTouches) / total.warpCount,
+                    static_cast<double>(total.cacheMisses) / FRAME_COUNT);
+            }
+        }
+    }
+}
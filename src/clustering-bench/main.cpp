@@ -0,0 +1,116 @@
+#include <cstring>
+#include <iostream>
+
+#include "./bench.h"
+
+namespace
+{
+
+    struct Benchmark
+    {
+        const char *name;
+        const char *desc;
+        void (*func)(ThreadPool &);
+    };
+
+    const Benchmark BENCHMARKS[] = {
+        { "assign",       "cpu light assignment throughput",    &benchAssign       },
+        { "simd",         "batched sphere-aabb kernel per isa", &benchSIMD         },
+        { "hierarchical", "tile + z-slice light assignment",    &benchHierarchical },
+        { "bvh",          "light bvh build, refit and query",   &benchBVH          },
+        { "compact",      "exact-size light index lists",       &benchCompact      },
+        { "stats",        "overflow detection and statistics",  &benchStats        },
+        { "aabb",         "parallel cluster aabb builder",      &benchAABB         },
+        { "active",       "active clusters from scene depth",   &benchActive       },
+        { "zbin",         "z-binning with tile light masks",    &benchZBin         },
+        { "slicing",      "light list balance per z-slicing",   &benchSlicing      },
+        { "temporal",     "light list reuse across frames",     &benchTemporal     },
+        { "morton",       "morton light sort and shade loop",   &benchMorton       },
+        { "encoding",     "compact ranges and uint16 indices",  &benchEncoding     },
+        { "tune",         "cluster grid sweep and auto-tuner",  &benchTune         },
+        { "dynamic",      "dirty-range light staging uploads",  &benchDynamic      },
+        { "frustum",      "tile plane test vs exact frustum",   &benchFrustum      },
+        { "occupancy",    "per-cluster light count heatmap",    &benchOccupancy    },
+        { "global",       "global list for large lights",       &benchGlobal       },
+        { "layout",       "cluster range layout locality",      &benchLayout       },
+        { "items",        "one pass for several item types",    &benchItems        },
+        { "tiled",        "tiled forward+ vs cluster lists",    &benchTiled        },
+        { "scatter",      "light scatter vs cluster gather",    &benchScatter      },
+        { "static",       "world grid of static lights",        &benchStatic       },
+        { "objects",      "per-object light lists",             &benchObjects      },
+    };
+
+    void printUsage()
+    {
+        std::cout << "usage: ClusteringBench [--save-grid file] "
+                     "[--save-occupancy prefix] [benchmark...]" << std::endl;
+        std::cout << "    --save-grid: save the grid recommended by tune to file, "
+                     "e.g. ./asset/clustered/cluster_grid.txt" << std::endl;
+        std::cout << "    --save-occupancy: save the heatmap and csv files of "
+                     "occupancy with this path prefix" << std::endl;
+        std::cout << "benchmarks:" << std::endl;
+        for(auto &b : BENCHMARKS)
+            std::cout << "    " << b.name << ": " << b.desc << std::endl;
+    }
+
+} // namespace anonymous
+
+int main(int argc, char *argv[])
+{
+    std::vector<const Benchmark *> selected;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--save-grid") == 0 ||
+           std::strcmp(argv[i], "--save-occupancy") == 0)
+        {
+            if(i + 1 >= argc)
+            {
+                printUsage();
+                return -1;
+            }
+            if(std::strcmp(argv[i], "--save-grid") == 0)
+                setTunedGridFilename(argv[i + 1]);
+            else
+                setOccupancyFilePrefix(argv[i + 1]);
+            ++i;
+            continue;
+        }
+
+        const Benchmark *found = nullptr;
+        for(auto &b : BENCHMARKS)
+        {
+            if(std::strcmp(argv[i], b.name) == 0)
+                found = &b;
+        }
+
+        if(!found)
+        {
+            printUsage();
+            return -1;
+        }
+        selected.push_back(found);
+    }
+
+    if(selected.empty())
+    {
+        for(auto &b : BENCHMARKS)
+            selected.push_back(&b);
+    }
+
+    try
+    {
+        ThreadPool threadPool;
+        std::cout << "threads: " << threadPool.getThreadCount() << std::endl;
+
+        for(auto b : selected)
+        {
+            std::cout << std::endl << "== " << b->name << " ==" << std::endl;
+            b->func(threadPool);
+        }
+    }
+    catch(const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <numeric>
+
+#include "../clustering/light_cluster.h"
+#include "../clustering/light_sort.h"
+#include "../clustering/radix_sort.h"
+#include "./bench.h"
+
+namespace
+{
+
+    void benchRadixSort(ThreadPool &threadPool)
+    {
+        const int COUNTS[] = { 4096, 65536, 1 << 20 };
+
+        std::printf(
+            "%10s %12s %12s %8s %8s\n",
+            "keys", "radix ms", "std ms", "speedup", "matches");
+
+        for(int count : COUNTS)
+        {
+            std::default_random_engine rng(count);
+            std::uniform_int_distribution<uint32_t> dist(0, (1u << 30) - 1);
+
+            std::vector<uint32_t> inputKeys(count);
+            for(auto &k : inputKeys)
+                k = dist(rng);
+
+            std::vector<uint32_t> keys;
+            std::vector<int32_t>  values(count);
+
+            const double radixMS = measureMS([&]
+            {
+                keys = inputKeys;
+                std::iota(values.begin(), values.end(), 0);
+                radixSort(threadPool, keys.data(), values.data(), count, 30);
+            });
+
+            std::vector<int32_t> expected(count);
+            const double stdMS = measureMS([&]
+            {
+                std::iota(expected.begin(), expected.end(), 0);
+                std::stable_sort(
+                    expected.begin(), expected.end(), [&](int32_t a, int32_t b)
+                {
+                    return inputKeys[a] < inputKeys[b];
+                });
+            });
+
+            std::printf(
+                "%10d %12.3f %12.3f %8.2f %8s\n",
+                count, radixMS, stdMS, stdMS / radixMS,
+                values == expected ? "yes" : "NO");
+        }
+    }
+
+    struct ShadeResult
+    {
+        double ms       = 0;
+        double radiance = 0;
+        // over non-empty clusters: (max - min + 1) / count of light indices,
+        // and distinct 64 byte lines of the light array / count
+        double span     = 0;
+        double lines    = 0;
+    };
+
+    ShadeResult benchShade(
+        ThreadPool                            &threadPool,
+        const std::vector<Light>              &lights,
+        const std::vector<SceneCamera>        &cameras,
+        const std::vector<std::vector<float>> &depthImages,
+        const Int3                            &clusterCount,
+        int                                    width,
+        int                                    height)
+    {
+        CPULightCluster cluster(threadPool);
+        cluster.setIndexCapacity(IndexCapacity::Exact);
+        cluster.setClusterCount(clusterCount);
+
+        ShadeResult result;
+        int64_t nonEmptyCount = 0;
+
+        std::vector<double> rowRadiance(height);
+
+        for(size_t frame = 0; frame < cameras.size(); ++frame)
+        {
+            const SceneCamera &camera = cameras[frame];
+            const Mat4 view = camera.getView();
+            const Mat4 proj = camera.getProj();
+
+            cluster.setProj(camera.nearZ, camera.farZ, proj);
+            cluster.updateClusterAABBs();
+            cluster.setView(view);
+            cluster.setLights(lights.data(), lights.size());
+            cluster.run();
+
+            const auto &ranges  = cluster.getClusterRanges();
+            const auto &indices = cluster.getLightIndices();
+
+            for(auto &range : ranges)
+            {
+                const int count = range.rangeEnd - range.rangeBeg;
+                if(!count)
+                    continue;
+
+                const int32_t *list = indices.data() + range.rangeBeg;
+
+                int lines = 0;
+                size_t lastLine = SIZE_MAX;
+                for(int i = 0; i < count; ++i)
+                {
+                    const size_t line = list[i] * sizeof(Light) / 64;
+                    lines += line != lastLine;
+                    lastLine = line;
+                }
+
+                result.span  += static_cast<double>(list[count - 1] - list[0] + 1) / count;
+                result.lines += static_cast<double>(lines) / count;
+                ++nonEmptyCount;
+            }
+
+            const Mat4 invProj = proj.inv();
+            const Mat4 invView = view.inv();
+            const ClusterSlicing slicing = getClusterSlicing(
+                clusterCount.z, camera.nearZ, camera.farZ);
+
+            const float *depth = depthImages[frame].data();
+
+            // gather the light list of each pixel's cluster and accumulate
+            // a point light falloff, like the loop in forward.hlsl
+
+            auto shade = [&]
+            {
+                threadPool.parallelFor(height, 8, [&](int beg, int end, int)
+                {
+                    for(int py = beg; py < end; ++py)
+                    {
+                        const float scrY = 1 - (py + 0.5f) / height;
+                        const int   yi   = static_cast<int>(scrY * clusterCount.y);
+
+                        double radiance = 0;
+                        for(int px = 0; px < width; ++px)
+                        {
+                            const float d = depth[static_cast<size_t>(py) * width + px];
+                            if(d >= 1)
+                                continue;
+
+                            const float scrX = (px + 0.5f) / width;
+                            const Float3 pv = (Float4{
+                                2 * scrX - 1, 2 * scrY - 1, d, 1 } * invProj).homogenize();
+
+                            const int zi = viewZ2i(slicing, pv.z);
+                            if(zi < 0 || zi >= clusterCount.z)
+                                continue;
+
+                            const int xi = static_cast<int>(scrX * clusterCount.x);
+                            const ClusterRange &range =
+                                ranges[getClusterIndex(clusterCount, xi, yi, zi)];
+
+                            const Float3 pw = invView.transformPoint(pv);
+
+                            float r = 0, g = 0, b = 0;
+                            for(int i = range.rangeBeg; i < range.rangeEnd; ++i)
+                            {
+                                const Light &light = lights[indices[i]];
+                                const float dist =
+                                    (light.lightPosition - pw).length();
+                                const float falloff = (std::max)(
+                                    0.0f, 1 - dist / light.maxLightDistance);
+                                r += falloff * light.lightIntensity.x;
+                                g += falloff * light.lightIntensity.y;
+                                b += falloff * light.lightIntensity.z;
+                            }
+                            radiance += r + g + b;
+                        }
+                        rowRadiance[py] = radiance;
+                    }
+                });
+            };
+
+            result.ms += measureMS(shade, 100);
+            result.radiance +=
+                std::accumulate(rowRadiance.begin(), rowRadiance.end(), 0.0);
+        }
+
+        result.ms    /= cameras.size();
+        result.span  /= (std::max)(nonEmptyCount, int64_t(1));
+        result.lines /= (std::max)(nonEmptyCount, int64_t(1));
+        return result;
+    }
+
+} // namespace anonymous
+
+void benchMorton(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 4;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096, 16384 };
+
+    benchRadixSort(threadPool);
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // shade ms is the gather/shade loop over all pixels, span and lines are
+    // index spread and touched light cache lines per list entry
+
+    std::printf(
+        "\n%8s %8s %10s %10s %8s %8s %8s %8s %8s\n",
+        "lights", "sort ms", "shade ms", "sorted ms", "speedup",
+        "span", "sorted", "lines", "sorted");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        // smaller radii keep per-cluster lists about the same length
+        const float radius = 2.5f * std::cbrt(1024.0f / lightCount);
+        const auto lights = generateSceneLights(lightCount, 1, radius);
+
+        auto sortedLights = lights;
+        Timer sortTimer;
+        const std::vector<int32_t> remap =
+            sortLightsByMorton(threadPool, sortedLights.data(), sortedLights.size());
+        const double sortMS = sortTimer.ms();
+
+        // the remap must move every light to its new index
+        bool remapped = true;
+        for(size_t i = 0; i < lights.size(); ++i)
+        {
+            const Light &a = lights[i], &b = sortedLights[remap[i]];
+            remapped &= a.lightPosition.x == b.lightPosition.x &&
+                        a.lightPosition.y == b.lightPosition.y &&
+                        a.lightPosition.z == b.lightPosition.z;
+        }
+
+        const ShadeResult original = benchShade(
+            threadPool, lights, cameras, depthImages, CLUSTER_COUNT, WIDTH, HEIGHT);
+        const ShadeResult sorted = benchShade(
+            threadPool, sortedLights, cameras, depthImages, CLUSTER_COUNT, WIDTH, HEIGHT);
+
+        const bool matches = remapped &&
+            std::abs(original.radiance - sorted.radiance) <=
+            1e-4 * std::abs(original.radiance);
+
+        std::printf(
+            "%8zu %8.3f %10.3f %10.3f %8.2f %8.1f %8.1f %8.3f %8.3f%s\n",
+            lightCount, sortMS, original.ms, sorted.ms, original.ms / sorted.ms,
+            original.span, sorted.span, original.lines, sorted.lines,
+            matches ? "" : "  MISMATCH");
+    }
+}
@@ -0,0 +1,139 @@
+#include "../clustering/object_lights.h"
+#include "./bench.h"
+
+namespace
+{
+
+    // boxes of 0.2 to 1 units scattered in the church, like props and pews
+    std::vector<AABB> generateObjects(size_t count, uint32_t seed)
+    {
+        std::default_random_engine rng(seed);
+        std::uniform_real_distribution<float> distX(-16, 8);
+        std::uniform_real_distribution<float> distY(-9, 2);
+        std::uniform_real_distribution<float> distZ(-6, 6);
+        std::uniform_real_distribution<float> distSize(0.2f, 1.0f);
+
+        std::vector<AABB> objects(count);
+        for(auto &object : objects)
+        {
+            const Float3 center = { distX(rng), distY(rng), distZ(rng) };
+            const Float3 extent = {
+                0.5f * distSize(rng), 0.5f * distSize(rng), 0.5f * distSize(rng)
+            };
+            object = AABB{
+                .lower = center - extent,
+                .upper = center + extent
+            };
+        }
+        return objects;
+    }
+
+    bool matchesReference(
+        const CPUObjectLights    &objectLights,
+        const std::vector<AABB>  &objects,
+        const std::vector<Light> &lights)
+    {
+        auto &ranges  = objectLights.getObjectRanges();
+        auto &indices = objectLights.getLightIndices();
+        if(ranges.size() != objects.size())
+            return false;
+
+        std::vector<int32_t> expected;
+        for(size_t oi = 0; oi < objects.size(); ++oi)
+        {
+            expected.clear();
+            for(size_t li = 0; li < lights.size(); ++li)
+            {
+                const Light &light = lights[li];
+                if(isLightInAABB(light.lightPosition, light.maxLightDistance, objects[oi]))
+                    expected.push_back(static_cast<int32_t>(li));
+            }
+
+            const ClusterRange &range = ranges[oi];
+            if(!std::equal(
+                expected.begin(), expected.end(),
+                indices.begin() + range.rangeBeg, indices.begin() + range.rangeEnd))
+                return false;
+        }
+        return true;
+    }
+
+} // namespace anonymous
+
+void benchObjects(ThreadPool &threadPool)
+{
+    // every n-th object moves each frame, lights are fixed
+    const int MOVING_OBJECT_STRIDE = 16;
+
+    // each object costs one pass of the kernel over all lights, so the full
+    // run scales with objects * lights: on one thread about 7ms for 16384
+    // objects and 256 lights, 41ms with 4096 lights. the incremental run only
+    // re-tests the moving objects but still compacts every list, which made
+    // it 9x to 17x faster with 1/16 of the objects moving
+
+    std::printf(
+        "%8s %8s %10s %10s %9s %11s %9s %8s\n",
+        "objects", "lights", "full ms", "incr ms", "speedup",
+        "lights/obj", "culled", "matches");
+
+    for(size_t lightCount : { 256, 4096 })
+    {
+        // same density scaling as the clustered benchmarks
+
+        const float radius =
+            2.5f * std::cbrt(1024.0f / static_cast<float>(lightCount));
+        const auto lights = generateSceneLights(lightCount, 1, radius);
+
+        for(size_t objectCount : { 1024, 4096, 16384 })
+        {
+            const auto initialObjects = generateObjects(objectCount, 2);
+            auto objects = initialObjects;
+
+            CPUObjectLights full(threadPool);
+            CPUObjectLights incremental(threadPool);
+            incremental.setIncrementalEnabled(true);
+
+            for(CPUObjectLights *objectLights : { &full, &incremental })
+            {
+                objectLights->setObjects(objects.data(), objects.size());
+                objectLights->setLights(lights.data(), lights.size());
+                objectLights->run();
+            }
+
+            const double fullMS = measureMS([&] { full.run(); }, 100);
+
+            // move a different offset each call so that the incremental run
+            // always has dirty objects
+
+            int frame = 0;
+            const double incrMS = measureMS([&]
+            {
+                ++frame;
+                for(size_t i = 0; i < objects.size(); i += MOVING_OBJECT_STRIDE)
+                {
+                    const float  dx = 0.1f * std::sin(0.3f * frame + static_cast<float>(i));
+                    const Float3 d  = { dx, 0, 0 };
+                    objects[i].lower = initialObjects[i].lower + d;
+                    objects[i].upper = initialObjects[i].upper + d;
+                }
+                incremental.run();
+            }, 100);
+
+            full.run();
+
+            const bool matches =
+                matchesReference(full, objects, lights) &&
+                full.getObjectRanges() == incremental.getObjectRanges() &&
+                full.getLightIndices() == incremental.getLightIndices();
+
+            const double avgLights =
+                static_cast<double>(full.getAssignmentCount()) / objectCount;
+
+            std::printf(
+                "%8zu %8zu %10.3f %10.3f %8.2fx %11.2f %8.2f%% %8s\n",
+                objectCount, lightCount, fullMS, incrMS, fullMS / incrMS,
+                avgLights, 100.0 * (1 - avgLights / lightCount),
+                matches ? "yes" : "NO");
+        }
+    }
+}
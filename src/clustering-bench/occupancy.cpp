@@ -0,0 +1,72 @@
+#include "../clustering/light_cluster.h"
+#include "../clustering/occupancy.h"
+#include "./bench.h"
+
+namespace
+{
+
+    // set by --save-occupancy, nothing is written without it
+    const char *occupancyFilePrefix = nullptr;
+
+} // namespace anonymous
+
+void benchOccupancy(ThreadPool &threadPool)
+{
+    const Int3   CLUSTER_COUNT = { 20, 15, 32 };
+    const size_t LIGHT_COUNT   = 4096;
+
+    // first pose of the camera path, like the other scene benchmarks
+
+    const SceneCamera camera = generateCameraPath(1)[0];
+    const auto lights = generateSceneLights(LIGHT_COUNT);
+
+    CPULightCluster cluster(threadPool);
+    cluster.setIndexCapacity(IndexCapacity::Exact);
+    cluster.setClusterCount(CLUSTER_COUNT);
+    cluster.setProj(camera.nearZ, camera.farZ, camera.getProj());
+    cluster.updateClusterAABBs();
+    cluster.setView(camera.getView());
+    cluster.setLights(lights.data(), lights.size());
+    cluster.run();
+
+    const ClusterOccupancy occupancy = computeClusterOccupancy(
+        CLUSTER_COUNT, cluster.getClusterRanges().data());
+
+    const ClusterSlicing slicing = getClusterSlicing(
+        CLUSTER_COUNT.z, camera.nearZ, camera.farZ);
+
+    // the fill light reaches every cluster, so 1 is the floor of each slice
+
+    std::printf("%8s %10s %10s %8s %8s\n", "slice", "near z", "far z", "max", "mean");
+    for(int zi = 0; zi < CLUSTER_COUNT.z; ++zi)
+    {
+        std::printf(
+            "%8d %10.3f %10.3f %8d %8.2f\n",
+            zi, clusterI2Z(slicing, zi), clusterI2Z(slicing, zi + 1),
+            occupancy.sliceMaxLights[zi], occupancy.sliceMeanLights[zi]);
+    }
+
+    std::printf("max lights %d\n", occupancy.maxLights);
+
+    if(!occupancyFilePrefix)
+    {
+        std::printf("pass --save-occupancy <prefix> to save the heatmap and csv\n");
+        return;
+    }
+
+    const std::string prefix = occupancyFilePrefix;
+    const bool saved =
+        saveOccupancyHeatmap((prefix + "cluster_occupancy.ppm").c_str(), occupancy) &&
+        saveClusterOccupancyCSV((prefix + "cluster_occupancy.csv").c_str(), occupancy) &&
+        saveTileOccupancyCSV((prefix + "tile_occupancy.csv").c_str(), occupancy);
+
+    std::printf(
+        "heatmap and csv %s %scluster_occupancy.ppm/csv and %stile_occupancy.csv\n",
+        saved ? "saved to" : "could not be saved to",
+        occupancyFilePrefix, occupancyFilePrefix);
+}
+
+void setOccupancyFilePrefix(const char *prefix)
+{
+    occupancyFilePrefix = prefix;
+}
@@ -0,0 +1,99 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchScatter(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNTS[] = { { 20, 15, 32 }, { 50, 38, 32 } };
+
+    // small lights, where most clusters of the gather modes test lights
+    // that are nowhere near them
+    const float LIGHT_RADIUS = 1.0f;
+
+    SceneCamera camera;
+
+    // flat and hier gather with the frustum test, scatter has to match them.
+    // aabb pairs are the pairs of the flat aabb test, of which scatter drops
+    // the ones outside the tile pyramids.
+    // a cluster with temporal reuse also switches between flat and scatter
+    // with the lights standing still, and must match fresh runs of each mode.
+    // on one thread scatter took about 1/5 to 1/9 of the flat time and 1/2.5
+    // of the hierarchical time, since most lights of the scene are small and
+    // behind or beside the camera and never reach a cluster test
+
+    std::printf(
+        "%10s %8s %10s %10s %10s %9s %9s %10s %10s %8s\n",
+        "grid", "lights", "flat ms", "hier ms", "scatter ms", "vs flat", "vs hier",
+        "pairs", "aabb pairs", "matches");
+
+    for(const Int3 &clusterCount : CLUSTER_COUNTS)
+    {
+        char grid[32];
+        std::snprintf(
+            grid, sizeof(grid), "%dx%dx%d",
+            clusterCount.x, clusterCount.y, clusterCount.z);
+
+        for(size_t lightCount : { 1024, 4096, 16384, 65536 })
+        {
+            const auto lights = generateSceneLights(lightCount, 1, LIGHT_RADIUS);
+
+            CPULightCluster flat(threadPool);
+            CPULightCluster hier(threadPool);
+            CPULightCluster scatter(threadPool);
+            CPULightCluster flatAABB(threadPool);
+            CPULightCluster scatterAABB(threadPool);
+            CPULightCluster switched(threadPool);
+
+            hier.setAssignMode(AssignMode::Hierarchical);
+            scatter.setAssignMode(AssignMode::Scatter);
+            scatterAABB.setAssignMode(AssignMode::Scatter);
+            switched.setTemporalReuseEnabled(true);
+
+            for(CPULightCluster *cluster :
+                { &flat, &hier, &scatter, &flatAABB, &scatterAABB, &switched })
+            {
+                cluster->setClusterCount(clusterCount);
+                cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+                cluster->updateClusterAABBs();
+                cluster->setView(camera.getView());
+                cluster->setLights(lights.data(), lights.size());
+                cluster->setIndexCapacity(IndexCapacity::Exact);
+                if(cluster == &flat || cluster == &hier || cluster == &scatter)
+                    cluster->setClusterTest(ClusterTest::Frustum);
+            }
+
+            const double flatMS    = measureMS([&] { flat.run(); });
+            const double hierMS    = measureMS([&] { hier.run(); });
+            const double scatterMS = measureMS([&] { scatter.run(); });
+            flatAABB.run();
+            scatterAABB.run();
+
+            auto sameLists = [](const CPULightCluster &a, const CPULightCluster &b)
+            {
+                return a.getClusterRanges() == b.getClusterRanges() &&
+                       a.getLightIndices()  == b.getLightIndices();
+            };
+
+            switched.run();
+            bool switchMatches = sameLists(switched, flatAABB);
+            switched.setAssignMode(AssignMode::Scatter);
+            switched.run();
+            switchMatches &= sameLists(switched, scatterAABB);
+            switched.setAssignMode(AssignMode::Flat);
+            switched.run();
+            switchMatches &= sameLists(switched, flatAABB);
+
+            const bool matches =
+                sameLists(flat, scatter) &&
+                hier.getLightIndices() == scatter.getLightIndices() &&
+                switchMatches;
+
+            std::printf(
+                "%10s %8zu %10.3f %10.3f %10.3f %8.1fx %8.1fx %10lld %10lld %8s\n",
+                grid, lightCount, flatMS, hierMS, scatterMS,
+                flatMS / scatterMS, hierMS / scatterMS,
+                static_cast<long long>(scatter.getAssignmentCount()),
+                static_cast<long long>(flatAABB.getAssignmentCount()),
+                matches ? "yes" : "NO");
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#include "./bench.h"
+
+Mat4 SceneCamera::getView() const
+{
+    const Float3 dir = {
+        std::cos(horiRad) * std::cos(vertRad),
+        std::sin(vertRad),
+        std::sin(horiRad) * std::cos(vertRad)
+    };
+    return Mat4::lookAt(position, position + dir, { 0, 1, 0 });
+}
+
+Mat4 SceneCamera::getProj() const
+{
+    return Mat4::perspective(
+        fovDeg * 3.14159265f / 180, wOverH, nearZ, farZ);
+}
+
+std::vector<Light> generateSceneLights(
+    size_t count, uint32_t seed, float radius)
+{
+    std::vector<Light> lights;
+    lights.reserve(count);
+
+    if(count)
+    {
+        lights.push_back(Light{
+            .lightPosition    = { 0, 0, 0 },
+            .maxLightDistance = 40,
+            .lightIntensity   = Float3(0.01f, 0.01f, 0.01f),
+            .lightAmbient     = Float3(0)
+        });
+    }
+
+    std::default_random_engine rng(seed);
+    auto ufloat = [&](float low, float high)
+        { return std::uniform_real_distribution<float>(low, high)(rng); };
+
+    while(lights.size() < count)
+    {
+        Light light;
+        light.lightPosition.x  = ufloat(-16, 8);
+        light.lightPosition.y  = ufloat(-9, 2);
+        light.lightPosition.z  = ufloat(-6, 6);
+        light.maxLightDistance = radius;
+        light.lightIntensity.x = ufloat(0.5f, 1);
+        light.lightIntensity.y = ufloat(0.5f, 1);
+        light.lightIntensity.z = ufloat(0.5f, 1);
+        lights.push_back(light);
+    }
+
+    return lights;
+}
+
+std::vector<SceneCamera> generateCameraPath(int frameCount)
+{
+    std::vector<SceneCamera> result;
+    result.reserve(frameCount);
+
+    for(int i = 0; i < frameCount; ++i)
+    {
+        const float t = static_cast<float>(i) / (std::max)(frameCount, 1);
+
+        SceneCamera camera;
+        camera.position = {
+            -4 + 8 * std::cos(2 * 3.14159265f * t),
+            -4,
+            4 * std::sin(2 * 3.14159265f * t)
+        };
+        camera.horiRad = 2 * 3.14159265f * t;
+        camera.vertRad = 0.2f * std::sin(4 * 3.14159265f * t);
+        result.push_back(camera);
+    }
+
+    return result;
+}
+
+std::vector<float> renderSceneDepth(
+    const SceneCamera &camera, int width, int height)
+{
+    const AABB nave = { { -30, -10, -10 }, { 20, 14, 10 } };
+
+    std::vector<AABB> boxes;
+    for(int i = 0; i < 11; ++i)
+    {
+        const float x = -26.0f + 4 * i;
+        for(float z : { -5.0f, 5.0f })
+        {
+            boxes.push_back(
+                { { x - 0.6f, -10, z - 0.6f }, { x + 0.6f, 14, z + 0.6f } });
+        }
+    }
+    for(int i = 0; i < 12; ++i)
+    {
+        const float x = -24.0f + 2.5f * i;
+        boxes.push_back({ { x, -10, -4 }, { x + 0.8f, -9, -1 } });
+        boxes.push_back({ { x, -10,  1 }, { x + 0.8f, -9,  4 } });
+    }
+    boxes.push_back({ { 14, -10, -3 }, { 17, -8, 3 } });
+
+    const Mat4 view     = camera.getView();
+    const Mat4 viewProj = view * camera.getProj();
+    const Mat4 invView  = view.inv();
+    const Mat4 invProj  = camera.getProj().inv();
+
+    // returns (tNear, tFar) of the ray against aabb
+    auto intersect = [](const Float3 &o, const Float3 &invDir, const AABB &aabb)
+    {
+        float tNear = std::numeric_limits<float>::lowest();
+        float tFar  = (std::numeric_limits<float>::max)();
+        for(int i = 0; i < 3; ++i)
+        {
+            const float t0 = (aabb.lower[i] - o[i]) * invDir[i];
+            const float t1 = (aabb.upper[i] - o[i]) * invDir[i];
+            tNear = (std::max)(tNear, (std::min)(t0, t1));
+            tFar  = (std::min)(tFar, (std::max)(t0, t1));
+        }
+        return std::make_pair(tNear, tFar);
+    };
+
+    std::vector<float> depth(static_cast<size_t>(width) * height, 1.0f);
+    for(int py = 0; py < height; ++py)
+    {
+        for(int px = 0; px < width; ++px)
+        {
+            const float ndcX = (px + 0.5f) / width * 2 - 1;
+            const float ndcY = 1 - (py + 0.5f) / height * 2;
+
+            const Float3 viewPoint =
+                (Float4{ ndcX, ndcY, 0.5f, 1 } * invProj).homogenize();
+            const Float3 dir =
+                invView.transformPoint(viewPoint) - camera.position;
+            const Float3 invDir = { 1 / dir.x, 1 / dir.y, 1 / dir.z };
+
+            float t = intersect(camera.position, invDir, nave).second;
+            for(auto &box : boxes)
+            {
+                const auto [tNear, tFar] =
+                    intersect(camera.position, invDir, box);
+                if(tNear <= tFar && tNear > 0)
+                    t = (std::min)(t, tNear);
+            }
+
+            const Float3 hit = camera.position + t * dir;
+            const Float4 clip = Float4{ hit.x, hit.y, hit.z, 1 } * viewProj;
+            const float d = clip.z / clip.w;
+            if(t > 0 && d < 1)
+                depth[static_cast<size_t>(py) * width + px] = d;
+        }
+    }
+
+    return depth;
+}
@@ -0,0 +1,78 @@
+#include "../clustering/cluster_aabb.h"
+#include "../clustering/sphere_aabb.h"
+#include "./bench.h"
+
+void benchSIMD(ThreadPool &)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  LIGHT_COUNT   = 4096;
+
+    SceneCamera camera;
+    const Mat4 view = camera.getView();
+
+    const auto aabbs = buildClusterAABBs(
+        CLUSTER_COUNT, camera.nearZ, camera.farZ, camera.getProj());
+
+    const auto lights = generateSceneLights(LIGHT_COUNT);
+
+    LightSoA soa;
+    soa.resize(LIGHT_COUNT);
+    for(int i = 0; i < LIGHT_COUNT; ++i)
+    {
+        soa.set(
+            i,
+            view.transformPoint(lights[i].lightPosition),
+            lights[i].maxLightDistance);
+    }
+
+    // no output limit so that every light is tested
+
+    std::vector<int32_t> output(LIGHT_COUNT);
+    std::vector<int32_t> scalarOutput;
+
+    std::printf(
+        "%8s %12s %12s %14s %10s\n",
+        "isa", "ms/frame", "Gtests/s", "assignments", "matches");
+
+    for(ISA isa : { ISA::Scalar, ISA::SSE4, ISA::AVX2, ISA::AVX512 })
+    {
+        if(!isISASupported(isa))
+        {
+            std::printf("%8s %12s\n", getISAName(isa), "unsupported");
+            continue;
+        }
+
+        const SphereAABBKernel kernel = getSphereAABBKernel(isa);
+
+        std::vector<int32_t> allOutput;
+        for(auto &aabb : aabbs)
+        {
+            const int count = kernel(
+                soa, 0, LIGHT_COUNT, aabb, output.data(), LIGHT_COUNT);
+            allOutput.insert(
+                allOutput.end(), output.begin(), output.begin() + count);
+        }
+
+        if(isa == ISA::Scalar)
+            scalarOutput = allOutput;
+
+        size_t assignments = 0;
+        const double ms = measureMS([&]
+        {
+            assignments = 0;
+            for(auto &aabb : aabbs)
+            {
+                assignments += kernel(
+                    soa, 0, LIGHT_COUNT, aabb, output.data(), LIGHT_COUNT);
+            }
+        });
+
+        const double tests =
+            static_cast<double>(aabbs.size()) * LIGHT_COUNT;
+
+        std::printf(
+            "%8s %12.3f %12.3f %14zu %10s\n",
+            getISAName(isa), ms, tests / ms / 1e6, assignments,
+            allOutput == scalarOutput ? "yes" : "NO");
+    }
+}
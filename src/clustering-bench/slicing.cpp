@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchSlicing(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 8;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096 };
+
+    struct Policy
+    {
+        const char   *name;
+        SlicingPolicy policy;
+    };
+
+    const Policy POLICIES[] = {
+        { "logarithmic", { SlicingMode::Logarithmic, 0 } },
+        { "linear",      { SlicingMode::Linear,      0 } },
+        { "hybrid 1",    { SlicingMode::Hybrid,      1 } },
+        { "hybrid 3",    { SlicingMode::Hybrid,      3 } },
+        { "hybrid 6",    { SlicingMode::Hybrid,      6 } },
+    };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // slice 0 is the depth covered by the first slice. cluster columns are
+    // over non-empty clusters, cv is stddev / mean of their list lengths.
+    // pixel columns are list lengths seen by visible pixels, i.e. the
+    // shading loop, and used is the ratio of clusters containing pixels
+
+    std::printf(
+        "%8s %12s %8s %8s %8s %8s %8s %8s %8s\n",
+        "lights", "policy", "slice 0", "max", "mean", "cv",
+        "px mean", "px max", "used");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        for(auto &p : POLICIES)
+        {
+            CPULightCluster cluster(threadPool);
+            cluster.setIndexCapacity(IndexCapacity::Exact);
+            cluster.setClusterCount(CLUSTER_COUNT);
+            cluster.setSlicingPolicy(p.policy);
+
+            int    maxLights = 0, maxPixelLights = 0;
+            double lightSum = 0, lightSquareSum = 0, pixelLightSum = 0;
+            int64_t nonEmptyCount = 0, pixelCount = 0, usedCount = 0;
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const SceneCamera &camera = cameras[frame];
+                const Mat4 proj = camera.getProj();
+
+                cluster.setProj(camera.nearZ, camera.farZ, proj);
+                cluster.updateClusterAABBs();
+                cluster.setView(camera.getView());
+                cluster.setLights(lights.data(), lights.size());
+                cluster.run();
+
+                const auto &ranges = cluster.getClusterRanges();
+                for(auto &range : ranges)
+                {
+                    const int count = range.rangeEnd - range.rangeBeg;
+                    if(!count)
+                        continue;
+                    maxLights = (std::max)(maxLights, count);
+                    lightSum       += count;
+                    lightSquareSum += static_cast<double>(count) * count;
+                    ++nonEmptyCount;
+                }
+
+                const ClusterSlicing slicing = getClusterSlicing(
+                    CLUSTER_COUNT.z, camera.nearZ, camera.farZ, p.policy);
+
+                std::vector<uint8_t> used(CLUSTER_COUNT.product(), 0);
+
+                const float *depth = depthImages[frame].data();
+                for(int py = 0; py < HEIGHT; ++py)
+                {
+                    const float scrY = 1 - (py + 0.5f) / HEIGHT;
+                    const int yi = static_cast<int>(scrY * CLUSTER_COUNT.y);
+
+                    for(int px = 0; px < WIDTH; ++px)
+                    {
+                        const float d = depth[static_cast<size_t>(py) * WIDTH + px];
+                        if(d >= 1)
+                            continue;
+
+                        const float scrX = (px + 0.5f) / WIDTH;
+                        const int xi = static_cast<int>(scrX * CLUSTER_COUNT.x);
+                        const int zi = viewZ2i(
+                            slicing, proj.m[3][2] / (d - proj.m[2][2]));
+                        if(zi < 0 || zi >= CLUSTER_COUNT.z)
+                            continue;
+
+                        const int ci = getClusterIndex(CLUSTER_COUNT, xi, yi, zi);
+                        const int count = ranges[ci].rangeEnd - ranges[ci].rangeBeg;
+
+                        maxPixelLights = (std::max)(maxPixelLights, count);
+                        pixelLightSum += count;
+                        ++pixelCount;
+
+                        usedCount += !used[ci];
+                        used[ci] = 1;
+                    }
+                }
+            }
+
+            const double mean = lightSum / (std::max)(nonEmptyCount, int64_t(1));
+            const double variance =
+                lightSquareSum / (std::max)(nonEmptyCount, int64_t(1)) - mean * mean;
+
+            const SceneCamera &camera = cameras[0];
+            const ClusterSlicing slicing = getClusterSlicing(
+                CLUSTER_COUNT.z, camera.nearZ, camera.farZ, p.policy);
+
+            std::printf(
+                "%8zu %12s %8.3f %8d %8.1f %8.3f %8.2f %8d %8.3f\n",
+                lightCount, p.name,
+                clusterI2Z(slicing, 1) - clusterI2Z(slicing, 0),
+                maxLights, mean,
+                std::sqrt((std::max)(variance, 0.0)) / mean,
+                pixelLightSum / (std::max)(pixelCount, int64_t(1)),
+                maxPixelLights,
+                static_cast<double>(usedCount) /
+                    (static_cast<int64_t>(CLUSTER_COUNT.product()) * FRAME_COUNT));
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchStatic(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  FRAME_COUNT   = 32;
+
+    // every n-th light moves each frame, the others are in the static grid
+    const int DYNAMIC_LIGHT_STRIDE = 8;
+
+    // the grid is built once, every frame only checks the static lights for
+    // changes. on one thread it took about as long as the refitted bvh and
+    // 1/3 to 1/7 of the flat time from 4096 lights on, at a one-time build
+    // of about 1ms per 1000 lights
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::printf(
+        "%8s %8s %10s %10s %10s %10s %9s %9s %8s %10s %8s\n",
+        "lights", "dynamic", "build ms", "flat ms", "bvh ms", "grid ms",
+        "vs flat", "vs bvh", "builds", "entries", "matches");
+
+    for(size_t lightCount : { 1024, 4096, 16384, 65536 })
+    {
+        // keep the average number of lights per cluster roughly constant
+
+        const float radius =
+            2.5f * std::cbrt(1024.0f / static_cast<float>(lightCount));
+        const auto initialLights = generateSceneLights(lightCount, 1, radius);
+        auto lights = initialLights;
+
+        std::vector<int32_t> staticLights;
+        for(size_t i = 0; i < lights.size(); ++i)
+        {
+            if(i % DYNAMIC_LIGHT_STRIDE != 1)
+                staticLights.push_back(static_cast<int32_t>(i));
+        }
+
+        StaticLightGrid grid;
+        Timer buildTimer;
+        grid.update(lights.data(), lights.size(), staticLights);
+        const double buildMS = buildTimer.ms();
+
+        CPULightCluster flat(threadPool);
+        CPULightCluster bvh(threadPool);
+        CPULightCluster cached(threadPool);
+
+        bvh.setAssignMode(AssignMode::BVH);
+        cached.setAssignMode(AssignMode::StaticGrid);
+        cached.setStaticLightGrid(&grid);
+
+        double flatMS = 0, bvhMS = 0, gridMS = 0;
+        bool matches = true;
+
+        for(int frame = 0; frame < FRAME_COUNT; ++frame)
+        {
+            const SceneCamera &camera = cameras[frame];
+
+            for(size_t i = 1; i < lights.size(); i += DYNAMIC_LIGHT_STRIDE)
+            {
+                const float t = 0.3f * frame + static_cast<float>(i);
+                lights[i].lightPosition.x = initialLights[i].lightPosition.x + std::sin(t);
+                lights[i].lightPosition.z = initialLights[i].lightPosition.z + std::cos(t);
+            }
+
+            for(CPULightCluster *cluster : { &flat, &bvh, &cached })
+            {
+                cluster->setClusterCount(CLUSTER_COUNT);
+                cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+                cluster->updateClusterAABBs();
+                cluster->setView(camera.getView());
+                cluster->setLights(lights.data(), lights.size());
+            }
+
+            flatMS += measureMS([&] { flat.run(); }, 20);
+            bvhMS  += measureMS([&] { bvh.run(); }, 20);
+
+            // the change check of the grid is part of every frame
+
+            gridMS += measureMS([&]
+            {
+                grid.update(lights.data(), lights.size(), staticLights);
+                cached.run();
+            }, 20);
+
+            matches &=
+                flat.getClusterRanges() == cached.getClusterRanges() &&
+                flat.getLightIndices()  == cached.getLightIndices();
+        }
+
+        std::printf(
+            "%8zu %8zu %10.3f %10.3f %10.3f %10.3f %8.2fx %8.2fx %8lld %10zu %8s\n",
+            lightCount, lights.size() - staticLights.size(), buildMS,
+            flatMS / FRAME_COUNT, bvhMS / FRAME_COUNT, gridMS / FRAME_COUNT,
+            flatMS / gridMS, bvhMS / gridMS,
+            static_cast<long long>(grid.getBuildCount()), grid.getEntryCount(),
+            matches ? "yes" : "NO");
+    }
+}
@@ -0,0 +1,98 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchStats(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+
+    SceneCamera camera;
+
+    struct Case
+    {
+        const char *name;
+        size_t      lightCount;
+        float       radius;
+    };
+
+    const Case CASES[] = {
+        { "sparse", 256,   1.0f },
+        { "sample", 1024,  2.5f },
+        { "dense",  16384, 2.5f },
+        { "huge",   16384, 6.0f },
+    };
+
+    std::printf(
+        "%8s %8s %10s %6s %8s %6s %10s %10s %10s %10s %10s %8s\n",
+        "scene", "lights", "pairs", "max", "mean", "p99",
+        "overflow", "dropped", "idx drop", "off ms", "on ms", "matches");
+
+    for(auto &c : CASES)
+    {
+        const auto lights = generateSceneLights(c.lightCount, 1, c.radius);
+
+        CPULightCluster plain(threadPool);
+        CPULightCluster stats(threadPool);
+        CPULightCluster exact(threadPool);
+        stats.setStatisticsEnabled(true);
+        exact.setIndexCapacity(IndexCapacity::Exact);
+
+        for(CPULightCluster *cluster : { &plain, &stats, &exact })
+        {
+            cluster->setClusterCount(CLUSTER_COUNT);
+            cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+            cluster->updateClusterAABBs();
+            cluster->setView(camera.getView());
+            cluster->setLights(lights.data(), lights.size());
+        }
+
+        const double plainMS = measureMS([&] { plain.run(); });
+        const double statsMS = measureMS([&] { stats.run(); });
+        exact.run();
+
+        // statistics must not change the lists, and must agree with
+        // counters rebuilt from the uncapped exact lists
+
+        const int clusterCount = CLUSTER_COUNT.product();
+
+        std::vector<uint32_t> counters(stat::COUNTER_COUNT, 0);
+        for(int ci = 0; ci < clusterCount; ++ci)
+        {
+            const ClusterRange &range = exact.getClusterRanges()[ci];
+            addClusterToStatistics(
+                counters.data(), range.rangeEnd - range.rangeBeg,
+                MAX_LIGHTS_PER_CLUSTER);
+        }
+
+        const ClusterStatistics &s = stats.getStatistics();
+        const ClusterStatistics  r = resolveClusterStatistics(
+            counters.data(), clusterCount, plain.getLightIndexCount());
+
+        const bool matches =
+            plain.getClusterRanges() == stats.getClusterRanges() &&
+            plain.getLightIndices()  == stats.getLightIndices()  &&
+            s.assignmentCount        == r.assignmentCount        &&
+            s.maxLightsPerCluster    == r.maxLightsPerCluster    &&
+            s.p99LightsPerCluster    == r.p99LightsPerCluster    &&
+            s.p99Saturated           == r.p99Saturated           &&
+            s.overflowedClusterCount == r.overflowedClusterCount &&
+            s.clusterOverflowCount   == r.clusterOverflowCount   &&
+            s.indexOverflowCount     == r.indexOverflowCount;
+
+        // a saturated p99 is only a lower bound
+
+        char p99[16];
+        std::snprintf(
+            p99, sizeof(p99), "%s%d",
+            s.p99Saturated ? ">=" : "", s.p99LightsPerCluster);
+
+        std::printf(
+            "%8s %8zu %10lld %6d %8.2f %6s %10d %10lld %10lld %10.3f %10.3f %8s\n",
+            c.name, c.lightCount,
+            static_cast<long long>(s.assignmentCount),
+            s.maxLightsPerCluster, s.meanLightsPerCluster, p99,
+            s.overflowedClusterCount,
+            static_cast<long long>(s.clusterOverflowCount),
+            static_cast<long long>(s.indexOverflowCount),
+            plainMS, statsMS, matches ? "yes" : "NO");
+    }
+}
@@ -0,0 +1,103 @@
+#include "../clustering/light_cluster.h"
+#include "./bench.h"
+
+void benchTemporal(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  FRAME_COUNT   = 32;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096 };
+
+    struct Scenario
+    {
+        const char *name;
+        bool        moveCamera;
+        // every n-th light moves each frame, 0 for none
+        int         movingLightStride;
+    };
+
+    const Scenario SCENARIOS[] = {
+        { "static",        false, 0  },
+        { "1/64 moving",   false, 64 },
+        { "1/16 moving",   false, 16 },
+        { "1/4 moving",    false, 4  },
+        { "moving camera", true,  0  },
+    };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::printf(
+        "%8s %14s %10s %10s %8s %8s %8s %10s %8s\n",
+        "lights", "scenario", "full ms", "reuse ms", "speedup",
+        "reused", "incr", "clusters", "matches");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto initialLights = generateSceneLights(lightCount);
+
+        for(auto &s : SCENARIOS)
+        {
+            auto lights = initialLights;
+
+            CPULightCluster full(threadPool);
+            CPULightCluster reuse(threadPool);
+            reuse.setTemporalReuseEnabled(true);
+
+            double fullMS = 0, reuseMS = 0;
+            bool matches = true;
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const SceneCamera &camera = cameras[s.moveCamera ? frame : 0];
+
+                if(s.movingLightStride)
+                {
+                    for(size_t i = 1; i < lights.size(); i += s.movingLightStride)
+                    {
+                        const float t = 0.3f * frame + static_cast<float>(i);
+                        lights[i].lightPosition.x =
+                            initialLights[i].lightPosition.x + std::sin(t);
+                        lights[i].lightPosition.z =
+                            initialLights[i].lightPosition.z + std::cos(t);
+                    }
+                }
+
+                for(CPULightCluster *cluster : { &full, &reuse })
+                {
+                    cluster->setClusterCount(CLUSTER_COUNT);
+                    cluster->setProj(camera.nearZ, camera.farZ, camera.getProj());
+                    cluster->updateClusterAABBs();
+                    cluster->setView(camera.getView());
+                    cluster->setLights(lights.data(), lights.size());
+                }
+
+                // each frame is timed once, repeating it would turn every
+                // run after the first into a reused one
+
+                Timer fullTimer;
+                full.run();
+                fullMS += fullTimer.ms();
+
+                Timer reuseTimer;
+                reuse.run();
+                reuseMS += reuseTimer.ms();
+
+                matches &= findClusterMismatch(
+                    CLUSTER_COUNT.product(),
+                    full.getClusterRanges(), full.getLightIndices(),
+                    reuse.getClusterRanges(), reuse.getLightIndices()) < 0;
+            }
+
+            const TemporalReuseCounters &counters = reuse.getTemporalReuseCounters();
+
+            std::printf(
+                "%8zu %14s %10.3f %10.3f %8.2f %8.3f %8.3f %10.3f %8s\n",
+                lightCount, s.name,
+                fullMS / FRAME_COUNT, reuseMS / FRAME_COUNT, fullMS / reuseMS,
+                static_cast<double>(counters.reusedFrameCount) / counters.frameCount,
+                static_cast<double>(counters.incrementalFrameCount) / counters.frameCount,
+                static_cast<double>(counters.reusedClusterCount) / counters.clusterCount,
+                matches ? "yes" : "NO");
+        }
+    }
+}
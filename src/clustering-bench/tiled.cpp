@@ -0,0 +1,229 @@
+#include "../clustering/light_cluster.h"
+#include "../clustering/light_tiles.h"
+#include "./bench.h"
+
+namespace
+{
+
+    // light lists seen by the pixels of one depth image
+    struct PixelLightCounts
+    {
+        int64_t pixelCount     = 0;
+        int64_t evaluatedCount = 0;
+        // evaluated lights whose sphere contains the pixel
+        int64_t usefulCount    = 0;
+    };
+
+    // getList(px, py, viewZ) returns the range of the pixel's list in indices
+    template<typename GetList>
+    void countPixelLights(
+        const float              *depth,
+        int                       width,
+        int                       height,
+        const Mat4               &proj,
+        const std::vector<Float3> &viewLights,
+        const std::vector<Light>  &lights,
+        const std::vector<int32_t> &indices,
+        GetList                  &&getList,
+        PixelLightCounts          &counts)
+    {
+        for(int py = 0; py < height; ++py)
+        {
+            for(int px = 0; px < width; ++px)
+            {
+                const float d = depth[static_cast<size_t>(py) * width + px];
+                if(d >= 1)
+                    continue;
+
+                const float z    = depthToViewZ(proj, d);
+                const float ndcX = 2 * (px + 0.5f) / width - 1;
+                const float ndcY = 1 - 2 * (py + 0.5f) / height;
+                const Float3 p   = {
+                    ndcX * z / proj.m[0][0], ndcY * z / proj.m[1][1], z
+                };
+
+                const ClusterRange range = getList(px, py, z);
+                for(int i = range.rangeBeg; i < range.rangeEnd; ++i)
+                {
+                    const int li = indices[i];
+                    const float r = lights[li].maxLightDistance;
+                    if((viewLights[li] - p).length_square() < r * r)
+                        ++counts.usefulCount;
+                }
+
+                counts.evaluatedCount += range.rangeEnd - range.rangeBeg;
+                ++counts.pixelCount;
+            }
+        }
+    }
+
+} // namespace anonymous
+
+void benchTiled(ThreadPool &threadPool)
+{
+    const int WIDTH       = 800;
+    const int HEIGHT      = 600;
+    const int FRAME_COUNT = 4;
+    const int Z_COUNT     = 32;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096 };
+
+    // tiles of 16 and 32 pixels, the default cluster grid of the sample and
+    // clusters on the 16 pixel tiles
+    struct Mode
+    {
+        bool tiled;
+        int  tileSize;
+    };
+
+    const Mode MODES[] = {
+        { true,  16 },
+        { true,  32 },
+        { false, 40 },
+        { false, 16 },
+    };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // both modes read the depth image: tiles for their depth bounds,
+    // clusters to only fill active clusters (findActiveClusters is part of
+    // build ms). lists have no capacity limit; dropped counts the pairs a
+    // MAX_LIGHTS_PER_TILE limit loses. evaluated is the mean list length of
+    // a visible pixel, useful the part of it whose sphere contains the pixel.
+    // at 4096 lights 16 pixel tiles evaluate about as many lights per pixel
+    // as the clusters, with a fraction of their list memory
+
+    std::printf(
+        "%8s %8s %10s %10s %10s %10s %10s %8s %8s\n",
+        "lights", "mode", "grid", "build ms", "list KB", "dropped",
+        "evaluated", "useful", "ratio");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        for(const Mode &mode : MODES)
+        {
+            const Int3 count = getTiledClusterCount(
+                WIDTH, HEIGHT, mode.tileSize, mode.tileSize,
+                mode.tiled ? 1 : Z_COUNT);
+
+            double  buildMS  = 0;
+            int64_t listSize = 0;
+            int64_t dropped  = 0;
+
+            PixelLightCounts counts;
+
+            CPULightTiles   tiles(threadPool);
+            CPULightCluster cluster(threadPool);
+            cluster.setIndexCapacity(IndexCapacity::Exact);
+            cluster.setAssignMode(AssignMode::Hierarchical);
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const SceneCamera &camera = cameras[frame];
+                const Mat4 view  = camera.getView();
+                const Mat4 proj  = camera.getProj();
+                const float *depth = depthImages[frame].data();
+
+                std::vector<Float3> viewLights(lights.size());
+                for(size_t li = 0; li < lights.size(); ++li)
+                    viewLights[li] = view.transformPoint(lights[li].lightPosition);
+
+                if(mode.tiled)
+                {
+                    tiles.setTileCount(count.x, count.y);
+                    tiles.setProj(proj);
+                    tiles.setView(view);
+                    tiles.setLights(lights.data(), lights.size());
+                    tiles.setDepth(depth, WIDTH, HEIGHT);
+
+                    // the limited run finds the same pairs and keeps at
+                    // most MAX_LIGHTS_PER_TILE of each tile
+                    tiles.setLightCountLimited(true);
+                    tiles.run();
+                    dropped += tiles.getAssignmentCount() -
+                               static_cast<int64_t>(tiles.getLightIndices().size());
+
+                    tiles.setLightCountLimited(false);
+                    buildMS += measureMS([&] { tiles.run(); }, 100);
+
+                    listSize += tiles.getTileRanges().size() * sizeof(ClusterRange) +
+                                tiles.getLightIndices().size() * sizeof(int32_t);
+
+                    countPixelLights(
+                        depth, WIDTH, HEIGHT, proj, viewLights, lights,
+                        tiles.getLightIndices(),
+                        [&](int px, int py, float)
+                        {
+                            const int xi = static_cast<int>(
+                                (px + 0.5f) / WIDTH * count.x);
+                            const int yi = static_cast<int>(
+                                (1 - (py + 0.5f) / HEIGHT) * count.y);
+                            return tiles.getTileRanges()[tiles.getTileIndex(xi, yi)];
+                        },
+                        counts);
+                }
+                else
+                {
+                    std::vector<int32_t> activeClusters;
+
+                    cluster.setClusterCount(count);
+                    cluster.setProj(camera.nearZ, camera.farZ, proj);
+                    cluster.updateClusterAABBs();
+                    cluster.setView(view);
+                    cluster.setLights(lights.data(), lights.size());
+                    cluster.setActiveClusters(&activeClusters);
+
+                    buildMS += measureMS([&]
+                    {
+                        activeClusters = findActiveClusters(
+                            threadPool, depth, WIDTH, HEIGHT, count,
+                            camera.nearZ, camera.farZ, proj);
+                        cluster.run();
+                    }, 100);
+
+                    listSize += cluster.getClusterRanges().size() * sizeof(ClusterRange) +
+                                cluster.getLightIndices().size() * sizeof(int32_t);
+
+                    const ClusterSlicing slicing =
+                        getClusterSlicing(count.z, camera.nearZ, camera.farZ);
+
+                    countPixelLights(
+                        depth, WIDTH, HEIGHT, proj, viewLights, lights,
+                        cluster.getLightIndices(),
+                        [&](int px, int py, float z)
+                        {
+                            const int xi = static_cast<int>(
+                                (px + 0.5f) / WIDTH * count.x);
+                            const int yi = static_cast<int>(
+                                (1 - (py + 0.5f) / HEIGHT) * count.y);
+                            const int zi = viewZ2i(slicing, z);
+                            if(zi < 0 || zi >= count.z)
+                                return ClusterRange{};
+                            return cluster.getClusterRanges()[
+                                getClusterIndex(count, xi, yi, zi)];
+                        },
+                        counts);
+                }
+            }
+
+            char grid[32];
+            std::snprintf(grid, sizeof(grid), "%dx%dx%d", count.x, count.y, count.z);
+
+            std::printf(
+                "%8zu %8s %10s %10.3f %10.1f %10.1f %10.2f %8.2f %7.1f%%\n",
+                lightCount, mode.tiled ? "tiles" : "clusters", grid,
+                buildMS / FRAME_COUNT,
+                listSize / 1024.0 / FRAME_COUNT,
+                static_cast<double>(dropped) / FRAME_COUNT,
+                static_cast<double>(counts.evaluatedCount) / counts.pixelCount,
+                static_cast<double>(counts.usefulCount) / counts.pixelCount,
+                100.0 * counts.usefulCount / counts.evaluatedCount);
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+
+#include "../clustering/grid_tuner.h"
+#include "./bench.h"
+
+namespace
+{
+
+    // the grid of the clustered sample before tuning
+    const Int3 DEFAULT_CLUSTER_COUNT = { 20, 15, 32 };
+
+    // set by --save-grid, nothing is written without it
+    const char *gridFilename = nullptr;
+
+    Int3 tune(
+        ThreadPool               &threadPool,
+        const std::vector<Light> &lights,
+        int                       width,
+        int                       height)
+    {
+        constexpr int FRAME_COUNT = 4;
+        constexpr int PRINT_COUNT = 8;
+
+        const auto cameras = generateCameraPath(FRAME_COUNT);
+
+        std::vector<std::vector<float>> depthImages;
+        std::vector<GridTuningFrame>    frames;
+        for(auto &camera : cameras)
+        {
+            SceneCamera c = camera;
+            c.wOverH = static_cast<float>(width) / height;
+            depthImages.push_back(renderSceneDepth(c, width, height));
+
+            frames.push_back(GridTuningFrame{
+                .view   = c.getView(),
+                .proj   = c.getProj(),
+                .nearZ  = c.nearZ,
+                .farZ   = c.farZ,
+                .depth  = depthImages.back().data(),
+                .width  = width,
+                .height = height
+            });
+        }
+
+        ClusterGridTuner tuner(threadPool);
+        tuner.setLights(lights.data(), lights.size());
+        tuner.setFrames(std::move(frames));
+        tuner.run(
+            { 10, 16, 20, 32, 40 },
+            { 8, 12, 15, 24, 30 },
+            { 16, 24, 32, 48, 64 });
+
+        const auto &results = tuner.getResults();
+
+        std::vector<int> order(results.size());
+        for(int i = 0; i < static_cast<int>(order.size()); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+        {
+            return results[a].cost < results[b].cost;
+        });
+
+        // cost is in millions of sphere-aabb tests
+
+        std::printf(
+            "%dx%d, %zu lights, %zu grids\n", width, height,
+            lights.size(), results.size());
+        std::printf(
+            "%12s %10s %10s %10s %8s %10s %10s\n",
+            "grid", "assign ms", "buffer KB", "used KB",
+            "lights/px", "dropped", "cost");
+
+        auto print = [&](const GridTuningResult &r, const char *note)
+        {
+            char grid[32];
+            std::snprintf(
+                grid, sizeof(grid), "%dx%dx%d",
+                r.clusterCount.x, r.clusterCount.y, r.clusterCount.z);
+            std::printf(
+                "%12s %10.3f %10.1f %10.1f %8.2f %10.0f %10.2f%s\n",
+                grid, r.assignMS, r.bufferKB, r.usedKB,
+                r.lightsPerPixel, r.droppedCount, r.cost / 1e6, note);
+        };
+
+        const int recommended = tuner.getRecommendedIndex();
+        for(int i = 0; i < (std::min)(PRINT_COUNT, static_cast<int>(order.size())); ++i)
+            print(results[order[i]], order[i] == recommended ? "  <- recommended" : "");
+
+        for(auto &r : results)
+        {
+            if(r.clusterCount == DEFAULT_CLUSTER_COUNT)
+                print(r, "  <- default");
+        }
+
+        return recommended >= 0 ?
+               results[recommended].clusterCount : DEFAULT_CLUSTER_COUNT;
+    }
+
+} // namespace anonymous
+
+void benchTune(ThreadPool &threadPool)
+{
+    const auto lights = generateSceneLights(1024);
+
+    // the sample window size first, its grid is saved
+
+    const Int3 grid = tune(threadPool, lights, 800, 600);
+
+    std::printf("\n");
+    tune(threadPool, lights, 1920, 1080);
+
+    if(!gridFilename)
+    {
+        std::printf(
+            "\npass --save-grid ./asset/clustered/cluster_grid.txt to save the grid\n");
+    }
+    else if(saveClusterGrid(gridFilename, grid))
+    {
+        std::printf(
+            "\nsaved %dx%dx%d to %s\n", grid.x, grid.y, grid.z, gridFilename);
+    }
+    else
+        std::printf("\nfailed to save the grid to %s\n", gridFilename);
+}
+
+void setTunedGridFilename(const char *filename)
+{
+    gridFilename = filename;
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+
+#include "../clustering/light_cluster.h"
+#include "../clustering/zbin.h"
+#include "./bench.h"
+
+void benchZBin(ThreadPool &threadPool)
+{
+    const Int3 CLUSTER_COUNT = { 20, 15, 32 };
+    const int  WIDTH         = 800;
+    const int  HEIGHT        = 600;
+    const int  FRAME_COUNT   = 4;
+    const int  PIXEL_STEP    = 2;
+
+    const size_t LIGHT_COUNTS[] = { 1024, 4096 };
+
+    // tiles of the cluster grid, and 16x16 pixel tiles
+    const Int3 BIN_COUNTS[] = { { 20, 15, 256 }, { 50, 38, 256 } };
+
+    const auto cameras = generateCameraPath(FRAME_COUNT);
+
+    std::vector<std::vector<float>> depthImages;
+    for(auto &camera : cameras)
+        depthImages.push_back(renderSceneDepth(camera, WIDTH, HEIGHT));
+
+    // candidates are the lights a pixel loops over. matches compares the
+    // lights that actually reach each pixel, which must be the same for both
+    // paths since both are conservative
+
+    std::printf(
+        "%8s %10s %10s %10s %12s %12s %10s %10s %8s\n",
+        "lights", "grid", "cluster ms", "zbin ms", "cluster KB",
+        "zbin KB", "cluster/px", "zbin/px", "matches");
+
+    for(size_t lightCount : LIGHT_COUNTS)
+    {
+        const auto lights = generateSceneLights(lightCount);
+
+        for(const Int3 &binCount : BIN_COUNTS)
+        {
+            CPULightCluster cluster(threadPool);
+            cluster.setIndexCapacity(IndexCapacity::Exact);
+            cluster.setClusterCount(CLUSTER_COUNT);
+
+            CPUZBinning zBinning(threadPool);
+            zBinning.setBinCount(binCount);
+
+            double clusterMS = 0, zBinMS = 0;
+            double clusterKB = 0, zBinKB = 0;
+            int64_t clusterCandidates = 0, zBinCandidates = 0, pixelCount = 0;
+            bool matches = true;
+
+            std::vector<Float3>  viewLights(lights.size());
+            std::vector<int32_t> clusterLights, zBinLights;
+
+            for(int frame = 0; frame < FRAME_COUNT; ++frame)
+            {
+                const SceneCamera &camera = cameras[frame];
+                const Mat4 view = camera.getView();
+                const Mat4 proj = camera.getProj();
+
+                cluster.setProj(camera.nearZ, camera.farZ, proj);
+                cluster.updateClusterAABBs();
+                cluster.setView(view);
+                cluster.setLights(lights.data(), lights.size());
+
+                zBinning.setProj(camera.nearZ, camera.farZ, proj);
+                zBinning.setView(view);
+                matches &= zBinning.setLights(lights.data(), lights.size());
+
+                clusterMS += measureMS([&] { cluster.run(); }, 20);
+                zBinMS    += measureMS([&] { zBinning.run(); }, 20);
+
+                clusterKB += (cluster.getClusterRanges().size() * sizeof(ClusterRange) +
+                              cluster.getLightIndices().size() * sizeof(int32_t)) / 1024.0;
+                zBinKB += zBinning.getByteSize() / 1024.0;
+
+                for(size_t i = 0; i < lights.size(); ++i)
+                    viewLights[i] = view.transformPoint(lights[i].lightPosition);
+
+                const Mat4 invProj = proj.inv();
+                const ClusterSlicing slicing = getClusterSlicing(
+                    CLUSTER_COUNT.z, camera.nearZ, camera.farZ);
+
+                // keep lights reaching p, in a comparable order
+                auto filter = [&](std::vector<int32_t> &indices, const Float3 &p)
+                {
+                    std::erase_if(indices, [&](int32_t li)
+                    {
+                        const float r = lights[li].maxLightDistance;
+                        return (viewLights[li] - p).length_square() >= r * r;
+                    });
+                    std::sort(indices.begin(), indices.end());
+                };
+
+                const float *depth = depthImages[frame].data();
+                for(int py = 0; py < HEIGHT; py += PIXEL_STEP)
+                {
+                    for(int px = 0; px < WIDTH; px += PIXEL_STEP)
+                    {
+                        const float d = depth[static_cast<size_t>(py) * WIDTH + px];
+                        if(d >= 1)
+                            continue;
+
+                        const float scrX = (px + 0.5f) / WIDTH;
+                        const float scrY = 1 - (py + 0.5f) / HEIGHT;
+                        const Float3 p = (Float4{
+                            2 * scrX - 1, 2 * scrY - 1, d, 1 } * invProj).homogenize();
+
+                        clusterLights.clear();
+                        const int xi = static_cast<int>(scrX * CLUSTER_COUNT.x);
+                        const int yi = static_cast<int>(scrY * CLUSTER_COUNT.y);
+                        const int zi = viewZ2i(slicing, p.z);
+                        if(0 <= zi && zi < CLUSTER_COUNT.z)
+                        {
+                            const ClusterRange &range = cluster.getClusterRanges()[
+                                getClusterIndex(CLUSTER_COUNT, xi, yi, zi)];
+                            clusterLights.assign(
+                                cluster.getLightIndices().begin() + range.rangeBeg,
+                                cluster.getLightIndices().begin() + range.rangeEnd);
+                        }
+
+                        zBinLights.clear();
+                        zBinning.getLights(
+                            static_cast<int>(scrX * binCount.x),
+                            static_cast<int>(scrY * binCount.y),
+                            p.z, zBinLights);
+
+                        clusterCandidates += clusterLights.size();
+                        zBinCandidates    += zBinLights.size();
+                        ++pixelCount;
+
+                        filter(clusterLights, p);
+                        filter(zBinLights, p);
+                        matches &= clusterLights == zBinLights;
+                    }
+                }
+            }
+
+            char grid[32];
+            std::snprintf(grid, sizeof(grid), "%dx%d", binCount.x, binCount.y);
+
+            std::printf(
+                "%8zu %10s %10.3f %10.3f %12.1f %12.1f %10.1f %10.1f %8s\n",
+                lightCount, grid,
+                clusterMS / FRAME_COUNT, zBinMS / FRAME_COUNT,
+                clusterKB / FRAME_COUNT, zBinKB / FRAME_COUNT,
+                static_cast<double>(clusterCandidates) / pixelCount,
+                static_cast<double>(zBinCandidates) / pixelCount,
+                matches ? "yes" : "NO");
+        }
+    }
+}
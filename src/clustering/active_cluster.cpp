@@ -0,0 +1,77 @@
+#include "./active_cluster.h"
+
+namespace clustering
+{
+
+    std::vector<int32_t> findActiveClusters(
+        ThreadPool          &threadPool,
+        const float         *depth,
+        int                  width,
+        int                  height,
+        const Int3          &clusterCount,
+        float                nearZ,
+        float                farZ,
+        const Mat4          &proj,
+        const SlicingPolicy &policy)
+    {
+        const ClusterSlicing slicing =
+            getClusterSlicing(clusterCount.z, nearZ, farZ, policy);
+
+        // pixel columns of cluster column xi are [columnBeg[xi], columnBeg[xi + 1])
+
+        std::vector<int> columnBeg(clusterCount.x + 1, width);
+        for(int px = width - 1; px >= 0; --px)
+        {
+            const float scrX = (px + 0.5f) / width;
+            const int xi = static_cast<int>(std::floor(scrX * clusterCount.x));
+            if(0 <= xi && xi < clusterCount.x)
+                columnBeg[xi] = px;
+        }
+        for(int xi = clusterCount.x - 1; xi >= 0; --xi)
+            columnBeg[xi] = (std::min)(columnBeg[xi], columnBeg[xi + 1]);
+
+        // each cluster column owns a disjoint range of flags
+
+        std::vector<uint8_t> flags(clusterCount.product(), 0);
+
+        threadPool.parallelFor(
+            clusterCount.x, 1, [&](int beg, int end, int)
+        {
+            for(int py = 0; py < height; ++py)
+            {
+                const float scrY = 1 - (py + 0.5f) / height;
+                const int yi = static_cast<int>(std::floor(scrY * clusterCount.y));
+                if(yi < 0 || yi >= clusterCount.y)
+                    continue;
+
+                const float *row = depth + static_cast<size_t>(py) * width;
+                for(int px = columnBeg[beg]; px < columnBeg[end]; ++px)
+                {
+                    if(row[px] >= 1)
+                        continue;
+
+                    const float scrX = (px + 0.5f) / width;
+                    const int xi = static_cast<int>(
+                        std::floor(scrX * clusterCount.x));
+                    const int zi = viewZ2i(slicing, depthToViewZ(proj, row[px]));
+                    if(zi < 0 || zi >= clusterCount.z)
+                        continue;
+
+                    flags[getClusterIndex(clusterCount, xi, yi, zi)] = 1;
+                }
+            }
+        });
+
+        // compact
+
+        std::vector<int32_t> result;
+        for(int ci = 0; ci < clusterCount.product(); ++ci)
+        {
+            if(flags[ci])
+                result.push_back(ci);
+        }
+
+        return result;
+    }
+
+} // namespace clustering
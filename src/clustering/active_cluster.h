@@ -0,0 +1,32 @@
+#pragma once
+
+#include "./common.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // depth buffer value -> view space z, for a perspective projection in
+    // the row-vector convention (clip.z = z * m[2][2] + m[3][2], clip.w = z)
+    inline float depthToViewZ(const Mat4 &proj, float depth)
+    {
+        return proj.m[3][2] / (depth - proj.m[2][2]);
+    }
+
+    // cpu reference of CSMarkActiveClusters and CSCompactActiveClusters in
+    // asset/clustered/cluster.hlsl. depth is a width * height image of depth
+    // buffer values with row 0 at the top of the screen. samples at the far
+    // plane (depth >= 1) are ignored.
+    // returns the clusters containing at least one sample, in ascending order
+    std::vector<int32_t> findActiveClusters(
+        ThreadPool          &threadPool,
+        const float         *depth,
+        int                  width,
+        int                  height,
+        const Int3          &clusterCount,
+        float                nearZ,
+        float                farZ,
+        const Mat4          &proj,
+        const SlicingPolicy &policy = {});
+
+} // namespace clustering
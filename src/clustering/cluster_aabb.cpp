@@ -0,0 +1,273 @@
+#include "./cluster_aabb.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        Float3 getFrustumDirection(
+            const Float3 &A,
+            const Float3 &B,
+            const Float3 &C,
+            const Float3 &D,
+            float         scrX,
+            float         scrY)
+        {
+            const Float3 AB = lerp(A, B, scrX);
+            const Float3 CD = lerp(C, D, scrX);
+            return lerp(CD, AB, scrY).normalize();
+        }
+
+        Float3 getClusterVertex(const Float3 &dir, float z)
+        {
+            return dir * z / dir.z;
+        }
+
+    } // namespace anonymous
+
+    std::vector<AABB> buildClusterAABBs(
+        const Int3          &clusterCount,
+        float                nearZ,
+        float                farZ,
+        const Mat4          &proj,
+        const SlicingPolicy &slicing)
+    {
+        const ClusterSlicing clusterSlicing =
+            getClusterSlicing(clusterCount.z, nearZ, farZ, slicing);
+
+        std::vector<AABB> result;
+        result.reserve(clusterCount.product());
+
+        const Mat4 invProj = proj.inv();
+
+        const Float3 frustumA =
+            (Float4{ -1, +1, 0.5f, 1 } * invProj).homogenize().normalize();
+        const Float3 frustumB =
+            (Float4{ +1, +1, 0.5f, 1 } * invProj).homogenize().normalize();
+        const Float3 frustumC =
+            (Float4{ -1, -1, 0.5f, 1 } * invProj).homogenize().normalize();
+        const Float3 frustumD =
+            (Float4{ +1, -1, 0.5f, 1 } * invProj).homogenize().normalize();
+
+        for(int xi = 0; xi < clusterCount.x; ++xi)
+        {
+            const float lowerScrX = static_cast<float>(xi    ) / clusterCount.x;
+            const float upperScrX = static_cast<float>(xi + 1) / clusterCount.x;
+
+            for(int yi = 0; yi < clusterCount.y; ++yi)
+            {
+                const float lowerScrY = static_cast<float>(yi    ) / clusterCount.y;
+                const float upperScrY = static_cast<float>(yi + 1) / clusterCount.y;
+
+                const Float3 A = getFrustumDirection(
+                    frustumA, frustumB, frustumC, frustumD, lowerScrX, upperScrY);
+                const Float3 B = getFrustumDirection(
+                    frustumA, frustumB, frustumC, frustumD, upperScrX, upperScrY);
+                const Float3 C = getFrustumDirection(
+                    frustumA, frustumB, frustumC, frustumD, lowerScrX, lowerScrY);
+                const Float3 D = getFrustumDirection(
+                    frustumA, frustumB, frustumC, frustumD, upperScrX, lowerScrY);
+
+                for(int zi = 0; zi < clusterCount.z; ++zi)
+                {
+                    const float lowerZ = clusterI2Z(clusterSlicing, zi);
+                    const float upperZ = clusterI2Z(clusterSlicing, zi + 1);
+
+                    const Float3 corners[] = {
+                        getClusterVertex(A, lowerZ),
+                        getClusterVertex(B, lowerZ),
+                        getClusterVertex(C, lowerZ),
+                        getClusterVertex(D, lowerZ),
+                        getClusterVertex(A, upperZ),
+                        getClusterVertex(B, upperZ),
+                        getClusterVertex(C, upperZ),
+                        getClusterVertex(D, upperZ)
+                    };
+
+                    AABB aabb = {
+                        Float3((std::numeric_limits<float>::max)()),
+                        Float3(std::numeric_limits<float>::lowest())
+                    };
+                    for(auto &p : corners)
+                    {
+                        aabb.lower = vec_min(aabb.lower, p);
+                        aabb.upper = vec_max(aabb.upper, p);
+                    }
+
+                    result.push_back(aabb);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    ClusterAABBBuilder::ClusterAABBBuilder(ThreadPool &threadPool)
+        : threadPool_(threadPool), cacheHitCount_(0), cacheMissCount_(0)
+    {
+
+    }
+
+    const std::vector<AABB> &ClusterAABBBuilder::build(
+        const ClusterAABBKey &key)
+    {
+        for(auto it = cache_.begin(); it != cache_.end(); ++it)
+        {
+            if(it->key == key)
+            {
+                cache_.splice(cache_.begin(), cache_, it);
+                ++cacheHitCount_;
+                return cache_.front().aabbs;
+            }
+        }
+
+        ++cacheMissCount_;
+
+        if(cache_.size() >= CACHE_SIZE)
+        {
+            // reuse the storage of the least recently used entry
+            cache_.splice(cache_.begin(), cache_, std::prev(cache_.end()));
+        }
+        else
+            cache_.emplace_front();
+
+        Entry &entry = cache_.front();
+        entry.key = key;
+        buildAABBs(key, entry.aabbs);
+
+        return entry.aabbs;
+    }
+
+    int64_t ClusterAABBBuilder::getCacheHitCount() const
+    {
+        return cacheHitCount_;
+    }
+
+    int64_t ClusterAABBBuilder::getCacheMissCount() const
+    {
+        return cacheMissCount_;
+    }
+
+    void ClusterAABBBuilder::clearCache()
+    {
+        cache_.clear();
+    }
+
+    void ClusterAABBBuilder::buildAABBs(
+        const ClusterAABBKey &key, std::vector<AABB> &aabbs)
+    {
+        const Int3 &count = key.clusterCount;
+        aabbs.resize(count.product());
+
+        // slice depths
+
+        const ClusterSlicing slicing =
+            getClusterSlicing(count.z, key.nearZ, key.farZ, key.slicing);
+
+        sliceZ_.resize(count.z + 1);
+        for(int zi = 0; zi <= count.z; ++zi)
+            sliceZ_[zi] = clusterI2Z(slicing, zi);
+
+        // frustum corner directions
+
+        const Mat4 invProj = key.proj.inv();
+
+        const Float3 frustumA =
+            (Float4{ -1, +1, 0.5f, 1 } * invProj).homogenize().normalize();
+        const Float3 frustumB =
+            (Float4{ +1, +1, 0.5f, 1 } * invProj).homogenize().normalize();
+        const Float3 frustumC =
+            (Float4{ -1, -1, 0.5f, 1 } * invProj).homogenize().normalize();
+        const Float3 frustumD =
+            (Float4{ +1, -1, 0.5f, 1 } * invProj).homogenize().normalize();
+
+        const int boundaryCount = count.z + 1;
+
+        threadPool_.parallelFor(
+            count.x * count.y, 4, [&](int beg, int end, int)
+        {
+            // bounds of the 4 corners at each slice boundary
+            std::vector<float> bounds(6 * boundaryCount);
+            float *lowerX = bounds.data();
+            float *lowerY = lowerX + boundaryCount;
+            float *lowerZ = lowerY + boundaryCount;
+            float *upperX = lowerZ + boundaryCount;
+            float *upperY = upperX + boundaryCount;
+            float *upperZ = upperY + boundaryCount;
+
+            const float *sliceZ = sliceZ_.data();
+
+            for(int ti = beg; ti < end; ++ti)
+            {
+                const int xi = ti / count.y;
+                const int yi = ti % count.y;
+
+                const float lowerScrX = static_cast<float>(xi    ) / count.x;
+                const float upperScrX = static_cast<float>(xi + 1) / count.x;
+                const float lowerScrY = static_cast<float>(yi    ) / count.y;
+                const float upperScrY = static_cast<float>(yi + 1) / count.y;
+
+                const Float3 dirs[4] = {
+                    getFrustumDirection(
+                        frustumA, frustumB, frustumC, frustumD,
+                        lowerScrX, upperScrY),
+                    getFrustumDirection(
+                        frustumA, frustumB, frustumC, frustumD,
+                        upperScrX, upperScrY),
+                    getFrustumDirection(
+                        frustumA, frustumB, frustumC, frustumD,
+                        lowerScrX, lowerScrY),
+                    getFrustumDirection(
+                        frustumA, frustumB, frustumC, frustumD,
+                        upperScrX, lowerScrY)
+                };
+
+                // same arithmetic as getClusterVertex, but once per boundary
+                // instead of twice per cluster
+
+                for(int b = 0; b < boundaryCount; ++b)
+                {
+                    const float z = sliceZ[b];
+
+                    float lx = dirs[0].x * z / dirs[0].z, ux = lx;
+                    float ly = dirs[0].y * z / dirs[0].z, uy = ly;
+                    float lz = dirs[0].z * z / dirs[0].z, uz = lz;
+                    for(int i = 1; i < 4; ++i)
+                    {
+                        const float x = dirs[i].x * z / dirs[i].z;
+                        const float y = dirs[i].y * z / dirs[i].z;
+                        const float w = dirs[i].z * z / dirs[i].z;
+                        lx = (std::min)(lx, x); ux = (std::max)(ux, x);
+                        ly = (std::min)(ly, y); uy = (std::max)(uy, y);
+                        lz = (std::min)(lz, w); uz = (std::max)(uz, w);
+                    }
+
+                    lowerX[b] = lx; upperX[b] = ux;
+                    lowerY[b] = ly; upperY[b] = uy;
+                    lowerZ[b] = lz; upperZ[b] = uz;
+                }
+
+                // cluster zi is bounded by boundaries zi and zi + 1
+
+                AABB *output = aabbs.data() + ti * count.z;
+                for(int zi = 0; zi < count.z; ++zi)
+                {
+                    output[zi] = AABB{
+                        {
+                            (std::min)(lowerX[zi], lowerX[zi + 1]),
+                            (std::min)(lowerY[zi], lowerY[zi + 1]),
+                            (std::min)(lowerZ[zi], lowerZ[zi + 1])
+                        },
+                        {
+                            (std::max)(upperX[zi], upperX[zi + 1]),
+                            (std::max)(upperY[zi], upperY[zi + 1]),
+                            (std::max)(upperZ[zi], upperZ[zi + 1])
+                        }
+                    };
+                }
+            }
+        });
+    }
+
+} // namespace clustering
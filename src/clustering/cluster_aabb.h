@@ -0,0 +1,79 @@
+#pragma once
+
+#include <list>
+
+#include "./common.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // scalar reference, a direct port of the original triple loop in
+    // LightCluster::initClusterAABBBuffer. result is indexed by
+    // getClusterIndex
+    std::vector<AABB> buildClusterAABBs(
+        const Int3          &clusterCount,
+        float                nearZ,
+        float                farZ,
+        const Mat4          &proj,
+        const SlicingPolicy &slicing = {});
+
+    // everything the cluster aabbs depend on
+    struct ClusterAABBKey
+    {
+        Int3  clusterCount;
+        float nearZ = 0;
+        float farZ  = 0;
+        Mat4  proj;
+
+        SlicingPolicy slicing;
+
+        bool operator==(const ClusterAABBKey &) const noexcept = default;
+    };
+
+    // parallel version of buildClusterAABBs with bit-identical results.
+    // slice depths are computed once per build, and each tile evaluates
+    // its corner rays at the z-count + 1 slice boundaries in flat loops
+    // over float arrays, which the compiler vectorizes.
+    // the last CACHE_SIZE results are kept, so switching back to a
+    // previous projection (e.g. when the window is resized back) is free
+    class ClusterAABBBuilder
+    {
+    public:
+
+        static constexpr int CACHE_SIZE = 4;
+
+        explicit ClusterAABBBuilder(ThreadPool &threadPool);
+
+        // the returned reference stays valid until CACHE_SIZE other keys
+        // have been built
+        const std::vector<AABB> &build(const ClusterAABBKey &key);
+
+        int64_t getCacheHitCount() const;
+
+        int64_t getCacheMissCount() const;
+
+        void clearCache();
+
+    private:
+
+        struct Entry
+        {
+            ClusterAABBKey    key;
+            std::vector<AABB> aabbs;
+        };
+
+        void buildAABBs(const ClusterAABBKey &key, std::vector<AABB> &aabbs);
+
+        ThreadPool &threadPool_;
+
+        // most recently used first
+        std::list<Entry> cache_;
+
+        std::vector<float> sliceZ_;
+
+        int64_t cacheHitCount_;
+        int64_t cacheMissCount_;
+    };
+
+} // namespace clustering
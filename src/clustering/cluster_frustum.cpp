@@ -0,0 +1,168 @@
+#include "./cluster_frustum.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        // unit normal of the plane through the origin and the points whose
+        // ndc coordinate along axis (0: x, 1: y) is ndc, i.e.
+        // clip[axis] - ndc * clip.w = 0. the positive side is ndc' >= ndc
+        // for sign = 1 and ndc' <= ndc for sign = -1
+        Float3 getNDCPlaneNormal(const Mat4 &proj, int axis, float ndc, float sign)
+        {
+            const Float3 normal = {
+                proj.m[0][axis] - ndc * proj.m[0][3],
+                proj.m[1][axis] - ndc * proj.m[1][3],
+                proj.m[2][axis] - ndc * proj.m[2][3]
+            };
+            return normal * (sign / normal.length());
+        }
+
+        ClusterTilePlanes makeTilePlanes(
+            const Float3 &left, const Float3 &bottom,
+            const Float3 &right, const Float3 &top)
+        {
+            ClusterTilePlanes result;
+            result.normals[0] = left;
+            result.normals[1] = bottom;
+            result.normals[2] = right;
+            result.normals[3] = top;
+
+            for(int i = 0; i < 4; ++i)
+            {
+                const Float3 &a = result.normals[i];
+                const Float3 &b = result.normals[(i + 1) % 4];
+                result.edges[i]     = cross(a, b).normalize();
+                result.cosAngles[i] = dot(a, b);
+            }
+
+            return result;
+        }
+
+        // closest point on triangle abc, from real-time collision detection
+        // 5.1.5
+        Float3 getClosestPointOnTriangle(
+            const Float3 &p, const Float3 &a, const Float3 &b, const Float3 &c)
+        {
+            const Float3 ab = b - a;
+            const Float3 ac = c - a;
+
+            const Float3 ap = p - a;
+            const float d1 = dot(ab, ap);
+            const float d2 = dot(ac, ap);
+            if(d1 <= 0 && d2 <= 0)
+                return a;
+
+            const Float3 bp = p - b;
+            const float d3 = dot(ab, bp);
+            const float d4 = dot(ac, bp);
+            if(d3 >= 0 && d4 <= d3)
+                return b;
+
+            const float vc = d1 * d4 - d3 * d2;
+            if(vc <= 0 && d1 >= 0 && d3 <= 0)
+                return a + ab * (d1 / (d1 - d3));
+
+            const Float3 cp = p - c;
+            const float d5 = dot(ab, cp);
+            const float d6 = dot(ac, cp);
+            if(d6 >= 0 && d5 <= d6)
+                return c;
+
+            const float vb = d5 * d2 - d1 * d6;
+            if(vb <= 0 && d2 >= 0 && d6 <= 0)
+                return a + ac * (d2 / (d2 - d6));
+
+            const float va = d3 * d6 - d5 * d4;
+            if(va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+                return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+            const float denom = 1 / (va + vb + vc);
+            return a + ab * (vb * denom) + ac * (vc * denom);
+        }
+
+        float getQuadDistanceSquare(
+            const Float3 &p,
+            const Float3 &a, const Float3 &b, const Float3 &c, const Float3 &d)
+        {
+            return (std::min)(
+                (getClosestPointOnTriangle(p, a, b, c) - p).length_square(),
+                (getClosestPointOnTriangle(p, a, c, d) - p).length_square());
+        }
+
+    } // namespace anonymous
+
+    std::vector<ClusterTilePlanes> buildClusterTilePlanes(
+        const Int3 &clusterCount, const Mat4 &proj)
+    {
+        std::vector<ClusterTilePlanes> result;
+        result.reserve(clusterCount.x * clusterCount.y);
+
+        for(int xi = 0; xi < clusterCount.x; ++xi)
+        {
+            const float lowerX = 2.0f * xi / clusterCount.x - 1;
+            const float upperX = 2.0f * (xi + 1) / clusterCount.x - 1;
+
+            const Float3 left  = getNDCPlaneNormal(proj, 0, lowerX, 1);
+            const Float3 right = getNDCPlaneNormal(proj, 0, upperX, -1);
+
+            for(int yi = 0; yi < clusterCount.y; ++yi)
+            {
+                const float lowerY = 2.0f * yi / clusterCount.y - 1;
+                const float upperY = 2.0f * (yi + 1) / clusterCount.y - 1;
+
+                result.push_back(makeTilePlanes(
+                    left,
+                    getNDCPlaneNormal(proj, 1, lowerY, 1),
+                    right,
+                    getNDCPlaneNormal(proj, 1, upperY, -1)));
+            }
+        }
+
+        return result;
+    }
+
+    bool isLightInClusterExact(
+        const Float3            &lightPosition,
+        float                    maxLightDistance,
+        const ClusterTilePlanes &planes,
+        float                    lowerZ,
+        float                    upperZ)
+    {
+        const Float3 &p = lightPosition;
+
+        bool inside = lowerZ <= p.z && p.z <= upperZ;
+        for(auto &normal : planes.normals)
+            inside &= dot(normal, p) >= 0;
+        if(inside)
+            return true;
+
+        // outside the slice, the closest point is on one of its faces.
+        // corner i is on edge i, scaled to the slice depths
+
+        Float3 lower[4], upper[4];
+        for(int i = 0; i < 4; ++i)
+        {
+            const Float3 &edge = planes.edges[i];
+            lower[i] = edge * (lowerZ / edge.z);
+            upper[i] = edge * (upperZ / edge.z);
+        }
+
+        float distSquare = (std::min)(
+            getQuadDistanceSquare(p, lower[0], lower[1], lower[2], lower[3]),
+            getQuadDistanceSquare(p, upper[0], upper[1], upper[2], upper[3]));
+
+        for(int i = 0; i < 4; ++i)
+        {
+            const int j = (i + 1) % 4;
+            distSquare = (std::min)(
+                distSquare,
+                getQuadDistanceSquare(p, lower[i], lower[j], upper[j], upper[i]));
+        }
+
+        return distSquare < maxLightDistance * maxLightDistance;
+    }
+
+} // namespace clustering
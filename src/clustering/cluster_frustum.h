@@ -0,0 +1,105 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // the clusters of a screen tile lie between four planes through the
+    // view space origin. a cluster aabb bounds a frustum slice with slanted
+    // sides, so it is wider than the slice, most of all near the screen
+    // borders and in deep slices, and accepts lights that only touch its
+    // empty corners. testing the tile planes as well rejects part of them
+
+    // same values as CLUSTER_TEST_* in asset/clustered/common.hlsl
+    enum class ClusterTest : int32_t
+    {
+        // sphere against the cluster aabb
+        AABB    = 0,
+        // sphere against the aabb and the pyramid of the cluster's screen
+        // tile, see isLightInClusterFrustum
+        Frustum = 1
+    };
+
+    // side planes dot(n, p) = 0 of a tile, with unit normals pointing into
+    // the tile. same as getTilePlanes in asset/clustered/common.hlsl
+    struct ClusterTilePlanes
+    {
+        // left, bottom, right and top, so neighbouring planes are adjacent
+        Float3 normals[4];
+
+        // unit direction of the edge shared by normals[i] and
+        // normals[(i + 1) % 4], and the cosine between the two normals
+        Float3 edges[4];
+        float  cosAngles[4] = {};
+    };
+
+    // indexed by xi * count.y + yi, the tile part of getClusterIndex
+    std::vector<ClusterTilePlanes> buildClusterTilePlanes(
+        const Int3 &clusterCount, const Mat4 &proj);
+
+    // whether the sphere overlaps the pyramid of the tile. same as
+    // isLightInTilePlanes in asset/clustered/common.hlsl.
+    // lightPosition is in view space
+    inline bool isLightInTilePlanes(
+        const Float3            &lightPosition,
+        float                    maxLightDistance,
+        const ClusterTilePlanes &planes)
+    {
+        const Float3 &p = lightPosition;
+        const float   r = maxLightDistance;
+
+        float d[4];
+        for(int i = 0; i < 4; ++i)
+        {
+            d[i] = dot(planes.normals[i], p);
+            if(d[i] <= -r)
+                return false;
+        }
+
+        // a center outside two neighbouring planes is closest to their
+        // shared edge, unless its projection onto one plane is inside the
+        // other one. the spheres of small tiles often end up here
+
+        for(int i = 0; i < 4; ++i)
+        {
+            const int j = (i + 1) % 4;
+            if(d[i] >= 0 || d[j] >= 0)
+                continue;
+
+            const float c = planes.cosAngles[i];
+            if(d[j] - d[i] * c >= 0 || d[i] - d[j] * c >= 0)
+                continue;
+
+            const float t = dot(planes.edges[i], p);
+            if(p.length_square() - t * t >= r * r)
+                return false;
+        }
+
+        return true;
+    }
+
+    // aabb and tile pyramid. still conservative: a sphere near a corner of
+    // the slice may pass both without touching the slice
+    inline bool isLightInClusterFrustum(
+        const Float3            &lightPosition,
+        float                    maxLightDistance,
+        const AABB              &aabb,
+        const ClusterTilePlanes &planes)
+    {
+        return isLightInAABB(lightPosition, maxLightDistance, aabb) &&
+               isLightInTilePlanes(lightPosition, maxLightDistance, planes);
+    }
+
+    // exact reference: whether the sphere overlaps the slice of the tile
+    // between view z lowerZ and upperZ. computes the distance to the
+    // faces of the slice, so it is only meant for measuring the false
+    // positives of the tests above
+    bool isLightInClusterExact(
+        const Float3            &lightPosition,
+        float                    maxLightDistance,
+        const ClusterTilePlanes &planes,
+        float                    lowerZ,
+        float                    upperZ);
+
+} // namespace clustering
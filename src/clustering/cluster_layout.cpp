@@ -0,0 +1,94 @@
+#include <algorithm>
+
+#include "./active_cluster.h"
+#include "./cluster_layout.h"
+
+namespace clustering
+{
+
+    ClusterLookupStatistics simulateClusterLookups(
+        const float              *depth,
+        int                       width,
+        int                       height,
+        const Int3               &clusterCount,
+        float                     nearZ,
+        float                     farZ,
+        const Mat4               &proj,
+        const SlicingPolicy      &slicing,
+        ClusterLayout             layout,
+        int                       rangeStride,
+        const ClusterLookupCache &cache)
+    {
+        const ClusterSlicing clusterSlicing =
+            getClusterSlicing(clusterCount.z, nearZ, farZ, slicing);
+
+        ClusterLookupStatistics result;
+
+        // most recently used line last
+        std::vector<int64_t> lruLines;
+        lruLines.reserve(cache.lineCount);
+
+        std::vector<int64_t> warpLines;
+
+        for(int wy = 0; wy < height; wy += cache.warpHeight)
+        {
+            for(int wx = 0; wx < width; wx += cache.warpWidth)
+            {
+                warpLines.clear();
+
+                const int yEnd = (std::min)(wy + cache.warpHeight, height);
+                const int xEnd = (std::min)(wx + cache.warpWidth, width);
+                for(int py = wy; py < yEnd; ++py)
+                {
+                    const float scrY = 1 - (py + 0.5f) / height;
+                    const int yi = static_cast<int>(scrY * clusterCount.y);
+
+                    for(int px = wx; px < xEnd; ++px)
+                    {
+                        const float d = depth[static_cast<size_t>(py) * width + px];
+                        if(d >= 1)
+                            continue;
+
+                        const float scrX = (px + 0.5f) / width;
+                        const int xi = static_cast<int>(scrX * clusterCount.x);
+                        const int zi = viewZ2i(clusterSlicing, depthToViewZ(proj, d));
+                        if(zi < 0 || zi >= clusterCount.z)
+                            continue;
+
+                        const int64_t slot =
+                            getClusterSlot(layout, clusterCount, xi, yi, zi);
+                        warpLines.push_back(slot * rangeStride / cache.lineSize);
+                        ++result.pixelCount;
+                    }
+                }
+
+                if(warpLines.empty())
+                    continue;
+
+                std::sort(warpLines.begin(), warpLines.end());
+                warpLines.erase(
+                    std::unique(warpLines.begin(), warpLines.end()), warpLines.end());
+
+                ++result.warpCount;
+                result.lineTouches += warpLines.size();
+
+                for(int64_t line : warpLines)
+                {
+                    auto it = std::find(lruLines.begin(), lruLines.end(), line);
+                    if(it != lruLines.end())
+                        lruLines.erase(it);
+                    else
+                    {
+                        ++result.cacheMisses;
+                        if(static_cast<int>(lruLines.size()) >= cache.lineCount)
+                            lruLines.erase(lruLines.begin());
+                    }
+                    lruLines.push_back(line);
+                }
+            }
+        }
+
+        return result;
+    }
+
+} // namespace clustering
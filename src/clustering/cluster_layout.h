@@ -0,0 +1,85 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // the slot functions are shared with the shaders
+    namespace shader
+    {
+        #include "../../asset/clustered/cluster_layout.hlsl"
+    }
+
+    // order of ranges in the cluster range buffer of LightCluster, see
+    // CLUSTER_LAYOUT_* in asset/clustered/cluster_layout.hlsl.
+    // CPULightCluster always keeps its ranges in Linear order
+    enum class ClusterLayout : int32_t
+    {
+        Linear     = CLUSTER_LAYOUT_LINEAR,
+        SliceMajor = CLUSTER_LAYOUT_SLICE_MAJOR,
+        Morton     = CLUSTER_LAYOUT_MORTON
+    };
+
+    inline int getClusterSlot(
+        ClusterLayout layout, const Int3 &count, int xi, int yi, int zi)
+    {
+        return shader::getClusterSlot(
+            static_cast<int>(layout), xi, yi, zi, count.x, count.y, count.z);
+    }
+
+    // slot of the cluster with getClusterIndex index clusterIndex
+    inline int getClusterSlot(
+        ClusterLayout layout, const Int3 &count, int clusterIndex)
+    {
+        const int zi = clusterIndex % count.z;
+        const int yi = clusterIndex / count.z % count.y;
+        const int xi = clusterIndex / count.z / count.y;
+        return getClusterSlot(layout, count, xi, yi, zi);
+    }
+
+    inline int getClusterSlotCount(ClusterLayout layout, const Int3 &count)
+    {
+        return shader::getClusterSlotCount(
+            static_cast<int>(layout), count.x, count.y, count.z);
+    }
+
+    // a gpu reading cluster ranges: pixels are shaded in warps of
+    // warpWidth x warpHeight, each warp fetching whole lines of lineSize
+    // bytes through an lru cache of lineCount lines
+    struct ClusterLookupCache
+    {
+        int warpWidth  = 8;
+        int warpHeight = 8;
+        int lineSize   = 128;
+        int lineCount  = 128;
+    };
+
+    struct ClusterLookupStatistics
+    {
+        int64_t pixelCount = 0;
+        int64_t warpCount  = 0;
+
+        // distinct lines read by each warp, summed over warps
+        int64_t lineTouches = 0;
+
+        int64_t cacheMisses = 0;
+    };
+
+    // replay the range lookups of the forward pass for a depth image (row 0
+    // at the top, depth >= 1 is background). warps are visited row by row,
+    // and a range of rangeStride bytes occupies the slot given by layout
+    ClusterLookupStatistics simulateClusterLookups(
+        const float              *depth,
+        int                       width,
+        int                       height,
+        const Int3               &clusterCount,
+        float                     nearZ,
+        float                     farZ,
+        const Mat4               &proj,
+        const SlicingPolicy      &slicing,
+        ClusterLayout             layout,
+        int                       rangeStride,
+        const ClusterLookupCache &cache = {});
+
+} // namespace clustering
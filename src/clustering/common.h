@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "./math.h"
+
+namespace clustering
+{
+
+    // same layout as common::PBSLight
+    struct Light
+    {
+        Float3 lightPosition;  float maxLightDistance = 0;
+        Float3 lightIntensity; float pad0 = 0;
+        Float3 lightAmbient;   float pad1 = 0;
+    };
+
+    // same layout as AABB in asset/clustered/common.hlsl
+    struct AABB
+    {
+        Float3 lower;
+        Float3 upper;
+    };
+
+    // same layout as ClusterRange in asset/clustered/common.hlsl
+    struct ClusterRange
+    {
+        int32_t rangeBeg = 0;
+        int32_t rangeEnd = 0;
+
+        bool operator==(const ClusterRange &) const noexcept = default;
+    };
+
+    static_assert(sizeof(Light)        == 48);
+    static_assert(sizeof(AABB)         == 24);
+    static_assert(sizeof(ClusterRange) == 8);
+
+    // must be consistent with LightCluster and cluster.hlsl
+
+    constexpr int AVG_LIGHTS_PER_CLUSTER = 128;
+    constexpr int MAX_LIGHTS_PER_CLUSTER = 128;
+
+    inline int getClusterIndex(const Int3 &count, int xi, int yi, int zi)
+    {
+        return xi * count.y * count.z + yi * count.z + zi;
+    }
+
+    // smallest grid whose tiles are at most tileWidth x tileHeight pixels
+    // on a width x height framebuffer. tiles still split the screen evenly,
+    // so each is less than one tile / count smaller than asked
+    inline Int3 getTiledClusterCount(
+        int width, int height, int tileWidth, int tileHeight, int zCount)
+    {
+        return {
+            (std::max)((width  + tileWidth  - 1) / tileWidth,  1),
+            (std::max)((height + tileHeight - 1) / tileHeight, 1),
+            zCount
+        };
+    }
+
+    // compact cluster encoding, see COMPACT_CLUSTERS in
+    // asset/clustered/common.hlsl. a cluster range is one word with the
+    // offset in the low 24 bits and the light count in the high 8 bits.
+    // light indices are uint16, packed two per word with the lower index
+    // first. ranges start at even offsets, so that every gpu thread writes
+    // whole words
+
+    constexpr int     COMPACT_RANGE_OFFSET_BITS = 24;
+    constexpr int     COMPACT_MAX_RANGE_COUNT   = 0xff;
+    constexpr size_t  COMPACT_MAX_LIGHT_COUNT   = 1 << 16;
+    constexpr int64_t COMPACT_MAX_INDEX_COUNT   = 1 << COMPACT_RANGE_OFFSET_BITS;
+
+    static_assert(MAX_LIGHTS_PER_CLUSTER <= COMPACT_MAX_RANGE_COUNT);
+
+    inline uint32_t packCompactRange(int32_t offset, int32_t count)
+    {
+        return static_cast<uint32_t>(offset) |
+              (static_cast<uint32_t>(count) << COMPACT_RANGE_OFFSET_BITS);
+    }
+
+    inline int32_t getCompactRangeOffset(uint32_t range)
+    {
+        return static_cast<int32_t>(
+            range & ((1u << COMPACT_RANGE_OFFSET_BITS) - 1));
+    }
+
+    inline int32_t getCompactRangeCount(uint32_t range)
+    {
+        return static_cast<int32_t>(range >> COMPACT_RANGE_OFFSET_BITS);
+    }
+
+    // whether lists of at most MAX_LIGHTS_PER_CLUSTER lights with the given
+    // light index capacity can use the compact encoding
+    inline bool canUseCompactClusters(size_t lightCount, int64_t lightIndexCount)
+    {
+        return lightCount <= COMPACT_MAX_LIGHT_COUNT &&
+               lightIndexCount < COMPACT_MAX_INDEX_COUNT;
+    }
+
+    enum class SlicingMode : int32_t
+    {
+        // slice depths grow geometrically from nearZ to farZ
+        Logarithmic = 0,
+        // slices of equal depth
+        Linear      = 1,
+        // slice 0 covers [nearZ, nearSliceZ], the others are logarithmic
+        // over [nearSliceZ, farZ]
+        Hybrid      = 2
+    };
+
+    // how clusters are distributed along view z. shared by cluster aabbs,
+    // light assignment, active clusters and viewZ2i in
+    // asset/clustered/common.hlsl
+    struct SlicingPolicy
+    {
+        SlicingMode mode       = SlicingMode::Logarithmic;
+        float       nearSliceZ = 0;
+
+        bool operator==(const SlicingPolicy &) const noexcept = default;
+    };
+
+    // a slicing policy applied to zCount slices over [nearZ, farZ]
+    struct ClusterSlicing
+    {
+        SlicingPolicy policy;
+
+        int   zCount = 0;
+        float nearZ  = 0;
+        float farZ   = 0;
+
+        // z -> i constants: floor(log(z) * A - B) for logarithmic slices,
+        // floor(z * A - B) for linear ones. hybrid adds 1 for the near slice
+        float A = 0;
+        float B = 0;
+    };
+
+    inline ClusterSlicing getClusterSlicing(
+        int zCount, float nearZ, float farZ, const SlicingPolicy &policy = {})
+    {
+        ClusterSlicing result = {
+            .policy = policy,
+            .zCount = zCount,
+            .nearZ  = nearZ,
+            .farZ   = farZ
+        };
+
+        // hybrid needs a near slice and at least one logarithmic slice
+        if(policy.mode == SlicingMode::Hybrid &&
+           (zCount < 2 || policy.nearSliceZ <= nearZ || policy.nearSliceZ >= farZ))
+            result.policy.mode = SlicingMode::Logarithmic;
+
+        switch(result.policy.mode)
+        {
+        case SlicingMode::Logarithmic:
+            result.A = zCount / std::log(farZ / nearZ);
+            result.B = zCount * std::log(nearZ) / std::log(farZ / nearZ);
+            break;
+        case SlicingMode::Linear:
+            result.A = zCount / (farZ - nearZ);
+            result.B = nearZ * result.A;
+            break;
+        case SlicingMode::Hybrid:
+            {
+                const float logBeg = policy.nearSliceZ;
+                result.A = (zCount - 1) / std::log(farZ / logBeg);
+                result.B = (zCount - 1) * std::log(logBeg) / std::log(farZ / logBeg);
+            }
+            break;
+        }
+
+        return result;
+    }
+
+    // same as viewZ2i in asset/clustered/common.hlsl
+    inline int viewZ2i(const ClusterSlicing &slicing, float z)
+    {
+        switch(slicing.policy.mode)
+        {
+        case SlicingMode::Linear:
+            return static_cast<int>(std::floor(z * slicing.A - slicing.B));
+        case SlicingMode::Hybrid:
+            if(z < slicing.policy.nearSliceZ)
+                return 0;
+            return 1 + static_cast<int>(
+                std::floor(std::log(z) * slicing.A - slicing.B));
+        default:
+            return static_cast<int>(
+                std::floor(std::log(z) * slicing.A - slicing.B));
+        }
+    }
+
+    // view z of the near boundary of slice i. i = zCount gives farZ
+    inline float clusterI2Z(const ClusterSlicing &slicing, int i)
+    {
+        const int   N     = slicing.zCount;
+        const float nearZ = slicing.nearZ;
+        const float farZ  = slicing.farZ;
+
+        switch(slicing.policy.mode)
+        {
+        case SlicingMode::Linear:
+            return nearZ + (farZ - nearZ) * (static_cast<float>(i) / N);
+        case SlicingMode::Hybrid:
+            {
+                if(i == 0)
+                    return nearZ;
+                const float logBeg = slicing.policy.nearSliceZ;
+                return logBeg * std::pow(
+                    farZ / logBeg,
+                    static_cast<float>(i - 1) / static_cast<float>(N - 1));
+            }
+        default:
+            return nearZ * std::pow(
+                farZ / nearZ, static_cast<float>(i) / static_cast<float>(N));
+        }
+    }
+
+    // same as isLightInAABB in asset/clustered/common.hlsl.
+    // lightPosition is in view space
+    inline bool isLightInAABB(
+        const Float3 &lightPosition, float maxLightDistance, const AABB &aabb)
+    {
+        const Float3 closest = vec_max(
+            aabb.lower, vec_min(lightPosition, aabb.upper));
+        const Float3 diff = closest - lightPosition;
+        return diff.length_square() < maxLightDistance * maxLightDistance;
+    }
+
+} // namespace clustering
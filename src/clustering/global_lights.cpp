@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+
+#include "./global_lights.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        // [lower, upper] of the tiles between ndc coordinates lowerNDC and
+        // upperNDC along an axis with count tiles
+        void getTileRange(
+            float lowerNDC, float upperNDC, int count, int &lower, int &upper)
+        {
+            lower = static_cast<int>(std::floor((0.5f * lowerNDC + 0.5f) * count));
+            upper = static_cast<int>(std::floor((0.5f * upperNDC + 0.5f) * count));
+            lower = std::clamp(lower, 0, count - 1);
+            upper = std::clamp(upper, 0, count - 1);
+        }
+
+        // [lowerZi, upperZi] of the slices overlapped by the sphere.
+        // returns false if it is outside [nearZ, farZ]
+        bool getSliceRange(
+            const Float3         &p,
+            float                 r,
+            const Int3           &clusterCount,
+            const ClusterSlicing &slicing,
+            int                  &lowerZi,
+            int                  &upperZi)
+        {
+            const float lowerZ = (std::max)(p.z - r, slicing.nearZ);
+            const float upperZ = (std::min)(p.z + r, slicing.farZ);
+            if(lowerZ > upperZ || clusterCount.product() <= 0)
+                return false;
+
+            const int zCount = clusterCount.z;
+            lowerZi = std::clamp(viewZ2i(slicing, lowerZ), 0, zCount - 1);
+            upperZi = std::clamp(viewZ2i(slicing, upperZ), 0, zCount - 1);
+            return true;
+        }
+
+    } // namespace anonymous
+
+    float estimateClusterCoverage(
+        const Float3         &viewPosition,
+        float                 maxLightDistance,
+        const Int3           &clusterCount,
+        const Mat4           &proj,
+        const ClusterSlicing &slicing)
+    {
+        const Float3 &p = viewPosition;
+        const float   r = maxLightDistance;
+
+        int lowerZi, upperZi;
+        if(!getSliceRange(p, r, clusterCount, slicing, lowerZi, upperZi))
+            return 0;
+
+        // a sphere near the camera spans many thin slices but only reaches
+        // a few tiles in most of them, so each slice bounds its own part of
+        // the sphere: a box of the slice depths and the largest radius of
+        // the sphere's cross sections between them. slices start at nearZ,
+        // so all boxes are in front of the camera
+
+        int clusters = 0;
+        for(int zi = lowerZi; zi <= upperZi; ++zi)
+        {
+            const float z0 = (std::max)(clusterI2Z(slicing, zi), p.z - r);
+            const float z1 = (std::min)(clusterI2Z(slicing, zi + 1), p.z + r);
+            if(z0 > z1)
+                continue;
+
+            const float dz = z0 <= p.z && p.z <= z1 ?
+                0.0f : (std::min)(std::abs(z0 - p.z), std::abs(z1 - p.z));
+            const float sliceR = std::sqrt((std::max)(r * r - dz * dz, 0.0f));
+
+            float lower[2] = { 1, 1 }, upper[2] = { -1, -1 };
+            for(int i = 0; i < 8; ++i)
+            {
+                const Float4 corner = {
+                    (i & 1) ? p.x + sliceR : p.x - sliceR,
+                    (i & 2) ? p.y + sliceR : p.y - sliceR,
+                    (i & 4) ? z1 : z0,
+                    1
+                };
+                const Float3 ndc = (corner * proj).homogenize();
+
+                lower[0] = (std::min)(lower[0], ndc.x);
+                lower[1] = (std::min)(lower[1], ndc.y);
+                upper[0] = (std::max)(upper[0], ndc.x);
+                upper[1] = (std::max)(upper[1], ndc.y);
+            }
+
+            if(lower[0] > 1 || lower[1] > 1 || upper[0] < -1 || upper[1] < -1)
+                continue;
+
+            int lowerXi, upperXi, lowerYi, upperYi;
+            getTileRange(lower[0], upper[0], clusterCount.x, lowerXi, upperXi);
+            getTileRange(lower[1], upper[1], clusterCount.y, lowerYi, upperYi);
+
+            clusters += (upperXi - lowerXi + 1) * (upperYi - lowerYi + 1);
+        }
+
+        return static_cast<float>(clusters) /
+               static_cast<float>(clusterCount.product());
+    }
+
+    bool isGlobalLight(
+        const Float3         &viewPosition,
+        float                 maxLightDistance,
+        const Int3           &clusterCount,
+        const Mat4           &proj,
+        const ClusterSlicing &slicing,
+        float                 maxCoverage)
+    {
+        if(maxCoverage >= 1)
+            return false;
+
+        // a light reaches at most all tiles of its slices. this rejects
+        // most local lights before the per-slice estimate
+
+        int lowerZi, upperZi;
+        if(!getSliceRange(
+            viewPosition, maxLightDistance, clusterCount, slicing, lowerZi, upperZi))
+            return false;
+        if(upperZi - lowerZi + 1 <= maxCoverage * clusterCount.z)
+            return false;
+
+        return estimateClusterCoverage(
+            viewPosition, maxLightDistance, clusterCount, proj, slicing) > maxCoverage;
+    }
+
+    void findGlobalLights(
+        const Light          *lights,
+        size_t                lightCount,
+        const Mat4           &view,
+        const Mat4           &proj,
+        const Int3           &clusterCount,
+        const ClusterSlicing &slicing,
+        float                 maxCoverage,
+        std::vector<int32_t> &globalLights)
+    {
+        globalLights.clear();
+        for(size_t i = 0; i < lightCount; ++i)
+        {
+            if(isGlobalLight(
+                view.transformPoint(lights[i].lightPosition),
+                lights[i].maxLightDistance, clusterCount, proj, slicing,
+                maxCoverage))
+                globalLights.push_back(static_cast<int32_t>(i));
+        }
+    }
+
+} // namespace clustering
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // a light reaching most of the grid, e.g. a sun-like or large fill
+    // light, costs one index per cluster and is shaded by nearly every
+    // pixel anyway. such lights can be kept out of the cluster lists and
+    // evaluated from one global list instead
+
+    // fraction of the clusters in the slices overlapped by the z range of
+    // the view space sphere and the screen tiles covered by the projection
+    // of its bounding box. an upper bound of the fraction of clusters any
+    // cluster test assigns the light to
+    float estimateClusterCoverage(
+        const Float3         &viewPosition,
+        float                 maxLightDistance,
+        const Int3           &clusterCount,
+        const Mat4           &proj,
+        const ClusterSlicing &slicing);
+
+    // whether the estimated coverage exceeds maxCoverage. maxCoverage >= 1
+    // is never exceeded
+    bool isGlobalLight(
+        const Float3         &viewPosition,
+        float                 maxLightDistance,
+        const Int3           &clusterCount,
+        const Mat4           &proj,
+        const ClusterSlicing &slicing,
+        float                 maxCoverage);
+
+    // lights passing isGlobalLight, in ascending order
+    void findGlobalLights(
+        const Light          *lights,
+        size_t                lightCount,
+        const Mat4           &view,
+        const Mat4           &proj,
+        const Int3           &clusterCount,
+        const ClusterSlicing &slicing,
+        float                 maxCoverage,
+        std::vector<int32_t> &globalLights);
+
+} // namespace clustering
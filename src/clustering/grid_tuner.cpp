@@ -0,0 +1,209 @@
+#include <chrono>
+#include <fstream>
+
+#include "./grid_tuner.h"
+
+namespace clustering
+{
+
+    ClusterGridTuner::ClusterGridTuner(ThreadPool &threadPool)
+        : threadPool_(threadPool), lights_(nullptr), lightCount_(0),
+          cluster_(threadPool)
+    {
+
+    }
+
+    void ClusterGridTuner::setLights(const Light *lights, size_t lightCount)
+    {
+        lights_     = lights;
+        lightCount_ = lightCount;
+    }
+
+    void ClusterGridTuner::setFrames(std::vector<GridTuningFrame> frames)
+    {
+        frames_ = std::move(frames);
+    }
+
+    void ClusterGridTuner::setOptions(const GridTuningOptions &options)
+    {
+        options_ = options;
+    }
+
+    void ClusterGridTuner::run(
+        const std::vector<int> &xCounts,
+        const std::vector<int> &yCounts,
+        const std::vector<int> &zCounts)
+    {
+        results_.clear();
+        for(int x : xCounts)
+        {
+            for(int y : yCounts)
+            {
+                for(int z : zCounts)
+                    results_.push_back(evaluate({ x, y, z }));
+            }
+        }
+    }
+
+    const std::vector<GridTuningResult> &ClusterGridTuner::getResults() const
+    {
+        return results_;
+    }
+
+    int ClusterGridTuner::getRecommendedIndex() const
+    {
+        int result = -1;
+        for(int i = 0; i < static_cast<int>(results_.size()); ++i)
+        {
+            const GridTuningResult &r = results_[i];
+            if(r.droppedCount > 0)
+                continue;
+            if(result < 0 || r.cost < results_[result].cost)
+                result = i;
+        }
+        return result;
+    }
+
+    GridTuningResult ClusterGridTuner::evaluate(const Int3 &clusterCount)
+    {
+        const int threadCount = threadPool_.getThreadCount();
+
+        GridTuningResult result;
+        result.clusterCount = clusterCount;
+
+        cluster_.setIndexCapacity(IndexCapacity::Fixed);
+        cluster_.setClusterCount(clusterCount);
+        cluster_.setSlicingPolicy(options_.slicing);
+        cluster_.setLights(lights_, lightCount_);
+
+        const int lightIndexCount =
+            AVG_LIGHTS_PER_CLUSTER * clusterCount.product();
+        result.bufferKB = (clusterCount.product() * sizeof(ClusterRange) +
+                           lightIndexCount * sizeof(int32_t)) / 1024.0;
+
+        std::vector<int64_t> threadEvaluations(threadCount);
+        std::vector<int64_t> threadPixels(threadCount);
+
+        for(auto &frame : frames_)
+        {
+            cluster_.setProj(frame.nearZ, frame.farZ, frame.proj);
+            cluster_.updateClusterAABBs();
+            cluster_.setView(frame.view);
+
+            // timing without statistics, which would uncap the lists
+
+            cluster_.setStatisticsEnabled(false);
+
+            double frameMS = 0;
+            for(int i = 0; i < (std::max)(options_.timingRuns, 1); ++i)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                cluster_.run();
+                const auto d = std::chrono::steady_clock::now() - start;
+                frameMS += std::chrono::duration<double, std::milli>(d).count();
+            }
+            result.assignMS += frameMS / (std::max)(options_.timingRuns, 1);
+
+            cluster_.setStatisticsEnabled(true);
+            cluster_.run();
+
+            const ClusterStatistics &statistics = cluster_.getStatistics();
+            result.droppedCount += static_cast<double>(
+                statistics.clusterOverflowCount + statistics.indexOverflowCount);
+            result.usedKB +=
+                (clusterCount.product() * sizeof(ClusterRange) +
+                 cluster_.getLightIndices().size() * sizeof(int32_t)) / 1024.0;
+
+            // lights looped over per pixel
+
+            const ClusterSlicing slicing = getClusterSlicing(
+                clusterCount.z, frame.nearZ, frame.farZ, options_.slicing);
+            const auto &ranges = cluster_.getClusterRanges();
+
+            std::fill(threadEvaluations.begin(), threadEvaluations.end(), 0);
+            std::fill(threadPixels.begin(), threadPixels.end(), 0);
+
+            threadPool_.parallelFor(
+                frame.height, 8, [&](int beg, int end, int threadIndex)
+            {
+                int64_t evaluations = 0, pixels = 0;
+                for(int py = beg; py < end; ++py)
+                {
+                    const int yi = static_cast<int>(
+                        (1 - (py + 0.5f) / frame.height) * clusterCount.y);
+
+                    const float *row =
+                        frame.depth + static_cast<size_t>(py) * frame.width;
+                    for(int px = 0; px < frame.width; ++px)
+                    {
+                        if(row[px] >= 1)
+                            continue;
+
+                        const float viewZ = frame.proj.m[3][2] /
+                                            (row[px] - frame.proj.m[2][2]);
+                        const int zi = viewZ2i(slicing, viewZ);
+                        if(zi < 0 || zi >= clusterCount.z)
+                            continue;
+
+                        const int xi = static_cast<int>(
+                            (px + 0.5f) / frame.width * clusterCount.x);
+                        const ClusterRange &range =
+                            ranges[getClusterIndex(clusterCount, xi, yi, zi)];
+
+                        evaluations += range.rangeEnd - range.rangeBeg;
+                        ++pixels;
+                    }
+                }
+                threadEvaluations[threadIndex] += evaluations;
+                threadPixels[threadIndex]      += pixels;
+            });
+
+            int64_t evaluations = 0, pixels = 0;
+            for(int i = 0; i < threadCount; ++i)
+            {
+                evaluations += threadEvaluations[i];
+                pixels      += threadPixels[i];
+            }
+
+            result.lightsPerPixel +=
+                static_cast<double>(evaluations) / (std::max)(pixels, int64_t(1));
+            result.cost +=
+                options_.shadeCost * static_cast<double>(evaluations) +
+                options_.testCost  * static_cast<double>(clusterCount.product()) *
+                                     static_cast<double>(lightCount_);
+        }
+
+        const double frameCount =
+            static_cast<double>((std::max)(frames_.size(), size_t(1)));
+        result.assignMS       /= frameCount;
+        result.usedKB         /= frameCount;
+        result.lightsPerPixel /= frameCount;
+        result.droppedCount   /= frameCount;
+        result.cost           /= frameCount;
+        return result;
+    }
+
+    bool saveClusterGrid(const char *filename, const Int3 &clusterCount)
+    {
+        std::ofstream fout(filename, std::ios::trunc);
+        if(!fout)
+            return false;
+        fout << clusterCount.x << " "
+             << clusterCount.y << " "
+             << clusterCount.z << std::endl;
+        return static_cast<bool>(fout);
+    }
+
+    bool loadClusterGrid(const char *filename, Int3 &clusterCount)
+    {
+        std::ifstream fin(filename);
+        Int3 result;
+        if(!(fin >> result.x >> result.y >> result.z))
+            return false;
+        if(result.x <= 0 || result.y <= 0 || result.z <= 0)
+            return false;
+        clusterCount = result;
+        return true;
+    }
+
+} // namespace clustering
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "./light_cluster.h"
+
+namespace clustering
+{
+
+    // one camera pose of a recorded scene and the depth buffer it sees.
+    // depth is width * height depth buffer values with row 0 at the top of
+    // the screen, like in findActiveClusters
+    struct GridTuningFrame
+    {
+        Mat4  view;
+        Mat4  proj;
+        float nearZ = 0;
+        float farZ  = 0;
+
+        const float *depth  = nullptr;
+        int          width  = 0;
+        int          height = 0;
+    };
+
+    // the recommended grid minimizes
+    //     lightEvaluations * shadeCost + sphereAABBTests * testCost
+    // per frame, where light evaluations are the lights looped over by the
+    // forward pixel shader and tests are the clusters * lights of CSMain
+    struct GridTuningOptions
+    {
+        double shadeCost = 16;
+        double testCost  = 1;
+
+        // cpu assignment is timed over at least this many runs per frame
+        int timingRuns = 3;
+
+        SlicingPolicy slicing;
+    };
+
+    // averages per frame
+    struct GridTuningResult
+    {
+        Int3 clusterCount;
+
+        // CPULightCluster::run with the fixed capacity of LightCluster
+        double assignMS = 0;
+
+        // range and index buffers as allocated by LightCluster, and the
+        // part of the index buffer actually filled
+        double bufferKB = 0;
+        double usedKB   = 0;
+
+        // over pixels with a depth sample in [nearZ, farZ)
+        double lightsPerPixel = 0;
+
+        // light-cluster pairs dropped by MAX_LIGHTS_PER_CLUSTER or the
+        // index capacity. grids dropping lights are never recommended
+        double droppedCount = 0;
+
+        double cost = 0;
+    };
+
+    // sweeps cluster grids over a recorded scene with CPULightCluster
+    class ClusterGridTuner
+    {
+    public:
+
+        explicit ClusterGridTuner(ThreadPool &threadPool);
+
+        void setLights(const Light *lights, size_t lightCount);
+
+        // depth images are referenced, not copied
+        void setFrames(std::vector<GridTuningFrame> frames);
+
+        void setOptions(const GridTuningOptions &options);
+
+        // evaluates every combination of the given counts
+        void run(
+            const std::vector<int> &xCounts,
+            const std::vector<int> &yCounts,
+            const std::vector<int> &zCounts);
+
+        // in the order of evaluation
+        const std::vector<GridTuningResult> &getResults() const;
+
+        // index into getResults(), -1 if every grid dropped lights
+        int getRecommendedIndex() const;
+
+    private:
+
+        GridTuningResult evaluate(const Int3 &clusterCount);
+
+        ThreadPool &threadPool_;
+
+        const Light *lights_;
+        size_t       lightCount_;
+
+        std::vector<GridTuningFrame> frames_;
+        GridTuningOptions            options_;
+
+        CPULightCluster cluster_;
+
+        std::vector<GridTuningResult> results_;
+    };
+
+    // a grid is stored as "x y z" in a text file, e.g. a tuner result read
+    // by the clustered sample at startup. return false on failure
+    bool saveClusterGrid(const char *filename, const Int3 &clusterCount);
+
+    bool loadClusterGrid(const char *filename, Int3 &clusterCount);
+
+} // namespace clustering
@@ -0,0 +1,88 @@
+#include "./item_cluster.h"
+
+namespace clustering
+{
+
+    BoundingSphere transformSphere(const Mat4 &view, const BoundingSphere &sphere)
+    {
+        return { view.transformPoint(sphere.center), sphere.radius };
+    }
+
+    OBB transformOBB(const Mat4 &view, const OBB &obb)
+    {
+        OBB result;
+        result.center = view.transformPoint(obb.center);
+        for(int i = 0; i < 3; ++i)
+        {
+            const Float4 axis = Float4{
+                obb.axes[i].x, obb.axes[i].y, obb.axes[i].z, 0 } * view;
+            const Float3 dir = axis.xyz();
+            const float  len = dir.length();
+
+            result.axes[i]        = dir / len;
+            result.halfExtents[i] = obb.halfExtents[i] * len;
+        }
+        return result;
+    }
+
+    OBB toOBB(const AABB &aabb)
+    {
+        OBB result;
+        result.center      = 0.5f * (aabb.lower + aabb.upper);
+        result.halfExtents = 0.5f * (aabb.upper - aabb.lower);
+        return result;
+    }
+
+    AABB getSphereAABB(const BoundingSphere &sphere)
+    {
+        return {
+            sphere.center - Float3(sphere.radius),
+            sphere.center + Float3(sphere.radius)
+        };
+    }
+
+    AABB getOBBAABB(const OBB &obb)
+    {
+        Float3 extent;
+        for(int k = 0; k < 3; ++k)
+        {
+            extent[k] = std::abs(obb.axes[0][k]) * obb.halfExtents.x +
+                        std::abs(obb.axes[1][k]) * obb.halfExtents.y +
+                        std::abs(obb.axes[2][k]) * obb.halfExtents.z;
+        }
+        return { obb.center - extent, obb.center + extent };
+    }
+
+    bool isOBBInAABB(const OBB &obb, const AABB &aabb)
+    {
+        const Float3 aabbCenter = 0.5f * (aabb.lower + aabb.upper);
+        const Float3 aabbExtent = 0.5f * (aabb.upper - aabb.lower);
+        const Float3 d = obb.center - aabbCenter;
+
+        // axes of the aabb
+
+        for(int k = 0; k < 3; ++k)
+        {
+            const float r = std::abs(obb.axes[0][k]) * obb.halfExtents.x +
+                            std::abs(obb.axes[1][k]) * obb.halfExtents.y +
+                            std::abs(obb.axes[2][k]) * obb.halfExtents.z;
+            if(std::abs(d[k]) > aabbExtent[k] + r)
+                return false;
+        }
+
+        // axes of the obb
+
+        for(int i = 0; i < 3; ++i)
+        {
+            const Float3 &axis = obb.axes[i];
+            const float r = std::abs(axis.x) * aabbExtent.x +
+                            std::abs(axis.y) * aabbExtent.y +
+                            std::abs(axis.z) * aabbExtent.z;
+            if(std::abs(dot(axis, d)) > obb.halfExtents[i] + r)
+                return false;
+        }
+
+        return true;
+    }
+
+} // namespace clustering
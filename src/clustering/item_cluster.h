@@ -0,0 +1,517 @@
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <utility>
+
+#include "./cluster_aabb.h"
+#include "./prefix_sum.h"
+
+namespace clustering
+{
+
+    // bound types of clustered items. lights, reflection probes and other
+    // radial items use spheres, decals and fog volumes boxes
+
+    struct BoundingSphere
+    {
+        Float3 center;
+        float  radius = 0;
+    };
+
+    // axes are orthonormal
+    struct OBB
+    {
+        Float3 center;
+        Float3 axes[3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+        Float3 halfExtents;
+    };
+
+    BoundingSphere transformSphere(const Mat4 &view, const BoundingSphere &sphere);
+
+    // view may scale, the axes are normalized again
+    OBB transformOBB(const Mat4 &view, const OBB &obb);
+
+    OBB toOBB(const AABB &aabb);
+
+    AABB getSphereAABB(const BoundingSphere &sphere);
+
+    AABB getOBBAABB(const OBB &obb);
+
+    // separating axis test with the 3 axes of each box. the 9 edge-edge
+    // axes are skipped, so a few boxes only touching a cluster near its
+    // edges are kept, like isLightInAABB keeps a few lights
+    bool isOBBInAABB(const OBB &obb, const AABB &aabb);
+
+    // how items of a bound type are tested against view space cluster aabbs.
+    // ViewBound is the bound after the view transform, getAABB() a box
+    // containing it and intersects() the exact (or conservative) test
+
+    template<typename Bound>
+    struct ItemBoundTraits;
+
+    template<>
+    struct ItemBoundTraits<BoundingSphere>
+    {
+        using ViewBound = BoundingSphere;
+
+        static ViewBound toView(const Mat4 &view, const BoundingSphere &sphere)
+        {
+            return transformSphere(view, sphere);
+        }
+
+        static AABB getAABB(const ViewBound &sphere)
+        {
+            return getSphereAABB(sphere);
+        }
+
+        static bool intersects(const ViewBound &sphere, const AABB &aabb)
+        {
+            return isLightInAABB(sphere.center, sphere.radius, aabb);
+        }
+    };
+
+    // a world space aabb is an obb in view space
+    template<>
+    struct ItemBoundTraits<AABB>
+    {
+        using ViewBound = OBB;
+
+        static ViewBound toView(const Mat4 &view, const AABB &aabb)
+        {
+            return transformOBB(view, toOBB(aabb));
+        }
+
+        static AABB getAABB(const ViewBound &obb)
+        {
+            return getOBBAABB(obb);
+        }
+
+        static bool intersects(const ViewBound &obb, const AABB &aabb)
+        {
+            return isOBBInAABB(obb, aabb);
+        }
+    };
+
+    template<>
+    struct ItemBoundTraits<OBB>
+    {
+        using ViewBound = OBB;
+
+        static ViewBound toView(const Mat4 &view, const OBB &obb)
+        {
+            return transformOBB(view, obb);
+        }
+
+        static AABB getAABB(const ViewBound &obb)
+        {
+            return getOBBAABB(obb);
+        }
+
+        static bool intersects(const ViewBound &obb, const AABB &aabb)
+        {
+            return isOBBInAABB(obb, aabb);
+        }
+    };
+
+    // clusters items of several bound types into one froxel grid in a
+    // single pass, so that a pixel finds all of them with one lookup.
+    // assignment is hierarchical like AssignMode::Hierarchical of
+    // CPULightCluster, with an exact index capacity. type t of cluster ci
+    // lists its item indices (into the array given to setItems<t>) in
+    //     [offsets[ci * TYPE_COUNT + t], offsets[ci * TYPE_COUNT + t + 1])
+    // of the index buffer, so the ranges of every type of a cluster are
+    // TYPE_COUNT + 1 consecutive offsets. with a single sphere type this
+    // gives the same lists as CPULightCluster
+    template<typename...Bounds>
+    class CPUItemCluster
+    {
+    public:
+
+        static constexpr int TYPE_COUNT = sizeof...(Bounds);
+
+        static_assert(TYPE_COUNT > 0);
+
+        template<int T>
+        using Bound = std::tuple_element_t<T, std::tuple<Bounds...>>;
+
+        explicit CPUItemCluster(ThreadPool &threadPool);
+
+        void setClusterCount(const Int3 &count);
+
+        void setProj(float nearZ, float farZ, const Mat4 &proj);
+
+        // takes effect at the next updateClusterAABBs()
+        void setSlicingPolicy(const SlicingPolicy &policy);
+
+        void setView(const Mat4 &view);
+
+        // rebuild cluster aabbs for the current cluster count and projection
+        void updateClusterAABBs();
+
+        // world space bounds, referenced until the next call
+        template<int T>
+        void setItems(const Bound<T> *items, size_t count);
+
+        void run();
+
+        const Int3 &getClusterCount() const;
+
+        // TYPE_COUNT * clusterCount + 1 offsets into getItemIndices()
+        const std::vector<int32_t> &getRangeOffsets() const;
+
+        ClusterRange getItemRange(int clusterIndex, int type) const;
+
+        const std::vector<int32_t> &getItemIndices() const;
+
+        // item-cluster pairs of the last run, over all types
+        int64_t getAssignmentCount() const;
+
+        // available after updateClusterAABBs()
+        const std::vector<AABB> &getClusterAABBs() const;
+
+    private:
+
+        template<typename B>
+        struct ItemList
+        {
+            using ViewBound = typename ItemBoundTraits<B>::ViewBound;
+
+            const B *items = nullptr;
+            size_t   count = 0;
+
+            std::vector<ViewBound> viewBounds;
+            std::vector<AABB>      viewAABBs;
+        };
+
+        // tile lists are appended to the output of the thread that computed
+        // them, then copied to their place in the index buffer
+        struct ThreadScratch
+        {
+            std::vector<int32_t> output;
+
+            std::array<std::vector<int32_t>, TYPE_COUNT> survivors;
+        };
+
+        struct TileList
+        {
+            int32_t threadIndex;
+            int32_t offset;
+        };
+
+        // calls func(std::integral_constant<int, T>) for each type T
+        template<typename Func>
+        static void forEachType(Func &&func);
+
+        static bool overlaps(const AABB &a, const AABB &b);
+
+        void transformItems();
+
+        void fillTileLists();
+
+        void scatterTileLists();
+
+        ThreadPool &threadPool_;
+
+        Int3 clusterCount_;
+
+        float nearZ_;
+        float farZ_;
+        Mat4  proj_;
+
+        SlicingPolicy slicingPolicy_;
+
+        Mat4 view_;
+
+        std::tuple<ItemList<Bounds>...> items_;
+
+        ClusterAABBBuilder       clusterAABBBuilder_;
+        const std::vector<AABB> *clusterAABBs_;
+
+        // union of the cluster aabbs of each screen tile
+        std::vector<AABB> tileAABBs_;
+
+        std::vector<ThreadScratch> threadScratch_;
+        std::vector<TileList>      tileLists_;
+
+        int64_t assignmentCount_;
+
+        std::vector<int32_t> rangeOffsets_;
+        std::vector<int32_t> itemIndices_;
+    };
+
+    template<typename...Bounds>
+    CPUItemCluster<Bounds...>::CPUItemCluster(ThreadPool &threadPool)
+        : threadPool_(threadPool), nearZ_(0), farZ_(0),
+          view_(Mat4::identity()),
+          clusterAABBBuilder_(threadPool), clusterAABBs_(nullptr),
+          assignmentCount_(0)
+    {
+
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::setClusterCount(const Int3 &count)
+    {
+        clusterCount_ = count;
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::setProj(
+        float nearZ, float farZ, const Mat4 &proj)
+    {
+        nearZ_ = nearZ;
+        farZ_  = farZ;
+        proj_  = proj;
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::setSlicingPolicy(const SlicingPolicy &policy)
+    {
+        slicingPolicy_ = policy;
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::setView(const Mat4 &view)
+    {
+        view_ = view;
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::updateClusterAABBs()
+    {
+        clusterAABBs_ = &clusterAABBBuilder_.build(ClusterAABBKey{
+            .clusterCount = clusterCount_,
+            .nearZ        = nearZ_,
+            .farZ         = farZ_,
+            .proj         = proj_,
+            .slicing      = slicingPolicy_
+        });
+
+        const int tileCount = clusterCount_.x * clusterCount_.y;
+        tileAABBs_.resize(tileCount);
+        for(int ti = 0; ti < tileCount; ++ti)
+        {
+            const int firstCluster = ti * clusterCount_.z;
+
+            AABB tileAABB = (*clusterAABBs_)[firstCluster];
+            for(int zi = 1; zi < clusterCount_.z; ++zi)
+            {
+                const AABB &aabb = (*clusterAABBs_)[firstCluster + zi];
+                tileAABB.lower = vec_min(tileAABB.lower, aabb.lower);
+                tileAABB.upper = vec_max(tileAABB.upper, aabb.upper);
+            }
+            tileAABBs_[ti] = tileAABB;
+        }
+    }
+
+    template<typename...Bounds>
+    template<int T>
+    void CPUItemCluster<Bounds...>::setItems(const Bound<T> *items, size_t count)
+    {
+        auto &list = std::get<T>(items_);
+        list.items = items;
+        list.count = count;
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::run()
+    {
+        transformItems();
+        fillTileLists();
+        scatterTileLists();
+    }
+
+    template<typename...Bounds>
+    const Int3 &CPUItemCluster<Bounds...>::getClusterCount() const
+    {
+        return clusterCount_;
+    }
+
+    template<typename...Bounds>
+    const std::vector<int32_t> &CPUItemCluster<Bounds...>::getRangeOffsets() const
+    {
+        return rangeOffsets_;
+    }
+
+    template<typename...Bounds>
+    ClusterRange CPUItemCluster<Bounds...>::getItemRange(
+        int clusterIndex, int type) const
+    {
+        const int i = clusterIndex * TYPE_COUNT + type;
+        return { rangeOffsets_[i], rangeOffsets_[i + 1] };
+    }
+
+    template<typename...Bounds>
+    const std::vector<int32_t> &CPUItemCluster<Bounds...>::getItemIndices() const
+    {
+        return itemIndices_;
+    }
+
+    template<typename...Bounds>
+    int64_t CPUItemCluster<Bounds...>::getAssignmentCount() const
+    {
+        return assignmentCount_;
+    }
+
+    template<typename...Bounds>
+    const std::vector<AABB> &CPUItemCluster<Bounds...>::getClusterAABBs() const
+    {
+        return *clusterAABBs_;
+    }
+
+    template<typename...Bounds>
+    template<typename Func>
+    void CPUItemCluster<Bounds...>::forEachType(Func &&func)
+    {
+        [&]<int...Ts>(std::integer_sequence<int, Ts...>)
+        {
+            (func(std::integral_constant<int, Ts>{}), ...);
+        }(std::make_integer_sequence<int, TYPE_COUNT>{});
+    }
+
+    template<typename...Bounds>
+    bool CPUItemCluster<Bounds...>::overlaps(const AABB &a, const AABB &b)
+    {
+        return a.lower.x <= b.upper.x && b.lower.x <= a.upper.x &&
+               a.lower.y <= b.upper.y && b.lower.y <= a.upper.y &&
+               a.lower.z <= b.upper.z && b.lower.z <= a.upper.z;
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::transformItems()
+    {
+        forEachType([&](auto type)
+        {
+            constexpr int T = decltype(type)::value;
+
+            auto &list = std::get<T>(items_);
+            using Traits = ItemBoundTraits<Bound<T>>;
+
+            const int count = static_cast<int>(list.count);
+            list.viewBounds.resize(count);
+            list.viewAABBs.resize(count);
+
+            threadPool_.parallelFor(count, 256, [&](int beg, int end, int)
+            {
+                for(int i = beg; i < end; ++i)
+                {
+                    list.viewBounds[i] = Traits::toView(view_, list.items[i]);
+                    list.viewAABBs[i]  = Traits::getAABB(list.viewBounds[i]);
+                }
+            });
+        });
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::fillTileLists()
+    {
+        // the tile aabb contains all its cluster aabbs, so an item rejected
+        // by the tile can not touch any of its clusters. per cluster, the
+        // lists of all types are written back to back
+
+        const int tileCount    = clusterCount_.x * clusterCount_.y;
+        const int clusterCount = clusterCount_.product();
+
+        threadScratch_.resize(threadPool_.getThreadCount());
+        for(auto &scratch : threadScratch_)
+            scratch.output.clear();
+
+        tileLists_.resize(tileCount);
+        rangeOffsets_.resize(static_cast<size_t>(clusterCount) * TYPE_COUNT + 1);
+
+        threadPool_.parallelFor(
+            tileCount, 1, [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+
+            for(int ti = beg; ti < end; ++ti)
+            {
+                const AABB &tileAABB = tileAABBs_[ti];
+
+                // coarse: items against the tile aabb
+
+                forEachType([&](auto type)
+                {
+                    constexpr int T = decltype(type)::value;
+
+                    const auto &list = std::get<T>(items_);
+                    using Traits = ItemBoundTraits<Bound<T>>;
+
+                    auto &survivors = scratch.survivors[T];
+                    survivors.clear();
+                    for(int i = 0; i < static_cast<int>(list.count); ++i)
+                    {
+                        if(overlaps(list.viewAABBs[i], tileAABB) &&
+                           Traits::intersects(list.viewBounds[i], tileAABB))
+                            survivors.push_back(i);
+                    }
+                });
+
+                // fine: survivors against each z-slice
+
+                tileLists_[ti] = {
+                    threadIndex, static_cast<int32_t>(scratch.output.size())
+                };
+
+                for(int zi = 0; zi < clusterCount_.z; ++zi)
+                {
+                    const int   ci   = ti * clusterCount_.z + zi;
+                    const AABB &aabb = (*clusterAABBs_)[ci];
+
+                    forEachType([&](auto type)
+                    {
+                        constexpr int T = decltype(type)::value;
+
+                        const auto &list = std::get<T>(items_);
+                        using Traits = ItemBoundTraits<Bound<T>>;
+
+                        const size_t outputBeg = scratch.output.size();
+                        for(int i : scratch.survivors[T])
+                        {
+                            if(overlaps(list.viewAABBs[i], aabb) &&
+                               Traits::intersects(list.viewBounds[i], aabb))
+                                scratch.output.push_back(i);
+                        }
+
+                        rangeOffsets_[ci * TYPE_COUNT + T] =
+                            static_cast<int32_t>(scratch.output.size() - outputBeg);
+                    });
+                }
+            }
+        });
+    }
+
+    template<typename...Bounds>
+    void CPUItemCluster<Bounds...>::scatterTileLists()
+    {
+        const int rangeCount = clusterCount_.product() * TYPE_COUNT;
+
+        assignmentCount_ = exclusiveScan(
+            threadPool_, rangeOffsets_.data(), rangeOffsets_.data(), rangeCount);
+        rangeOffsets_[rangeCount] = static_cast<int32_t>(assignmentCount_);
+
+        itemIndices_.resize(assignmentCount_);
+
+        // clusters of a tile are consecutive, so each tile list is copied
+        // in one piece
+
+        const int tileRangeCount = clusterCount_.z * TYPE_COUNT;
+
+        threadPool_.parallelFor(
+            static_cast<int>(tileLists_.size()), 16, [&](int beg, int end, int)
+        {
+            for(int ti = beg; ti < end; ++ti)
+            {
+                const int32_t dstBeg = rangeOffsets_[ti * tileRangeCount];
+                const int32_t dstEnd = rangeOffsets_[(ti + 1) * tileRangeCount];
+
+                const TileList &list = tileLists_[ti];
+                const int32_t *src =
+                    threadScratch_[list.threadIndex].output.data() + list.offset;
+                std::copy(src, src + (dstEnd - dstBeg), itemIndices_.data() + dstBeg);
+            }
+        });
+    }
+
+} // namespace clustering
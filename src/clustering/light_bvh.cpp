@@ -0,0 +1,146 @@
+#include "./light_bvh.h"
+
+namespace clustering
+{
+
+    void LightBVH::build(const Light *lights, size_t lightCount)
+    {
+        nodes_.clear();
+        lightOrder_.clear();
+
+        if(!lightCount)
+            return;
+
+        std::vector<BuildItem> items(lightCount);
+        for(size_t i = 0; i < lightCount; ++i)
+        {
+            items[i] = BuildItem{
+                .center     = lights[i].lightPosition,
+                .bound      = getLightBound(lights[i]),
+                .lightIndex = static_cast<int32_t>(i)
+            };
+        }
+
+        nodes_.reserve(2 * lightCount / MAX_LEAF_SIZE + 1);
+        lightOrder_.reserve(lightCount);
+
+        buildRecursively(items.data(), items.data() + items.size(), 0);
+    }
+
+    void LightBVH::refit(const Light *lights, size_t lightCount)
+    {
+        if(lightCount != lightOrder_.size())
+        {
+            build(lights, lightCount);
+            return;
+        }
+
+        // children always follow their parent, so a reverse sweep visits
+        // both children before the parent
+
+        for(int ni = static_cast<int>(nodes_.size()) - 1; ni >= 0; --ni)
+        {
+            LightBVHNode &node = nodes_[ni];
+
+            AABB bound;
+            if(node.lightCount)
+            {
+                bound = getLightBound(lights[lightOrder_[node.rightOrFirst]]);
+                for(int i = 1; i < node.lightCount; ++i)
+                {
+                    const AABB lightBound = getLightBound(
+                        lights[lightOrder_[node.rightOrFirst + i]]);
+                    bound.lower = vec_min(bound.lower, lightBound.lower);
+                    bound.upper = vec_max(bound.upper, lightBound.upper);
+                }
+            }
+            else
+            {
+                const LightBVHNode &left  = nodes_[ni + 1];
+                const LightBVHNode &right = nodes_[node.rightOrFirst];
+                bound.lower = vec_min(left.lower, right.lower);
+                bound.upper = vec_max(left.upper, right.upper);
+            }
+
+            node.lower = bound.lower;
+            node.upper = bound.upper;
+        }
+    }
+
+    bool LightBVH::empty() const
+    {
+        return nodes_.empty();
+    }
+
+    size_t LightBVH::getLightCount() const
+    {
+        return lightOrder_.size();
+    }
+
+    const std::vector<LightBVHNode> &LightBVH::getNodes() const
+    {
+        return nodes_;
+    }
+
+    const std::vector<int32_t> &LightBVH::getLightOrder() const
+    {
+        return lightOrder_;
+    }
+
+    int LightBVH::buildRecursively(BuildItem *beg, BuildItem *end, int depth)
+    {
+        const int nodeIndex = static_cast<int>(nodes_.size());
+        nodes_.emplace_back();
+
+        AABB bound = beg->bound;
+        AABB centerBound = { beg->center, beg->center };
+        for(BuildItem *item = beg + 1; item != end; ++item)
+        {
+            bound.lower = vec_min(bound.lower, item->bound.lower);
+            bound.upper = vec_max(bound.upper, item->bound.upper);
+            centerBound.lower = vec_min(centerBound.lower, item->center);
+            centerBound.upper = vec_max(centerBound.upper, item->center);
+        }
+
+        nodes_[nodeIndex].lower = bound.lower;
+        nodes_[nodeIndex].upper = bound.upper;
+
+        const int count = static_cast<int>(end - beg);
+        if(count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH)
+        {
+            nodes_[nodeIndex].rightOrFirst =
+                static_cast<int32_t>(lightOrder_.size());
+            nodes_[nodeIndex].lightCount = count;
+            for(BuildItem *item = beg; item != end; ++item)
+                lightOrder_.push_back(item->lightIndex);
+            return nodeIndex;
+        }
+
+        // median split along the largest extent of light centers
+
+        const Float3 extent = centerBound.upper - centerBound.lower;
+        int axis = 0;
+        if(extent.y > extent[axis]) axis = 1;
+        if(extent.z > extent[axis]) axis = 2;
+
+        BuildItem *mid = beg + count / 2;
+        std::nth_element(
+            beg, mid, end, [axis](const BuildItem &a, const BuildItem &b)
+        {
+            return a.center[axis] < b.center[axis];
+        });
+
+        buildRecursively(beg, mid, depth + 1);
+        const int right = buildRecursively(mid, end, depth + 1);
+        nodes_[nodeIndex].rightOrFirst = right;
+
+        return nodeIndex;
+    }
+
+    AABB LightBVH::getLightBound(const Light &light)
+    {
+        const Float3 r(light.maxLightDistance);
+        return { light.lightPosition - r, light.lightPosition + r };
+    }
+
+} // namespace clustering
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // flattened bvh node. nodes are stored in depth-first order, so the
+    // left child of an interior node is always the next node. the layout
+    // matches
+    //
+    //     struct LightBVHNode
+    //     {
+    //         float3 lower; int rightOrFirst;
+    //         float3 upper; int lightCount;
+    //     };
+    //
+    // and can be uploaded as a StructuredBuffer together with getLightOrder()
+    struct LightBVHNode
+    {
+        Float3  lower;
+        int32_t rightOrFirst = 0; // right child, or first slot for leaves
+        Float3  upper;
+        int32_t lightCount   = 0; // 0 for interior nodes
+    };
+
+    static_assert(sizeof(LightBVHNode) == 32);
+
+    // bvh over light spheres (lightPosition + maxLightDistance)
+    class LightBVH
+    {
+    public:
+
+        static constexpr int MAX_LEAF_SIZE = 4;
+        static constexpr int MAX_DEPTH     = 64;
+
+        void build(const Light *lights, size_t lightCount);
+
+        // keep the topology and recompute bounds for moved lights.
+        // lights must have the same count as in the last build
+        void refit(const Light *lights, size_t lightCount);
+
+        bool empty() const;
+
+        size_t getLightCount() const;
+
+        const std::vector<LightBVHNode> &getNodes() const;
+
+        // leaf slot -> light index
+        const std::vector<int32_t> &getLightOrder() const;
+
+        // call func(lightIndex) for every light whose sphere bounding box
+        // overlaps aabb
+        template<typename Func>
+        void query(const AABB &aabb, Func &&func) const;
+
+    private:
+
+        struct BuildItem
+        {
+            Float3  center;
+            AABB    bound;
+            int32_t lightIndex;
+        };
+
+        int buildRecursively(BuildItem *beg, BuildItem *end, int depth);
+
+        static AABB getLightBound(const Light &light);
+
+        std::vector<LightBVHNode> nodes_;
+        std::vector<int32_t>      lightOrder_;
+    };
+
+    template<typename Func>
+    void LightBVH::query(const AABB &aabb, Func &&func) const
+    {
+        if(nodes_.empty())
+            return;
+
+        auto overlap = [&](const Float3 &lower, const Float3 &upper)
+        {
+            return lower.x <= aabb.upper.x && aabb.lower.x <= upper.x &&
+                   lower.y <= aabb.upper.y && aabb.lower.y <= upper.y &&
+                   lower.z <= aabb.upper.z && aabb.lower.z <= upper.z;
+        };
+
+        int stack[MAX_DEPTH + 1];
+        int top = 0;
+        stack[top++] = 0;
+
+        while(top)
+        {
+            const int nodeIndex = stack[--top];
+            const LightBVHNode &node = nodes_[nodeIndex];
+
+            if(!overlap(node.lower, node.upper))
+                continue;
+
+            if(node.lightCount)
+            {
+                for(int i = 0; i < node.lightCount; ++i)
+                    func(lightOrder_[node.rightOrFirst + i]);
+                continue;
+            }
+
+            stack[top++] = node.rightOrFirst;
+            stack[top++] = nodeIndex + 1;
+        }
+    }
+
+} // namespace clustering
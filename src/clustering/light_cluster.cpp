@@ -0,0 +1,1341 @@
+#include <bit>
+
+#include "./light_cluster.h"
+#include "./prefix_sum.h"
+#include "./radix_sort.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        // clusters [beg, end] per axis that a view space sphere may reach
+        struct ClusterBounds
+        {
+            Int3 beg;
+            Int3 end;
+        };
+
+        // tile range covered by [lower, upper] of a sphere's ndc bounds
+        // along one axis. empty (beg > end) when off screen
+        void getTileBounds(float lower, float upper, int count, int &beg, int &end)
+        {
+            // covers float differences to the tile planes at tile borders
+            constexpr float NDC_EPS = 1e-4f;
+
+            lower = (std::max)(lower - NDC_EPS, -1.0f);
+            upper = (std::min)(upper + NDC_EPS, 1.0f);
+
+            beg = static_cast<int>(std::floor((0.5f * lower + 0.5f) * count));
+            end = static_cast<int>(std::floor((0.5f * upper + 0.5f) * count));
+            beg = (std::max)(beg, 0);
+            end = (std::min)(end, count - 1);
+        }
+
+        // clusters that a sphere may reach, or false when it misses [nearZ, farZ].
+        // x and y from the screen rect of the sphere's view space box clipped
+        // to [nearZ, farZ], which contains the projection of the part of the
+        // sphere that can touch clusters. z from the slices of the clipped
+        // range, widened by one slice against rounding at slice borders
+        bool getLightClusterBounds(
+            const Float3         &p,
+            float                 r,
+            const Int3           &clusterCount,
+            const Mat4           &proj,
+            const ClusterSlicing &slicing,
+            ClusterBounds        &bounds)
+        {
+            const float minZ = (std::max)(p.z - r, slicing.nearZ);
+            const float maxZ = (std::min)(p.z + r, slicing.farZ);
+            if(minZ > maxZ)
+                return false;
+
+            // x / z is monotonic in x and z for z > 0, so the extremes are at
+            // corners of the box
+
+            auto getNDCBounds = [&](float c, float scale, float &lower, float &upper)
+            {
+                lower = scale * (std::min)((c - r) / minZ, (c - r) / maxZ);
+                upper = scale * (std::max)((c + r) / minZ, (c + r) / maxZ);
+            };
+
+            float lowerX, upperX, lowerY, upperY;
+            getNDCBounds(p.x, proj.m[0][0], lowerX, upperX);
+            getNDCBounds(p.y, proj.m[1][1], lowerY, upperY);
+
+            getTileBounds(lowerX, upperX, clusterCount.x, bounds.beg.x, bounds.end.x);
+            getTileBounds(lowerY, upperY, clusterCount.y, bounds.beg.y, bounds.end.y);
+
+            bounds.beg.z = (std::max)(viewZ2i(slicing, minZ) - 1, 0);
+            bounds.end.z = (std::min)(viewZ2i(slicing, maxZ) + 1, clusterCount.z - 1);
+
+            return bounds.beg.x <= bounds.end.x && bounds.beg.y <= bounds.end.y;
+        }
+
+    } // namespace anonymous
+
+    CPULightCluster::CPULightCluster(ThreadPool &threadPool)
+        : threadPool_(threadPool),
+          nearZ_(0), farZ_(0), view_(Mat4::identity()),
+          lights_(nullptr), lightCount_(0), activeClusters_(nullptr),
+          isa_(ISA::Scalar), kernel_(nullptr),
+          assignMode_(AssignMode::Flat),
+          indexCapacity_(IndexCapacity::Fixed),
+          clusterTest_(ClusterTest::AABB),
+          globalLightCoverage_(1),
+          enableStatistics_(false),
+          lightBVHSource_(nullptr),
+          clusterAABBBuilder_(threadPool), clusterAABBs_(nullptr),
+          staticLightGrid_(nullptr),
+          assignmentCount_(0),
+          enableTemporalReuse_(false), hasTemporalKey_(false),
+          enableCompactEncoding_(false), compactRequested_(false),
+          compactEncoded_(false)
+    {
+        setISA(detectISA());
+    }
+
+    void CPULightCluster::setClusterCount(const Int3 &count)
+    {
+        clusterCount_ = count;
+    }
+
+    void CPULightCluster::setProj(float nearZ, float farZ, const Mat4 &proj)
+    {
+        nearZ_ = nearZ;
+        farZ_  = farZ;
+        proj_  = proj;
+    }
+
+    void CPULightCluster::setSlicingPolicy(const SlicingPolicy &policy)
+    {
+        slicingPolicy_ = policy;
+    }
+
+    void CPULightCluster::setView(const Mat4 &view)
+    {
+        view_ = view;
+    }
+
+    void CPULightCluster::updateClusterAABBs()
+    {
+        clusterAABBKey_ = ClusterAABBKey{
+            .clusterCount = clusterCount_,
+            .nearZ        = nearZ_,
+            .farZ         = farZ_,
+            .proj         = proj_,
+            .slicing      = slicingPolicy_
+        };
+        clusterAABBs_ = &clusterAABBBuilder_.build(clusterAABBKey_);
+        clusterTilePlanes_ = buildClusterTilePlanes(clusterCount_, proj_);
+    }
+
+    void CPULightCluster::setLights(const Light *lights, size_t lightCount)
+    {
+        lights_     = lights;
+        lightCount_ = lightCount;
+    }
+
+    void CPULightCluster::setActiveClusters(
+        const std::vector<int32_t> *activeClusters)
+    {
+        activeClusters_ = activeClusters;
+    }
+
+    void CPULightCluster::setISA(ISA isa)
+    {
+        isa_    = isISASupported(isa) ? isa : ISA::Scalar;
+        kernel_ = getSphereAABBKernel(isa_);
+    }
+
+    void CPULightCluster::setAssignMode(AssignMode mode)
+    {
+        assignMode_ = mode;
+    }
+
+    void CPULightCluster::setIndexCapacity(IndexCapacity capacity)
+    {
+        indexCapacity_ = capacity;
+    }
+
+    void CPULightCluster::setClusterTest(ClusterTest test)
+    {
+        clusterTest_ = test;
+    }
+
+    void CPULightCluster::setStaticLightGrid(const StaticLightGrid *grid)
+    {
+        staticLightGrid_ = grid;
+    }
+
+    void CPULightCluster::setGlobalLightCoverage(float maxCoverage)
+    {
+        globalLightCoverage_ = maxCoverage;
+    }
+
+    void CPULightCluster::setStatisticsEnabled(bool enabled)
+    {
+        enableStatistics_ = enabled;
+    }
+
+    void CPULightCluster::setTemporalReuseEnabled(bool enabled)
+    {
+        enableTemporalReuse_ = enabled;
+    }
+
+    void CPULightCluster::setCompactEncodingEnabled(bool enabled)
+    {
+        enableCompactEncoding_ = enabled;
+    }
+
+    void CPULightCluster::run()
+    {
+        const TemporalAction action = prepareTemporalReuse();
+
+        if(action == TemporalAction::Incremental)
+        {
+            fillLocalLightIndicesIncremental();
+            compactLightIndices();
+        }
+        else if(action == TemporalAction::Full)
+        {
+            if(assignMode_ == AssignMode::BVH)
+                updateLightBVH();
+
+            transformLights();
+            fillLocalLightIndices();
+            compactLightIndices();
+        }
+
+        if(action != TemporalAction::Reuse ||
+           compactRequested_ != enableCompactEncoding_)
+            encodeCompactClusters();
+    }
+
+    const Int3 &CPULightCluster::getClusterCount() const
+    {
+        return clusterCount_;
+    }
+
+    int CPULightCluster::getLightIndexCount() const
+    {
+        if(indexCapacity_ == IndexCapacity::Exact)
+            return static_cast<int>(lightIndices_.size());
+        return AVG_LIGHTS_PER_CLUSTER * clusterCount_.product();
+    }
+
+    int64_t CPULightCluster::getAssignmentCount() const
+    {
+        return assignmentCount_;
+    }
+
+    ISA CPULightCluster::getISA() const
+    {
+        return isa_;
+    }
+
+    AssignMode CPULightCluster::getAssignMode() const
+    {
+        return assignMode_;
+    }
+
+    IndexCapacity CPULightCluster::getIndexCapacity() const
+    {
+        return indexCapacity_;
+    }
+
+    ClusterTest CPULightCluster::getClusterTest() const
+    {
+        return clusterTest_;
+    }
+
+    float CPULightCluster::getGlobalLightCoverage() const
+    {
+        return globalLightCoverage_;
+    }
+
+    bool CPULightCluster::isStatisticsEnabled() const
+    {
+        return enableStatistics_;
+    }
+
+    const ClusterStatistics &CPULightCluster::getStatistics() const
+    {
+        return statistics_;
+    }
+
+    const std::vector<AABB> &CPULightCluster::getClusterAABBs() const
+    {
+        return *clusterAABBs_;
+    }
+
+    const ClusterAABBBuilder &CPULightCluster::getClusterAABBBuilder() const
+    {
+        return clusterAABBBuilder_;
+    }
+
+    const std::vector<ClusterTilePlanes> &CPULightCluster::getClusterTilePlanes() const
+    {
+        return clusterTilePlanes_;
+    }
+
+    const SlicingPolicy &CPULightCluster::getSlicingPolicy() const
+    {
+        return slicingPolicy_;
+    }
+
+    const std::vector<ClusterRange> &CPULightCluster::getClusterRanges() const
+    {
+        return clusterRanges_;
+    }
+
+    bool CPULightCluster::isTemporalReuseEnabled() const
+    {
+        return enableTemporalReuse_;
+    }
+
+    const TemporalReuseCounters &CPULightCluster::getTemporalReuseCounters() const
+    {
+        return temporalReuseCounters_;
+    }
+
+    void CPULightCluster::resetTemporalReuseCounters()
+    {
+        temporalReuseCounters_ = {};
+    }
+
+    const std::vector<int32_t> &CPULightCluster::getLightIndices() const
+    {
+        return lightIndices_;
+    }
+
+    const std::vector<int32_t> &CPULightCluster::getGlobalLights() const
+    {
+        return globalLights_;
+    }
+
+    bool CPULightCluster::isCompactEncoded() const
+    {
+        return compactEncoded_;
+    }
+
+    const std::vector<uint32_t> &CPULightCluster::getCompactClusterRanges() const
+    {
+        return compactClusterRanges_;
+    }
+
+    const std::vector<uint16_t> &CPULightCluster::getCompactLightIndices() const
+    {
+        return compactLightIndices_;
+    }
+
+    const LightBVH &CPULightCluster::getLightBVH() const
+    {
+        return lightBVH_;
+    }
+
+    const StaticLightGrid *CPULightCluster::getStaticLightGrid() const
+    {
+        return staticLightGrid_;
+    }
+
+    CPULightCluster::TemporalAction CPULightCluster::prepareTemporalReuse()
+    {
+        // incremental updates stop paying off when more than 1 / ratio of
+        // the lights moved
+        constexpr size_t INCREMENTAL_LIGHT_RATIO = 8;
+
+        if(!enableTemporalReuse_)
+        {
+            hasTemporalKey_ = false;
+            return TemporalAction::Full;
+        }
+
+        const int clusterCount = clusterCount_.product();
+        ++temporalReuseCounters_.frameCount;
+        temporalReuseCounters_.clusterCount += clusterCount;
+
+        // scatter lists follow the frustum test whatever clusterTest_ is,
+        // so lists of another assign mode cannot be kept
+
+        const TemporalKey key = {
+            .clusterAABBKey  = clusterAABBKey_,
+            .view            = view_,
+            .assignMode      = assignMode_,
+            .indexCapacity   = indexCapacity_,
+            .clusterTest     = clusterTest_,
+            .globalCoverage  = globalLightCoverage_,
+            .lightCount      = lightCount_,
+            .activeClusters  = activeClusters_ != nullptr,
+            .staticLightGrid = staticLightGrid_
+        };
+
+        // lists are only reused when all of them were stored completely.
+        // the fixed capacity may have dropped the tail of the index buffer
+
+        const bool reusable =
+            hasTemporalKey_ && key == temporalKey_ &&
+            !enableStatistics_ && !key.activeClusters &&
+            assignmentCount_ == static_cast<int64_t>(lightIndices_.size());
+
+        temporalKey_    = key;
+        hasTemporalKey_ = true;
+
+        if(!reusable)
+        {
+            updateLightSpheres();
+            return TemporalAction::Full;
+        }
+
+        movedLights_.clear();
+        for(size_t i = 0; i < lightCount_; ++i)
+        {
+            const Float4 &s = lightSpheres_[i];
+            const Light  &l = lights_[i];
+            if(s.x != l.lightPosition.x || s.y != l.lightPosition.y ||
+               s.z != l.lightPosition.z || s.w != l.maxLightDistance)
+                movedLights_.push_back(static_cast<int32_t>(i));
+        }
+
+        if(movedLights_.empty())
+        {
+            ++temporalReuseCounters_.reusedFrameCount;
+            temporalReuseCounters_.reusedClusterCount += clusterCount;
+            return TemporalAction::Reuse;
+        }
+
+        // the incremental update tests moved lights like the flat mode,
+        // which would mix pairs outside the screen rects into scatter lists
+
+        if(movedLights_.size() * INCREMENTAL_LIGHT_RATIO > lightCount_ ||
+           assignMode_ == AssignMode::Scatter)
+        {
+            updateLightSpheres();
+            return TemporalAction::Full;
+        }
+
+        ++temporalReuseCounters_.incrementalFrameCount;
+        return TemporalAction::Incremental;
+    }
+
+    void CPULightCluster::updateLightSpheres()
+    {
+        lightSpheres_.resize(lightCount_);
+        for(size_t i = 0; i < lightCount_; ++i)
+        {
+            const Light &l = lights_[i];
+            lightSpheres_[i] = {
+                l.lightPosition.x, l.lightPosition.y, l.lightPosition.z,
+                l.maxLightDistance
+            };
+        }
+    }
+
+    void CPULightCluster::transformLights()
+    {
+        const ClusterSlicing slicing = getGlobalLightSlicing();
+
+        viewLights_.resize(static_cast<int>(lightCount_));
+        globalLightFlags_.resize(lightCount_);
+
+        threadPool_.parallelFor(
+            static_cast<int>(lightCount_), 1024,
+            [&](int beg, int end, int)
+        {
+            for(int i = beg; i < end; ++i)
+            {
+                const Float3 position = view_.transformPoint(lights_[i].lightPosition);
+                viewLights_.set(i, position, getViewLightRadius(i, position, slicing));
+            }
+        });
+
+        collectGlobalLights();
+    }
+
+    ClusterSlicing CPULightCluster::getGlobalLightSlicing() const
+    {
+        // the grid of the cluster aabbs, which may lag behind the setters
+
+        const ClusterAABBKey &key = clusterAABBKey_;
+        return getClusterSlicing(
+            key.clusterCount.z, key.nearZ, key.farZ, key.slicing);
+    }
+
+    float CPULightCluster::getViewLightRadius(
+        int li, const Float3 &viewPosition, const ClusterSlicing &slicing)
+    {
+        const float radius = lights_[li].maxLightDistance;
+
+        const bool global = isGlobalLight(
+            viewPosition, radius, clusterAABBKey_.clusterCount,
+            clusterAABBKey_.proj, slicing, globalLightCoverage_);
+
+        globalLightFlags_[li] = global;
+        return global ? 0.0f : radius;
+    }
+
+    void CPULightCluster::collectGlobalLights()
+    {
+        globalLights_.clear();
+        for(size_t i = 0; i < lightCount_; ++i)
+        {
+            if(globalLightFlags_[i])
+                globalLights_.push_back(static_cast<int32_t>(i));
+        }
+    }
+
+    int CPULightCluster::getMaxLightsPerCluster() const
+    {
+        if(indexCapacity_ == IndexCapacity::Exact || enableStatistics_)
+            return static_cast<int>(lightCount_);
+        return MAX_LIGHTS_PER_CLUSTER;
+    }
+
+    int32_t *CPULightCluster::beginLocalList(
+        ThreadScratch &scratch, int maxCount)
+    {
+        const size_t requiredSize = scratch.outputSize + maxCount;
+        if(scratch.output.size() < requiredSize)
+        {
+            scratch.output.resize(
+                (std::max)(requiredSize, 2 * scratch.output.size()));
+        }
+        return scratch.output.data() + scratch.outputSize;
+    }
+
+    void CPULightCluster::endLocalList(
+        ThreadScratch &scratch, int threadIndex, int clusterIndex, int count)
+    {
+        localLists_[clusterIndex] = LocalList{
+            .threadIndex = threadIndex,
+            .offset      = static_cast<int32_t>(scratch.outputSize)
+        };
+        localLightCounts_[clusterIndex] = count;
+        scratch.outputSize += count;
+    }
+
+    int CPULightCluster::testLights(
+        ThreadScratch  &scratch,
+        const LightSoA &lights,
+        int             clusterIndex,
+        int32_t        *output,
+        int             maxOutput)
+    {
+        const AABB &aabb = (*clusterAABBs_)[clusterIndex];
+        if(clusterTest_ == ClusterTest::AABB)
+            return kernel_(lights, 0, lights.count, aabb, output, maxOutput);
+
+        // the planes only run on the lights passing the simd aabb test.
+        // those are not limited to maxOutput, since the planes may reject
+        // some of them
+
+        std::vector<int32_t> &hits = scratch.aabbHits;
+        hits.resize(lights.count);
+        const int hitCount = kernel_(
+            lights, 0, lights.count, aabb, hits.data(), lights.count);
+
+        const ClusterTilePlanes &planes =
+            clusterTilePlanes_[clusterIndex / clusterCount_.z];
+
+        int count = 0;
+        for(int i = 0; i < hitCount && count < maxOutput; ++i)
+        {
+            const int li = hits[i];
+            if(isLightInTilePlanes(lights.getPosition(li), lights.radius[li], planes))
+                output[count++] = li;
+        }
+        return count;
+    }
+
+    int CPULightCluster::getListedClusterCount() const
+    {
+        if(activeClusters_)
+            return static_cast<int>(activeClusters_->size());
+        return clusterCount_.product();
+    }
+
+    int CPULightCluster::getListedCluster(int i) const
+    {
+        return activeClusters_ ? (*activeClusters_)[i] : i;
+    }
+
+    void CPULightCluster::fillLocalLightIndices()
+    {
+        const int clusterCount = clusterCount_.product();
+
+        localLightCounts_.resize(clusterCount);
+        localLists_.resize(clusterCount);
+
+        // clusters not in the active list keep these empty lists
+
+        if(activeClusters_)
+        {
+            std::fill(localLightCounts_.begin(), localLightCounts_.end(), 0);
+            std::fill(localLists_.begin(), localLists_.end(), LocalList{ 0, 0 });
+        }
+
+        threadScratch_.resize(threadPool_.getThreadCount());
+        for(auto &scratch : threadScratch_)
+            scratch.outputSize = 0;
+
+        if(assignMode_ == AssignMode::Hierarchical)
+            fillLocalLightIndicesHierarchical();
+        else if(assignMode_ == AssignMode::BVH)
+            fillLocalLightIndicesBVH();
+        else if(assignMode_ == AssignMode::Scatter)
+            fillLocalLightIndicesScatter();
+        else if(assignMode_ == AssignMode::StaticGrid)
+            fillLocalLightIndicesStaticGrid();
+        else
+            fillLocalLightIndicesFlat();
+    }
+
+    void CPULightCluster::fillLocalLightIndicesFlat()
+    {
+        const int maxCount = getMaxLightsPerCluster();
+
+        threadPool_.parallelFor(
+            getListedClusterCount(), 16, [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+            for(int i = beg; i < end; ++i)
+            {
+                const int ci = getListedCluster(i);
+                int32_t *output = beginLocalList(scratch, maxCount);
+                const int count = testLights(
+                    scratch, viewLights_, ci, output, maxCount);
+                endLocalList(scratch, threadIndex, ci, count);
+            }
+        });
+    }
+
+    void CPULightCluster::fillLocalLightIndicesHierarchical()
+    {
+        // the tile aabb contains all its cluster aabbs, so a light rejected
+        // by the tile can not touch any of its clusters. survivors keep
+        // their relative order, so the result equals the flat assignment
+
+        const int tileCount  = clusterCount_.x * clusterCount_.y;
+        const int lightCount = static_cast<int>(lightCount_);
+        const int maxCount   = getMaxLightsPerCluster();
+
+        // active clusters of tile ti are [tileListBeg[ti], tileListBeg[ti + 1])
+        // in the active list. the tile aabb then only covers those clusters
+
+        std::vector<int32_t> tileListBeg;
+        if(activeClusters_)
+        {
+            tileListBeg.resize(tileCount + 1);
+            int i = 0;
+            for(int ti = 0; ti <= tileCount; ++ti)
+            {
+                const int firstCluster = ti * clusterCount_.z;
+                while(i < static_cast<int>(activeClusters_->size()) &&
+                      (*activeClusters_)[i] < firstCluster)
+                    ++i;
+                tileListBeg[ti] = i;
+            }
+        }
+
+        threadPool_.parallelFor(
+            tileCount, 1, [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+            scratch.survivors.resize(lightCount);
+            scratch.fineIndices.resize(maxCount);
+
+            std::vector<int32_t> &tileClusters = scratch.tileClusters;
+
+            for(int ti = beg; ti < end; ++ti)
+            {
+                const int firstCluster = ti * clusterCount_.z;
+
+                tileClusters.clear();
+                if(activeClusters_)
+                {
+                    tileClusters.assign(
+                        activeClusters_->begin() + tileListBeg[ti],
+                        activeClusters_->begin() + tileListBeg[ti + 1]);
+                }
+                else
+                {
+                    for(int zi = 0; zi < clusterCount_.z; ++zi)
+                        tileClusters.push_back(firstCluster + zi);
+                }
+
+                if(tileClusters.empty())
+                    continue;
+
+                // coarse: lights against the tile aabb
+
+                AABB tileAABB = (*clusterAABBs_)[tileClusters[0]];
+                for(size_t i = 1; i < tileClusters.size(); ++i)
+                {
+                    const AABB &aabb = (*clusterAABBs_)[tileClusters[i]];
+                    tileAABB.lower = vec_min(tileAABB.lower, aabb.lower);
+                    tileAABB.upper = vec_max(tileAABB.upper, aabb.upper);
+                }
+
+                const int survivorCount = kernel_(
+                    viewLights_, 0, lightCount, tileAABB,
+                    scratch.survivors.data(), lightCount);
+
+                LightSoA &survivorLights = scratch.survivorLights;
+                survivorLights.resize(survivorCount);
+                for(int i = 0; i < survivorCount; ++i)
+                {
+                    const int li = scratch.survivors[i];
+                    survivorLights.set(
+                        i, viewLights_.getPosition(li), viewLights_.radius[li]);
+                }
+
+                // fine: survivors against each z-slice
+
+                for(int ci : tileClusters)
+                {
+                    const int count = testLights(
+                        scratch, survivorLights, ci,
+                        scratch.fineIndices.data(), maxCount);
+
+                    int32_t *output = beginLocalList(scratch, count);
+                    for(int i = 0; i < count; ++i)
+                        output[i] = scratch.survivors[scratch.fineIndices[i]];
+
+                    endLocalList(scratch, threadIndex, ci, count);
+                }
+            }
+        });
+    }
+
+    void CPULightCluster::fillLocalLightIndicesBVH()
+    {
+        // the bvh lives in world space. each cluster aabb is transformed back
+        // to a (slightly inflated) world space box for the query, and the
+        // candidates are then tested exactly in view space. sorting the hits
+        // before truncation gives the same lists as the flat assignment
+
+        const Mat4 invView  = view_.inv();
+        const int  maxCount = getMaxLightsPerCluster();
+
+        threadPool_.parallelFor(
+            getListedClusterCount(), 16, [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+            std::vector<int32_t> &candidates = scratch.candidates;
+
+            for(int i = beg; i < end; ++i)
+            {
+                const int ci = getListedCluster(i);
+                const AABB &aabb = (*clusterAABBs_)[ci];
+                const ClusterTilePlanes &planes =
+                    clusterTilePlanes_[ci / clusterCount_.z];
+
+                const AABB worldAABB = getWorldAABB(invView, aabb);
+
+                candidates.clear();
+                lightBVH_.query(worldAABB, [&](int32_t li)
+                {
+                    const Float3 p = viewLights_.getPosition(li);
+                    const float  r = viewLights_.radius[li];
+                    if(clusterTest_ == ClusterTest::AABB ?
+                       isLightInAABB(p, r, aabb) :
+                       isLightInClusterFrustum(p, r, aabb, planes))
+                        candidates.push_back(li);
+                });
+
+                std::sort(candidates.begin(), candidates.end());
+
+                const int count = (std::min)(
+                    static_cast<int>(candidates.size()), maxCount);
+
+                int32_t *output = beginLocalList(scratch, count);
+                std::copy(candidates.begin(), candidates.begin() + count, output);
+
+                endLocalList(scratch, threadIndex, ci, count);
+            }
+        });
+    }
+
+    void CPULightCluster::fillLocalLightIndicesScatter()
+    {
+        // each chunk of lights appends its pairs to the bins of its thread in
+        // light order. the chunks are concatenated in light order and sorted
+        // stably by cluster, which leaves every list sorted by light index.
+        // no thread writes to another's data, so nothing needs atomics
+
+        constexpr int LIGHT_CHUNK_SIZE = 64;
+
+        const int clusterCount = clusterCount_.product();
+        const int lightCount   = static_cast<int>(lightCount_);
+        const int chunkCount   = (lightCount + LIGHT_CHUNK_SIZE - 1) / LIGHT_CHUNK_SIZE;
+        const int maxCount     = getMaxLightsPerCluster();
+
+        const ClusterSlicing slicing = getGlobalLightSlicing();
+        const Int3          &count   = clusterAABBKey_.clusterCount;
+
+        if(activeClusters_)
+        {
+            activeClusterFlags_.assign(clusterCount, 0);
+            for(int ci : *activeClusters_)
+                activeClusterFlags_[ci] = 1;
+        }
+
+        for(auto &scratch : threadScratch_)
+        {
+            scratch.scatterClusters.clear();
+            scratch.scatterLights.clear();
+        }
+
+        scatterChunks_.resize(chunkCount);
+
+        // scatter
+
+        threadPool_.parallelFor(
+            lightCount, LIGHT_CHUNK_SIZE, [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+
+            ScatterChunk &chunk = scatterChunks_[beg / LIGHT_CHUNK_SIZE];
+            chunk.threadIndex = threadIndex;
+            chunk.offset      = static_cast<int32_t>(scratch.scatterLights.size());
+
+            for(int li = beg; li < end; ++li)
+            {
+                const Float3 p = viewLights_.getPosition(li);
+                const float  r = viewLights_.radius[li];
+                if(r <= 0)
+                    continue;
+
+                ClusterBounds bounds;
+                if(!getLightClusterBounds(
+                    p, r, count, clusterAABBKey_.proj, slicing, bounds))
+                    continue;
+
+                for(int xi = bounds.beg.x; xi <= bounds.end.x; ++xi)
+                {
+                    for(int yi = bounds.beg.y; yi <= bounds.end.y; ++yi)
+                    {
+                        const int ti = xi * count.y + yi;
+                        const ClusterTilePlanes &planes = clusterTilePlanes_[ti];
+
+                        if(clusterTest_ == ClusterTest::Frustum &&
+                           !isLightInTilePlanes(p, r, planes))
+                            continue;
+
+                        for(int zi = bounds.beg.z; zi <= bounds.end.z; ++zi)
+                        {
+                            const int ci = ti * count.z + zi;
+                            if(activeClusters_ && !activeClusterFlags_[ci])
+                                continue;
+                            if(!isLightInAABB(p, r, (*clusterAABBs_)[ci]))
+                                continue;
+
+                            scratch.scatterClusters.push_back(static_cast<uint32_t>(ci));
+                            scratch.scatterLights.push_back(li);
+                        }
+                    }
+                }
+            }
+
+            chunk.count = static_cast<int32_t>(scratch.scatterLights.size()) - chunk.offset;
+        });
+
+        // merge
+
+        std::vector<int32_t> chunkOffsets(chunkCount);
+        for(int i = 0; i < chunkCount; ++i)
+            chunkOffsets[i] = scatterChunks_[i].count;
+        const int pairCount = static_cast<int>(exclusiveScan(
+            threadPool_, chunkOffsets.data(), chunkOffsets.data(), chunkCount));
+
+        scatterKeys_.resize(pairCount);
+        scatterValues_.resize(pairCount);
+
+        threadPool_.parallelFor(chunkCount, 16, [&](int beg, int end, int)
+        {
+            for(int i = beg; i < end; ++i)
+            {
+                const ScatterChunk  &chunk   = scatterChunks_[i];
+                const ThreadScratch &scratch = threadScratch_[chunk.threadIndex];
+                std::copy_n(
+                    scratch.scatterClusters.begin() + chunk.offset, chunk.count,
+                    scatterKeys_.begin() + chunkOffsets[i]);
+                std::copy_n(
+                    scratch.scatterLights.begin() + chunk.offset, chunk.count,
+                    scatterValues_.begin() + chunkOffsets[i]);
+            }
+        });
+
+        const int keyBits = std::bit_width(static_cast<uint32_t>(clusterCount));
+        radixSort(
+            threadPool_, scatterKeys_.data(), scatterValues_.data(), pairCount, keyBits);
+
+        // the sorted lights become the local output of thread 0, with one
+        // run per cluster
+
+        std::fill(localLightCounts_.begin(), localLightCounts_.end(), 0);
+        std::fill(localLists_.begin(), localLists_.end(), LocalList{ 0, 0 });
+
+        for(int i = 0; i < pairCount;)
+        {
+            const int ci = static_cast<int>(scatterKeys_[i]);
+
+            int j = i + 1;
+            while(j < pairCount && static_cast<int>(scatterKeys_[j]) == ci)
+                ++j;
+
+            localLists_[ci]       = LocalList{ .threadIndex = 0, .offset = i };
+            localLightCounts_[ci] = (std::min)(j - i, maxCount);
+            i = j;
+        }
+
+        std::swap(threadScratch_[0].output, scatterValues_);
+        threadScratch_[0].outputSize = pairCount;
+    }
+
+    void CPULightCluster::fillLocalLightIndicesStaticGrid()
+    {
+        // static lights come from the grid cells overlapping each cluster
+        // and are tested exactly. dynamic lights are culled against the
+        // aabb of a group of listed clusters like in the hierarchical mode,
+        // and the survivors are tested per cluster with the simd kernel.
+        // both lists are ascending, so merging them before truncation gives
+        // the lists of the flat assignment
+
+        constexpr int CLUSTER_GROUP_SIZE = 16;
+
+        const int lightCount = static_cast<int>(lightCount_);
+        const int maxCount   = getMaxLightsPerCluster();
+        const Mat4 invView   = view_.inv();
+
+        staticLightFlags_.assign(lightCount, 0);
+        if(staticLightGrid_)
+        {
+            for(int li : staticLightGrid_->getStaticLights())
+            {
+                if(li < lightCount)
+                    staticLightFlags_[li] = 1;
+            }
+        }
+
+        dynamicLights_.clear();
+        for(int li = 0; li < lightCount; ++li)
+        {
+            if(!staticLightFlags_[li])
+                dynamicLights_.push_back(li);
+        }
+
+        const int dynamicCount = static_cast<int>(dynamicLights_.size());
+        dynamicViewLights_.resize(dynamicCount);
+        for(int i = 0; i < dynamicCount; ++i)
+        {
+            const int li = dynamicLights_[i];
+            dynamicViewLights_.set(
+                i, viewLights_.getPosition(li), viewLights_.radius[li]);
+        }
+
+        threadPool_.parallelFor(
+            getListedClusterCount(), CLUSTER_GROUP_SIZE,
+            [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+            std::vector<int32_t> &candidates = scratch.candidates;
+            std::vector<int32_t> &survivors  = scratch.survivors;
+            survivors.resize(dynamicCount);
+
+            for(int groupBeg = beg; groupBeg < end; groupBeg += CLUSTER_GROUP_SIZE)
+            {
+                const int groupEnd = (std::min)(groupBeg + CLUSTER_GROUP_SIZE, end);
+
+                // coarse: dynamic lights against the group aabb
+
+                AABB groupAABB = (*clusterAABBs_)[getListedCluster(groupBeg)];
+                for(int i = groupBeg + 1; i < groupEnd; ++i)
+                {
+                    const AABB &aabb = (*clusterAABBs_)[getListedCluster(i)];
+                    groupAABB.lower = vec_min(groupAABB.lower, aabb.lower);
+                    groupAABB.upper = vec_max(groupAABB.upper, aabb.upper);
+                }
+
+                const int survivorCount = kernel_(
+                    dynamicViewLights_, 0, dynamicCount, groupAABB,
+                    survivors.data(), dynamicCount);
+
+                LightSoA &survivorLights = scratch.survivorLights;
+                survivorLights.resize(survivorCount);
+                for(int i = 0; i < survivorCount; ++i)
+                {
+                    const int li = dynamicLights_[survivors[i]];
+                    survivorLights.set(
+                        i, viewLights_.getPosition(li), viewLights_.radius[li]);
+                }
+
+                scratch.fineIndices.resize(survivorCount);
+
+                for(int i = groupBeg; i < groupEnd; ++i)
+                {
+                    const int ci = getListedCluster(i);
+                    const AABB &aabb = (*clusterAABBs_)[ci];
+                    const ClusterTilePlanes &planes =
+                        clusterTilePlanes_[ci / clusterCount_.z];
+
+                    // fine: grid candidates, then the dynamic survivors
+
+                    candidates.clear();
+                    if(staticLightGrid_)
+                    {
+                        staticLightGrid_->query(
+                            getWorldAABB(invView, aabb), [&](int32_t li)
+                        {
+                            if(li >= lightCount)
+                                return;
+                            const Float3 p = viewLights_.getPosition(li);
+                            const float  r = viewLights_.radius[li];
+                            if(clusterTest_ == ClusterTest::AABB ?
+                               isLightInAABB(p, r, aabb) :
+                               isLightInClusterFrustum(p, r, aabb, planes))
+                                candidates.push_back(li);
+                        });
+                        std::sort(candidates.begin(), candidates.end());
+                    }
+
+                    const int staticHitCount = static_cast<int>(candidates.size());
+
+                    const int dynamicHitCount = testLights(
+                        scratch, survivorLights, ci,
+                        scratch.fineIndices.data(), survivorCount);
+                    for(int j = 0; j < dynamicHitCount; ++j)
+                    {
+                        candidates.push_back(
+                            dynamicLights_[survivors[scratch.fineIndices[j]]]);
+                    }
+
+                    std::inplace_merge(
+                        candidates.begin(), candidates.begin() + staticHitCount,
+                        candidates.end());
+
+                    const int count = (std::min)(
+                        static_cast<int>(candidates.size()), maxCount);
+
+                    int32_t *output = beginLocalList(scratch, count);
+                    std::copy(candidates.begin(), candidates.begin() + count, output);
+
+                    endLocalList(scratch, threadIndex, ci, count);
+                }
+            }
+        });
+    }
+
+    void CPULightCluster::fillLocalLightIndicesIncremental()
+    {
+        // the view is unchanged, so only the moved lights need new view space
+        // spheres. a cluster is affected if its list contains a moved light
+        // or a moved light hits it now. unaffected clusters keep their
+        // lists, affected ones merge their kept lights with the moved lights
+        // that hit them, both sorted by light index
+
+        const int clusterCount = clusterCount_.product();
+        const int lightCount   = static_cast<int>(lightCount_);
+        const int movedCount   = static_cast<int>(movedLights_.size());
+        const int maxCount     = getMaxLightsPerCluster();
+
+        // a moved light may also have become global or local. lists holding
+        // a light that became global drop it like any other moved light
+
+        const ClusterSlicing slicing = getGlobalLightSlicing();
+
+        movedViewLights_.resize(movedCount);
+        movedLightFlags_.assign(lightCount, 0);
+        for(int k = 0; k < movedCount; ++k)
+        {
+            const int li = movedLights_[k];
+            const Float3 position = view_.transformPoint(lights_[li].lightPosition);
+            const float  radius   = getViewLightRadius(li, position, slicing);
+
+            viewLights_.set(li, position, radius);
+            movedViewLights_.set(k, position, radius);
+            movedLightFlags_[li] = 1;
+        }
+
+        collectGlobalLights();
+
+        localLightCounts_.resize(clusterCount);
+        localLists_.resize(clusterCount);
+        affectedClusterFlags_.assign(clusterCount, 0);
+
+        threadScratch_.resize(threadPool_.getThreadCount());
+        for(auto &scratch : threadScratch_)
+            scratch.outputSize = 0;
+
+        threadPool_.parallelFor(
+            clusterCount, 16, [&](int beg, int end, int threadIndex)
+        {
+            ThreadScratch &scratch = threadScratch_[threadIndex];
+
+            std::vector<int32_t> &hits = scratch.candidates;
+            hits.resize(movedCount);
+
+            for(int ci = beg; ci < end; ++ci)
+            {
+                const ClusterRange &range    = clusterRanges_[ci];
+                const int32_t      *oldList  = lightIndices_.data() + range.rangeBeg;
+                const int           oldCount = range.rangeEnd - range.rangeBeg;
+
+                // indices into movedLights_, increasing
+                const int hitCount = testLights(
+                    scratch, movedViewLights_, ci, hits.data(), movedCount);
+
+                bool affected = hitCount > 0;
+                for(int i = 0; i < oldCount && !affected; ++i)
+                    affected = movedLightFlags_[oldList[i]] != 0;
+
+                if(!affected)
+                {
+                    int32_t *output = beginLocalList(scratch, oldCount);
+                    std::copy(oldList, oldList + oldCount, output);
+                    endLocalList(scratch, threadIndex, ci, oldCount);
+                    continue;
+                }
+
+                affectedClusterFlags_[ci] = 1;
+
+                // a full list may have dropped lights that fit now
+
+                if(oldCount >= maxCount)
+                {
+                    int32_t *output = beginLocalList(scratch, maxCount);
+                    const int count = testLights(
+                        scratch, viewLights_, ci, output, maxCount);
+                    endLocalList(scratch, threadIndex, ci, count);
+                    continue;
+                }
+
+                int32_t *output = beginLocalList(
+                    scratch, (std::min)(oldCount + hitCount, maxCount));
+
+                int count = 0, i = 0, k = 0;
+                while(count < maxCount)
+                {
+                    while(i < oldCount && movedLightFlags_[oldList[i]])
+                        ++i;
+
+                    if(i == oldCount && k == hitCount)
+                        break;
+
+                    if(k == hitCount ||
+                       (i < oldCount && oldList[i] < movedLights_[hits[k]]))
+                        output[count++] = oldList[i++];
+                    else
+                        output[count++] = movedLights_[hits[k++]];
+                }
+
+                endLocalList(scratch, threadIndex, ci, count);
+            }
+        });
+
+        int affectedCount = 0;
+        for(uint8_t flag : affectedClusterFlags_)
+            affectedCount += flag;
+        temporalReuseCounters_.reusedClusterCount += clusterCount - affectedCount;
+
+        for(int li : movedLights_)
+        {
+            const Light &l = lights_[li];
+            lightSpheres_[li] = {
+                l.lightPosition.x, l.lightPosition.y, l.lightPosition.z,
+                l.maxLightDistance
+            };
+        }
+    }
+
+    void CPULightCluster::updateLightBVH()
+    {
+        if(lightBVHSource_ != lights_ ||
+           lightBVH_.getLightCount() != lightCount_)
+        {
+            lightBVH_.build(lights_, lightCount_);
+            lightBVHSource_ = lights_;
+        }
+        else
+            lightBVH_.refit(lights_, lightCount_);
+    }
+
+    AABB CPULightCluster::getWorldAABB(const Mat4 &invView, const AABB &aabb)
+    {
+        constexpr float QUERY_EPS = 1e-3f;
+
+        AABB result = {
+            Float3((std::numeric_limits<float>::max)()),
+            Float3(std::numeric_limits<float>::lowest())
+        };
+        for(int i = 0; i < 8; ++i)
+        {
+            const Float3 corner = {
+                (i & 1) ? aabb.upper.x : aabb.lower.x,
+                (i & 2) ? aabb.upper.y : aabb.lower.y,
+                (i & 4) ? aabb.upper.z : aabb.lower.z
+            };
+            const Float3 worldCorner = invView.transformPoint(corner);
+            result.lower = vec_min(result.lower, worldCorner);
+            result.upper = vec_max(result.upper, worldCorner);
+        }
+        result.lower = result.lower - Float3(QUERY_EPS);
+        result.upper = result.upper + Float3(QUERY_EPS);
+
+        return result;
+    }
+
+    void CPULightCluster::compactLightIndices()
+    {
+        const int clusterCount = clusterCount_.product();
+
+        // local lists are uncapped when statistics are enabled. they are
+        // sorted by light index, so capping here keeps the same prefix as
+        // capping during the assignment
+
+        const int maxLightsPerCluster = indexCapacity_ == IndexCapacity::Exact ?
+            (std::numeric_limits<int>::max)() : MAX_LIGHTS_PER_CLUSTER;
+
+        if(enableStatistics_)
+        {
+            statisticsCounters_.assign(stat::COUNTER_COUNT, 0);
+            for(int ci = 0; ci < clusterCount; ++ci)
+            {
+                addClusterToStatistics(
+                    statisticsCounters_.data(),
+                    localLightCounts_[ci], maxLightsPerCluster);
+                localLightCounts_[ci] =
+                    (std::min)(localLightCounts_[ci], maxLightsPerCluster);
+            }
+        }
+
+        // scan
+
+        std::vector<int32_t> &offsets = localLightCounts_;
+        clusterRanges_.resize(clusterCount);
+        for(int ci = 0; ci < clusterCount; ++ci)
+            clusterRanges_[ci].rangeEnd = localLightCounts_[ci];
+
+        assignmentCount_ = exclusiveScan(
+            threadPool_, localLightCounts_.data(), offsets.data(), clusterCount);
+
+        const int lightIndexCount = indexCapacity_ == IndexCapacity::Exact ?
+            static_cast<int>(assignmentCount_) :
+            (std::min)(
+                AVG_LIGHTS_PER_CLUSTER * clusterCount,
+                static_cast<int>(assignmentCount_));
+
+        lightIndices_.resize(lightIndexCount);
+
+        if(enableStatistics_)
+        {
+            statistics_ = resolveClusterStatistics(
+                statisticsCounters_.data(), clusterCount, lightIndexCount);
+        }
+
+        // scatter
+
+        threadPool_.parallelFor(
+            clusterCount, 64, [&](int beg, int end, int)
+        {
+            for(int ci = beg; ci < end; ++ci)
+            {
+                ClusterRange &range = clusterRanges_[ci];
+                const int count = range.rangeEnd;
+
+                range.rangeBeg = offsets[ci];
+                range.rangeEnd = (std::min)(lightIndexCount, offsets[ci] + count);
+
+                const LocalList &list = localLists_[ci];
+                const int32_t *localIndices =
+                    threadScratch_[list.threadIndex].output.data() + list.offset;
+
+                for(int i = range.rangeBeg, j = 0; i < range.rangeEnd; ++i, ++j)
+                    lightIndices_[i] = localIndices[j];
+            }
+        });
+    }
+
+    void CPULightCluster::encodeCompactClusters()
+    {
+        const int clusterCount = clusterCount_.product();
+
+        compactRequested_ = enableCompactEncoding_;
+        compactEncoded_   = false;
+
+        if(!enableCompactEncoding_ || lightCount_ > COMPACT_MAX_LIGHT_COUNT)
+            return;
+
+        // counts rounded up to even, like the allocation of CSMain
+
+        compactOffsets_.resize(clusterCount);
+        for(int ci = 0; ci < clusterCount; ++ci)
+        {
+            const ClusterRange &range = clusterRanges_[ci];
+            const int count = range.rangeEnd - range.rangeBeg;
+            if(count > COMPACT_MAX_RANGE_COUNT)
+                return;
+            compactOffsets_[ci] = (count + 1) & ~1;
+        }
+
+        const int64_t indexCount = exclusiveScan(
+            threadPool_, compactOffsets_.data(), compactOffsets_.data(), clusterCount);
+        if(indexCount >= COMPACT_MAX_INDEX_COUNT)
+            return;
+
+        compactClusterRanges_.resize(clusterCount);
+        compactLightIndices_.resize(indexCount);
+
+        threadPool_.parallelFor(
+            clusterCount, 64, [&](int beg, int end, int)
+        {
+            for(int ci = beg; ci < end; ++ci)
+            {
+                const ClusterRange &range = clusterRanges_[ci];
+                const int offset = compactOffsets_[ci];
+                const int count  = range.rangeEnd - range.rangeBeg;
+
+                compactClusterRanges_[ci] = packCompactRange(offset, count);
+
+                for(int i = 0; i < count; ++i)
+                {
+                    compactLightIndices_[offset + i] = static_cast<uint16_t>(
+                        lightIndices_[range.rangeBeg + i]);
+                }
+                if(count & 1)
+                    compactLightIndices_[offset + count] = 0;
+            }
+        });
+
+        compactEncoded_ = true;
+    }
+
+    int findClusterMismatch(
+        int                              clusterCount,
+        const std::vector<ClusterRange> &rangesA,
+        const std::vector<int32_t>      &indicesA,
+        const std::vector<ClusterRange> &rangesB,
+        const std::vector<int32_t>      &indicesB)
+    {
+        std::vector<int32_t> listA, listB;
+        for(int ci = 0; ci < clusterCount; ++ci)
+        {
+            const ClusterRange &a = rangesA[ci];
+            const ClusterRange &b = rangesB[ci];
+
+            listA.assign(
+                indicesA.begin() + a.rangeBeg, indicesA.begin() + a.rangeEnd);
+            listB.assign(
+                indicesB.begin() + b.rangeBeg, indicesB.begin() + b.rangeEnd);
+
+            std::sort(listA.begin(), listA.end());
+            std::sort(listB.begin(), listB.end());
+
+            if(listA != listB)
+                return ci;
+        }
+        return -1;
+    }
+
+} // namespace clustering
@@ -0,0 +1,413 @@
+#pragma once
+
+#include "./cluster_aabb.h"
+#include "./cluster_frustum.h"
+#include "./global_lights.h"
+#include "./light_bvh.h"
+#include "./sphere_aabb.h"
+#include "./static_light_grid.h"
+#include "./statistics.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    enum class AssignMode
+    {
+        // test every light against every cluster
+        Flat,
+        // cull lights against each screen tile's full-depth aabb, then test
+        // only the survivors against the tile's z-slices
+        Hierarchical,
+        // query a world space light bvh with each cluster's bounding box.
+        // the bvh is rebuilt when the light array changes and refitted on
+        // every run, so lights can move in place
+        BVH,
+        // each light projects its sphere to a conservative screen rect and
+        // slice range and is only tested against the clusters inside. the
+        // light-cluster pairs of each thread are merged by a stable sort on
+        // the cluster index, so lists are still sorted by light index.
+        // lights reaching a cluster aabb outside the tile pyramid are not
+        // listed, so the lists equal those of ClusterTest::Frustum.
+        // temporal reuse runs fully instead of incrementally when lights move
+        Scatter,
+        // take the candidates of each cluster from the world space cells of
+        // the static light grid (setStaticLightGrid) overlapping it, and test
+        // the lights outside the grid against every cluster like Flat
+        StaticGrid
+    };
+
+    enum class IndexCapacity
+    {
+        // like LightCluster: at most MAX_LIGHTS_PER_CLUSTER lights per
+        // cluster in a buffer of AVG_LIGHTS_PER_CLUSTER * clusterCount
+        Fixed,
+        // no per-cluster limit, the index buffer has exactly as many
+        // entries as there are light-cluster pairs
+        Exact
+    };
+
+    // how much of the previous result CPULightCluster::run() could keep,
+    // with temporal reuse enabled
+    struct TemporalReuseCounters
+    {
+        int64_t frameCount = 0;
+        // nothing changed, all lists were kept
+        int64_t reusedFrameCount = 0;
+        // only some lights moved, the lists were updated in place
+        int64_t incrementalFrameCount = 0;
+
+        int64_t clusterCount = 0;
+        // clusters whose lists were kept without testing any light
+        int64_t reusedClusterCount = 0;
+    };
+
+    // cpu implementation of LightCluster, producing the same cluster range
+    // and light index buffers as CSMain in asset/clustered/cluster.hlsl.
+    // ranges are laid out in cluster order instead of atomic order
+    class CPULightCluster
+    {
+    public:
+
+        explicit CPULightCluster(ThreadPool &threadPool);
+
+        void setClusterCount(const Int3 &count);
+
+        void setProj(float nearZ, float farZ, const Mat4 &proj);
+
+        // takes effect at the next updateClusterAABBs()
+        void setSlicingPolicy(const SlicingPolicy &policy);
+
+        void setView(const Mat4 &view);
+
+        // rebuild cluster aabbs for the current cluster count and projection.
+        // the last few results are cached by ClusterAABBBuilder
+        void updateClusterAABBs();
+
+        void setLights(const Light *lights, size_t lightCount);
+
+        // only assign lights to the given clusters (ascending, e.g. from
+        // findActiveClusters). other clusters get empty ranges.
+        // nullptr means all clusters
+        void setActiveClusters(const std::vector<int32_t> *activeClusters);
+
+        // isa of the sphere-aabb kernel. detectISA() by default
+        void setISA(ISA isa);
+
+        void setAssignMode(AssignMode mode);
+
+        void setIndexCapacity(IndexCapacity capacity);
+
+        void setClusterTest(ClusterTest test);
+
+        // static lights of AssignMode::StaticGrid. the grid must have been
+        // updated with the light array of setLights() before run().
+        // nullptr tests all lights like Flat
+        void setStaticLightGrid(const StaticLightGrid *grid);
+
+        // lights whose estimated coverage (see estimateClusterCoverage)
+        // exceeds maxCoverage are left out of the cluster lists and listed
+        // by getGlobalLights() instead. 1 by default, which disables it
+        void setGlobalLightCoverage(float maxCoverage);
+
+        // collect ClusterStatistics in run(). in Fixed mode this makes the
+        // assignment count lights past MAX_LIGHTS_PER_CLUSTER, like CSMain
+        // does when its statistics are enabled
+        void setStatisticsEnabled(bool enabled);
+
+        // skip run() when the view, cluster aabbs, settings and light
+        // spheres are the same as in the last run. when only a few lights
+        // moved, only those are re-tested, and only the lists holding one of
+        // them or reached by one of them are rebuilt. falls back to a full
+        // run with statistics or active clusters enabled
+        void setTemporalReuseEnabled(bool enabled);
+
+        // also encode the result of run() in the compact format of
+        // LightCluster (see packCompactRange). skipped when the lists do
+        // not fit, e.g. with more than COMPACT_MAX_LIGHT_COUNT lights
+        void setCompactEncodingEnabled(bool enabled);
+
+        void run();
+
+        const Int3 &getClusterCount() const;
+
+        // capacity of the light index buffer. in Exact mode this is only
+        // known after run()
+        int getLightIndexCount() const;
+
+        // light-cluster pairs found by the last run, including the ones
+        // dropped by the fixed capacity
+        int64_t getAssignmentCount() const;
+
+        ISA getISA() const;
+
+        AssignMode getAssignMode() const;
+
+        IndexCapacity getIndexCapacity() const;
+
+        ClusterTest getClusterTest() const;
+
+        float getGlobalLightCoverage() const;
+
+        bool isStatisticsEnabled() const;
+
+        bool isTemporalReuseEnabled() const;
+
+        const TemporalReuseCounters &getTemporalReuseCounters() const;
+
+        void resetTemporalReuseCounters();
+
+        // statistics of the last run. available if statistics are enabled
+        const ClusterStatistics &getStatistics() const;
+
+        // available after updateClusterAABBs()
+        const std::vector<AABB> &getClusterAABBs() const;
+
+        const ClusterAABBBuilder &getClusterAABBBuilder() const;
+
+        // available after updateClusterAABBs(), see buildClusterTilePlanes
+        const std::vector<ClusterTilePlanes> &getClusterTilePlanes() const;
+
+        const SlicingPolicy &getSlicingPolicy() const;
+
+        const std::vector<ClusterRange> &getClusterRanges() const;
+
+        const std::vector<int32_t> &getLightIndices() const;
+
+        // lights of the last run shaded by every pixel, in ascending order.
+        // none of them is in a cluster list
+        const std::vector<int32_t> &getGlobalLights() const;
+
+        // whether the last run produced the compact encoding below
+        bool isCompactEncoded() const;
+
+        // one packed range per cluster, in cluster order like
+        // getClusterRanges()
+        const std::vector<uint32_t> &getCompactClusterRanges() const;
+
+        const std::vector<uint16_t> &getCompactLightIndices() const;
+
+        const LightBVH &getLightBVH() const;
+
+        const StaticLightGrid *getStaticLightGrid() const;
+
+    private:
+
+        // per-cluster lists are first appended to the output of the thread
+        // that computed them (count), then placed with an exclusive scan of
+        // the counts (scan) and copied into the final buffer (scatter)
+        struct ThreadScratch
+        {
+            std::vector<int32_t> output;
+            size_t               outputSize = 0;
+
+            std::vector<int32_t> survivors;
+            std::vector<int32_t> fineIndices;
+            LightSoA             survivorLights;
+            std::vector<int32_t> candidates;
+            std::vector<int32_t> tileClusters;
+            std::vector<int32_t> aabbHits;
+
+            // scatter: (cluster, light) pairs found by this thread
+            std::vector<uint32_t> scatterClusters;
+            std::vector<int32_t>  scatterLights;
+        };
+
+        // pairs of the lights of one parallelFor chunk in the scratch of
+        // the thread that ran it
+        struct ScatterChunk
+        {
+            int32_t threadIndex;
+            int32_t offset;
+            int32_t count;
+        };
+
+        struct LocalList
+        {
+            int32_t threadIndex;
+            int32_t offset;
+        };
+
+        // cluster aabbs, view and settings of a run
+        struct TemporalKey
+        {
+            ClusterAABBKey         clusterAABBKey;
+            Mat4                   view;
+            AssignMode             assignMode      = AssignMode::Flat;
+            IndexCapacity          indexCapacity   = IndexCapacity::Fixed;
+            ClusterTest            clusterTest     = ClusterTest::AABB;
+            float                  globalCoverage  = 1;
+            size_t                 lightCount      = 0;
+            bool                   activeClusters  = false;
+            const StaticLightGrid *staticLightGrid = nullptr;
+
+            bool operator==(const TemporalKey &) const noexcept = default;
+        };
+
+        // full run, incremental run or nothing to do
+        enum class TemporalAction
+        {
+            Full,
+            Incremental,
+            Reuse
+        };
+
+        TemporalAction prepareTemporalReuse();
+
+        void updateLightSpheres();
+
+        void transformLights();
+
+        ClusterSlicing getGlobalLightSlicing() const;
+
+        // view space radius of light li. global lights get 0, which fails
+        // every test since they all require a distance below the radius
+        float getViewLightRadius(
+            int li, const Float3 &viewPosition, const ClusterSlicing &slicing);
+
+        void collectGlobalLights();
+
+        int getMaxLightsPerCluster() const;
+
+        int32_t *beginLocalList(ThreadScratch &scratch, int maxCount);
+
+        void endLocalList(
+            ThreadScratch &scratch, int threadIndex, int clusterIndex, int count);
+
+        // kernel_ with the cluster test: lights [0, lights.count) against
+        // cluster ci, appending at most maxOutput indices to output
+        int testLights(
+            ThreadScratch  &scratch,
+            const LightSoA &lights,
+            int             clusterIndex,
+            int32_t        *output,
+            int             maxOutput);
+
+        int getListedClusterCount() const;
+
+        int getListedCluster(int i) const;
+
+        void fillLocalLightIndices();
+
+        void fillLocalLightIndicesFlat();
+
+        void fillLocalLightIndicesHierarchical();
+
+        void fillLocalLightIndicesBVH();
+
+        void fillLocalLightIndicesScatter();
+
+        void fillLocalLightIndicesStaticGrid();
+
+        void fillLocalLightIndicesIncremental();
+
+        void updateLightBVH();
+
+        // world space box of a view space aabb, inflated against rounding
+        static AABB getWorldAABB(const Mat4 &invView, const AABB &aabb);
+
+        void compactLightIndices();
+
+        void encodeCompactClusters();
+
+        ThreadPool &threadPool_;
+
+        Int3 clusterCount_;
+
+        float nearZ_;
+        float farZ_;
+        Mat4  proj_;
+
+        SlicingPolicy slicingPolicy_;
+
+        ClusterAABBKey clusterAABBKey_;
+
+        Mat4 view_;
+
+        const Light *lights_;
+        size_t       lightCount_;
+
+        const std::vector<int32_t> *activeClusters_;
+
+        ISA              isa_;
+        SphereAABBKernel kernel_;
+
+        AssignMode    assignMode_;
+        IndexCapacity indexCapacity_;
+        ClusterTest   clusterTest_;
+        float         globalLightCoverage_;
+        bool          enableStatistics_;
+
+        std::vector<ThreadScratch> threadScratch_;
+
+        LightBVH     lightBVH_;
+        const Light *lightBVHSource_;
+
+        ClusterAABBBuilder       clusterAABBBuilder_;
+        const std::vector<AABB> *clusterAABBs_;
+
+        std::vector<ClusterTilePlanes> clusterTilePlanes_;
+
+        // lights outside staticLightGrid_, tested against every cluster
+        const StaticLightGrid *staticLightGrid_;
+        std::vector<uint8_t>   staticLightFlags_;
+        std::vector<int32_t>   dynamicLights_;
+        LightSoA               dynamicViewLights_;
+
+        std::vector<ScatterChunk> scatterChunks_;
+        std::vector<uint32_t>     scatterKeys_;
+        std::vector<int32_t>      scatterValues_;
+        std::vector<uint8_t>      activeClusterFlags_;
+
+        LightSoA               viewLights_;
+        std::vector<uint8_t>   globalLightFlags_;
+        std::vector<int32_t>   globalLights_;
+        std::vector<int32_t>   localLightCounts_;
+        std::vector<LocalList> localLists_;
+
+        int64_t assignmentCount_;
+
+        std::vector<uint32_t> statisticsCounters_;
+        ClusterStatistics     statistics_;
+
+        // temporal reuse. lightSpheres_ are the world space spheres used by
+        // the last run (xyz: position, w: radius)
+
+        bool enableTemporalReuse_;
+
+        bool        hasTemporalKey_;
+        TemporalKey temporalKey_;
+
+        std::vector<Float4>  lightSpheres_;
+        std::vector<int32_t> movedLights_;
+        std::vector<uint8_t> movedLightFlags_;
+        LightSoA             movedViewLights_;
+        std::vector<uint8_t> affectedClusterFlags_;
+
+        TemporalReuseCounters temporalReuseCounters_;
+
+        std::vector<ClusterRange> clusterRanges_;
+        std::vector<int32_t>      lightIndices_;
+
+        // compact encoding. compactRequested_ is the switch at the last
+        // encoding, so reused lists are only encoded again when it changed
+
+        bool enableCompactEncoding_;
+        bool compactRequested_;
+        bool compactEncoded_;
+
+        std::vector<int32_t>  compactOffsets_;
+        std::vector<uint32_t> compactClusterRanges_;
+        std::vector<uint16_t> compactLightIndices_;
+    };
+
+    // compare per-cluster light sets, ignoring where each range is placed
+    // in the index buffer. returns the first mismatching cluster or -1
+    int findClusterMismatch(
+        int                              clusterCount,
+        const std::vector<ClusterRange> &rangesA,
+        const std::vector<int32_t>      &indicesA,
+        const std::vector<ClusterRange> &rangesB,
+        const std::vector<int32_t>      &indicesB);
+
+} // namespace clustering
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // view space light spheres as structure-of-arrays. arrays are padded
+    // so that simd kernels can always load 16 lanes past any valid index.
+    // lanes past count are masked out by the kernels
+    struct LightSoA
+    {
+        static constexpr int PADDING = 16;
+
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+
+        int count = 0;
+
+        void resize(int newCount)
+        {
+            count = newCount;
+
+            const size_t size =
+                (static_cast<size_t>(newCount) + 2 * PADDING - 1)
+                / PADDING * PADDING;
+
+            if(x.size() < size)
+            {
+                x.resize(size);
+                y.resize(size);
+                z.resize(size);
+                radius.resize(size);
+            }
+        }
+
+        void set(int i, const Float3 &position, float maxLightDistance)
+        {
+            x[i]      = position.x;
+            y[i]      = position.y;
+            z[i]      = position.z;
+            radius[i] = maxLightDistance;
+        }
+
+        Float3 getPosition(int i) const
+        {
+            return { x[i], y[i], z[i] };
+        }
+    };
+
+} // namespace clustering
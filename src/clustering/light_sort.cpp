@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <numeric>
+
+#include "./light_sort.h"
+#include "./radix_sort.h"
+
+namespace clustering
+{
+
+    std::vector<int32_t> sortLightsByMorton(
+        ThreadPool &threadPool, Light *lights, size_t lightCount)
+    {
+        const int count = static_cast<int>(lightCount);
+        if(count <= 1)
+            return std::vector<int32_t>(count, 0);
+
+        Float3 lower = lights[0].lightPosition, upper = lower;
+        for(int i = 1; i < count; ++i)
+        {
+            const Float3 &p = lights[i].lightPosition;
+            lower = {
+                (std::min)(lower.x, p.x),
+                (std::min)(lower.y, p.y),
+                (std::min)(lower.z, p.z)
+            };
+            upper = {
+                (std::max)(upper.x, p.x),
+                (std::max)(upper.y, p.y),
+                (std::max)(upper.z, p.z)
+            };
+        }
+
+        // quantize to 10 bits per axis
+
+        const Float3 extent = upper - lower;
+        const Float3 scale = {
+            extent.x > 0 ? 1023 / extent.x : 0,
+            extent.y > 0 ? 1023 / extent.y : 0,
+            extent.z > 0 ? 1023 / extent.z : 0
+        };
+
+        std::vector<uint32_t> keys(count);
+        std::vector<int32_t>  order(count);
+        std::iota(order.begin(), order.end(), 0);
+
+        threadPool.parallelFor(count, 4096, [&](int beg, int end, int)
+        {
+            for(int i = beg; i < end; ++i)
+            {
+                const Float3 p = lights[i].lightPosition - lower;
+                keys[i] = encodeMorton3(
+                    static_cast<uint32_t>(p.x * scale.x),
+                    static_cast<uint32_t>(p.y * scale.y),
+                    static_cast<uint32_t>(p.z * scale.z));
+            }
+        });
+
+        radixSort(threadPool, keys.data(), order.data(), count, 30);
+
+        std::vector<Light>   sorted(count);
+        std::vector<int32_t> remap(count);
+
+        threadPool.parallelFor(count, 4096, [&](int beg, int end, int)
+        {
+            for(int i = beg; i < end; ++i)
+            {
+                sorted[i]       = lights[order[i]];
+                remap[order[i]] = i;
+            }
+        });
+
+        std::copy(sorted.begin(), sorted.end(), lights);
+        return remap;
+    }
+
+    void remapLightHandles(
+        const std::vector<int32_t> &remap, int32_t *handles, size_t handleCount)
+    {
+        for(size_t i = 0; i < handleCount; ++i)
+        {
+            if(handles[i] >= 0)
+                handles[i] = remap[handles[i]];
+        }
+    }
+
+} // namespace clustering
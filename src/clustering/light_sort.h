@@ -0,0 +1,37 @@
+#pragma once
+
+#include "./common.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // interleaves the low 10 bits of x, y and z as ... z1 y1 x1 z0 y0 x0
+    inline uint32_t encodeMorton3(uint32_t x, uint32_t y, uint32_t z)
+    {
+        auto spread = [](uint32_t v)
+        {
+            v &= 0x3ff;
+            v = (v | (v << 16)) & 0x030000ff;
+            v = (v | (v << 8))  & 0x0300f00f;
+            v = (v | (v << 4))  & 0x030c30c3;
+            v = (v | (v << 2))  & 0x09249249;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+    }
+
+    // reorders lights along a morton curve over the bounding box of their
+    // positions, so lights close in space get close indices and neighbouring
+    // clusters reference nearby lights. equal codes keep their order.
+    // returns old index -> new index, to be applied to every light index
+    // kept outside of the array with remapLightHandles
+    std::vector<int32_t> sortLightsByMorton(
+        ThreadPool &threadPool, Light *lights, size_t lightCount);
+
+    // handles[i] = remap[handles[i]]. negative handles mean no light and
+    // are kept
+    void remapLightHandles(
+        const std::vector<int32_t> &remap, int32_t *handles, size_t handleCount);
+
+} // namespace clustering
@@ -0,0 +1,179 @@
+#include "./light_store.h"
+
+namespace clustering
+{
+
+    LightStore::LightStore(int consumerCount)
+        : lightCount_(0), dirtyBlocks_((std::max)(consumerCount, 1))
+    {
+
+    }
+
+    void LightStore::resize(size_t lightCount)
+    {
+        lightCount_ = lightCount;
+
+        positionX_.resize(lightCount);
+        positionY_.resize(lightCount);
+        positionZ_.resize(lightCount);
+        maxDistance_.resize(lightCount);
+        intensity_.resize(lightCount);
+        ambient_.resize(lightCount);
+
+        const size_t blockCount =
+            (lightCount + DIRTY_BLOCK_SIZE - 1) / DIRTY_BLOCK_SIZE;
+        for(auto &blocks : dirtyBlocks_)
+            blocks.assign(blockCount, 1);
+    }
+
+    size_t LightStore::size() const
+    {
+        return lightCount_;
+    }
+
+    int LightStore::getConsumerCount() const
+    {
+        return static_cast<int>(dirtyBlocks_.size());
+    }
+
+    void LightStore::setLight(size_t index, const Light &light)
+    {
+        positionX_[index]   = light.lightPosition.x;
+        positionY_[index]   = light.lightPosition.y;
+        positionZ_[index]   = light.lightPosition.z;
+        maxDistance_[index] = light.maxLightDistance;
+        intensity_[index]   = light.lightIntensity;
+        ambient_[index]     = light.lightAmbient;
+        markDirty(index, index + 1);
+    }
+
+    Light LightStore::getLight(size_t index) const
+    {
+        return Light{
+            .lightPosition    = { positionX_[index], positionY_[index], positionZ_[index] },
+            .maxLightDistance = maxDistance_[index],
+            .lightIntensity   = intensity_[index],
+            .lightAmbient     = ambient_[index]
+        };
+    }
+
+    void LightStore::setPosition(size_t index, const Float3 &position)
+    {
+        positionX_[index] = position.x;
+        positionY_[index] = position.y;
+        positionZ_[index] = position.z;
+        markDirty(index, index + 1);
+    }
+
+    void LightStore::setMaxDistance(size_t index, float maxDistance)
+    {
+        maxDistance_[index] = maxDistance;
+        markDirty(index, index + 1);
+    }
+
+    float *LightStore::getPositionX()
+    {
+        return positionX_.data();
+    }
+
+    float *LightStore::getPositionY()
+    {
+        return positionY_.data();
+    }
+
+    float *LightStore::getPositionZ()
+    {
+        return positionZ_.data();
+    }
+
+    float *LightStore::getMaxDistance()
+    {
+        return maxDistance_.data();
+    }
+
+    const float *LightStore::getPositionX() const
+    {
+        return positionX_.data();
+    }
+
+    const float *LightStore::getPositionY() const
+    {
+        return positionY_.data();
+    }
+
+    const float *LightStore::getPositionZ() const
+    {
+        return positionZ_.data();
+    }
+
+    const float *LightStore::getMaxDistance() const
+    {
+        return maxDistance_.data();
+    }
+
+    void LightStore::markDirty(size_t beg, size_t end)
+    {
+        end = (std::min)(end, lightCount_);
+        if(beg >= end)
+            return;
+
+        const size_t blockBeg = beg / DIRTY_BLOCK_SIZE;
+        const size_t blockEnd = (end - 1) / DIRTY_BLOCK_SIZE + 1;
+        for(auto &blocks : dirtyBlocks_)
+            std::fill(blocks.begin() + blockBeg, blocks.begin() + blockEnd, 1);
+    }
+
+    void LightStore::takeDirtyRanges(int consumer, std::vector<LightRange> &ranges)
+    {
+        ranges.clear();
+
+        std::vector<uint8_t> &blocks = dirtyBlocks_[consumer];
+        const int blockCount = static_cast<int>(blocks.size());
+
+        for(int bi = 0; bi < blockCount;)
+        {
+            if(!blocks[bi])
+            {
+                ++bi;
+                continue;
+            }
+
+            const int blockBeg = bi;
+            while(bi < blockCount && blocks[bi])
+                blocks[bi++] = 0;
+
+            ranges.push_back({
+                blockBeg * DIRTY_BLOCK_SIZE,
+                (std::min)(bi * DIRTY_BLOCK_SIZE, static_cast<int>(lightCount_))
+            });
+        }
+    }
+
+    void LightStore::writeLights(
+        ThreadPool                    &threadPool,
+        const std::vector<LightRange> &ranges,
+        Light                         *dst) const
+    {
+        // ranges are block aligned, so blocks are the unit of work
+
+        std::vector<int32_t> blocks;
+        for(auto &range : ranges)
+        {
+            for(int32_t i = range.beg; i < range.end; i += DIRTY_BLOCK_SIZE)
+                blocks.push_back(i);
+        }
+
+        threadPool.parallelFor(
+            static_cast<int>(blocks.size()), 16, [&](int beg, int end, int)
+        {
+            for(int b = beg; b < end; ++b)
+            {
+                const size_t first = blocks[b];
+                const size_t last  = (std::min)(first + DIRTY_BLOCK_SIZE, lightCount_);
+                for(size_t i = first; i < last; ++i)
+                    dst[i] = getLight(i);
+            }
+        });
+    }
+
+} // namespace clustering
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "./common.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // [beg, end) of light indices
+    struct LightRange
+    {
+        int32_t beg = 0;
+        int32_t end = 0;
+    };
+
+    // structure-of-arrays light storage for lights animated on the cpu.
+    // changes are tracked per block of DIRTY_BLOCK_SIZE lights, separately
+    // for each consumer (e.g. one staging copy per frame in flight), so a
+    // consumer only converts and uploads what changed since it last did
+    class LightStore
+    {
+    public:
+
+        static constexpr int DIRTY_BLOCK_SIZE = 64;
+
+        explicit LightStore(int consumerCount = 1);
+
+        // new lights are zero. marks everything dirty
+        void resize(size_t lightCount);
+
+        size_t size() const;
+
+        int getConsumerCount() const;
+
+        void setLight(size_t index, const Light &light);
+
+        Light getLight(size_t index) const;
+
+        void setPosition(size_t index, const Float3 &position);
+
+        void setMaxDistance(size_t index, float maxDistance);
+
+        // arrays for bulk updates. call markDirty for the written range
+
+        float *getPositionX();
+        float *getPositionY();
+        float *getPositionZ();
+        float *getMaxDistance();
+
+        const float *getPositionX() const;
+        const float *getPositionY() const;
+        const float *getPositionZ() const;
+        const float *getMaxDistance() const;
+
+        void markDirty(size_t beg, size_t end);
+
+        // dirty block ranges of the consumer, merged and ascending. they are
+        // cleared for this consumer only
+        void takeDirtyRanges(int consumer, std::vector<LightRange> &ranges);
+
+        // dst[i] = getLight(i) for i in ranges
+        void writeLights(
+            ThreadPool                    &threadPool,
+            const std::vector<LightRange> &ranges,
+            Light                         *dst) const;
+
+    private:
+
+        size_t lightCount_;
+
+        std::vector<float>  positionX_;
+        std::vector<float>  positionY_;
+        std::vector<float>  positionZ_;
+        std::vector<float>  maxDistance_;
+        std::vector<Float3> intensity_;
+        std::vector<Float3> ambient_;
+
+        // dirtyBlocks_[consumer][block]
+        std::vector<std::vector<uint8_t>> dirtyBlocks_;
+    };
+
+} // namespace clustering
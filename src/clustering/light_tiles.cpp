@@ -0,0 +1,198 @@
+#include "./light_tiles.h"
+
+namespace clustering
+{
+
+    CPULightTiles::CPULightTiles(ThreadPool &threadPool)
+        : threadPool_(threadPool), tileCountX_(0), tileCountY_(0),
+          view_(Mat4::identity()), lights_(nullptr), lightCount_(0),
+          depth_(nullptr), width_(0), height_(0), limitLightCount_(true),
+          assignmentCount_(0)
+    {
+
+    }
+
+    void CPULightTiles::setTileCount(int tileCountX, int tileCountY)
+    {
+        tileCountX_ = tileCountX;
+        tileCountY_ = tileCountY;
+    }
+
+    void CPULightTiles::setProj(const Mat4 &proj)
+    {
+        proj_ = proj;
+    }
+
+    void CPULightTiles::setView(const Mat4 &view)
+    {
+        view_ = view;
+    }
+
+    void CPULightTiles::setLights(const Light *lights, size_t lightCount)
+    {
+        lights_     = lights;
+        lightCount_ = lightCount;
+    }
+
+    void CPULightTiles::setDepth(const float *depth, int width, int height)
+    {
+        depth_  = depth;
+        width_  = width;
+        height_ = height;
+    }
+
+    void CPULightTiles::setLightCountLimited(bool limited)
+    {
+        limitLightCount_ = limited;
+    }
+
+    void CPULightTiles::run()
+    {
+        tilePlanes_ = buildClusterTilePlanes({ tileCountX_, tileCountY_, 1 }, proj_);
+
+        computeDepthBounds();
+        assignLights();
+    }
+
+    int CPULightTiles::getTileCountX() const
+    {
+        return tileCountX_;
+    }
+
+    int CPULightTiles::getTileCountY() const
+    {
+        return tileCountY_;
+    }
+
+    int CPULightTiles::getTileIndex(int xi, int yi) const
+    {
+        return xi * tileCountY_ + yi;
+    }
+
+    const std::vector<TileDepthBounds> &CPULightTiles::getTileDepthBounds() const
+    {
+        return tileDepthBounds_;
+    }
+
+    int64_t CPULightTiles::getAssignmentCount() const
+    {
+        return assignmentCount_;
+    }
+
+    const std::vector<ClusterRange> &CPULightTiles::getTileRanges() const
+    {
+        return tileRanges_;
+    }
+
+    const std::vector<int32_t> &CPULightTiles::getLightIndices() const
+    {
+        return lightIndices_;
+    }
+
+    void CPULightTiles::computeDepthBounds()
+    {
+        const int tileCount = tileCountX_ * tileCountY_;
+        tileDepthBounds_.assign(tileCount, TileDepthBounds{});
+
+        // pixel columns of tile column xi are [columnBeg[xi], columnBeg[xi + 1])
+
+        std::vector<int> columnBeg(tileCountX_ + 1, width_);
+        for(int px = width_ - 1; px >= 0; --px)
+        {
+            const float scrX = (px + 0.5f) / width_;
+            const int xi = static_cast<int>(std::floor(scrX * tileCountX_));
+            if(0 <= xi && xi < tileCountX_)
+                columnBeg[xi] = px;
+        }
+        for(int xi = tileCountX_ - 1; xi >= 0; --xi)
+            columnBeg[xi] = (std::min)(columnBeg[xi], columnBeg[xi + 1]);
+
+        // each tile column owns a disjoint range of bounds
+
+        threadPool_.parallelFor(
+            tileCountX_, 1, [&](int beg, int end, int)
+        {
+            for(int py = 0; py < height_; ++py)
+            {
+                const float scrY = 1 - (py + 0.5f) / height_;
+                const int yi = static_cast<int>(std::floor(scrY * tileCountY_));
+                if(yi < 0 || yi >= tileCountY_)
+                    continue;
+
+                const float *row = depth_ + static_cast<size_t>(py) * width_;
+                for(int px = columnBeg[beg]; px < columnBeg[end]; ++px)
+                {
+                    if(row[px] >= 1)
+                        continue;
+
+                    const float scrX = (px + 0.5f) / width_;
+                    const int xi = static_cast<int>(std::floor(scrX * tileCountX_));
+                    const float z = depthToViewZ(proj_, row[px]);
+
+                    TileDepthBounds &bounds = tileDepthBounds_[getTileIndex(xi, yi)];
+                    bounds.minZ = (std::min)(bounds.minZ, z);
+                    bounds.maxZ = (std::max)(bounds.maxZ, z);
+                }
+            }
+        });
+    }
+
+    void CPULightTiles::assignLights()
+    {
+        const int tileCount  = tileCountX_ * tileCountY_;
+        const int lightCount = static_cast<int>(lightCount_);
+
+        viewPositions_.resize(lightCount);
+        for(int li = 0; li < lightCount; ++li)
+            viewPositions_[li] = view_.transformPoint(lights_[li].lightPosition);
+
+        tileFoundCounts_.resize(tileCount);
+        tileLists_.resize(tileCount);
+
+        threadPool_.parallelFor(tileCount, 16, [&](int beg, int end, int)
+        {
+            for(int ti = beg; ti < end; ++ti)
+            {
+                std::vector<int32_t> &list = tileLists_[ti];
+                list.clear();
+
+                int found = 0;
+
+                const TileDepthBounds &bounds = tileDepthBounds_[ti];
+                if(!bounds.empty())
+                {
+                    for(int li = 0; li < lightCount; ++li)
+                    {
+                        if(!isLightInTile(
+                            viewPositions_[li], lights_[li].maxLightDistance,
+                            tilePlanes_[ti], bounds))
+                            continue;
+
+                        if(!limitLightCount_ || found < MAX_LIGHTS_PER_TILE)
+                            list.push_back(li);
+                        ++found;
+                    }
+                }
+
+                tileFoundCounts_[ti] = found;
+            }
+        });
+
+        // compact
+
+        tileRanges_.resize(tileCount);
+        lightIndices_.clear();
+        assignmentCount_ = 0;
+
+        for(int ti = 0; ti < tileCount; ++ti)
+        {
+            tileRanges_[ti].rangeBeg = static_cast<int32_t>(lightIndices_.size());
+            lightIndices_.insert(
+                lightIndices_.end(), tileLists_[ti].begin(), tileLists_[ti].end());
+            tileRanges_[ti].rangeEnd = static_cast<int32_t>(lightIndices_.size());
+
+            assignmentCount_ += tileFoundCounts_[ti];
+        }
+    }
+
+} // namespace clustering
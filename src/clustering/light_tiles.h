@@ -0,0 +1,128 @@
+#pragma once
+
+#include "./active_cluster.h"
+#include "./cluster_frustum.h"
+
+namespace clustering
+{
+
+    // tiled forward (forward+): lights are culled per screen tile against
+    // the tile pyramid, cut to the view z range of the tile's depth
+    // samples. one list per tile instead of one per cluster, which costs
+    // less to build but lets a tile spanning a depth edge collect the
+    // lights of both sides
+
+    // must be consistent with LightTiles and asset/clustered/tile.hlsl
+    constexpr int MAX_LIGHTS_PER_TILE = 256;
+
+    // view z range of the depth samples of a tile. tiles without a sample
+    // in front of the far plane have minZ > maxZ
+    struct TileDepthBounds
+    {
+        float minZ = (std::numeric_limits<float>::max)();
+        float maxZ = std::numeric_limits<float>::lowest();
+
+        bool empty() const noexcept
+        {
+            return minZ > maxZ;
+        }
+    };
+
+    // same test as CSMain in asset/clustered/tile.hlsl.
+    // lightPosition is in view space
+    inline bool isLightInTile(
+        const Float3            &lightPosition,
+        float                    maxLightDistance,
+        const ClusterTilePlanes &planes,
+        const TileDepthBounds   &bounds)
+    {
+        return lightPosition.z + maxLightDistance > bounds.minZ &&
+               lightPosition.z - maxLightDistance < bounds.maxZ &&
+               isLightInTilePlanes(lightPosition, maxLightDistance, planes);
+    }
+
+    // cpu reference of asset/clustered/tile.hlsl. tiles split the screen
+    // evenly like the x and y of clusters, and are indexed by
+    // xi * tileCountY + yi
+    class CPULightTiles
+    {
+    public:
+
+        explicit CPULightTiles(ThreadPool &threadPool);
+
+        void setTileCount(int tileCountX, int tileCountY);
+
+        void setProj(const Mat4 &proj);
+
+        void setView(const Mat4 &view);
+
+        void setLights(const Light *lights, size_t lightCount);
+
+        // width * height depth buffer values with row 0 at the top of the
+        // screen, like findActiveClusters. referenced until run()
+        void setDepth(const float *depth, int width, int height);
+
+        // when limited, a list keeps its first MAX_LIGHTS_PER_TILE
+        // lights like tile.hlsl does (which keeps an arbitrary subset
+        // instead). true by default
+        void setLightCountLimited(bool limited);
+
+        void run();
+
+        int getTileCountX() const;
+
+        int getTileCountY() const;
+
+        int getTileIndex(int xi, int yi) const;
+
+        const std::vector<TileDepthBounds> &getTileDepthBounds() const;
+
+        // light-tile pairs found by the last run, including the ones
+        // dropped by MAX_LIGHTS_PER_TILE
+        int64_t getAssignmentCount() const;
+
+        // ranges into getLightIndices(), in tile order
+        const std::vector<ClusterRange> &getTileRanges() const;
+
+        const std::vector<int32_t> &getLightIndices() const;
+
+    private:
+
+        void computeDepthBounds();
+
+        void assignLights();
+
+        ThreadPool &threadPool_;
+
+        int tileCountX_;
+        int tileCountY_;
+
+        Mat4 proj_;
+        Mat4 view_;
+
+        const Light *lights_;
+        size_t       lightCount_;
+
+        const float *depth_;
+        int          width_;
+        int          height_;
+
+        bool limitLightCount_;
+
+        std::vector<Float3> viewPositions_;
+
+        std::vector<ClusterTilePlanes> tilePlanes_;
+        std::vector<TileDepthBounds>   tileDepthBounds_;
+
+        int64_t assignmentCount_;
+
+        // lights found per tile, and the ones kept of them. the lists are
+        // then compacted into lightIndices_
+        std::vector<int32_t>              tileFoundCounts_;
+        std::vector<std::vector<int32_t>> tileLists_;
+
+        std::vector<ClusterRange> tileRanges_;
+        std::vector<int32_t>      lightIndices_;
+    };
+
+} // namespace clustering
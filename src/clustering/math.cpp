@@ -0,0 +1,127 @@
+#include "./math.h"
+
+namespace clustering
+{
+
+    Mat4 Mat4::identity() noexcept
+    {
+        Mat4 ret;
+        for(int i = 0; i < 4; ++i)
+            ret.m[i][i] = 1;
+        return ret;
+    }
+
+    Mat4 Mat4::lookAt(
+        const Float3 &eye, const Float3 &dst, const Float3 &up) noexcept
+    {
+        const Float3 D = (dst - eye).normalize();
+        const Float3 R = cross(up, D).normalize();
+        const Float3 U = cross(D, R);
+
+        Mat4 ret;
+        ret.m[0][0] = R.x; ret.m[0][1] = U.x; ret.m[0][2] = D.x;
+        ret.m[1][0] = R.y; ret.m[1][1] = U.y; ret.m[1][2] = D.y;
+        ret.m[2][0] = R.z; ret.m[2][1] = U.z; ret.m[2][2] = D.z;
+        ret.m[3][0] = -dot(R, eye);
+        ret.m[3][1] = -dot(U, eye);
+        ret.m[3][2] = -dot(D, eye);
+        ret.m[3][3] = 1;
+        return ret;
+    }
+
+    Mat4 Mat4::perspective(
+        float fovYRad, float wOverH, float nearZ, float farZ) noexcept
+    {
+        const float yScale = 1 / std::tan(0.5f * fovYRad);
+        const float xScale = yScale / wOverH;
+
+        Mat4 ret;
+        ret.m[0][0] = xScale;
+        ret.m[1][1] = yScale;
+        ret.m[2][2] = farZ / (farZ - nearZ);
+        ret.m[2][3] = 1;
+        ret.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+        return ret;
+    }
+
+    Mat4 Mat4::inv() const noexcept
+    {
+        // gauss-jordan elimination with partial pivoting
+
+        double a[4][8];
+        for(int r = 0; r < 4; ++r)
+        {
+            for(int c = 0; c < 4; ++c)
+            {
+                a[r][c]     = m[r][c];
+                a[r][c + 4] = r == c ? 1 : 0;
+            }
+        }
+
+        for(int c = 0; c < 4; ++c)
+        {
+            int pivot = c;
+            for(int r = c + 1; r < 4; ++r)
+            {
+                if(std::abs(a[r][c]) > std::abs(a[pivot][c]))
+                    pivot = r;
+            }
+
+            if(pivot != c)
+            {
+                for(int k = 0; k < 8; ++k)
+                    std::swap(a[c][k], a[pivot][k]);
+            }
+
+            const double invPivot = 1 / a[c][c];
+            for(int k = 0; k < 8; ++k)
+                a[c][k] *= invPivot;
+
+            for(int r = 0; r < 4; ++r)
+            {
+                if(r == c)
+                    continue;
+                const double f = a[r][c];
+                for(int k = 0; k < 8; ++k)
+                    a[r][k] -= f * a[c][k];
+            }
+        }
+
+        Mat4 ret;
+        for(int r = 0; r < 4; ++r)
+        {
+            for(int c = 0; c < 4; ++c)
+                ret.m[r][c] = static_cast<float>(a[r][c + 4]);
+        }
+        return ret;
+    }
+
+    Float4 operator*(const Float4 &v, const Mat4 &m) noexcept
+    {
+        const float in[4] = { v.x, v.y, v.z, v.w };
+        float out[4] = {};
+        for(int c = 0; c < 4; ++c)
+        {
+            for(int r = 0; r < 4; ++r)
+                out[c] += in[r] * m.m[r][c];
+        }
+        return { out[0], out[1], out[2], out[3] };
+    }
+
+    Mat4 operator*(const Mat4 &a, const Mat4 &b) noexcept
+    {
+        Mat4 ret;
+        for(int r = 0; r < 4; ++r)
+        {
+            for(int c = 0; c < 4; ++c)
+            {
+                float sum = 0;
+                for(int k = 0; k < 4; ++k)
+                    sum += a.m[r][k] * b.m[k][c];
+                ret.m[r][c] = sum;
+            }
+        }
+        return ret;
+    }
+
+} // namespace clustering
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace clustering
+{
+
+    struct Float3
+    {
+        float x = 0, y = 0, z = 0;
+
+        constexpr Float3() = default;
+
+        constexpr explicit Float3(float v) noexcept
+            : x(v), y(v), z(v)
+        {
+
+        }
+
+        constexpr Float3(float x, float y, float z) noexcept
+            : x(x), y(y), z(z)
+        {
+
+        }
+
+        float &operator[](int i) noexcept
+        {
+            return (&x)[i];
+        }
+
+        float operator[](int i) const noexcept
+        {
+            return (&x)[i];
+        }
+
+        float length_square() const noexcept
+        {
+            return x * x + y * y + z * z;
+        }
+
+        float length() const noexcept
+        {
+            return std::sqrt(length_square());
+        }
+
+        Float3 normalize() const noexcept
+        {
+            const float invLen = 1 / length();
+            return { x * invLen, y * invLen, z * invLen };
+        }
+
+        Float3 &operator+=(const Float3 &rhs) noexcept
+        {
+            x += rhs.x; y += rhs.y; z += rhs.z;
+            return *this;
+        }
+    };
+
+    inline Float3 operator+(const Float3 &a, const Float3 &b) noexcept
+    {
+        return { a.x + b.x, a.y + b.y, a.z + b.z };
+    }
+
+    inline Float3 operator-(const Float3 &a, const Float3 &b) noexcept
+    {
+        return { a.x - b.x, a.y - b.y, a.z - b.z };
+    }
+
+    inline Float3 operator-(const Float3 &a) noexcept
+    {
+        return { -a.x, -a.y, -a.z };
+    }
+
+    inline Float3 operator*(const Float3 &a, float b) noexcept
+    {
+        return { a.x * b, a.y * b, a.z * b };
+    }
+
+    inline Float3 operator*(float a, const Float3 &b) noexcept
+    {
+        return b * a;
+    }
+
+    inline Float3 operator/(const Float3 &a, float b) noexcept
+    {
+        return { a.x / b, a.y / b, a.z / b };
+    }
+
+    inline float dot(const Float3 &a, const Float3 &b) noexcept
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    inline Float3 cross(const Float3 &a, const Float3 &b) noexcept
+    {
+        return {
+            a.y * b.z - a.z * b.y,
+            a.z * b.x - a.x * b.z,
+            a.x * b.y - a.y * b.x
+        };
+    }
+
+    inline Float3 lerp(const Float3 &a, const Float3 &b, float t) noexcept
+    {
+        return a * (1 - t) + b * t;
+    }
+
+    inline Float3 vec_min(const Float3 &a, const Float3 &b) noexcept
+    {
+        return {
+            (std::min)(a.x, b.x),
+            (std::min)(a.y, b.y),
+            (std::min)(a.z, b.z)
+        };
+    }
+
+    inline Float3 vec_max(const Float3 &a, const Float3 &b) noexcept
+    {
+        return {
+            (std::max)(a.x, b.x),
+            (std::max)(a.y, b.y),
+            (std::max)(a.z, b.z)
+        };
+    }
+
+    struct Float4
+    {
+        float x = 0, y = 0, z = 0, w = 0;
+
+        Float3 xyz() const noexcept
+        {
+            return { x, y, z };
+        }
+
+        Float3 homogenize() const noexcept
+        {
+            return { x / w, y / w, z / w };
+        }
+    };
+
+    struct Int3
+    {
+        int x = 0, y = 0, z = 0;
+
+        int product() const noexcept
+        {
+            return x * y * z;
+        }
+
+        bool operator==(const Int3 &) const noexcept = default;
+    };
+
+    // row-vector convention, same as Float4 * Mat4 in agz-utils and
+    // mul(float4, float4x4) in the shaders
+    struct Mat4
+    {
+        float m[4][4] = {};
+
+        static Mat4 identity() noexcept;
+
+        // left-handed look-at, matches Trans4::look_at
+        static Mat4 lookAt(
+            const Float3 &eye, const Float3 &dst, const Float3 &up) noexcept;
+
+        // left-handed perspective, matches Trans4::perspective
+        static Mat4 perspective(
+            float fovYRad, float wOverH, float nearZ, float farZ) noexcept;
+
+        Mat4 inv() const noexcept;
+
+        Float3 transformPoint(const Float3 &p) const noexcept
+        {
+            return {
+                p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+                p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+                p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2]
+            };
+        }
+
+        bool operator==(const Mat4 &) const noexcept = default;
+    };
+
+    Float4 operator*(const Float4 &v, const Mat4 &m) noexcept;
+
+    Mat4 operator*(const Mat4 &a, const Mat4 &b) noexcept;
+
+} // namespace clustering
@@ -0,0 +1,206 @@
+#include "./object_lights.h"
+#include "./prefix_sum.h"
+
+namespace clustering
+{
+
+    AABB transformAABB(const AABB &aabb, const Mat4 &world)
+    {
+        const Float3 first = world.transformPoint(aabb.lower);
+
+        AABB result = { .lower = first, .upper = first };
+        for(int i = 1; i < 8; ++i)
+        {
+            const Float3 corner = {
+                (i & 1) ? aabb.upper.x : aabb.lower.x,
+                (i & 2) ? aabb.upper.y : aabb.lower.y,
+                (i & 4) ? aabb.upper.z : aabb.lower.z
+            };
+            const Float3 p = world.transformPoint(corner);
+            result.lower = vec_min(result.lower, p);
+            result.upper = vec_max(result.upper, p);
+        }
+        return result;
+    }
+
+    CPUObjectLights::CPUObjectLights(ThreadPool &threadPool)
+        : threadPool_(threadPool), isa_(ISA::Scalar), kernel_(nullptr),
+          objects_(nullptr), objectCount_(0), lights_(nullptr), lightCount_(0),
+          enableIncremental_(false), hasLastRun_(false), assignmentCount_(0)
+    {
+        setISA(detectISA());
+    }
+
+    void CPUObjectLights::setISA(ISA isa)
+    {
+        isa_    = isISASupported(isa) ? isa : ISA::Scalar;
+        kernel_ = getSphereAABBKernel(isa_);
+    }
+
+    void CPUObjectLights::setObjects(const AABB *bounds, size_t objectCount)
+    {
+        objects_     = bounds;
+        objectCount_ = objectCount;
+    }
+
+    void CPUObjectLights::setLights(const Light *lights, size_t lightCount)
+    {
+        lights_     = lights;
+        lightCount_ = lightCount;
+    }
+
+    void CPUObjectLights::setIncrementalEnabled(bool enabled)
+    {
+        enableIncremental_ = enabled;
+    }
+
+    void CPUObjectLights::run()
+    {
+        const int lightCount = static_cast<int>(lightCount_);
+
+        const bool lightsChanged = updateLightSpheres();
+        if(lightsChanged)
+        {
+            worldLights_.resize(lightCount);
+            for(int li = 0; li < lightCount; ++li)
+            {
+                worldLights_.set(
+                    li, lights_[li].lightPosition, lights_[li].maxLightDistance);
+            }
+        }
+
+        findDirtyObjects(!enableIncremental_ || !hasLastRun_ || lightsChanged);
+        hasLastRun_ = true;
+
+        threadOutputs_.resize(threadPool_.getThreadCount());
+        objectLists_.resize(objectCount_);
+
+        threadPool_.parallelFor(
+            static_cast<int>(dirtyObjects_.size()), 16,
+            [&](int beg, int end, int threadIndex)
+        {
+            std::vector<int32_t> &output = threadOutputs_[threadIndex];
+            output.resize(lightCount);
+
+            for(int i = beg; i < end; ++i)
+            {
+                const int oi = dirtyObjects_[i];
+                const int count = kernel_(
+                    worldLights_, 0, lightCount, objectBounds_[oi],
+                    output.data(), lightCount);
+                objectLists_[oi].assign(output.begin(), output.begin() + count);
+            }
+        });
+
+        compactLists();
+    }
+
+    ISA CPUObjectLights::getISA() const
+    {
+        return isa_;
+    }
+
+    bool CPUObjectLights::isIncrementalEnabled() const
+    {
+        return enableIncremental_;
+    }
+
+    int CPUObjectLights::getUpdatedObjectCount() const
+    {
+        return static_cast<int>(dirtyObjects_.size());
+    }
+
+    int64_t CPUObjectLights::getAssignmentCount() const
+    {
+        return assignmentCount_;
+    }
+
+    const std::vector<ClusterRange> &CPUObjectLights::getObjectRanges() const
+    {
+        return objectRanges_;
+    }
+
+    const std::vector<int32_t> &CPUObjectLights::getLightIndices() const
+    {
+        return lightIndices_;
+    }
+
+    bool CPUObjectLights::updateLightSpheres()
+    {
+        bool changed = lightSpheres_.size() != lightCount_;
+        lightSpheres_.resize(lightCount_);
+
+        for(size_t li = 0; li < lightCount_; ++li)
+        {
+            const Light &light = lights_[li];
+            const Float4 sphere = {
+                light.lightPosition.x, light.lightPosition.y,
+                light.lightPosition.z, light.maxLightDistance
+            };
+
+            Float4 &last = lightSpheres_[li];
+            if(last.x != sphere.x || last.y != sphere.y ||
+               last.z != sphere.z || last.w != sphere.w)
+            {
+                last    = sphere;
+                changed = true;
+            }
+        }
+
+        return changed;
+    }
+
+    void CPUObjectLights::findDirtyObjects(bool allDirty)
+    {
+        const size_t lastCount = objectBounds_.size();
+        objectBounds_.resize(objectCount_);
+
+        dirtyObjects_.clear();
+        for(size_t oi = 0; oi < objectCount_; ++oi)
+        {
+            const AABB &bounds = objects_[oi];
+            AABB       &last   = objectBounds_[oi];
+
+            const bool changed =
+                oi >= lastCount ||
+                bounds.lower.x != last.lower.x || bounds.upper.x != last.upper.x ||
+                bounds.lower.y != last.lower.y || bounds.upper.y != last.upper.y ||
+                bounds.lower.z != last.lower.z || bounds.upper.z != last.upper.z;
+
+            if(changed || allDirty)
+            {
+                last = bounds;
+                dirtyObjects_.push_back(static_cast<int32_t>(oi));
+            }
+        }
+    }
+
+    void CPUObjectLights::compactLists()
+    {
+        const int objectCount = static_cast<int>(objectCount_);
+
+        std::vector<int32_t> offsets(objectCount);
+        for(int oi = 0; oi < objectCount; ++oi)
+            offsets[oi] = static_cast<int32_t>(objectLists_[oi].size());
+
+        assignmentCount_ = exclusiveScan(
+            threadPool_, offsets.data(), offsets.data(), objectCount);
+
+        objectRanges_.resize(objectCount);
+        lightIndices_.resize(static_cast<size_t>(assignmentCount_));
+
+        threadPool_.parallelFor(objectCount, 256, [&](int beg, int end, int)
+        {
+            for(int oi = beg; oi < end; ++oi)
+            {
+                const std::vector<int32_t> &list = objectLists_[oi];
+                objectRanges_[oi] = ClusterRange{
+                    .rangeBeg = offsets[oi],
+                    .rangeEnd = offsets[oi] + static_cast<int32_t>(list.size())
+                };
+                std::copy(list.begin(), list.end(), lightIndices_.begin() + offsets[oi]);
+            }
+        });
+    }
+
+} // namespace clustering
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "./sphere_aabb.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // bounding box of the 8 corners of a model space box after world
+    AABB transformAABB(const AABB &aabb, const Mat4 &world);
+
+    // per-object light lists for forward renderers without a compute pass
+    // (0-basic, 2-predepth): the world space bounding box of each object is
+    // tested against the light spheres, and the pixel shader of an object
+    // only loops over its own list instead of all lights
+    class CPUObjectLights
+    {
+    public:
+
+        explicit CPUObjectLights(ThreadPool &threadPool);
+
+        // isa of the sphere-aabb kernel. detectISA() by default
+        void setISA(ISA isa);
+
+        // world space bounding boxes, referenced until run()
+        void setObjects(const AABB *bounds, size_t objectCount);
+
+        // world space lights, referenced until run()
+        void setLights(const Light *lights, size_t lightCount);
+
+        // only re-test the objects whose bounds changed since the last run,
+        // as long as no light changed. false by default
+        void setIncrementalEnabled(bool enabled);
+
+        void run();
+
+        ISA getISA() const;
+
+        bool isIncrementalEnabled() const;
+
+        // objects whose lists were rebuilt by the last run
+        int getUpdatedObjectCount() const;
+
+        // light-object pairs of the last run
+        int64_t getAssignmentCount() const;
+
+        // ranges into getLightIndices(), in object order
+        const std::vector<ClusterRange> &getObjectRanges() const;
+
+        const std::vector<int32_t> &getLightIndices() const;
+
+    private:
+
+        // whether any light differs from lightSpheres_, which are updated
+        bool updateLightSpheres();
+
+        void findDirtyObjects(bool allDirty);
+
+        void compactLists();
+
+        ThreadPool &threadPool_;
+
+        ISA              isa_;
+        SphereAABBKernel kernel_;
+
+        const AABB *objects_;
+        size_t      objectCount_;
+
+        const Light *lights_;
+        size_t       lightCount_;
+
+        bool enableIncremental_;
+        bool hasLastRun_;
+
+        // lights and object bounds of the last run (xyz: position, w: radius)
+        std::vector<Float4> lightSpheres_;
+        std::vector<AABB>   objectBounds_;
+        LightSoA            worldLights_;
+
+        std::vector<int32_t> dirtyObjects_;
+
+        // output buffer of each thread for one object, as long as the lights
+        std::vector<std::vector<int32_t>> threadOutputs_;
+
+        std::vector<std::vector<int32_t>> objectLists_;
+
+        int64_t assignmentCount_;
+
+        std::vector<ClusterRange> objectRanges_;
+        std::vector<int32_t>      lightIndices_;
+    };
+
+} // namespace clustering
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "./occupancy.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        template<typename GetLights>
+        ClusterOccupancy computeOccupancy(
+            const Int3 &clusterCount, GetLights &&getLights)
+        {
+            const int tileCount = clusterCount.x * clusterCount.y;
+
+            ClusterOccupancy result;
+            result.clusterCount = clusterCount;
+            result.clusterLights.resize(clusterCount.product());
+            result.tileMaxLights.assign(tileCount, 0);
+            result.tileSumLights.assign(tileCount, 0);
+            result.sliceMaxLights.assign(clusterCount.z, 0);
+            result.sliceMeanLights.assign(clusterCount.z, 0);
+
+            for(int ti = 0; ti < tileCount; ++ti)
+            {
+                for(int zi = 0; zi < clusterCount.z; ++zi)
+                {
+                    const int ci     = ti * clusterCount.z + zi;
+                    const int lights = getLights(ci);
+
+                    result.clusterLights[ci] = lights;
+
+                    result.tileMaxLights[ti] =
+                        (std::max)(result.tileMaxLights[ti], lights);
+                    result.tileSumLights[ti] += lights;
+
+                    result.sliceMaxLights[zi] =
+                        (std::max)(result.sliceMaxLights[zi], lights);
+                    result.sliceMeanLights[zi] += static_cast<float>(lights);
+
+                    result.maxLights = (std::max)(result.maxLights, lights);
+                }
+            }
+
+            for(auto &mean : result.sliceMeanLights)
+                mean /= static_cast<float>((std::max)(tileCount, 1));
+
+            return result;
+        }
+
+    } // namespace anonymous
+
+    ClusterOccupancy computeClusterOccupancy(
+        const Int3         &clusterCount,
+        const ClusterRange *ranges,
+        ClusterLayout       layout)
+    {
+        return computeOccupancy(clusterCount, [&](int ci)
+        {
+            const ClusterRange &range =
+                ranges[getClusterSlot(layout, clusterCount, ci)];
+            return range.rangeEnd - range.rangeBeg;
+        });
+    }
+
+    ClusterOccupancy computeCompactClusterOccupancy(
+        const Int3     &clusterCount,
+        const uint32_t *ranges,
+        ClusterLayout   layout)
+    {
+        return computeOccupancy(clusterCount, [&](int ci)
+        {
+            return getCompactRangeCount(
+                ranges[getClusterSlot(layout, clusterCount, ci)]);
+        });
+    }
+
+    Float3 getHeatmapColor(int lights, int maxLights)
+    {
+        const Float3 RAMP[] = {
+            { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 }
+        };
+        constexpr int SEGMENT_COUNT = static_cast<int>(std::size(RAMP)) - 1;
+
+        if(lights <= 0 || maxLights <= 0)
+            return RAMP[0];
+
+        const float t = SEGMENT_COUNT * (std::min)(
+            static_cast<float>(lights) / maxLights, 1.0f);
+        const int segment = (std::min)(static_cast<int>(t), SEGMENT_COUNT - 1);
+
+        return lerp(RAMP[segment], RAMP[segment + 1], t - segment);
+    }
+
+    bool saveClusterOccupancyCSV(
+        const char *filename, const ClusterOccupancy &occupancy)
+    {
+        std::ofstream fout(filename, std::ios::trunc);
+        if(!fout)
+            return false;
+
+        const Int3 &count = occupancy.clusterCount;
+
+        fout << "x,y,z,lights\n";
+        for(int xi = 0; xi < count.x; ++xi)
+        {
+            for(int yi = 0; yi < count.y; ++yi)
+            {
+                for(int zi = 0; zi < count.z; ++zi)
+                {
+                    fout << xi << "," << yi << "," << zi << ","
+                         << occupancy.clusterLights[
+                                getClusterIndex(count, xi, yi, zi)] << "\n";
+                }
+            }
+        }
+
+        return static_cast<bool>(fout);
+    }
+
+    bool saveTileOccupancyCSV(
+        const char *filename, const ClusterOccupancy &occupancy)
+    {
+        std::ofstream fout(filename, std::ios::trunc);
+        if(!fout)
+            return false;
+
+        const Int3 &count = occupancy.clusterCount;
+
+        fout << "x,y,max,sum\n";
+        for(int xi = 0; xi < count.x; ++xi)
+        {
+            for(int yi = 0; yi < count.y; ++yi)
+            {
+                const int ti = xi * count.y + yi;
+                fout << xi << "," << yi << ","
+                     << occupancy.tileMaxLights[ti] << ","
+                     << occupancy.tileSumLights[ti] << "\n";
+            }
+        }
+
+        return static_cast<bool>(fout);
+    }
+
+    bool saveOccupancyHeatmap(
+        const char *filename, const ClusterOccupancy &occupancy, int cellSize)
+    {
+        const Int3 &count = occupancy.clusterCount;
+        if(count.x <= 0 || count.y <= 0 || count.z <= 0 || cellSize <= 0)
+            return false;
+
+        // panel 0 is the tile max map, panel 1 + zi is slice zi. panels are
+        // separated by one gray cell
+
+        const int panelCount = 1 + count.z;
+        const int panelWidth = (count.x + 1) * cellSize;
+        const int width      = panelCount * panelWidth - cellSize;
+        const int height     = count.y * cellSize;
+
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 3, 64);
+
+        for(int panel = 0; panel < panelCount; ++panel)
+        {
+            for(int xi = 0; xi < count.x; ++xi)
+            {
+                for(int yi = 0; yi < count.y; ++yi)
+                {
+                    const int lights = panel == 0 ?
+                        occupancy.tileMaxLights[xi * count.y + yi] :
+                        occupancy.clusterLights[
+                            getClusterIndex(count, xi, yi, panel - 1)];
+
+                    const Float3 color = getHeatmapColor(lights, occupancy.maxLights);
+                    const uint8_t rgb[3] = {
+                        static_cast<uint8_t>(color.x * 255),
+                        static_cast<uint8_t>(color.y * 255),
+                        static_cast<uint8_t>(color.z * 255)
+                    };
+
+                    // yi = 0 is the bottom of the screen
+
+                    const int x0 = panel * panelWidth + xi * cellSize;
+                    const int y0 = (count.y - 1 - yi) * cellSize;
+                    for(int y = y0; y < y0 + cellSize; ++y)
+                    {
+                        uint8_t *row =
+                            &pixels[(static_cast<size_t>(y) * width + x0) * 3];
+                        for(int x = 0; x < cellSize; ++x)
+                            std::copy(rgb, rgb + 3, row + 3 * x);
+                    }
+                }
+            }
+        }
+
+        std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+        if(!fout)
+            return false;
+
+        fout << "P6\n" << width << " " << height << "\n255\n";
+        fout.write(
+            reinterpret_cast<const char *>(pixels.data()),
+            static_cast<std::streamsize>(pixels.size()));
+
+        return static_cast<bool>(fout);
+    }
+
+} // namespace clustering
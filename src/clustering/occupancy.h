@@ -0,0 +1,60 @@
+#pragma once
+
+#include "./cluster_layout.h"
+
+namespace clustering
+{
+
+    // light counts of a cluster grid, from the ranges of CPULightCluster
+    // or a readback of the cluster range buffer of LightCluster. ranges are
+    // stored in the given layout
+    struct ClusterOccupancy
+    {
+        Int3 clusterCount;
+
+        // indexed by getClusterIndex
+        std::vector<int32_t> clusterLights;
+
+        // indexed by xi * count.y + yi. the most lights of a slice of the
+        // tile (what its worst pixel shades), and the lights of all slices
+        std::vector<int32_t> tileMaxLights;
+        std::vector<int32_t> tileSumLights;
+
+        // indexed by zi
+        std::vector<int32_t> sliceMaxLights;
+        std::vector<float>   sliceMeanLights;
+
+        int32_t maxLights = 0;
+    };
+
+    ClusterOccupancy computeClusterOccupancy(
+        const Int3         &clusterCount,
+        const ClusterRange *ranges,
+        ClusterLayout       layout = ClusterLayout::Linear);
+
+    // ranges packed by packCompactRange
+    ClusterOccupancy computeCompactClusterOccupancy(
+        const Int3     &clusterCount,
+        const uint32_t *ranges,
+        ClusterLayout   layout = ClusterLayout::Linear);
+
+    // rgb of a light count relative to maxLights, on a black, blue, green,
+    // yellow, red ramp
+    Float3 getHeatmapColor(int lights, int maxLights);
+
+    // one row per cluster: x, y, z, lights
+    bool saveClusterOccupancyCSV(
+        const char *filename, const ClusterOccupancy &occupancy);
+
+    // one row per screen tile: x, y, max, sum
+    bool saveTileOccupancyCSV(
+        const char *filename, const ClusterOccupancy &occupancy);
+
+    // binary ppm with cellSize x cellSize pixels per cluster. the left
+    // panel is the tile max map, followed by one panel per z-slice, near to
+    // far. panels are laid out like the screen, colors are relative to the
+    // most lights of any cluster
+    bool saveOccupancyHeatmap(
+        const char *filename, const ClusterOccupancy &occupancy, int cellSize = 8);
+
+} // namespace clustering
@@ -0,0 +1,73 @@
+#include <algorithm>
+
+#include "./prefix_sum.h"
+
+namespace clustering
+{
+
+    int64_t exclusiveScan(
+        ThreadPool &threadPool, const int32_t *in, int32_t *out, int count)
+    {
+        constexpr int BLOCK_SIZE = 4096;
+
+        const int blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        if(blockCount <= 1)
+        {
+            int64_t sum = 0;
+            for(int i = 0; i < count; ++i)
+            {
+                const int32_t v = in[i];
+                out[i] = static_cast<int32_t>(sum);
+                sum += v;
+            }
+            return sum;
+        }
+
+        // block sums -> scan of block sums -> scan inside each block
+
+        std::vector<int64_t> blockOffsets(blockCount);
+
+        threadPool.parallelFor(blockCount, 1, [&](int beg, int end, int)
+        {
+            for(int bi = beg; bi < end; ++bi)
+            {
+                const int first = bi * BLOCK_SIZE;
+                const int last  = (std::min)(first + BLOCK_SIZE, count);
+
+                int64_t sum = 0;
+                for(int i = first; i < last; ++i)
+                    sum += in[i];
+                blockOffsets[bi] = sum;
+            }
+        });
+
+        int64_t total = 0;
+        for(auto &offset : blockOffsets)
+        {
+            const int64_t blockSum = offset;
+            offset = total;
+            total += blockSum;
+        }
+
+        threadPool.parallelFor(blockCount, 1, [&](int beg, int end, int)
+        {
+            for(int bi = beg; bi < end; ++bi)
+            {
+                const int first = bi * BLOCK_SIZE;
+                const int last  = (std::min)(first + BLOCK_SIZE, count);
+
+                int64_t sum = blockOffsets[bi];
+                for(int i = first; i < last; ++i)
+                {
+                    const int32_t v = in[i];
+                    out[i] = static_cast<int32_t>(sum);
+                    sum += v;
+                }
+            }
+        });
+
+        return total;
+    }
+
+} // namespace clustering
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // out[i] = in[0] + ... + in[i - 1]. in and out may alias.
+    // returns the sum of all elements
+    int64_t exclusiveScan(
+        ThreadPool &threadPool, const int32_t *in, int32_t *out, int count);
+
+} // namespace clustering
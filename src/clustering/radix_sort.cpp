@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstring>
+
+#include "./radix_sort.h"
+
+namespace clustering
+{
+
+    void radixSort(
+        ThreadPool &threadPool,
+        uint32_t   *keys,
+        int32_t    *values,
+        int         count,
+        int         keyBits)
+    {
+        constexpr int BLOCK_SIZE  = 4096;
+        constexpr int DIGIT_BITS  = 8;
+        constexpr int DIGIT_COUNT = 1 << DIGIT_BITS;
+
+        if(count <= 1)
+            return;
+
+        const int passCount =
+            (std::clamp(keyBits, 1, 32) + DIGIT_BITS - 1) / DIGIT_BITS;
+        const int blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        std::vector<uint32_t> keyScratch(count);
+        std::vector<int32_t>  valueScratch(count);
+
+        // histograms[bi * DIGIT_COUNT + d] is first the count of digit d in
+        // block bi, then the output offset of its first element
+        std::vector<int32_t> histograms(
+            static_cast<size_t>(blockCount) * DIGIT_COUNT);
+
+        uint32_t *srcKeys   = keys;
+        int32_t  *srcValues = values;
+        uint32_t *dstKeys   = keyScratch.data();
+        int32_t  *dstValues = valueScratch.data();
+
+        for(int pass = 0; pass < passCount; ++pass)
+        {
+            const int shift = pass * DIGIT_BITS;
+
+            threadPool.parallelFor(blockCount, 1, [&](int beg, int end, int)
+            {
+                for(int bi = beg; bi < end; ++bi)
+                {
+                    int32_t *histogram = &histograms[bi * DIGIT_COUNT];
+                    std::fill(histogram, histogram + DIGIT_COUNT, 0);
+
+                    const int first = bi * BLOCK_SIZE;
+                    const int last  = (std::min)(first + BLOCK_SIZE, count);
+                    for(int i = first; i < last; ++i)
+                        ++histogram[(srcKeys[i] >> shift) & (DIGIT_COUNT - 1)];
+                }
+            });
+
+            // digit-major, block-minor order keeps the sort stable
+
+            int32_t offset = 0;
+            for(int d = 0; d < DIGIT_COUNT; ++d)
+            {
+                for(int bi = 0; bi < blockCount; ++bi)
+                {
+                    int32_t &h = histograms[bi * DIGIT_COUNT + d];
+                    const int32_t digitCount = h;
+                    h = offset;
+                    offset += digitCount;
+                }
+            }
+
+            threadPool.parallelFor(blockCount, 1, [&](int beg, int end, int)
+            {
+                for(int bi = beg; bi < end; ++bi)
+                {
+                    int32_t *offsets = &histograms[bi * DIGIT_COUNT];
+
+                    const int first = bi * BLOCK_SIZE;
+                    const int last  = (std::min)(first + BLOCK_SIZE, count);
+                    for(int i = first; i < last; ++i)
+                    {
+                        const uint32_t key = srcKeys[i];
+                        const int32_t  dst =
+                            offsets[(key >> shift) & (DIGIT_COUNT - 1)]++;
+                        dstKeys[dst]   = key;
+                        dstValues[dst] = srcValues[i];
+                    }
+                }
+            });
+
+            std::swap(srcKeys, dstKeys);
+            std::swap(srcValues, dstValues);
+        }
+
+        if(srcKeys != keys)
+        {
+            std::memcpy(keys, srcKeys, sizeof(uint32_t) * count);
+            std::memcpy(values, srcValues, sizeof(int32_t) * count);
+        }
+    }
+
+} // namespace clustering
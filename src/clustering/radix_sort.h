@@ -0,0 +1,17 @@
+#pragma once
+
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // stable ascending sort of (keys[i], values[i]) pairs by key, 8 bits per
+    // pass. only the low keyBits bits of keys are compared
+    void radixSort(
+        ThreadPool &threadPool,
+        uint32_t   *keys,
+        int32_t    *values,
+        int         count,
+        int         keyBits = 32);
+
+} // namespace clustering
@@ -0,0 +1,151 @@
+#if defined(CLUSTERING_X86_SIMD) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "./sphere_aabb.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+#if defined(CLUSTERING_X86_SIMD)
+
+        struct CPUFeatures
+        {
+            bool sse4   = false;
+            bool avx2   = false;
+            bool avx512 = false;
+        };
+
+        CPUFeatures queryCPUFeatures()
+        {
+            CPUFeatures result;
+
+#if defined(_MSC_VER)
+
+            int info[4];
+            __cpuid(info, 0);
+            const int maxLeaf = info[0];
+
+            __cpuid(info, 1);
+            const bool sse41   = (info[2] & (1 << 19)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx     = (info[2] & (1 << 28)) != 0;
+
+            const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+            const bool ymmState = (xcr0 & 0x06) == 0x06;
+            const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+            bool avx2 = false, avx512f = false;
+            if(maxLeaf >= 7)
+            {
+                __cpuidex(info, 7, 0);
+                avx2    = (info[1] & (1 << 5))  != 0;
+                avx512f = (info[1] & (1 << 16)) != 0;
+            }
+
+            result.sse4   = sse41;
+            result.avx2   = avx && avx2 && ymmState;
+            result.avx512 = result.avx2 && avx512f && zmmState;
+
+#else
+
+            __builtin_cpu_init();
+            result.sse4   = __builtin_cpu_supports("sse4.1");
+            result.avx2   = __builtin_cpu_supports("avx2");
+            result.avx512 = __builtin_cpu_supports("avx512f");
+
+#endif
+
+            return result;
+        }
+
+        const CPUFeatures &getCPUFeatures()
+        {
+            static const CPUFeatures features = queryCPUFeatures();
+            return features;
+        }
+
+#endif // #if defined(CLUSTERING_X86_SIMD)
+
+    } // namespace anonymous
+
+    const char *getISAName(ISA isa)
+    {
+        switch(isa)
+        {
+        case ISA::Scalar: return "scalar";
+        case ISA::SSE4:   return "sse4";
+        case ISA::AVX2:   return "avx2";
+        case ISA::AVX512: return "avx512";
+        }
+        return "unknown";
+    }
+
+    ISA detectISA()
+    {
+        for(ISA isa : { ISA::AVX512, ISA::AVX2, ISA::SSE4 })
+        {
+            if(isISASupported(isa))
+                return isa;
+        }
+        return ISA::Scalar;
+    }
+
+    bool isISASupported(ISA isa)
+    {
+        if(isa == ISA::Scalar)
+            return true;
+
+#if defined(CLUSTERING_X86_SIMD)
+        auto &features = getCPUFeatures();
+        switch(isa)
+        {
+        case ISA::SSE4:   return features.sse4;
+        case ISA::AVX2:   return features.avx2;
+        case ISA::AVX512: return features.avx512;
+        default:          return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+    SphereAABBKernel getSphereAABBKernel(ISA isa)
+    {
+        if(!isISASupported(isa))
+            return &detail::testSpheresAABBScalar;
+
+#if defined(CLUSTERING_X86_SIMD)
+        switch(isa)
+        {
+        case ISA::SSE4:   return &detail::testSpheresAABBSSE4;
+        case ISA::AVX2:   return &detail::testSpheresAABBAVX2;
+        case ISA::AVX512: return &detail::testSpheresAABBAVX512;
+        default:          break;
+        }
+#endif
+
+        return &detail::testSpheresAABBScalar;
+    }
+
+    int detail::testSpheresAABBScalar(
+        const LightSoA &lights,
+        int             beg,
+        int             end,
+        const AABB     &aabb,
+        int32_t        *output,
+        int             maxOutput)
+    {
+        int count = 0;
+        for(int i = beg; i < end && count < maxOutput; ++i)
+        {
+            if(isLightInAABB(lights.getPosition(i), lights.radius[i], aabb))
+                output[count++] = i;
+        }
+        return count;
+    }
+
+} // namespace clustering
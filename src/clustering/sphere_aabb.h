@@ -0,0 +1,55 @@
+#pragma once
+
+#include "./light_soa.h"
+
+namespace clustering
+{
+
+    enum class ISA
+    {
+        Scalar,
+        SSE4,
+        AVX2,
+        AVX512
+    };
+
+    const char *getISAName(ISA isa);
+
+    // best isa supported by both the build and the running cpu
+    ISA detectISA();
+
+    bool isISASupported(ISA isa);
+
+    // test lights [beg, end) against aabb with the same predicate as
+    // isLightInAABB. indices of intersecting lights are appended to output
+    // in increasing order, stopping after maxOutput entries like CSMain does
+    // at MAX_LIGHTS_PER_CLUSTER. returns the number of written indices
+    using SphereAABBKernel = int(*)(
+        const LightSoA &lights,
+        int             beg,
+        int             end,
+        const AABB     &aabb,
+        int32_t        *output,
+        int             maxOutput);
+
+    // falls back to the scalar kernel if isa is not supported
+    SphereAABBKernel getSphereAABBKernel(ISA isa);
+
+    namespace detail
+    {
+
+        int testSpheresAABBScalar(
+            const LightSoA &, int, int, const AABB &, int32_t *, int);
+
+        int testSpheresAABBSSE4(
+            const LightSoA &, int, int, const AABB &, int32_t *, int);
+
+        int testSpheresAABBAVX2(
+            const LightSoA &, int, int, const AABB &, int32_t *, int);
+
+        int testSpheresAABBAVX512(
+            const LightSoA &, int, int, const AABB &, int32_t *, int);
+
+    } // namespace detail
+
+} // namespace clustering
@@ -0,0 +1,62 @@
+#if defined(CLUSTERING_X86_SIMD)
+
+#include <bit>
+
+#include <immintrin.h>
+
+#include "./sphere_aabb.h"
+
+namespace clustering
+{
+
+    int detail::testSpheresAABBAVX2(
+        const LightSoA &lights,
+        int             beg,
+        int             end,
+        const AABB     &aabb,
+        int32_t        *output,
+        int             maxOutput)
+    {
+        const __m256 lowerX = _mm256_set1_ps(aabb.lower.x);
+        const __m256 lowerY = _mm256_set1_ps(aabb.lower.y);
+        const __m256 lowerZ = _mm256_set1_ps(aabb.lower.z);
+        const __m256 upperX = _mm256_set1_ps(aabb.upper.x);
+        const __m256 upperY = _mm256_set1_ps(aabb.upper.y);
+        const __m256 upperZ = _mm256_set1_ps(aabb.upper.z);
+
+        int count = 0;
+        for(int i = beg; i < end && count < maxOutput; i += 8)
+        {
+            const __m256 px = _mm256_loadu_ps(&lights.x[i]);
+            const __m256 py = _mm256_loadu_ps(&lights.y[i]);
+            const __m256 pz = _mm256_loadu_ps(&lights.z[i]);
+            const __m256 r  = _mm256_loadu_ps(&lights.radius[i]);
+
+            const __m256 dx = _mm256_sub_ps(
+                _mm256_max_ps(lowerX, _mm256_min_ps(px, upperX)), px);
+            const __m256 dy = _mm256_sub_ps(
+                _mm256_max_ps(lowerY, _mm256_min_ps(py, upperY)), py);
+            const __m256 dz = _mm256_sub_ps(
+                _mm256_max_ps(lowerZ, _mm256_min_ps(pz, upperZ)), pz);
+
+            const __m256 dist2 = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                _mm256_mul_ps(dz, dz));
+
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(
+                _mm256_cmp_ps(dist2, _mm256_mul_ps(r, r), _CMP_LT_OQ)));
+            if(end - i < 8)
+                mask &= (1u << (end - i)) - 1;
+
+            while(mask && count < maxOutput)
+            {
+                output[count++] = i + std::countr_zero(mask);
+                mask &= mask - 1;
+            }
+        }
+        return count;
+    }
+
+} // namespace clustering
+
+#endif // #if defined(CLUSTERING_X86_SIMD)
@@ -0,0 +1,62 @@
+#if defined(CLUSTERING_X86_SIMD)
+
+#include <bit>
+
+#include <immintrin.h>
+
+#include "./sphere_aabb.h"
+
+namespace clustering
+{
+
+    int detail::testSpheresAABBAVX512(
+        const LightSoA &lights,
+        int             beg,
+        int             end,
+        const AABB     &aabb,
+        int32_t        *output,
+        int             maxOutput)
+    {
+        const __m512 lowerX = _mm512_set1_ps(aabb.lower.x);
+        const __m512 lowerY = _mm512_set1_ps(aabb.lower.y);
+        const __m512 lowerZ = _mm512_set1_ps(aabb.lower.z);
+        const __m512 upperX = _mm512_set1_ps(aabb.upper.x);
+        const __m512 upperY = _mm512_set1_ps(aabb.upper.y);
+        const __m512 upperZ = _mm512_set1_ps(aabb.upper.z);
+
+        int count = 0;
+        for(int i = beg; i < end && count < maxOutput; i += 16)
+        {
+            const __m512 px = _mm512_loadu_ps(&lights.x[i]);
+            const __m512 py = _mm512_loadu_ps(&lights.y[i]);
+            const __m512 pz = _mm512_loadu_ps(&lights.z[i]);
+            const __m512 r  = _mm512_loadu_ps(&lights.radius[i]);
+
+            const __m512 dx = _mm512_sub_ps(
+                _mm512_max_ps(lowerX, _mm512_min_ps(px, upperX)), px);
+            const __m512 dy = _mm512_sub_ps(
+                _mm512_max_ps(lowerY, _mm512_min_ps(py, upperY)), py);
+            const __m512 dz = _mm512_sub_ps(
+                _mm512_max_ps(lowerZ, _mm512_min_ps(pz, upperZ)), pz);
+
+            const __m512 dist2 = _mm512_add_ps(
+                _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)),
+                _mm512_mul_ps(dz, dz));
+
+            uint32_t mask = _mm512_cmp_ps_mask(
+                dist2, _mm512_mul_ps(r, r), _CMP_LT_OQ);
+            if(end - i < 16)
+                mask &= (1u << (end - i)) - 1;
+
+            while(mask && count < maxOutput)
+            {
+                output[count++] = i + std::countr_zero(mask);
+                mask &= mask - 1;
+            }
+        }
+        return count;
+    }
+
+} // namespace clustering
+
+#endif // #if defined(CLUSTERING_X86_SIMD)
@@ -0,0 +1,80 @@
+#if defined(CLUSTERING_X86_SIMD)
+
+#include <bit>
+
+#include <smmintrin.h>
+
+#include "./sphere_aabb.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        __m128 testLanes(
+            const LightSoA &lights, int i,
+            __m128 lowerX, __m128 lowerY, __m128 lowerZ,
+            __m128 upperX, __m128 upperY, __m128 upperZ)
+        {
+            const __m128 px = _mm_loadu_ps(&lights.x[i]);
+            const __m128 py = _mm_loadu_ps(&lights.y[i]);
+            const __m128 pz = _mm_loadu_ps(&lights.z[i]);
+            const __m128 r  = _mm_loadu_ps(&lights.radius[i]);
+
+            const __m128 dx = _mm_sub_ps(
+                _mm_max_ps(lowerX, _mm_min_ps(px, upperX)), px);
+            const __m128 dy = _mm_sub_ps(
+                _mm_max_ps(lowerY, _mm_min_ps(py, upperY)), py);
+            const __m128 dz = _mm_sub_ps(
+                _mm_max_ps(lowerZ, _mm_min_ps(pz, upperZ)), pz);
+
+            const __m128 dist2 = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                _mm_mul_ps(dz, dz));
+
+            return _mm_cmplt_ps(dist2, _mm_mul_ps(r, r));
+        }
+
+    } // namespace anonymous
+
+    int detail::testSpheresAABBSSE4(
+        const LightSoA &lights,
+        int             beg,
+        int             end,
+        const AABB     &aabb,
+        int32_t        *output,
+        int             maxOutput)
+    {
+        const __m128 lowerX = _mm_set1_ps(aabb.lower.x);
+        const __m128 lowerY = _mm_set1_ps(aabb.lower.y);
+        const __m128 lowerZ = _mm_set1_ps(aabb.lower.z);
+        const __m128 upperX = _mm_set1_ps(aabb.upper.x);
+        const __m128 upperY = _mm_set1_ps(aabb.upper.y);
+        const __m128 upperZ = _mm_set1_ps(aabb.upper.z);
+
+        int count = 0;
+        for(int i = beg; i < end && count < maxOutput; i += 8)
+        {
+            const __m128 mask0 = testLanes(
+                lights, i, lowerX, lowerY, lowerZ, upperX, upperY, upperZ);
+            const __m128 mask1 = testLanes(
+                lights, i + 4, lowerX, lowerY, lowerZ, upperX, upperY, upperZ);
+
+            uint32_t mask = static_cast<uint32_t>(
+                _mm_movemask_ps(mask0) | (_mm_movemask_ps(mask1) << 4));
+            if(end - i < 8)
+                mask &= (1u << (end - i)) - 1;
+
+            while(mask && count < maxOutput)
+            {
+                output[count++] = i + std::countr_zero(mask);
+                mask &= mask - 1;
+            }
+        }
+        return count;
+    }
+
+} // namespace clustering
+
+#endif // #if defined(CLUSTERING_X86_SIMD)
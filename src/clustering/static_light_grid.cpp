@@ -0,0 +1,230 @@
+#include <cmath>
+
+#include "./static_light_grid.h"
+
+namespace clustering
+{
+
+    void StaticLightGrid::setCellSize(float size)
+    {
+        requestedCellSize_ = size;
+    }
+
+    bool StaticLightGrid::update(
+        const Light                *lights,
+        size_t                      lightCount,
+        const std::vector<int32_t> &staticLights)
+    {
+        bool changed =
+            staticLights != staticLights_ || builtCellSize_ != requestedCellSize_;
+
+        if(!changed)
+        {
+            for(size_t i = 0; i < staticLights.size(); ++i)
+            {
+                const int li = staticLights[i];
+                if(static_cast<size_t>(li) >= lightCount)
+                {
+                    changed = true;
+                    break;
+                }
+
+                const Light  &light  = lights[li];
+                const Float4 &sphere = spheres_[i];
+                if(light.lightPosition.x  != sphere.x ||
+                   light.lightPosition.y  != sphere.y ||
+                   light.lightPosition.z  != sphere.z ||
+                   light.maxLightDistance != sphere.w)
+                {
+                    changed = true;
+                    break;
+                }
+            }
+        }
+
+        if(!changed)
+            return false;
+
+        staticLights_.clear();
+        spheres_.clear();
+        for(int li : staticLights)
+        {
+            if(static_cast<size_t>(li) >= lightCount)
+                continue;
+            const Light &light = lights[li];
+            staticLights_.push_back(li);
+            spheres_.push_back({
+                light.lightPosition.x, light.lightPosition.y,
+                light.lightPosition.z, light.maxLightDistance
+            });
+        }
+
+        build();
+        return true;
+    }
+
+    int64_t StaticLightGrid::getBuildCount() const
+    {
+        return buildCount_;
+    }
+
+    const std::vector<int32_t> &StaticLightGrid::getStaticLights() const
+    {
+        return staticLights_;
+    }
+
+    float StaticLightGrid::getCellSize() const
+    {
+        return cellSize_;
+    }
+
+    const Int3 &StaticLightGrid::getCellCount() const
+    {
+        return cellCount_;
+    }
+
+    size_t StaticLightGrid::getEntryCount() const
+    {
+        return cellEntries_.size();
+    }
+
+    void StaticLightGrid::build()
+    {
+        ++buildCount_;
+        builtCellSize_ = requestedCellSize_;
+
+        cellOffsets_.clear();
+        cellEntries_.clear();
+        largeEntries_.clear();
+
+        const int slotCount = static_cast<int>(spheres_.size());
+        if(!slotCount)
+        {
+            cellCount_ = {};
+            return;
+        }
+
+        float radiusSum = 0;
+        for(const Float4 &sphere : spheres_)
+            radiusSum += sphere.w;
+
+        cellSize_ = requestedCellSize_ > 0 ?
+            requestedCellSize_ : radiusSum / static_cast<float>(slotCount);
+        cellSize_ = (std::max)(cellSize_, 1e-3f);
+
+        // entries of all lights. the large ones are split off before the
+        // bounds, so the cell size may still grow below
+
+        std::vector<CellEntry> entries;
+        entries.reserve(slotCount);
+
+        bound_ = {
+            Float3((std::numeric_limits<float>::max)()),
+            Float3(std::numeric_limits<float>::lowest())
+        };
+
+        for(int slot = 0; slot < slotCount; ++slot)
+        {
+            const Float4 &sphere = spheres_[slot];
+            const Float3 r(sphere.w);
+
+            const CellEntry entry = {
+                .bound      = { sphere.xyz() - r, sphere.xyz() + r },
+                .lowerCell  = {},
+                .lightIndex = staticLights_[slot]
+            };
+
+            if(2 * sphere.w > MAX_LIGHT_CELL_SPAN * cellSize_)
+            {
+                largeEntries_.push_back(entry);
+                continue;
+            }
+
+            entries.push_back(entry);
+            bound_.lower = vec_min(bound_.lower, entry.bound.lower);
+            bound_.upper = vec_max(bound_.upper, entry.bound.upper);
+        }
+
+        if(entries.empty())
+        {
+            cellCount_ = {};
+            return;
+        }
+
+        const Float3 extent = bound_.upper - bound_.lower;
+        for(;;)
+        {
+            auto getCount = [&](float e)
+            {
+                return (std::max)(static_cast<int>(std::ceil(e / cellSize_)), 1);
+            };
+            cellCount_ = { getCount(extent.x), getCount(extent.y), getCount(extent.z) };
+
+            const int64_t cellCount =
+                int64_t(cellCount_.x) * cellCount_.y * cellCount_.z;
+            if(cellCount <= MAX_CELL_COUNT)
+                break;
+            cellSize_ *= 1.25f;
+        }
+
+        // counting sort of the (cell, light) entries. lights are visited in
+        // ascending order, so every cell lists them in ascending order
+
+        const int cellCount = cellCount_.product();
+        cellOffsets_.assign(cellCount + 1, 0);
+
+        std::vector<Int3> upperCells(entries.size());
+        for(size_t i = 0; i < entries.size(); ++i)
+        {
+            entries[i].lowerCell = getCell(entries[i].bound.lower);
+            upperCells[i]        = getCell(entries[i].bound.upper);
+        }
+
+        auto forEachCell = [&](size_t i, auto &&func)
+        {
+            const Int3 &lower = entries[i].lowerCell;
+            const Int3 &upper = upperCells[i];
+            for(int xi = lower.x; xi <= upper.x; ++xi)
+            {
+                for(int yi = lower.y; yi <= upper.y; ++yi)
+                {
+                    for(int zi = lower.z; zi <= upper.z; ++zi)
+                        func((xi * cellCount_.y + yi) * cellCount_.z + zi);
+                }
+            }
+        };
+
+        for(size_t i = 0; i < entries.size(); ++i)
+            forEachCell(i, [&](int ci) { ++cellOffsets_[ci + 1]; });
+
+        for(int ci = 0; ci < cellCount; ++ci)
+            cellOffsets_[ci + 1] += cellOffsets_[ci];
+
+        cellEntries_.resize(cellOffsets_[cellCount]);
+
+        std::vector<int32_t> cursors(cellOffsets_.begin(), cellOffsets_.end() - 1);
+        for(size_t i = 0; i < entries.size(); ++i)
+        {
+            forEachCell(i, [&](int ci)
+            {
+                cellEntries_[cursors[ci]++] = entries[i];
+            });
+        }
+    }
+
+    Int3 StaticLightGrid::getCell(const Float3 &position) const
+    {
+        auto getIndex = [&](float p, float lower, int count)
+        {
+            const int i = static_cast<int>(std::floor((p - lower) / cellSize_));
+            return (std::clamp)(i, 0, count - 1);
+        };
+
+        return {
+            getIndex(position.x, bound_.lower.x, cellCount_.x),
+            getIndex(position.y, bound_.lower.y, cellCount_.y),
+            getIndex(position.z, bound_.lower.z, cellCount_.z)
+        };
+    }
+
+} // namespace clustering
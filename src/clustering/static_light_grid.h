@@ -0,0 +1,142 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // world space uniform grid of static light lists. unlike the view space
+    // clusters it does not depend on the camera, so it is kept across frames
+    // and only rebuilt by update() when a static light changed.
+    // CPULightCluster (AssignMode::StaticGrid) takes the candidates of each
+    // cluster from the cells overlapping it instead of testing all lights
+    class StaticLightGrid
+    {
+    public:
+
+        // the cell size grows until the grid has at most this many cells
+        static constexpr int MAX_CELL_COUNT = 1 << 18;
+
+        // lights whose box is wider than this many cells, e.g. big fill
+        // lights, are kept in one list that every query walks. they neither
+        // fill the cells nor stretch the grid over empty space
+        static constexpr int MAX_LIGHT_CELL_SPAN = 4;
+
+        // world space edge length of a cell. 0 (the default) uses the average
+        // radius of the static lights, so a light covers about 27 cells.
+        // takes effect at the next build
+        void setCellSize(float size);
+
+        // staticLights are ascending indices into lights. rebuilds the grid
+        // when they or their spheres differ from the last build and returns
+        // whether it did
+        bool update(
+            const Light                *lights,
+            size_t                      lightCount,
+            const std::vector<int32_t> &staticLights);
+
+        // grid builds since construction
+        int64_t getBuildCount() const;
+
+        const std::vector<int32_t> &getStaticLights() const;
+
+        float getCellSize() const;
+
+        const Int3 &getCellCount() const;
+
+        // number of (cell, light) entries
+        size_t getEntryCount() const;
+
+        // call func(lightIndex) once for every static light whose sphere
+        // bounding box overlaps aabb. the order is unspecified
+        template<typename Func>
+        void query(const AABB &aabb, Func &&func) const;
+
+    private:
+
+        // a light in a cell, with what the queries need to reject it
+        // without leaving the cell's entries
+        struct CellEntry
+        {
+            AABB    bound;
+            Int3    lowerCell;
+            int32_t lightIndex;
+        };
+
+        void build();
+
+        Int3 getCell(const Float3 &position) const;
+
+        std::vector<int32_t> staticLights_;
+        std::vector<Float4>  spheres_;
+
+        float requestedCellSize_ = 0;
+        float builtCellSize_     = -1;
+
+        int64_t buildCount_ = 0;
+
+        // union of the boxes of the lights in cells, the grid starts at
+        // bound_.lower
+        AABB  bound_;
+        float cellSize_ = 1;
+        Int3  cellCount_;
+
+        // entries of cell ci are [cellOffsets_[ci], cellOffsets_[ci + 1])
+        std::vector<int32_t>   cellOffsets_;
+        std::vector<CellEntry> cellEntries_;
+        std::vector<CellEntry> largeEntries_;
+    };
+
+    template<typename Func>
+    void StaticLightGrid::query(const AABB &aabb, Func &&func) const
+    {
+        auto overlap = [&](const AABB &b)
+        {
+            return b.lower.x <= aabb.upper.x && aabb.lower.x <= b.upper.x &&
+                   b.lower.y <= aabb.upper.y && aabb.lower.y <= b.upper.y &&
+                   b.lower.z <= aabb.upper.z && aabb.lower.z <= b.upper.z;
+        };
+
+        for(const CellEntry &entry : largeEntries_)
+        {
+            if(overlap(entry.bound))
+                func(entry.lightIndex);
+        }
+
+        if(cellOffsets_.empty())
+            return;
+
+        if(aabb.upper.x < bound_.lower.x || aabb.lower.x > bound_.upper.x ||
+           aabb.upper.y < bound_.lower.y || aabb.lower.y > bound_.upper.y ||
+           aabb.upper.z < bound_.lower.z || aabb.lower.z > bound_.upper.z)
+            return;
+
+        const Int3 beg = getCell(aabb.lower);
+        const Int3 end = getCell(aabb.upper);
+
+        // a light covering several cells of the range is only reported by
+        // the first of them
+
+        for(int xi = beg.x; xi <= end.x; ++xi)
+        {
+            for(int yi = beg.y; yi <= end.y; ++yi)
+            {
+                for(int zi = beg.z; zi <= end.z; ++zi)
+                {
+                    const int ci = (xi * cellCount_.y + yi) * cellCount_.z + zi;
+                    for(int e = cellOffsets_[ci]; e < cellOffsets_[ci + 1]; ++e)
+                    {
+                        const CellEntry &entry = cellEntries_[e];
+                        const Int3      &lower = entry.lowerCell;
+
+                        if(xi == (std::max)(lower.x, beg.x) &&
+                           yi == (std::max)(lower.y, beg.y) &&
+                           zi == (std::max)(lower.z, beg.z) && overlap(entry.bound))
+                            func(entry.lightIndex);
+                    }
+                }
+            }
+        }
+    }
+
+} // namespace clustering
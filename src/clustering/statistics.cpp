@@ -0,0 +1,57 @@
+#include "./statistics.h"
+
+namespace clustering
+{
+
+    void addClusterToStatistics(
+        uint32_t *counters, int lightCount, int maxLightsPerCluster)
+    {
+        const uint32_t count = static_cast<uint32_t>(lightCount);
+
+        counters[stat::ASSIGNMENT_COUNT] += count;
+        counters[stat::STORED_COUNT] +=
+            (std::min)(count, static_cast<uint32_t>(maxLightsPerCluster));
+        counters[stat::MAX_LIGHTS] = (std::max)(counters[stat::MAX_LIGHTS], count);
+
+        if(lightCount > maxLightsPerCluster)
+            ++counters[stat::OVERFLOWED_CLUSTERS];
+
+        const int bin = (std::min)(lightCount, stat::HISTOGRAM_BIN_COUNT - 1);
+        ++counters[stat::HISTOGRAM + bin];
+    }
+
+    ClusterStatistics resolveClusterStatistics(
+        const uint32_t *counters, int clusterCount, int lightIndexCount)
+    {
+        ClusterStatistics result;
+
+        const int64_t storedCount = counters[stat::STORED_COUNT];
+
+        result.assignmentCount      = counters[stat::ASSIGNMENT_COUNT];
+        result.maxLightsPerCluster  = static_cast<int>(counters[stat::MAX_LIGHTS]);
+        result.meanLightsPerCluster = clusterCount ?
+            static_cast<float>(result.assignmentCount) / clusterCount : 0.0f;
+
+        const int64_t p99Rank = (static_cast<int64_t>(clusterCount) * 99 + 99) / 100;
+        int64_t accumulated = 0;
+        for(int bin = 0; bin < stat::HISTOGRAM_BIN_COUNT; ++bin)
+        {
+            accumulated += counters[stat::HISTOGRAM + bin];
+            if(accumulated >= p99Rank)
+            {
+                result.p99LightsPerCluster = bin;
+                result.p99Saturated        = bin == stat::HISTOGRAM_BIN_COUNT - 1;
+                break;
+            }
+        }
+
+        result.overflowedClusterCount =
+            static_cast<int>(counters[stat::OVERFLOWED_CLUSTERS]);
+        result.clusterOverflowCount = result.assignmentCount - storedCount;
+        result.indexOverflowCount   =
+            (std::max)(storedCount - lightIndexCount, int64_t(0));
+
+        return result;
+    }
+
+} // namespace clustering
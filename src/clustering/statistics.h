@@ -0,0 +1,55 @@
+#pragma once
+
+#include "./common.h"
+
+namespace clustering
+{
+
+    // layout of the raw uint counters written by CSMain into the cluster
+    // statistics buffer. must be consistent with asset/clustered/cluster.hlsl
+    namespace stat
+    {
+
+        constexpr int ASSIGNMENT_COUNT     = 0; // lights per cluster, summed before clipping
+        constexpr int STORED_COUNT         = 1; // sum of min(lights, MAX_LIGHTS_PER_CLUSTER)
+        constexpr int MAX_LIGHTS           = 2; // max lights of a single cluster
+        constexpr int OVERFLOWED_CLUSTERS  = 3; // clusters with more than MAX_LIGHTS_PER_CLUSTER
+        constexpr int HISTOGRAM            = 4; // histogram of lights per cluster
+
+        // the last bin also counts all clusters with more lights
+        constexpr int HISTOGRAM_BIN_COUNT = 256;
+
+        constexpr int COUNTER_COUNT = HISTOGRAM + HISTOGRAM_BIN_COUNT;
+
+    } // namespace stat
+
+    struct ClusterStatistics
+    {
+        int64_t assignmentCount = 0;
+
+        int   maxLightsPerCluster  = 0;
+        float meanLightsPerCluster = 0;
+
+        // read from the histogram. if it falls into the last bin, which also
+        // counts all larger clusters, p99Saturated is set and the real
+        // percentile is only known to be at least this value
+        int  p99LightsPerCluster = 0;
+        bool p99Saturated        = false;
+
+        int overflowedClusterCount = 0;
+
+        // pairs dropped by MAX_LIGHTS_PER_CLUSTER
+        int64_t clusterOverflowCount = 0;
+
+        // pairs dropped because the light index buffer is full
+        int64_t indexOverflowCount = 0;
+    };
+
+    // accumulate one cluster into raw counters, the same way CSMain does
+    void addClusterToStatistics(
+        uint32_t *counters, int lightCount, int maxLightsPerCluster);
+
+    ClusterStatistics resolveClusterStatistics(
+        const uint32_t *counters, int clusterCount, int lightIndexCount);
+
+} // namespace clustering
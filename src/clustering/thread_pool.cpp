@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    ThreadPool::ThreadPool(int threadCount)
+        : exit_(false), jobID_(0), activeWorkers_(0),
+          func_(nullptr), count_(0), grainSize_(1), nextBeg_(0)
+    {
+        if(threadCount <= 0)
+        {
+            threadCount = static_cast<int>(
+                std::thread::hardware_concurrency());
+        }
+        threadCount = (std::max)(threadCount, 1);
+
+        // thread 0 is the caller of parallelFor
+
+        for(int i = 1; i < threadCount; ++i)
+            workers_.emplace_back(&ThreadPool::workerMain, this, i);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            exit_ = true;
+        }
+        startCond_.notify_all();
+
+        for(auto &w : workers_)
+            w.join();
+    }
+
+    int ThreadPool::getThreadCount() const noexcept
+    {
+        return static_cast<int>(workers_.size()) + 1;
+    }
+
+    void ThreadPool::parallelFor(
+        int count,
+        int grainSize,
+        const std::function<void(int, int, int)> &func)
+    {
+        if(count <= 0)
+            return;
+
+        grainSize = (std::max)(grainSize, 1);
+
+        if(workers_.empty() || count <= grainSize)
+        {
+            for(int beg = 0; beg < count; beg += grainSize)
+                func(beg, (std::min)(beg + grainSize, count), 0);
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            func_      = &func;
+            count_     = count;
+            grainSize_ = grainSize;
+            nextBeg_   = 0;
+            activeWorkers_ = static_cast<int>(workers_.size());
+            ++jobID_;
+        }
+        startCond_.notify_all();
+
+        runChunks(0);
+
+        std::unique_lock lock(mutex_);
+        finishCond_.wait(lock, [&] { return activeWorkers_ == 0; });
+        func_ = nullptr;
+    }
+
+    void ThreadPool::workerMain(int threadIndex)
+    {
+        uint64_t lastJobID = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock lock(mutex_);
+                startCond_.wait(
+                    lock, [&] { return exit_ || jobID_ != lastJobID; });
+                if(exit_)
+                    return;
+                lastJobID = jobID_;
+            }
+
+            runChunks(threadIndex);
+
+            {
+                std::lock_guard lock(mutex_);
+                --activeWorkers_;
+            }
+            finishCond_.notify_one();
+        }
+    }
+
+    void ThreadPool::runChunks(int threadIndex)
+    {
+        for(;;)
+        {
+            const int beg = nextBeg_.fetch_add(grainSize_);
+            if(beg >= count_)
+                return;
+            (*func_)(beg, (std::min)(beg + grainSize_, count_), threadIndex);
+        }
+    }
+
+} // namespace clustering
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace clustering
+{
+
+    class ThreadPool
+    {
+    public:
+
+        // threadCount <= 0 means std::thread::hardware_concurrency()
+        explicit ThreadPool(int threadCount = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        int getThreadCount() const noexcept;
+
+        // func(beg, end, threadIndex) is called on disjoint chunks of
+        // [0, count) with at most grainSize items each. threadIndex is in
+        // [0, getThreadCount()) and can be used to address per-thread data.
+        // the calling thread participates and the call blocks until all
+        // chunks are done
+        void parallelFor(
+            int count,
+            int grainSize,
+            const std::function<void(int, int, int)> &func);
+
+    private:
+
+        void workerMain(int threadIndex);
+
+        void runChunks(int threadIndex);
+
+        std::vector<std::thread> workers_;
+
+        std::mutex              mutex_;
+        std::condition_variable startCond_;
+        std::condition_variable finishCond_;
+
+        bool     exit_;
+        uint64_t jobID_;
+        int      activeWorkers_;
+
+        const std::function<void(int, int, int)> *func_;
+        int              count_;
+        int              grainSize_;
+        std::atomic<int> nextBeg_;
+    };
+
+} // namespace clustering
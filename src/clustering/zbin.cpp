@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+#include "./zbin.h"
+
+namespace clustering
+{
+
+    namespace
+    {
+
+        // normalized plane n * p + d = 0 through the points whose ndc
+        // coordinate along axis (0: x, 1: y) is ndc. the positive side is
+        // ndc' >= ndc for sign = 1 and ndc' <= ndc for sign = -1
+        struct Plane
+        {
+            Float3 normal;
+            float  d = 0;
+        };
+
+        Plane getNDCPlane(const Mat4 &proj, int axis, float ndc, float sign)
+        {
+            // clip[axis] - ndc * clip.w >= 0
+
+            Float3 normal = {
+                proj.m[0][axis] - ndc * proj.m[0][3],
+                proj.m[1][axis] - ndc * proj.m[1][3],
+                proj.m[2][axis] - ndc * proj.m[2][3]
+            };
+            float d = proj.m[3][axis] - ndc * proj.m[3][3];
+
+            const float invLen = sign / normal.length();
+            normal = normal * invLen;
+            d *= invLen;
+
+            return { normal, d };
+        }
+
+        bool isSphereInFront(const Plane &plane, const Float3 &p, float r)
+        {
+            return dot(plane.normal, p) + plane.d > -r;
+        }
+
+    } // namespace anonymous
+
+    CPUZBinning::CPUZBinning(ThreadPool &threadPool)
+        : threadPool_(threadPool),
+          nearZ_(0), farZ_(0), view_(Mat4::identity()),
+          lights_(nullptr), lightCount_(0)
+    {
+
+    }
+
+    void CPUZBinning::setBinCount(const Int3 &count)
+    {
+        binCount_ = count;
+    }
+
+    void CPUZBinning::setProj(float nearZ, float farZ, const Mat4 &proj)
+    {
+        nearZ_ = nearZ;
+        farZ_  = farZ;
+        proj_  = proj;
+    }
+
+    void CPUZBinning::setView(const Mat4 &view)
+    {
+        view_ = view;
+    }
+
+    bool CPUZBinning::setLights(const Light *lights, size_t lightCount)
+    {
+        lights_     = lights;
+        lightCount_ = (std::min)(
+            lightCount, static_cast<size_t>(MAX_ZBIN_LIGHTS));
+        return canUseZBinning(lightCount);
+    }
+
+    void CPUZBinning::run()
+    {
+        sortLights();
+        fillZBins();
+        fillTileMasks();
+    }
+
+    const Int3 &CPUZBinning::getBinCount() const
+    {
+        return binCount_;
+    }
+
+    int CPUZBinning::getMaskWordCount() const
+    {
+        return static_cast<int>((lightCount_ + 31) / 32);
+    }
+
+    int CPUZBinning::getTileIndex(int tileX, int tileY) const
+    {
+        return tileX * binCount_.y + tileY;
+    }
+
+    int CPUZBinning::getZBinIndex(float viewZ) const
+    {
+        const int bi = viewZ2Bin(
+            getZBinSlicing(binCount_.z, nearZ_, farZ_), viewZ);
+        return 0 <= bi && bi < binCount_.z ? bi : -1;
+    }
+
+    void CPUZBinning::getLights(
+        int tileX, int tileY, float viewZ, std::vector<int32_t> &output) const
+    {
+        const int bi = getZBinIndex(viewZ);
+        if(bi < 0 || zBins_[bi] == ZBIN_EMPTY)
+            return;
+
+        const int minIndex = getZBinMin(zBins_[bi]);
+        const int maxIndex = getZBinMax(zBins_[bi]);
+
+        const int wordCount = getMaskWordCount();
+        const uint32_t *mask =
+            &tileMasks_[static_cast<size_t>(getTileIndex(tileX, tileY)) * wordCount];
+
+        for(int w = minIndex / 32; w <= maxIndex / 32; ++w)
+        {
+            uint32_t bits = mask[w];
+
+            // clip the first and last words to [minIndex, maxIndex]
+
+            if(w == minIndex / 32)
+                bits &= ~0u << (minIndex % 32);
+            if(w == maxIndex / 32)
+                bits &= ~0u >> (31 - maxIndex % 32);
+
+            while(bits)
+            {
+                const int bit = std::countr_zero(bits);
+                bits &= bits - 1;
+                output.push_back(sortedLightIndices_[w * 32 + bit]);
+            }
+        }
+    }
+
+    const std::vector<uint32_t> &CPUZBinning::getZBins() const
+    {
+        return zBins_;
+    }
+
+    const std::vector<uint32_t> &CPUZBinning::getTileMasks() const
+    {
+        return tileMasks_;
+    }
+
+    const std::vector<int32_t> &CPUZBinning::getSortedLightIndices() const
+    {
+        return sortedLightIndices_;
+    }
+
+    size_t CPUZBinning::getByteSize() const
+    {
+        return zBins_.size() * sizeof(uint32_t) +
+               tileMasks_.size() * sizeof(uint32_t) +
+               sortedLightIndices_.size() * sizeof(int32_t);
+    }
+
+    void CPUZBinning::sortLights()
+    {
+        const int lightCount = static_cast<int>(lightCount_);
+
+        viewZ_.resize(lightCount);
+        threadPool_.parallelFor(lightCount, 1024, [&](int beg, int end, int)
+        {
+            for(int i = beg; i < end; ++i)
+                viewZ_[i] = view_.transformPoint(lights_[i].lightPosition).z;
+        });
+
+        sortedLightIndices_.resize(lightCount);
+        std::iota(sortedLightIndices_.begin(), sortedLightIndices_.end(), 0);
+        std::sort(
+            sortedLightIndices_.begin(), sortedLightIndices_.end(),
+            [&](int32_t a, int32_t b)
+        {
+            return viewZ_[a] < viewZ_[b] || (viewZ_[a] == viewZ_[b] && a < b);
+        });
+
+        sortedPositions_.resize(lightCount);
+        sortedRadius_.resize(lightCount);
+        threadPool_.parallelFor(lightCount, 1024, [&](int beg, int end, int)
+        {
+            for(int s = beg; s < end; ++s)
+            {
+                const Light &light = lights_[sortedLightIndices_[s]];
+                sortedPositions_[s] = view_.transformPoint(light.lightPosition);
+                sortedRadius_[s]    = light.maxLightDistance;
+            }
+        });
+    }
+
+    void CPUZBinning::fillZBins()
+    {
+        const ZBinSlicing slicing = getZBinSlicing(binCount_.z, nearZ_, farZ_);
+
+        zBins_.assign(binCount_.z, ZBIN_EMPTY);
+
+        // lights come in increasing sorted index, so the first light of a bin
+        // is its min and the last one is its max
+
+        for(int s = 0; s < static_cast<int>(lightCount_); ++s)
+        {
+            const float z = sortedPositions_[s].z;
+            const float r = sortedRadius_[s];
+
+            const int b0 = viewZ2Bin(slicing, z - r);
+            const int b1 = viewZ2Bin(slicing, z + r);
+            if(b1 < 0 || b0 >= binCount_.z)
+                continue;
+
+            const uint32_t maxBits = static_cast<uint32_t>(s) << 16;
+            for(int bi = (std::max)(b0, 0);
+                bi <= (std::min)(b1, binCount_.z - 1); ++bi)
+            {
+                uint32_t &bin = zBins_[bi];
+                bin = bin == ZBIN_EMPTY ?
+                      (static_cast<uint32_t>(s) | maxBits) :
+                      ((bin & 0xffff) | maxBits);
+            }
+        }
+    }
+
+    void CPUZBinning::fillTileMasks()
+    {
+        const int lightCount = static_cast<int>(lightCount_);
+        const int wordCount  = getMaskWordCount();
+
+        columnMasks_.assign(static_cast<size_t>(binCount_.x) * wordCount, 0);
+        rowMasks_.assign(static_cast<size_t>(binCount_.y) * wordCount, 0);
+
+        // a tile is the intersection of its column and row, so a light
+        // overlapping the tile frustum passes both sets of side planes
+
+        threadPool_.parallelFor(
+            binCount_.x + binCount_.y, 1, [&](int beg, int end, int)
+        {
+            for(int line = beg; line < end; ++line)
+            {
+                const bool column = line < binCount_.x;
+                const int  axis   = column ? 0 : 1;
+                const int  li     = column ? line : line - binCount_.x;
+                const int  count  = column ? binCount_.x : binCount_.y;
+
+                const float ndc0 = 2.0f * li / count - 1;
+                const float ndc1 = 2.0f * (li + 1) / count - 1;
+
+                const Plane lower = getNDCPlane(proj_, axis, ndc0, 1);
+                const Plane upper = getNDCPlane(proj_, axis, ndc1, -1);
+
+                uint32_t *mask =
+                    (column ? columnMasks_.data() : rowMasks_.data()) +
+                    static_cast<size_t>(li) * wordCount;
+
+                for(int s = 0; s < lightCount; ++s)
+                {
+                    const Float3 &p = sortedPositions_[s];
+                    const float   r = sortedRadius_[s];
+                    if(isSphereInFront(lower, p, r) &&
+                       isSphereInFront(upper, p, r))
+                        mask[s / 32] |= 1u << (s % 32);
+                }
+            }
+        });
+
+        const int tileCount = binCount_.x * binCount_.y;
+        tileMasks_.resize(static_cast<size_t>(tileCount) * wordCount);
+
+        threadPool_.parallelFor(tileCount, 16, [&](int beg, int end, int)
+        {
+            for(int tile = beg; tile < end; ++tile)
+            {
+                const int xi = tile / binCount_.y;
+                const int yi = tile % binCount_.y;
+
+                const uint32_t *column =
+                    &columnMasks_[static_cast<size_t>(xi) * wordCount];
+                const uint32_t *row =
+                    &rowMasks_[static_cast<size_t>(yi) * wordCount];
+                uint32_t *mask =
+                    &tileMasks_[static_cast<size_t>(tile) * wordCount];
+
+                for(int w = 0; w < wordCount; ++w)
+                    mask[w] = column[w] & row[w];
+            }
+        });
+    }
+
+} // namespace clustering
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "./common.h"
+#include "./thread_pool.h"
+
+namespace clustering
+{
+
+    // z-binning: lights are sorted by view depth. each depth bin stores the
+    // range of sorted light indices overlapping it, and each screen tile
+    // stores a bitmask of the sorted lights overlapping its frustum. a pixel
+    // uses the lights of its bin range whose bits are set in its tile mask.
+    // memory is tiles * lights / 32 + bins words, instead of growing with
+    // clusters * lights like CPULightCluster
+
+    // bin ranges are packed as minIndex | (maxIndex << 16), so at most
+    // MAX_ZBIN_LIGHTS lights are binned. empty bins are ZBIN_EMPTY
+    constexpr int      MAX_ZBIN_LIGHTS = 0xffff;
+    constexpr uint32_t ZBIN_EMPTY      = 0x0000ffff;
+
+    // whether every light fits into the packed bin ranges. with more lights,
+    // use cluster lists instead
+    inline bool canUseZBinning(size_t lightCount)
+    {
+        return lightCount <= static_cast<size_t>(MAX_ZBIN_LIGHTS);
+    }
+
+    inline int getZBinMin(uint32_t bin)
+    {
+        return static_cast<int>(bin & 0xffff);
+    }
+
+    inline int getZBinMax(uint32_t bin)
+    {
+        return static_cast<int>(bin >> 16);
+    }
+
+    // same bin mapping as getZBinIndex in asset/clustered/forward.hlsl.
+    // bins are linear in view z over [nearZ, farZ]
+    struct ZBinSlicing
+    {
+        float nearZ = 0;
+        float scale = 0;
+    };
+
+    inline ZBinSlicing getZBinSlicing(int binCount, float nearZ, float farZ)
+    {
+        return { nearZ, binCount / (farZ - nearZ) };
+    }
+
+    inline int viewZ2Bin(const ZBinSlicing &slicing, float z)
+    {
+        return static_cast<int>(std::floor((z - slicing.nearZ) * slicing.scale));
+    }
+
+    class CPUZBinning
+    {
+    public:
+
+        explicit CPUZBinning(ThreadPool &threadPool);
+
+        // x, y: screen tiles, laid out like the x, y of cluster indices.
+        // z: depth bins
+        void setBinCount(const Int3 &count);
+
+        void setProj(float nearZ, float farZ, const Mat4 &proj);
+
+        void setView(const Mat4 &view);
+
+        // returns false if !canUseZBinning(lightCount). only the first
+        // MAX_ZBIN_LIGHTS lights are binned then, so the others go unshaded
+        bool setLights(const Light *lights, size_t lightCount);
+
+        void run();
+
+        const Int3 &getBinCount() const;
+
+        // 32-bit words per tile mask
+        int getMaskWordCount() const;
+
+        int getTileIndex(int tileX, int tileY) const;
+
+        // -1 if z is outside [nearZ, farZ)
+        int getZBinIndex(float viewZ) const;
+
+        // candidate lights of a pixel in the given tile at view depth z.
+        // original light indices are appended in depth-sorted order
+        void getLights(
+            int tileX, int tileY, float viewZ, std::vector<int32_t> &output) const;
+
+        // packed [min, max] sorted light index range of each bin
+        const std::vector<uint32_t> &getZBins() const;
+
+        // getMaskWordCount() words per tile, bit i of word w is sorted
+        // light w * 32 + i
+        const std::vector<uint32_t> &getTileMasks() const;
+
+        // sorted light index -> original light index
+        const std::vector<int32_t> &getSortedLightIndices() const;
+
+        // bins, tile masks and sorted light indices
+        size_t getByteSize() const;
+
+    private:
+
+        void sortLights();
+
+        void fillZBins();
+
+        void fillTileMasks();
+
+        ThreadPool &threadPool_;
+
+        Int3 binCount_;
+
+        float nearZ_;
+        float farZ_;
+        Mat4  proj_;
+
+        Mat4 view_;
+
+        const Light *lights_;
+        size_t       lightCount_;
+
+        // sort keys, in original order
+        std::vector<float> viewZ_;
+
+        // view space spheres, in sorted order
+        std::vector<Float3> sortedPositions_;
+        std::vector<float>  sortedRadius_;
+
+        // masks of tile columns and rows, anded into tile masks
+        std::vector<uint32_t> columnMasks_;
+        std::vector<uint32_t> rowMasks_;
+
+        std::vector<uint32_t> zBins_;
+        std::vector<uint32_t> tileMasks_;
+        std::vector<int32_t>  sortedLightIndices_;
+    };
+
+} // namespace clustering
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../clustering/object_lights.h"
+#include "./light.h"
+#include "./mesh.h"
+
+// conversions from the sample types to the types of src/clustering.
+// header only, samples using them link Clustering
+namespace common
+{
+
+    inline clustering::Float3 toClusteringFloat3(const Float3 &v)
+    {
+        return { v.x, v.y, v.z };
+    }
+
+    inline clustering::Mat4 toClusteringMat4(const Mat4 &m)
+    {
+        clustering::Mat4 result;
+        for(int r = 0; r < 4; ++r)
+        {
+            for(int c = 0; c < 4; ++c)
+                result.m[r][c] = m(r, c);
+        }
+        return result;
+    }
+
+    inline clustering::Light toClusteringLight(const PBSLight &light)
+    {
+        return clustering::Light{
+            .lightPosition    = toClusteringFloat3(light.lightPosition),
+            .maxLightDistance = light.maxLightDistance,
+            .lightIntensity   = toClusteringFloat3(light.lightIntensity),
+            .pad0             = 0,
+            .lightAmbient     = toClusteringFloat3(light.lightAmbient),
+            .pad1             = 0
+        };
+    }
+
+    inline std::vector<clustering::Light> toClusteringLights(
+        const PBSLight *lights, size_t count)
+    {
+        std::vector<clustering::Light> result(count);
+        for(size_t i = 0; i < count; ++i)
+            result[i] = toClusteringLight(lights[i]);
+        return result;
+    }
+
+    // world space bounding box of a mesh placed with world
+    inline clustering::AABB getWorldBounds(const Mesh &mesh, const Mat4 &world)
+    {
+        const clustering::AABB bounds = {
+            .lower = toClusteringFloat3(mesh.boundLower),
+            .upper = toClusteringFloat3(mesh.boundUpper)
+        };
+        return clustering::transformAABB(bounds, toClusteringMat4(world));
+    }
+
+} // namespace common
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <agz-utils/mesh.h>
 
 #include "./mesh.h"
@@ -31,6 +33,20 @@ namespace common
                 });
             }
         }
+
+        boundLower = Float3((std::numeric_limits<float>::max)());
+        boundUpper = Float3(std::numeric_limits<float>::lowest());
+        for(auto &v : vertexData)
+        {
+            boundLower = Float3(
+                (std::min)(boundLower.x, v.position.x),
+                (std::min)(boundLower.y, v.position.y),
+                (std::min)(boundLower.z, v.position.z));
+            boundUpper = Float3(
+                (std::max)(boundUpper.x, v.position.x),
+                (std::max)(boundUpper.y, v.position.y),
+                (std::max)(boundUpper.z, v.position.z));
+        }
     
         vertexBuffer.initializeDefault(
             d3d12.getResourceManager(),
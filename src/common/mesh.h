@@ -30,6 +30,10 @@ namespace common
             const std::string &metallic,
             const std::string &roughness);
     
+        // bounding box of the vertices in model space
+        Float3 boundLower;
+        Float3 boundUpper;
+
         VertexBuffer<Vertex> vertexBuffer;
         UniqueResource       albedo;
         UniqueResource       metallic;